@@ -0,0 +1,358 @@
+/* bench-corpus.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "bench-corpus"
+
+#include <string.h>
+
+#include "bench-corpus.h"
+
+/*
+ * Writes out what rg --json would print for a search for "needle", with
+ * the same message layout and field order rg uses. Everything is derived
+ * from a fixed seed so a corpus is the same from one run, and one
+ * release, to the next.
+ */
+
+#define NEEDLE  "needle"
+#define SEED    0x6c6c7966
+
+typedef struct
+{
+  GString *text;
+  GRand   *rand;
+  guint    n_lines;
+  guint    n_files;
+  guint    n_matches;
+  guint64  offset;
+} Writer;
+
+static const gchar * const kind_names[BENCH_CORPUS_N_KINDS] = {
+  [BENCH_CORPUS_MANY_FILES]   = "many-files",
+  [BENCH_CORPUS_MANY_MATCHES] = "many-matches",
+  [BENCH_CORPUS_LONG_LINES]   = "long-lines",
+  [BENCH_CORPUS_UNICODE]      = "unicode",
+};
+
+static const gchar * const unicode_samples[] = {
+  "Llyfrgell: chwilio am y " NEEDLE " yn y das wair, ŵ ŷ â ô",
+  "検索: 干し草の山から " NEEDLE " を探す",
+  "Ελληνικά: βρες τη " NEEDLE " στ' άχυρα",
+  "emoji 🔍 " NEEDLE " 🧵 in a 🌾 haystack, " NEEDLE " 🪡",
+  "Кириллица: иголка " NEEDLE " в стоге сена",
+};
+
+// Latin-1 rather than UTF-8, so rg hands it over as base64.
+static const gchar latin1_sample[] = "caf\xe9 " NEEDLE " na\xefve \xe0 la carte";
+
+const gchar*
+bench_corpus_kind_to_string (BenchCorpusKind kind)
+{
+  g_return_val_if_fail (kind < BENCH_CORPUS_N_KINDS, NULL);
+
+  return kind_names[kind];
+}
+
+gboolean
+bench_corpus_kind_from_string (const gchar     *name,
+                               BenchCorpusKind *kind)
+{
+  for (guint i = 0; i < BENCH_CORPUS_N_KINDS; i++) {
+    if (g_strcmp0 (name, kind_names[i]) == 0) {
+      *kind = i;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static void
+append_json_string (GString     *out,
+                    const gchar *text,
+                    gsize        length,
+                    gboolean     escape_unicode)
+{
+  const gchar *end = text + length;
+
+  g_string_append_c (out, '"');
+
+  while (text < end) {
+    guchar c = *text;
+
+    if (c == '"' || c == '\\') {
+      g_string_append_c (out, '\\');
+      g_string_append_c (out, c);
+    } else if (c == '\n') {
+      g_string_append (out, "\\n");
+    } else if (c == '\t') {
+      g_string_append (out, "\\t");
+    } else if (c < 0x20) {
+      g_string_append_printf (out, "\\u%04x", c);
+    } else if (c >= 0x80 && escape_unicode) {
+      gunichar ch = g_utf8_get_char (text);
+
+      if (ch > 0xffff) {
+        ch -= 0x10000;
+        g_string_append_printf (out, "\\u%04x\\u%04x", 0xd800 + (ch >> 10), 0xdc00 + (ch & 0x3ff));
+      } else {
+        g_string_append_printf (out, "\\u%04x", ch);
+      }
+
+      text = g_utf8_next_char (text);
+      continue;
+    } else {
+      g_string_append_c (out, c);
+    }
+
+    text++;
+  }
+
+  g_string_append_c (out, '"');
+}
+
+static void
+write_begin (Writer      *writer,
+             const gchar *path)
+{
+  g_string_append (writer->text, "{\"type\":\"begin\",\"data\":{\"path\":{\"text\":");
+  append_json_string (writer->text, path, strlen (path), FALSE);
+  g_string_append (writer->text, "}}}\n");
+
+  writer->n_lines++;
+  writer->n_files++;
+}
+
+/*
+ * Write a match for @line, which shouldn't end in a newline. Submatches
+ * are wherever the needle turns up in it.
+ */
+static void
+write_match (Writer      *writer,
+             const gchar *path,
+             gint64       line_number,
+             const gchar *line,
+             gboolean     escape_unicode,
+             gboolean     as_bytes)
+{
+  g_autofree gchar *contents = g_strconcat (line, "\n", NULL);
+  gsize length = strlen (contents);
+  const gchar *found = contents;
+  gboolean first = TRUE;
+
+  g_string_append (writer->text, "{\"type\":\"match\",\"data\":{\"path\":{\"text\":");
+  append_json_string (writer->text, path, strlen (path), FALSE);
+
+  if (as_bytes) {
+    g_autofree gchar *encoded = g_base64_encode ((const guchar *) contents, length);
+
+    g_string_append_printf (writer->text, "},\"lines\":{\"bytes\":\"%s\"}", encoded);
+  } else {
+    g_string_append (writer->text, "},\"lines\":{\"text\":");
+    append_json_string (writer->text, contents, length, escape_unicode);
+    g_string_append_c (writer->text, '}');
+  }
+
+  g_string_append_printf (writer->text,
+                          ",\"line_number\":%" G_GINT64_FORMAT ",\"absolute_offset\":%" G_GUINT64_FORMAT ",\"submatches\":[",
+                          line_number, writer->offset);
+
+  while ((found = strstr (found, NEEDLE)) != NULL) {
+    gsize start = found - contents;
+
+    g_string_append_printf (writer->text,
+                            "%s{\"match\":{\"text\":\"" NEEDLE "\"},\"start\":%" G_GSIZE_FORMAT ",\"end\":%" G_GSIZE_FORMAT "}",
+                            first ? "" : ",", start, start + strlen (NEEDLE));
+    found += strlen (NEEDLE);
+    first = FALSE;
+  }
+
+  g_string_append (writer->text, "]}}\n");
+
+  writer->offset += length + g_rand_int_range (writer->rand, 0, 4096);
+  writer->n_lines++;
+  writer->n_matches++;
+}
+
+static void
+write_end (Writer      *writer,
+           const gchar *path,
+           guint        n_matches)
+{
+  g_string_append (writer->text, "{\"type\":\"end\",\"data\":{\"path\":{\"text\":");
+  append_json_string (writer->text, path, strlen (path), FALSE);
+  g_string_append_printf (writer->text,
+                          "},\"binary_offset\":null,\"stats\":{\"elapsed\":{\"secs\":0,\"nanos\":12345,\"human\":\"0.000012s\"},"
+                          "\"searches\":1,\"searches_with_match\":1,\"bytes_searched\":%" G_GUINT64_FORMAT ","
+                          "\"bytes_printed\":4096,\"matched_lines\":%u,\"matches\":%u}}}\n",
+                          writer->offset, n_matches, n_matches);
+
+  writer->n_lines++;
+  writer->offset = 0;
+}
+
+static void
+write_summary (Writer *writer)
+{
+  g_string_append_printf (writer->text,
+                          "{\"data\":{\"elapsed_total\":{\"human\":\"0.123456s\",\"nanos\":123456000,\"secs\":0},"
+                          "\"stats\":{\"bytes_printed\":%" G_GSIZE_FORMAT ",\"bytes_searched\":0,"
+                          "\"elapsed\":{\"human\":\"0.000012s\",\"nanos\":12345,\"secs\":0},"
+                          "\"matched_lines\":%u,\"matches\":%u,\"searches\":%u,\"searches_with_match\":%u}},"
+                          "\"type\":\"summary\"}\n",
+                          writer->text->len, writer->n_matches, writer->n_matches, writer->n_files, writer->n_files);
+
+  writer->n_lines++;
+}
+
+static gchar*
+make_long_line (GRand *rand,
+                gsize  target)
+{
+  GString *line = g_string_sized_new (target + 32);
+
+  while (line->len < target) {
+    guint n = g_rand_int_range (rand, 0, 10000);
+
+    if (g_rand_int_range (rand, 0, 8) == 0)
+      g_string_append_printf (line, "var a%u=" NEEDLE "_%u(b,c);", n, n);
+    else
+      g_string_append_printf (line, "var a%u=f%u(b,\"c\");", n, n);
+  }
+
+  return g_string_free (line, FALSE);
+}
+
+static void
+write_file (Writer          *writer,
+            BenchCorpusKind  kind,
+            guint            file,
+            guint            n_matches)
+{
+  g_autofree gchar *path = NULL;
+  gint64 line_number = 0;
+
+  if (kind == BENCH_CORPUS_UNICODE)
+    path = g_strdup_printf ("/home/user/src/prosiect/dogfennau-%u/ffeil-ŵ-%u.md", file % 37, file);
+  else
+    path = g_strdup_printf ("/home/user/src/project/module-%u/file-%u.c", file % 37, file);
+
+  write_begin (writer, path);
+
+  for (guint match = 0; match < n_matches; match++) {
+    g_autofree gchar *line = NULL;
+
+    line_number += g_rand_int_range (writer->rand, 1, 20);
+
+    switch (kind) {
+      case BENCH_CORPUS_MANY_FILES:
+      case BENCH_CORPUS_MANY_MATCHES:
+        line = g_strdup_printf ("  if (query_matches (\"" NEEDLE "\", haystack[%u]))", match);
+        write_match (writer, path, line_number, line, FALSE, FALSE);
+        break;
+
+      case BENCH_CORPUS_LONG_LINES:
+        line = make_long_line (writer->rand, 2048 << (match % 4));
+        write_match (writer, path, line_number, line, FALSE, FALSE);
+        break;
+
+      case BENCH_CORPUS_UNICODE:
+        if (match % 16 == 15)
+          write_match (writer, path, line_number, latin1_sample, FALSE, TRUE);
+        else
+          write_match (writer, path, line_number,
+                       unicode_samples[g_rand_int_range (writer->rand, 0, G_N_ELEMENTS (unicode_samples))],
+                       match % 2 == 1, FALSE);
+        break;
+
+      default:
+        g_assert_not_reached ();
+    }
+  }
+
+  write_end (writer, path, n_matches);
+}
+
+/*
+ * Generate the corpus of @kind, @scale times its usual size.
+ */
+BenchCorpus*
+bench_corpus_generate (BenchCorpusKind kind,
+                       guint           scale)
+{
+  BenchCorpus *corpus;
+  Writer writer = { 0, };
+  guint n_files, n_matches;
+
+  g_return_val_if_fail (kind < BENCH_CORPUS_N_KINDS, NULL);
+
+  switch (kind) {
+    case BENCH_CORPUS_MANY_FILES:
+      n_files = 20000;
+      n_matches = 2;
+      break;
+
+    case BENCH_CORPUS_MANY_MATCHES:
+      n_files = 10;
+      n_matches = 10000;
+      break;
+
+    case BENCH_CORPUS_LONG_LINES:
+      n_files = 100;
+      n_matches = 8;
+      break;
+
+    case BENCH_CORPUS_UNICODE:
+      n_files = 2000;
+      n_matches = 20;
+      break;
+
+    default:
+      g_assert_not_reached ();
+  }
+
+  writer.text = g_string_new (NULL);
+  writer.rand = g_rand_new_with_seed (SEED + kind);
+
+  for (guint file = 0; file < n_files * MAX (scale, 1); file++)
+    write_file (&writer, kind, file, n_matches);
+
+  write_summary (&writer);
+  g_rand_free (writer.rand);
+
+  corpus = g_new0 (BenchCorpus, 1);
+  corpus->kind = kind;
+  corpus->n_lines = writer.n_lines;
+  corpus->n_files = writer.n_files;
+  corpus->n_matches = writer.n_matches;
+  corpus->text = g_string_free_to_bytes (writer.text);
+
+  return corpus;
+}
+
+void
+bench_corpus_free (BenchCorpus *corpus)
+{
+  if (corpus == NULL)
+    return;
+
+  g_bytes_unref (corpus->text);
+  g_free (corpus);
+}
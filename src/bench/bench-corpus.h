@@ -0,0 +1,72 @@
+/* bench-corpus.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef BENCH_CORPUS_H
+#define BENCH_CORPUS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Synthetic rg --json output, each shaped to stress a different part of
+ * turning it into results.
+ */
+typedef enum
+{
+  // Lots of files with a couple of short matches each.
+  BENCH_CORPUS_MANY_FILES,
+  // A handful of files with thousands of matches each.
+  BENCH_CORPUS_MANY_MATCHES,
+  // Minified looking lines, kilobytes long with many submatches.
+  BENCH_CORPUS_LONG_LINES,
+  // Multi-byte text, \u escapes, surrogate pairs and lines rg had to
+  // base64 encode as they weren't valid UTF-8.
+  BENCH_CORPUS_UNICODE,
+  BENCH_CORPUS_N_KINDS,
+} BenchCorpusKind;
+
+/*
+ * A generated corpus, its text along with what it's expected to produce.
+ */
+typedef struct
+{
+  BenchCorpusKind kind;
+  GBytes         *text;
+  guint           n_lines;
+  guint           n_files;
+  guint           n_matches;
+} BenchCorpus;
+
+const gchar* bench_corpus_kind_to_string   (BenchCorpusKind kind);
+
+gboolean     bench_corpus_kind_from_string (const gchar *name,
+                                            BenchCorpusKind *kind);
+
+BenchCorpus* bench_corpus_generate         (BenchCorpusKind kind,
+                                            guint scale);
+
+void         bench_corpus_free             (BenchCorpus *corpus);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (BenchCorpus, bench_corpus_free)
+
+G_END_DECLS
+
+#endif /* BENCH_CORPUS_H */
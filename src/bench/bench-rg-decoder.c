@@ -0,0 +1,175 @@
+/* bench-rg-decoder.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "bench-rg-decoder"
+
+#include <string.h>
+#include <json-glib/json-glib.h>
+
+#include "llyfr-rg-decoder.h"
+
+/*
+ * Compares decoding rg --json output with json-glib, the way the search
+ * context used to, against the dedicated rg decoder.
+ */
+
+#define N_FILES        2000
+#define N_MATCHES      25
+
+static GPtrArray*
+generate_corpus (void)
+{
+  GPtrArray *lines = g_ptr_array_new_with_free_func (g_free);
+
+  for (guint file = 0; file < N_FILES; file++) {
+    g_autofree gchar *path = g_strdup_printf ("/home/user/src/project/module-%u/file-%u.c", file % 37, file);
+
+    g_ptr_array_add (lines, g_strdup_printf ("{\"type\":\"begin\",\"data\":{\"path\":{\"text\":\"%s\"}}}", path));
+
+    for (guint match = 0; match < N_MATCHES; match++) {
+      g_ptr_array_add (lines,
+                       g_strdup_printf ("{\"type\":\"match\",\"data\":{\"path\":{\"text\":\"%s\"},"
+                                        "\"lines\":{\"text\":\"  if (query_matches (\\\"needle\\\", haystack[%u]))\\n\"},"
+                                        "\"line_number\":%u,\"absolute_offset\":%u,"
+                                        "\"submatches\":[{\"match\":{\"text\":\"needle\"},\"start\":22,\"end\":28}]}}",
+                                        path, match, match * 7 + 1, match * 300));
+    }
+
+    g_ptr_array_add (lines,
+                     g_strdup_printf ("{\"type\":\"end\",\"data\":{\"path\":{\"text\":\"%s\"},\"binary_offset\":null,"
+                                      "\"stats\":{\"elapsed\":{\"secs\":0,\"nanos\":12345,\"human\":\"0.000012s\"},"
+                                      "\"searches\":1,\"searches_with_match\":1,\"bytes_searched\":4096,"
+                                      "\"bytes_printed\":2048,\"matched_lines\":%u,\"matches\":%u}}}",
+                                      path, N_MATCHES, N_MATCHES));
+  }
+
+  return lines;
+}
+
+static gint64
+decode_json_glib (GPtrArray *lines)
+{
+  gint64 checksum = 0;
+
+  for (guint i = 0; i < lines->len; i++) {
+    const gchar *line = g_ptr_array_index (lines, i);
+    g_autoptr(JsonParser) parser = json_parser_new ();
+    g_autoptr(JsonReader) reader = NULL;
+
+    if (!json_parser_load_from_data (parser, line, -1, NULL))
+      continue;
+
+    reader = json_reader_new (json_parser_get_root (parser));
+
+    json_reader_read_member (reader, "type");
+    if (g_strcmp0 (json_reader_get_string_value (reader), "match") != 0)
+      continue;
+    json_reader_end_member (reader);
+
+    json_reader_read_member (reader, "data");
+
+    json_reader_read_member (reader, "lines");
+    json_reader_read_member (reader, "text");
+    checksum += strlen (json_reader_get_string_value (reader));
+    json_reader_end_member (reader);
+    json_reader_end_member (reader);
+
+    json_reader_read_member (reader, "line_number");
+    checksum += json_reader_get_int_value (reader);
+    json_reader_end_member (reader);
+
+    json_reader_read_member (reader, "submatches");
+    for (gint j = 0; j < json_reader_count_elements (reader); j++) {
+      json_reader_read_element (reader, j);
+
+      json_reader_read_member (reader, "start");
+      checksum += json_reader_get_int_value (reader);
+      json_reader_end_member (reader);
+
+      json_reader_read_member (reader, "end");
+      checksum += json_reader_get_int_value (reader);
+      json_reader_end_member (reader);
+
+      json_reader_end_element (reader);
+    }
+    json_reader_end_member (reader);
+  }
+
+  return checksum;
+}
+
+static gint64
+decode_rg (GPtrArray *lines)
+{
+  LlyfrRgMessage message;
+  gint64 checksum = 0;
+
+  llyfr_rg_message_init (&message);
+
+  for (guint i = 0; i < lines->len; i++) {
+    const gchar *line = g_ptr_array_index (lines, i);
+    gsize length = strlen (line);
+    g_autofree gchar *copy = g_strndup (line, length);
+
+    if (!llyfr_rg_decode_line (copy, length, &message, NULL))
+      continue;
+
+    if (message.type != LLYFR_RG_MESSAGE_MATCH)
+      continue;
+
+    checksum += message.text_length + message.line_number;
+    for (guint j = 0; j < message.submatches->len; j++)
+      checksum += g_array_index (message.submatches, gint64, j);
+  }
+
+  llyfr_rg_message_clear (&message);
+  return checksum;
+}
+
+static void
+run (const gchar *name,
+     gint64     (*decode) (GPtrArray *lines),
+     GPtrArray   *lines)
+{
+  gint64 start, elapsed, checksum;
+
+  start = g_get_monotonic_time ();
+  checksum = decode (lines);
+  elapsed = MAX (g_get_monotonic_time () - start, 1);
+
+  g_print ("%-10s %8u lines in %8.2f ms, %12.0f lines/s (checksum %" G_GINT64_FORMAT ")\n",
+           name,
+           lines->len,
+           elapsed / 1000.0,
+           lines->len / (elapsed / (gdouble) G_USEC_PER_SEC),
+           checksum);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_autoptr(GPtrArray) lines = generate_corpus ();
+
+  run ("json-glib", decode_json_glib, lines);
+  run ("rg", decode_rg, lines);
+
+  return 0;
+}
@@ -0,0 +1,479 @@
+/* bench-search.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "bench-search"
+
+#include <string.h>
+#include <json-glib/json-glib.h>
+
+#include "llyfr-config.h"
+#include "bench-corpus.h"
+#include "llyfr-result-row.h"
+#include "llyfr-rg-backend.h"
+#include "llyfr-rg-decoder.h"
+#include "llyfr-search-arena.h"
+#include "llyfr-search-result.h"
+
+/*
+ * Measures each step between rg printing a line of --json output and the
+ * result it belongs to being ready to draw, for each of the corpora in
+ * bench-corpus.c:
+ *  - parse: lines/s through llyfr_rg_backend_read(), with both decoders,
+ *  - add_match: building results from lines that have already been
+ *    decoded, which is all llyfr_search_result_add_match_full() bar one
+ *    allocation per file,
+ *  - memory: the bytes held on to per match once results are built,
+ *  - text: building the text and attributes a result row draws.
+ * Each step is run a few times and the fastest kept. The numbers are
+ * written out as JSON so runs from different releases can be compared.
+ */
+
+static gint scale = 1;
+static gint iterations = 3;
+static gchar **corpora = NULL;
+static gchar *output = NULL;
+static gchar *dump = NULL;
+
+static const GOptionEntry entries[] = {
+  { "scale", 's', 0, G_OPTION_ARG_INT, &scale, "Make each corpus N times bigger", "N" },
+  { "iterations", 'i', 0, G_OPTION_ARG_INT, &iterations, "Run each step N times, keeping the fastest", "N" },
+  { "corpus", 'c', 0, G_OPTION_ARG_STRING_ARRAY, &corpora, "Only run the given corpus, may be repeated", "NAME" },
+  { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output, "Write the results to FILE rather than stdout", "FILE" },
+  { "dump", 0, 0, G_OPTION_ARG_STRING, &dump, "Print the given corpus and exit", "NAME" },
+  { NULL }
+};
+
+/*
+ * A line of the corpus, decoded up front so building results can be
+ * timed on its own.
+ */
+typedef struct
+{
+  LlyfrRgMessageType  type;
+  gchar              *path;
+  gchar              *text;
+  gint64              line_number;
+  GArray             *submatches;
+} DecodedLine;
+
+static void
+decoded_line_free (gpointer data)
+{
+  DecodedLine *line = data;
+
+  g_free (line->path);
+  g_free (line->text);
+  g_clear_pointer (&line->submatches, g_array_unref);
+  g_free (line);
+}
+
+static GPtrArray*
+decode_corpus (BenchCorpus *corpus)
+{
+  GPtrArray *lines = g_ptr_array_new_with_free_func (decoded_line_free);
+  g_auto(GStrv) split = NULL;
+  LlyfrRgMessage message;
+  gsize size;
+  const gchar *data = g_bytes_get_data (corpus->text, &size);
+  g_autofree gchar *text = g_strndup (data, size);
+
+  split = g_strsplit (text, "\n", -1);
+  llyfr_rg_message_init (&message);
+
+  for (guint i = 0; split[i] != NULL; i++) {
+    g_autoptr(GError) error = NULL;
+    DecodedLine *line;
+
+    if (split[i][0] == '\0')
+      continue;
+
+    if (!llyfr_rg_decode_line (split[i], strlen (split[i]), &message, &error))
+      g_error ("Unable to decode corpus: %s", error->message);
+
+    if (message.type != LLYFR_RG_MESSAGE_BEGIN &&
+        message.type != LLYFR_RG_MESSAGE_MATCH &&
+        message.type != LLYFR_RG_MESSAGE_END)
+      continue;
+
+    line = g_new0 (DecodedLine, 1);
+    line->type = message.type;
+
+    if (message.type == LLYFR_RG_MESSAGE_BEGIN)
+      line->path = g_strndup (message.path, message.path_length);
+
+    if (message.type == LLYFR_RG_MESSAGE_MATCH) {
+      // The same as the backend does for lines that arrived as base64.
+      line->line_number = message.line_number;
+      // Without g_array_copy(), which needs GLib 2.62.
+      line->submatches = g_array_sized_new (FALSE, FALSE,
+                                            g_array_get_element_size (message.submatches),
+                                            message.submatches->len);
+      g_array_append_vals (line->submatches, message.submatches->data, message.submatches->len);
+
+      if (g_utf8_validate (message.text, message.text_length, NULL))
+        line->text = g_strndup (message.text, message.text_length);
+      else
+        line->text = llyfr_search_result_make_valid (message.text,
+                                                     message.text_length,
+                                                     (gint64 *) line->submatches->data,
+                                                     line->submatches->len / 2);
+    }
+
+    g_ptr_array_add (lines, line);
+  }
+
+  llyfr_rg_message_clear (&message);
+  return lines;
+}
+
+static guint
+count_matches (GListModel *results)
+{
+  guint n_matches = 0;
+
+  for (guint i = 0; i < g_list_model_get_n_items (results); i++) {
+    g_autoptr(LlyfrSearchResult) result = g_list_model_get_item (results, i);
+
+    n_matches += llyfr_search_result_get_n_matches (result);
+  }
+
+  return n_matches;
+}
+
+/*
+ * Feed @corpus through the rg backend, returning how long it took. The
+ * results are left in @store.
+ */
+static gint64
+parse_corpus (BenchCorpus        *corpus,
+              LlyfrSearchDecoder  decoder,
+              GListStore         *store,
+              LlyfrSearchArena   *arena)
+{
+  g_autoptr(LlyfrSearchBackend) backend = llyfr_rg_backend_new ();
+  g_autoptr(GInputStream) input = g_memory_input_stream_new_from_bytes (corpus->text);
+  g_autoptr(LlyfrResultSink) sink = llyfr_result_sink_new (store);
+  g_autoptr(GError) error = NULL;
+  gint64 start;
+
+  llyfr_rg_backend_set_decoder (LLYFR_RG_BACKEND (backend), decoder);
+
+  start = g_get_monotonic_time ();
+
+  if (!llyfr_rg_backend_read (LLYFR_RG_BACKEND (backend), input, sink, arena, NULL, &error))
+    g_error ("Unable to parse corpus: %s", error->message);
+
+  llyfr_result_sink_flush (sink);
+
+  return MAX (g_get_monotonic_time () - start, 1);
+}
+
+static void
+add_parse (JsonBuilder        *builder,
+           const gchar        *name,
+           BenchCorpus        *corpus,
+           LlyfrSearchDecoder  decoder,
+           GListStore        **results,
+           LlyfrSearchArena  **arena)
+{
+  gint64 best = G_MAXINT64;
+  gdouble seconds;
+
+  for (gint i = 0; i < iterations; i++) {
+    g_autoptr(GListStore) store = g_list_store_new (LLYFR_TYPE_SEARCH_RESULT);
+    g_autoptr(LlyfrSearchArena) store_arena = llyfr_search_arena_new ();
+    gint64 elapsed = parse_corpus (corpus, decoder, store, store_arena);
+
+    // Anything lost or made up along the way makes the numbers meaningless.
+    if (g_list_model_get_n_items (G_LIST_MODEL (store)) != corpus->n_files ||
+        count_matches (G_LIST_MODEL (store)) != corpus->n_matches)
+      g_error ("%s: expected %u files and %u matches, got %u and %u",
+               bench_corpus_kind_to_string (corpus->kind),
+               corpus->n_files, corpus->n_matches,
+               g_list_model_get_n_items (G_LIST_MODEL (store)),
+               count_matches (G_LIST_MODEL (store)));
+
+    best = MIN (best, elapsed);
+
+    if (results != NULL) {
+      g_set_object (results, store);
+      g_clear_pointer (arena, llyfr_search_arena_unref);
+      *arena = g_steal_pointer (&store_arena);
+    }
+  }
+
+  seconds = best / (gdouble) G_USEC_PER_SEC;
+
+  json_builder_set_member_name (builder, name);
+  json_builder_begin_object (builder);
+  json_builder_set_member_name (builder, "seconds");
+  json_builder_add_double_value (builder, seconds);
+  json_builder_set_member_name (builder, "lines_per_second");
+  json_builder_add_double_value (builder, corpus->n_lines / seconds);
+  json_builder_set_member_name (builder, "bytes_per_second");
+  json_builder_add_double_value (builder, g_bytes_get_size (corpus->text) / seconds);
+  json_builder_end_object (builder);
+}
+
+static void
+add_add_match (JsonBuilder *builder,
+               BenchCorpus *corpus)
+{
+  g_autoptr(GPtrArray) lines = decode_corpus (corpus);
+  gint64 best = G_MAXINT64;
+
+  for (gint i = 0; i < iterations; i++) {
+    g_autoptr(LlyfrSearchArena) arena = llyfr_search_arena_new ();
+    g_autoptr(GPtrArray) results = g_ptr_array_new_with_free_func (g_object_unref);
+    LlyfrSearchResult *current = NULL;
+    gint64 start = g_get_monotonic_time ();
+
+    for (guint j = 0; j < lines->len; j++) {
+      DecodedLine *line = g_ptr_array_index (lines, j);
+
+      switch (line->type) {
+        case LLYFR_RG_MESSAGE_BEGIN:
+          current = llyfr_search_result_new_in_arena (arena, line->path);
+          g_ptr_array_add (results, current);
+          break;
+
+        case LLYFR_RG_MESSAGE_MATCH:
+          llyfr_search_result_add_match_full (current,
+                                              line->line_number,
+                                              line->text,
+                                              (const gint64 *) line->submatches->data,
+                                              line->submatches->len / 2);
+          break;
+
+        case LLYFR_RG_MESSAGE_END:
+          llyfr_search_result_end (current);
+          break;
+
+        default:
+          break;
+      }
+    }
+
+    best = MIN (best, MAX (g_get_monotonic_time () - start, 1));
+  }
+
+  json_builder_set_member_name (builder, "add_match");
+  json_builder_begin_object (builder);
+  json_builder_set_member_name (builder, "seconds");
+  json_builder_add_double_value (builder, best / (gdouble) G_USEC_PER_SEC);
+  json_builder_set_member_name (builder, "nanoseconds_per_match");
+  json_builder_add_double_value (builder, best * 1000.0 / MAX (corpus->n_matches, 1));
+  json_builder_end_object (builder);
+}
+
+static void
+add_memory (JsonBuilder      *builder,
+            BenchCorpus      *corpus,
+            GListModel       *results,
+            LlyfrSearchArena *arena)
+{
+  guint n_matches = MAX (corpus->n_matches, 1);
+  guint64 retained = 0;
+
+  for (guint i = 0; i < g_list_model_get_n_items (results); i++) {
+    g_autoptr(LlyfrSearchResult) result = g_list_model_get_item (results, i);
+
+    retained += llyfr_search_result_get_size (result);
+  }
+
+  json_builder_set_member_name (builder, "memory");
+  json_builder_begin_object (builder);
+  json_builder_set_member_name (builder, "bytes_per_match");
+  json_builder_add_double_value (builder, retained / (gdouble) n_matches);
+  json_builder_set_member_name (builder, "arena_bytes_per_match");
+  json_builder_add_double_value (builder, llyfr_search_arena_get_size (arena) / (gdouble) n_matches);
+  json_builder_end_object (builder);
+}
+
+static void
+add_text (JsonBuilder *builder,
+          BenchCorpus *corpus,
+          GListModel  *results)
+{
+  guint n_results = g_list_model_get_n_items (results);
+  gint64 best = G_MAXINT64;
+  guint64 cost = 0;
+
+  for (gint i = 0; i < iterations; i++) {
+    gint64 start = g_get_monotonic_time ();
+
+    cost = 0;
+
+    for (guint j = 0; j < n_results; j++) {
+      g_autoptr(LlyfrSearchResult) result = g_list_model_get_item (results, j);
+      gsize text_cost = 0;
+
+      llyfr_result_text_free (llyfr_result_text_new (result, &text_cost));
+      cost += text_cost;
+    }
+
+    best = MIN (best, MAX (g_get_monotonic_time () - start, 1));
+  }
+
+  json_builder_set_member_name (builder, "text");
+  json_builder_begin_object (builder);
+  json_builder_set_member_name (builder, "seconds");
+  json_builder_add_double_value (builder, best / (gdouble) G_USEC_PER_SEC);
+  json_builder_set_member_name (builder, "nanoseconds_per_result");
+  json_builder_add_double_value (builder, best * 1000.0 / MAX (n_results, 1));
+  json_builder_set_member_name (builder, "nanoseconds_per_match");
+  json_builder_add_double_value (builder, best * 1000.0 / MAX (corpus->n_matches, 1));
+  json_builder_set_member_name (builder, "bytes_per_match");
+  json_builder_add_double_value (builder, cost / (gdouble) MAX (corpus->n_matches, 1));
+  json_builder_end_object (builder);
+}
+
+static void
+run_corpus (JsonBuilder     *builder,
+            BenchCorpusKind  kind)
+{
+  g_autoptr(BenchCorpus) corpus = bench_corpus_generate (kind, scale);
+  g_autoptr(GListStore) results = NULL;
+  g_autoptr(LlyfrSearchArena) arena = NULL;
+
+  g_printerr ("%s: %u lines, %u files, %u matches\n",
+              bench_corpus_kind_to_string (kind),
+              corpus->n_lines, corpus->n_files, corpus->n_matches);
+
+  json_builder_set_member_name (builder, bench_corpus_kind_to_string (kind));
+  json_builder_begin_object (builder);
+
+  json_builder_set_member_name (builder, "lines");
+  json_builder_add_int_value (builder, corpus->n_lines);
+  json_builder_set_member_name (builder, "bytes");
+  json_builder_add_int_value (builder, g_bytes_get_size (corpus->text));
+  json_builder_set_member_name (builder, "files");
+  json_builder_add_int_value (builder, corpus->n_files);
+  json_builder_set_member_name (builder, "matches");
+  json_builder_add_int_value (builder, corpus->n_matches);
+
+  add_parse (builder, "parse", corpus, LLYFR_SEARCH_DECODER_RG, &results, &arena);
+
+  // The json-glib decoder only understands lines given as text, not the
+  // base64 ones in the unicode corpus.
+  if (kind != BENCH_CORPUS_UNICODE)
+    add_parse (builder, "parse_json_glib", corpus, LLYFR_SEARCH_DECODER_JSON_GLIB, NULL, NULL);
+
+  add_add_match (builder, corpus);
+  add_memory (builder, corpus, G_LIST_MODEL (results), arena);
+  add_text (builder, corpus, G_LIST_MODEL (results));
+
+  json_builder_end_object (builder);
+}
+
+static gboolean
+selected (BenchCorpusKind kind)
+{
+  if (corpora == NULL)
+    return TRUE;
+
+  return g_strv_contains ((const gchar * const *) corpora, bench_corpus_kind_to_string (kind));
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_autoptr(GOptionContext) context = NULL;
+  g_autoptr(JsonBuilder) builder = NULL;
+  g_autoptr(JsonGenerator) generator = NULL;
+  g_autoptr(JsonNode) root = NULL;
+  g_autoptr(GError) error = NULL;
+  BenchCorpusKind kind;
+
+  context = g_option_context_new ("- benchmark turning rg output into results");
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error)) {
+    g_printerr ("%s\n", error->message);
+    return 1;
+  }
+
+  for (guint i = 0; corpora != NULL && corpora[i] != NULL; i++) {
+    if (!bench_corpus_kind_from_string (corpora[i], &kind)) {
+      g_printerr ("Unknown corpus '%s'\n", corpora[i]);
+      return 1;
+    }
+  }
+
+  if (dump != NULL) {
+    g_autoptr(BenchCorpus) corpus = NULL;
+    gsize size;
+    const gchar *data;
+
+    if (!bench_corpus_kind_from_string (dump, &kind)) {
+      g_printerr ("Unknown corpus '%s'\n", dump);
+      return 1;
+    }
+
+    corpus = bench_corpus_generate (kind, scale);
+    data = g_bytes_get_data (corpus->text, &size);
+    fwrite (data, 1, size, stdout);
+
+    return 0;
+  }
+
+  scale = MAX (scale, 1);
+  iterations = MAX (iterations, 1);
+
+  builder = json_builder_new ();
+  json_builder_begin_object (builder);
+
+  json_builder_set_member_name (builder, "version");
+  json_builder_add_string_value (builder, PACKAGE_VERSION);
+  json_builder_set_member_name (builder, "scale");
+  json_builder_add_int_value (builder, scale);
+  json_builder_set_member_name (builder, "iterations");
+  json_builder_add_int_value (builder, iterations);
+
+  json_builder_set_member_name (builder, "corpora");
+  json_builder_begin_object (builder);
+
+  for (kind = 0; kind < BENCH_CORPUS_N_KINDS; kind++) {
+    if (selected (kind))
+      run_corpus (builder, kind);
+  }
+
+  json_builder_end_object (builder);
+  json_builder_end_object (builder);
+
+  root = json_builder_get_root (builder);
+  generator = json_generator_new ();
+  json_generator_set_pretty (generator, TRUE);
+  json_generator_set_root (generator, root);
+
+  if (output != NULL) {
+    if (!json_generator_to_file (generator, output, &error)) {
+      g_printerr ("Unable to write %s: %s\n", output, error->message);
+      return 1;
+    }
+  } else {
+    g_autofree gchar *text = json_generator_to_data (generator, NULL);
+
+    g_print ("%s\n", text);
+  }
+
+  return 0;
+}
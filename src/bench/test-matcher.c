@@ -0,0 +1,100 @@
+/* test-matcher.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "test-matcher"
+
+#include <string.h>
+
+#include "llyfr-matcher.h"
+#include "llyfr-search-arena.h"
+
+/*
+ * Checks the native backend's matcher finds what rg would in a single
+ * line, in particular that a regex matches characters rather than bytes.
+ */
+
+typedef struct
+{
+  const gchar *query;
+  const gchar *line;
+  // The highlighted part of the line, or NULL if it shouldn't match.
+  const gchar *highlight;
+} MatchTest;
+
+static const MatchTest match_tests[] = {
+  { "needle",      "a needle in a haystack", "needle" },
+  { "caf.",        "café au lait",           "café" },
+  { "^.{4} ",      "café au lait",           "café " },
+  { "^\\w+",       "ŵyn bach",               "ŵyn" },
+  { "[^a-z]yn",    "ŵyn bach",               "ŵyn" },
+  { "c.f",         "cafe\n",                 "caf" },
+  { "^.{5}$",      "café",                   NULL },
+  { "needle\\s+x", "needle\nx",              NULL },
+  // Not valid UTF-8, so matched a byte at a time.
+  { "caf.",        "caf\xe9 au lait",        "caf\xef\xbf\xbd" },
+};
+
+static void
+test_match (gconstpointer data)
+{
+  const MatchTest *test = data;
+  g_autoptr(LlyfrSearchArena) arena = llyfr_search_arena_new ();
+  g_autoptr(LlyfrMatcher) matcher = NULL;
+  g_autoptr(LlyfrSearchResult) result = NULL;
+  g_autoptr(GError) error = NULL;
+  const LlyfrSearchSpan *spans;
+  const gchar *text;
+  guint n_spans;
+
+  matcher = llyfr_matcher_new (test->query, &error);
+  g_assert_no_error (error);
+
+  result = llyfr_matcher_scan (matcher, arena, "test.txt", test->line, strlen (test->line));
+
+  if (test->highlight == NULL) {
+    g_assert_null (result);
+    return;
+  }
+
+  g_assert_nonnull (result);
+  g_assert_cmpuint (llyfr_search_result_get_n_matches (result), ==, 1);
+
+  text = llyfr_search_result_get_match_text (result, 0, NULL);
+  spans = llyfr_search_result_get_match_highlights (result, 0, &n_spans);
+
+  g_assert_cmpuint (n_spans, ==, 1);
+  g_assert_cmpmem (text + spans[0].start, spans[0].end - spans[0].start,
+                   test->highlight, strlen (test->highlight));
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  for (guint i = 0; i < G_N_ELEMENTS (match_tests); i++) {
+    g_autofree gchar *path = g_strdup_printf ("/matcher/match/%u", i);
+
+    g_test_add_data_func (path, &match_tests[i], test_match);
+  }
+
+  return g_test_run ();
+}
@@ -0,0 +1,99 @@
+/* test-memory-stats.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "test-memory-stats"
+
+#include <gio/gio.h>
+
+#include "bench-corpus.h"
+#include "llyfr-memory-stats.h"
+#include "llyfr-result-sink.h"
+#include "llyfr-rg-backend.h"
+#include "llyfr-search-arena.h"
+#include "llyfr-search-result.h"
+
+/*
+ * Feeds the short line corpora from bench-corpus.c through the rg backend
+ * and checks the memory counters against what was decoded. The lines in
+ * them are all under 64 bytes, so anything more than this per match
+ * means the matches have grown some overhead.
+ */
+
+#define MAX_BYTES_PER_MATCH 96
+
+static void
+test_bytes_per_match (gconstpointer data)
+{
+  BenchCorpusKind kind = GPOINTER_TO_UINT (data);
+  g_autoptr(BenchCorpus) corpus = bench_corpus_generate (kind, 1);
+  g_autoptr(LlyfrSearchBackend) backend = llyfr_rg_backend_new ();
+  g_autoptr(GInputStream) input = g_memory_input_stream_new_from_bytes (corpus->text);
+  g_autoptr(LlyfrSearchArena) arena = llyfr_search_arena_new ();
+  g_autoptr(GError) error = NULL;
+  LlyfrResultSink *sink;
+  GListStore *store;
+  guint64 matches, bytes;
+
+  store = g_list_store_new (LLYFR_TYPE_SEARCH_RESULT);
+  sink = llyfr_result_sink_new (store);
+
+  llyfr_rg_backend_read (LLYFR_RG_BACKEND (backend), input, sink, arena, NULL, &error);
+  g_assert_no_error (error);
+  llyfr_result_sink_flush (sink);
+
+  matches = llyfr_memory_stats_get (LLYFR_MEMORY_MATCHES);
+  bytes = llyfr_memory_stats_get (LLYFR_MEMORY_TEXT_BYTES) +
+          llyfr_memory_stats_get (LLYFR_MEMORY_HIGHLIGHT_BYTES);
+
+  g_assert_cmpuint (llyfr_memory_stats_get (LLYFR_MEMORY_RESULTS), ==, corpus->n_files);
+  g_assert_cmpuint (matches, ==, corpus->n_matches);
+  g_assert_cmpuint (bytes, <=, matches * MAX_BYTES_PER_MATCH);
+
+  g_test_message ("%s: %.1f bytes per match",
+                  bench_corpus_kind_to_string (kind), bytes / (gdouble) matches);
+
+  // Everything counted is given back once the results have gone.
+  g_object_unref (sink);
+  g_object_unref (store);
+
+  for (guint counter = 0; counter < LLYFR_MEMORY_N_COUNTERS; counter++)
+    g_assert_cmpuint (llyfr_memory_stats_get (counter), ==, 0);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  const BenchCorpusKind kinds[] = {
+    BENCH_CORPUS_MANY_FILES,
+    BENCH_CORPUS_MANY_MATCHES,
+    BENCH_CORPUS_UNICODE,
+  };
+
+  g_test_init (&argc, &argv, NULL);
+
+  for (guint i = 0; i < G_N_ELEMENTS (kinds); i++) {
+    g_autofree gchar *path = g_strdup_printf ("/memory-stats/%s", bench_corpus_kind_to_string (kinds[i]));
+
+    g_test_add_data_func (path, GUINT_TO_POINTER (kinds[i]), test_bytes_per_match);
+  }
+
+  return g_test_run ();
+}
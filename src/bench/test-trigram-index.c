@@ -0,0 +1,93 @@
+/* test-trigram-index.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "test-trigram-index"
+
+#include "llyfr-trigram-index.h"
+
+/*
+ * Checks the trigrams the index asks for against the queries they came
+ * from. Asking for one a match could do without would leave files out of
+ * the search, so anything unclear has to come back as NULL.
+ */
+
+typedef struct
+{
+  const gchar *query;
+  // The literal the query should need the same trigrams as, or NULL if it
+  // can't be used to narrow the search at all.
+  const gchar *literal;
+} ExtractTest;
+
+static const ExtractTest extract_tests[] = {
+  { "needle",               "needle" },
+  { "[abc]needle",          "needle" },
+  { "[]x]needle",           "needle" },
+  { "[^]x]needle",          "needle" },
+  { "[\\]x]needle",         "needle" },
+  { "[[:digit:]]needle",    "needle" },
+  { "[^[:space:]]needle",   "needle" },
+  { "[a[:alpha:]z]needle",  "needle" },
+  { "[[=e=]]needle",        "needle" },
+  { "[[.-.]]needle",        "needle" },
+  { "\\x{41}needle",        "needle" },
+  { "\\p{Greek}needle",     "needle" },
+  { "[a[bc]]needle",        NULL },
+  { "[a-z&&[^aeiou]]needle", NULL },
+  { "[a--b]needle",         NULL },
+  { "[[:digit:]needle",     NULL },
+  { "[needle",              NULL },
+  { "(?i)needle",           NULL },
+  { "needle|haystack",      NULL },
+};
+
+static void
+test_extract (gconstpointer data)
+{
+  const ExtractTest *test = data;
+  g_autoptr(GArray) trigrams = llyfr_trigram_index_extract (test->query);
+  g_autoptr(GArray) expected = NULL;
+
+  if (test->literal == NULL) {
+    g_assert_null (trigrams);
+    return;
+  }
+
+  expected = llyfr_trigram_index_extract (test->literal);
+
+  g_assert_nonnull (trigrams);
+  g_assert_cmpmem (trigrams->data, trigrams->len * sizeof (guint32),
+                   expected->data, expected->len * sizeof (guint32));
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  for (guint i = 0; i < G_N_ELEMENTS (extract_tests); i++) {
+    g_autofree gchar *path = g_strdup_printf ("/trigram-index/extract/%u", i);
+
+    g_test_add_data_func (path, &extract_tests[i], test_extract);
+  }
+
+  return g_test_run ();
+}
@@ -0,0 +1,244 @@
+/* llyfrgell-cli.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfrgell-cli"
+
+#include <stdio.h>
+#include <sys/resource.h>
+
+#include "llyfr-memory-stats.h"
+#include "llyfr-native-backend.h"
+#include "llyfr-search-context.h"
+#include "llyfr-search-result.h"
+
+/*
+ * Runs a search through the same engine as the app, without a display,
+ * printing results as they arrive. With --stats it also reports how long
+ * the first result took to show up, how long the search took and the
+ * most memory used along the way, for profiling the engine on machines
+ * with no desktop.
+ */
+
+static gboolean stats = FALSE;
+static gboolean quiet = FALSE;
+static gchar *backend_name = NULL;
+static gchar **revisions = NULL;
+static gint max_matches = 0;
+static gint max_time = 0;
+static gboolean use_index = FALSE;
+
+static const GOptionEntry entries[] = {
+  { "stats", 0, 0, G_OPTION_ARG_NONE, &stats, "Print timings by stage, match counts and peak memory use to stderr", NULL },
+  { "quiet", 'q', 0, G_OPTION_ARG_NONE, &quiet, "Don't print the results themselves", NULL },
+  { "backend", 'b', 0, G_OPTION_ARG_STRING, &backend_name, "Search with rg (the default) or native", "NAME" },
+  { "revision", 'r', 0, G_OPTION_ARG_STRING_ARRAY, &revisions, "Search REV rather than the working tree, may be repeated", "REV" },
+  { "max-matches", 0, 0, G_OPTION_ARG_INT, &max_matches, "Stop after N matching lines", "N" },
+  { "max-time", 0, 0, G_OPTION_ARG_INT, &max_time, "Stop after MS milliseconds", "MS" },
+  { "index", 0, 0, G_OPTION_ARG_NONE, &use_index, "Narrow the search down with the trigram index", NULL },
+  { NULL }
+};
+
+typedef struct
+{
+  GMainLoop  *loop;
+  GError     *error;
+  LlyfrTrace *trace;
+
+  gint64     start;
+  gint64     first_result;
+  gint64     end;
+
+  guint      n_files;
+  guint      n_matches;
+} Search;
+
+static void
+print_result (LlyfrSearchResult *result)
+{
+  const gchar *revision = llyfr_search_result_get_revision (result);
+  const gchar *filepath = llyfr_search_result_get_filepath (result);
+
+  for (guint i = 0; i < llyfr_search_result_get_n_matches (result); i++) {
+    const gchar *text = llyfr_search_result_get_match_text (result, i, NULL);
+    gint64 line_number = llyfr_search_result_get_match_line_number (result, i);
+
+    if (revision != NULL)
+      printf ("%s:%s:%" G_GINT64_FORMAT ":%s\n", revision, filepath, line_number, text);
+    else
+      printf ("%s:%" G_GINT64_FORMAT ":%s\n", filepath, line_number, text);
+  }
+}
+
+static void
+items_changed_cb (GListModel *results,
+                  guint       position,
+                  guint       removed,
+                  guint       added,
+                  Search     *search)
+{
+  if (added > 0 && search->first_result == 0)
+    search->first_result = g_get_monotonic_time ();
+
+  for (guint i = position; i < position + added; i++) {
+    g_autoptr(LlyfrSearchResult) result = g_list_model_get_item (results, i);
+
+    search->n_files++;
+    search->n_matches += llyfr_search_result_get_n_matches (result);
+
+    if (!quiet)
+      print_result (result);
+  }
+}
+
+static void
+search_cb (GObject      *object,
+           GAsyncResult *result,
+           gpointer      user_data)
+{
+  Search *search = user_data;
+
+  llyfr_search_context_search_finish (LLYFR_SEARCH_CONTEXT (object), result, &search->error);
+  search->end = g_get_monotonic_time ();
+
+  g_main_loop_quit (search->loop);
+}
+
+static void
+print_stats (Search *search)
+{
+  struct rusage usage;
+  g_autofree gchar *peak = NULL;
+  g_autofree gchar *children_peak = NULL;
+  g_autofree gchar *retained = NULL;
+
+  getrusage (RUSAGE_SELF, &usage);
+  // Linux gives ru_maxrss in kilobytes.
+  peak = g_format_size ((guint64) usage.ru_maxrss * 1024);
+
+  getrusage (RUSAGE_CHILDREN, &usage);
+  children_peak = g_format_size ((guint64) usage.ru_maxrss * 1024);
+
+  if (search->first_result > 0)
+    g_printerr ("Time to first result: %.2f ms\n", (search->first_result - search->start) / 1000.0);
+  else
+    g_printerr ("Time to first result: -\n");
+
+  g_printerr ("Total time:           %.2f ms\n", (search->end - search->start) / 1000.0);
+  g_printerr ("Files:                %u\n", search->n_files);
+  g_printerr ("Matches:              %u\n", search->n_matches);
+  g_printerr ("Peak RSS:             %s\n", peak);
+  g_printerr ("Peak RSS (children):  %s\n", children_peak);
+
+  // Every result is still held by the store at this point.
+  retained = llyfr_memory_stats_to_string ();
+  g_printerr ("Retained:             %s\n", retained);
+
+  // Stages on several threads at once can add up to more than the total.
+  for (guint stage = 0; stage < LLYFR_TRACE_N_STAGES; stage++) {
+    gint64 duration = llyfr_trace_get_stage (search->trace, stage);
+
+    if (duration > 0)
+      g_printerr ("  %-19s %.2f ms\n", llyfr_trace_stage_to_string (stage), duration / 1000.0);
+  }
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_autoptr(GOptionContext) option_context = NULL;
+  g_autoptr(LlyfrSearchContext) context = NULL;
+  g_autoptr(GListStore) results = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *directory = NULL;
+  LlyfrSearchBudget budget = { 0, };
+  Search search = { 0, };
+
+  option_context = g_option_context_new ("search DIRECTORY QUERY");
+  g_option_context_set_summary (option_context, "Search a directory the same way Llyfrgell does.");
+  g_option_context_add_main_entries (option_context, entries, NULL);
+
+  if (!g_option_context_parse (option_context, &argc, &argv, &error)) {
+    g_printerr ("%s\n", error->message);
+    return 2;
+  }
+
+  if (argc != 4 || g_strcmp0 (argv[1], "search") != 0) {
+    g_autofree gchar *help = g_option_context_get_help (option_context, TRUE, NULL);
+
+    g_printerr ("%s", help);
+    return 2;
+  }
+
+  if (backend_name != NULL && g_strcmp0 (backend_name, "native") == 0) {
+    g_autoptr(LlyfrSearchBackend) backend = llyfr_native_backend_new ();
+
+    llyfr_search_context_set_default_backend (backend);
+  } else if (backend_name != NULL && g_strcmp0 (backend_name, "rg") != 0) {
+    g_printerr ("Unknown backend '%s'\n", backend_name);
+    return 2;
+  }
+
+  // Results are printed as they arrive, which only makes sense if they
+  // stay where they were put.
+  llyfr_search_context_set_ranking_enabled (FALSE);
+  llyfr_search_context_set_indexing_enabled (use_index);
+
+  budget.max_matches = MAX (max_matches, 0);
+  budget.max_time = MAX (max_time, 0);
+
+  directory = g_canonicalize_filename (argv[2], NULL);
+  context = llyfr_search_context_new (directory);
+
+  if (revisions != NULL)
+    llyfr_search_context_set_revisions (context, (const gchar * const *) revisions);
+
+  results = g_list_store_new (LLYFR_TYPE_SEARCH_RESULT);
+  g_signal_connect (results, "items-changed", G_CALLBACK (items_changed_cb), &search);
+
+  search.loop = g_main_loop_new (NULL, FALSE);
+  search.trace = llyfr_trace_new (argv[3]);
+  search.start = g_get_monotonic_time ();
+
+  llyfr_search_context_search_full_async (context, argv[3], &budget, stats ? search.trace : NULL,
+                                          results, NULL, search_cb, &search);
+  g_main_loop_run (search.loop);
+  g_main_loop_unref (search.loop);
+  llyfr_trace_finish (search.trace);
+
+  fflush (stdout);
+
+  if (stats)
+    print_stats (&search);
+
+  if (g_error_matches (search.error, LLYFR_SEARCH_CONTEXT_ERROR, LLYFR_SEARCH_CONTEXT_ERROR_PARTIAL)) {
+    g_printerr ("Search stopped early: %s\n", search.error->message);
+  } else if (search.error != NULL) {
+    g_printerr ("Search failed: %s\n", search.error->message);
+    g_clear_error (&search.error);
+    llyfr_trace_unref (search.trace);
+    return 1;
+  }
+
+  g_clear_error (&search.error);
+  llyfr_trace_unref (search.trace);
+
+  return 0;
+}
@@ -0,0 +1,198 @@
+/* llyfr-catalog.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-catalog"
+
+#include <errno.h>
+
+#include <glib/gstdio.h>
+
+#include "llyfr-catalog.h"
+#include "llyfr-search-context.h"
+
+/*
+ * The catalog remembers which repositories were found last time, so search
+ * contexts are available as soon as the application starts rather than only
+ * after scanning the home directory again.
+ *
+ * It's stored as a single serialised GVariant which is mapped straight into
+ * memory when loading, along with a few details about each repository.
+ */
+
+#define CATALOG_VERSION 1
+
+// (version, [(directory, .git mtime, time added)])
+#define CATALOG_TYPE    "(ua(sxx))"
+
+gchar*
+llyfr_catalog_get_default_path (void)
+{
+  return g_build_filename (g_get_user_cache_dir (), "llyfrgell", "catalog.gvariant", NULL);
+}
+
+static gint64
+llyfr_catalog_get_git_mtime (const gchar *directory)
+{
+  g_autofree gchar *git_dir = g_build_filename (directory, ".git", NULL);
+  GStatBuf buf;
+
+  if (g_stat (git_dir, &buf) != 0)
+    return -1;
+
+  return buf.st_mtime;
+}
+
+/*
+ * Create a search context for every repository in the catalog at
+ * @filename.
+ */
+GListStore*
+llyfr_catalog_load (const gchar *filename,
+                    GError **error)
+{
+  g_autoptr(GMappedFile) file = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GVariant) catalog = NULL;
+  g_autoptr(GVariant) repos = NULL;
+  GListStore *contexts;
+  GVariantIter iter;
+  const gchar *directory;
+  guint32 version;
+
+  g_return_val_if_fail (filename != NULL, NULL);
+
+  file = g_mapped_file_new (filename, FALSE, error);
+  if (file == NULL)
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (file);
+  catalog = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (CATALOG_TYPE), bytes, FALSE));
+
+  g_variant_get_child (catalog, 0, "u", &version);
+  if (version != CATALOG_VERSION) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                 "Unsupported catalog version %u", version);
+    return NULL;
+  }
+
+  repos = g_variant_get_child_value (catalog, 1);
+  contexts = g_list_store_new (LLYFR_TYPE_SEARCH_CONTEXT);
+
+  g_variant_iter_init (&iter, repos);
+  while (g_variant_iter_next (&iter, "(&sxx)", &directory, NULL, NULL)) {
+    g_autoptr(LlyfrSearchContext) context = llyfr_search_context_new ((gchar *) directory);
+    g_list_store_append (contexts, context);
+  }
+
+  return contexts;
+}
+
+/*
+ * Write the directories of @contexts to the catalog at @filename, replacing
+ * whatever was there.
+ */
+gboolean
+llyfr_catalog_save (const gchar *filename,
+                    GListModel *contexts,
+                    GError **error)
+{
+  g_autoptr(GVariant) catalog = NULL;
+  g_autofree gchar *parent = NULL;
+  GVariantBuilder builder;
+  guint n_contexts;
+  gint64 now;
+
+  g_return_val_if_fail (filename != NULL, FALSE);
+  g_return_val_if_fail (G_IS_LIST_MODEL (contexts), FALSE);
+
+  now = g_get_real_time () / G_USEC_PER_SEC;
+  n_contexts = g_list_model_get_n_items (contexts);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sxx)"));
+
+  for (guint i = 0; i < n_contexts; i++) {
+    g_autoptr(LlyfrSearchContext) context = g_list_model_get_item (contexts, i);
+    const gchar *directory = llyfr_search_context_get_directory (context);
+
+    g_variant_builder_add (&builder, "(sxx)",
+                           directory,
+                           llyfr_catalog_get_git_mtime (directory),
+                           now);
+  }
+
+  catalog = g_variant_ref_sink (g_variant_new ("(ua(sxx))", CATALOG_VERSION, &builder));
+
+  parent = g_path_get_dirname (filename);
+  if (g_mkdir_with_parents (parent, 0700) != 0) {
+    int saved_errno = errno;
+
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                 "Unable to create %s: %s", parent, g_strerror (saved_errno));
+    return FALSE;
+  }
+
+  return g_file_set_contents (filename,
+                              g_variant_get_data (catalog),
+                              g_variant_get_size (catalog),
+                              error);
+}
+
+/*
+ * Bring @contexts in line with the @directories found by a fresh scan.
+ * Contexts for directories that are still there are kept as they are, so
+ * anything holding on to one (the current search, say) isn't disturbed.
+ */
+void
+llyfr_catalog_reconcile (GListStore *contexts,
+                         const gchar * const *directories)
+{
+  g_autoptr(GHashTable) found = NULL;
+  guint n_contexts;
+
+  g_return_if_fail (G_IS_LIST_STORE (contexts));
+
+  found = g_hash_table_new (g_str_hash, g_str_equal);
+  for (guint i = 0; directories != NULL && directories[i] != NULL; i++)
+    g_hash_table_add (found, (gpointer) directories[i]);
+
+  n_contexts = g_list_model_get_n_items (G_LIST_MODEL (contexts));
+
+  // Walk backwards so removals don't disturb what's left to check.
+  for (guint i = n_contexts; i > 0; i--) {
+    g_autoptr(LlyfrSearchContext) context = g_list_model_get_item (G_LIST_MODEL (contexts), i - 1);
+    const gchar *directory = llyfr_search_context_get_directory (context);
+
+    // Whatever is left in found afterwards is new.
+    if (!g_hash_table_remove (found, directory))
+      g_list_store_remove (contexts, i - 1);
+  }
+
+  for (guint i = 0; directories != NULL && directories[i] != NULL; i++) {
+    g_autoptr(LlyfrSearchContext) context = NULL;
+
+    if (!g_hash_table_contains (found, directories[i]))
+      continue;
+
+    g_hash_table_remove (found, directories[i]);
+
+    context = llyfr_search_context_new ((gchar *) directories[i]);
+    g_list_store_append (contexts, context);
+  }
+}
@@ -0,0 +1,43 @@
+/* llyfr-catalog.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_CATALOG_H
+#define LLYFR_CATALOG_H
+
+#include <gio/gio.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+gchar*      llyfr_catalog_get_default_path (void);
+
+GListStore* llyfr_catalog_load             (const gchar *filename,
+                                            GError **error);
+
+gboolean    llyfr_catalog_save             (const gchar *filename,
+                                            GListModel *contexts,
+                                            GError **error);
+
+void        llyfr_catalog_reconcile        (GListStore *contexts,
+                                            const gchar * const *directories);
+
+G_END_DECLS
+
+#endif /* LLYFR_CATALOG_H */
@@ -0,0 +1,421 @@
+/* llyfr-git-files.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-git-files"
+
+#include <string.h>
+#include <sys/stat.h>
+
+#include "llyfr-git-files.h"
+#include "llyfr-host.h"
+
+/*
+ * Lists the files git is tracking in a working tree, which saves walking
+ * the tree and working out what's ignored. The list is read straight out
+ * of .git/index, along with the modification time and size git recorded
+ * for each file. Anything we can't read that way (split indexes, SHA-256
+ * repositories, versions we don't know) is left to git ls-files.
+ *
+ * See gitformat-index(5) for the layout of the index.
+ */
+
+#define INDEX_SIGNATURE   "DIRC"
+#define INDEX_HEADER_SIZE 12
+
+// ctime, mtime, dev, ino, mode, uid, gid and size, then the object id and
+// flags.
+#define ENTRY_STAT_SIZE   40
+#define ENTRY_OID_SIZE    20
+#define ENTRY_FIXED_SIZE  (ENTRY_STAT_SIZE + ENTRY_OID_SIZE + 2)
+
+#define FLAG_EXTENDED     0x4000
+#define FLAG_STAGE_MASK   0x3000
+#define FLAG_NAME_MASK    0x0fff
+
+#define EXTENDED_FLAG_SKIP_WORKTREE 0x4000
+
+#define MODE_TYPE_MASK    0170000
+#define MODE_REGULAR      0100000
+
+G_DEFINE_QUARK (llyfr-git-files-error-quark, llyfr_git_files_error)
+
+void
+llyfr_git_file_clear (LlyfrGitFile *file)
+{
+  g_clear_pointer (&file->path, g_free);
+}
+
+static GArray*
+llyfr_git_files_new_array (void)
+{
+  GArray *files = g_array_new (FALSE, FALSE, sizeof (LlyfrGitFile));
+
+  g_array_set_clear_func (files, (GDestroyNotify) llyfr_git_file_clear);
+  return files;
+}
+
+/*
+ * The git directory of the working tree at @directory. Worktrees and
+ * submodules have a .git file pointing at it rather than a directory.
+ */
+static gchar*
+llyfr_git_files_get_git_dir (const gchar *directory)
+{
+  g_autofree gchar *dot_git = g_build_filename (directory, ".git", NULL);
+  g_autofree gchar *contents = NULL;
+  const gchar *path;
+
+  if (g_file_test (dot_git, G_FILE_TEST_IS_DIR))
+    return g_steal_pointer (&dot_git);
+
+  if (!g_file_get_contents (dot_git, &contents, NULL, NULL) ||
+      !g_str_has_prefix (contents, "gitdir:"))
+    return NULL;
+
+  path = g_strstrip (contents + strlen ("gitdir:"));
+  if (g_path_is_absolute (path))
+    return g_strdup (path);
+
+  return g_build_filename (directory, path, NULL);
+}
+
+/*
+ * The path to the index of the working tree at @directory, or NULL if it
+ * isn't one.
+ */
+gchar*
+llyfr_git_files_get_index_path (const gchar *directory)
+{
+  g_autofree gchar *git_dir = llyfr_git_files_get_git_dir (directory);
+
+  if (git_dir == NULL)
+    return NULL;
+
+  return g_build_filename (git_dir, "index", NULL);
+}
+
+static guint32
+read_be32 (const guint8 *p)
+{
+  guint32 value;
+
+  memcpy (&value, p, sizeof (value));
+  return GUINT32_FROM_BE (value);
+}
+
+static guint16
+read_be16 (const guint8 *p)
+{
+  guint16 value;
+
+  memcpy (&value, p, sizeof (value));
+  return GUINT16_FROM_BE (value);
+}
+
+/*
+ * The variable length integers version 4 uses to say how much of the
+ * previous path to drop.
+ */
+static gboolean
+read_offset_varint (const guint8 **p,
+                    const guint8  *end,
+                    guint64       *value)
+{
+  guint8 c;
+
+  if (*p >= end)
+    return FALSE;
+
+  c = *(*p)++;
+  *value = c & 0x7f;
+
+  while (c & 0x80) {
+    if (*p >= end)
+      return FALSE;
+
+    c = *(*p)++;
+    *value = ((*value + 1) << 7) | (c & 0x7f);
+  }
+
+  return TRUE;
+}
+
+static gboolean
+invalid_index (GError **error,
+               const gchar *index_path)
+{
+  g_set_error (error, LLYFR_GIT_FILES_ERROR, LLYFR_GIT_FILES_ERROR_INVALID_DATA,
+               "Unable to read %s", index_path);
+  return FALSE;
+}
+
+/*
+ * Read the tracked files of the working tree at @directory from its index,
+ * without running git. Only regular files that are checked out are
+ * included, each once, with paths relative to @directory.
+ */
+GArray*
+llyfr_git_files_read_index (const gchar *directory,
+                            GError **error)
+{
+  g_autofree gchar *git_dir = NULL;
+  g_autofree gchar *index_path = NULL;
+  g_autofree gchar *config_path = NULL;
+  g_autofree gchar *config = NULL;
+  g_autoptr(GMappedFile) file = NULL;
+  g_autoptr(GArray) files = NULL;
+  g_autoptr(GString) path = NULL;
+  const guint8 *data, *p, *end;
+  guint32 version, n_entries;
+  gsize size;
+
+  g_return_val_if_fail (directory != NULL, NULL);
+
+  git_dir = llyfr_git_files_get_git_dir (directory);
+  if (git_dir == NULL) {
+    g_set_error (error, LLYFR_GIT_FILES_ERROR, LLYFR_GIT_FILES_ERROR_NOT_A_REPOSITORY,
+                 "%s is not a git repository", directory);
+    return NULL;
+  }
+
+  // Object ids are longer in SHA-256 repositories.
+  config_path = g_build_filename (git_dir, "config", NULL);
+  if (g_file_get_contents (config_path, &config, NULL, NULL) &&
+      strstr (config, "objectformat") != NULL) {
+    g_set_error (error, LLYFR_GIT_FILES_ERROR, LLYFR_GIT_FILES_ERROR_UNSUPPORTED,
+                 "Unsupported object format");
+    return NULL;
+  }
+
+  index_path = g_build_filename (git_dir, "index", NULL);
+  file = g_mapped_file_new (index_path, FALSE, error);
+  if (file == NULL)
+    return NULL;
+
+  data = (const guint8 *) g_mapped_file_get_contents (file);
+  size = g_mapped_file_get_length (file);
+
+  if (size < INDEX_HEADER_SIZE || memcmp (data, INDEX_SIGNATURE, 4) != 0) {
+    invalid_index (error, index_path);
+    return NULL;
+  }
+
+  version = read_be32 (data + 4);
+  n_entries = read_be32 (data + 8);
+
+  if (version < 2 || version > 4) {
+    g_set_error (error, LLYFR_GIT_FILES_ERROR, LLYFR_GIT_FILES_ERROR_UNSUPPORTED,
+                 "Unsupported index version %u", version);
+    return NULL;
+  }
+
+  files = llyfr_git_files_new_array ();
+  path = g_string_new (NULL);
+  p = data + INDEX_HEADER_SIZE;
+  end = data + size;
+
+  for (guint32 i = 0; i < n_entries; i++) {
+    const guint8 *entry = p;
+    guint32 mode, name_length;
+    guint16 flags, extended_flags = 0;
+    gboolean duplicate;
+    LlyfrGitFile git_file;
+
+    if (end - p < ENTRY_FIXED_SIZE) {
+      invalid_index (error, index_path);
+      return NULL;
+    }
+
+    mode = read_be32 (entry + 24);
+    flags = read_be16 (entry + ENTRY_STAT_SIZE + ENTRY_OID_SIZE);
+    p += ENTRY_FIXED_SIZE;
+
+    if (flags & FLAG_EXTENDED) {
+      if (version < 3 || end - p < 2) {
+        invalid_index (error, index_path);
+        return NULL;
+      }
+
+      extended_flags = read_be16 (p);
+      p += 2;
+    }
+
+    if (version == 4) {
+      const guint8 *nul;
+      guint64 strip;
+
+      if (!read_offset_varint (&p, end, &strip) || strip > path->len ||
+          (nul = memchr (p, '\0', end - p)) == NULL) {
+        invalid_index (error, index_path);
+        return NULL;
+      }
+
+      g_string_truncate (path, path->len - strip);
+      g_string_append_len (path, (const gchar *) p, nul - p);
+      p = nul + 1;
+    } else {
+      const guint8 *nul = memchr (p, '\0', end - p);
+      gsize entry_length;
+
+      if (nul == NULL) {
+        invalid_index (error, index_path);
+        return NULL;
+      }
+
+      name_length = nul - p;
+      if ((flags & FLAG_NAME_MASK) != FLAG_NAME_MASK && name_length != (flags & FLAG_NAME_MASK)) {
+        invalid_index (error, index_path);
+        return NULL;
+      }
+
+      g_string_truncate (path, 0);
+      g_string_append_len (path, (const gchar *) p, name_length);
+
+      // Entries are padded with NULs to a multiple of eight bytes.
+      entry_length = (nul - entry + 8) & ~(gsize) 7;
+      if ((gsize) (end - entry) < entry_length) {
+        invalid_index (error, index_path);
+        return NULL;
+      }
+
+      p = entry + entry_length;
+    }
+
+    // Conflicted files have an entry for each stage, one will do.
+    duplicate = (flags & FLAG_STAGE_MASK) != 0 && files->len > 0 &&
+                strcmp (g_array_index (files, LlyfrGitFile, files->len - 1).path, path->str) == 0;
+
+    if (duplicate ||
+        (mode & MODE_TYPE_MASK) != MODE_REGULAR ||
+        (extended_flags & EXTENDED_FLAG_SKIP_WORKTREE) != 0)
+      continue;
+
+    git_file.path = g_strndup (path->str, path->len);
+    git_file.mtime = (gint64) read_be32 (entry + 8) * G_USEC_PER_SEC + read_be32 (entry + 12) / 1000;
+    git_file.size = read_be32 (entry + 36);
+    g_array_append_val (files, git_file);
+  }
+
+  // With a split index most entries live in a shared index elsewhere.
+  while (end - p >= 8 + 20) {
+    guint32 extension_size = read_be32 (p + 4);
+
+    if (memcmp (p, "link", 4) == 0) {
+      g_set_error (error, LLYFR_GIT_FILES_ERROR, LLYFR_GIT_FILES_ERROR_UNSUPPORTED,
+                   "Split indexes are not supported");
+      return NULL;
+    }
+
+    if ((gsize) (end - p) < 8 + (gsize) extension_size)
+      break;
+
+    p += 8 + extension_size;
+  }
+
+  return g_steal_pointer (&files);
+}
+
+/*
+ * List the tracked files of the working tree at @directory by running git
+ * ls-files, reading its output as it arrives. Modification times and sizes
+ * come from the files themselves.
+ */
+GArray*
+llyfr_git_files_ls_files (const gchar *directory,
+                          GCancellable *cancellable,
+                          GError **error)
+{
+  const gchar *argv[] = { "git", "-C", directory, "ls-files", "-z", NULL };
+  g_autoptr(GSubprocess) process = NULL;
+  g_autoptr(GDataInputStream) stream = NULL;
+  g_autoptr(GArray) files = NULL;
+  GError *local_error = NULL;
+  gchar *line;
+  gsize length;
+
+  g_return_val_if_fail (directory != NULL, NULL);
+
+  process = llyfr_host_spawnv (G_SUBPROCESS_FLAGS_STDOUT_PIPE | G_SUBPROCESS_FLAGS_STDERR_SILENCE,
+                               argv, error);
+  if (process == NULL)
+    return NULL;
+
+  files = llyfr_git_files_new_array ();
+  stream = g_data_input_stream_new (g_subprocess_get_stdout_pipe (process));
+
+  while ((line = g_data_input_stream_read_upto (stream, "", 1, &length, cancellable, &local_error)) != NULL) {
+    g_autofree gchar *path = g_build_filename (directory, line, NULL);
+    LlyfrGitFile git_file;
+    GStatBuf buf;
+
+    // Skip the NUL we stopped at.
+    g_data_input_stream_read_byte (stream, cancellable, &local_error);
+    if (local_error != NULL) {
+      g_free (line);
+      break;
+    }
+
+    if (length == 0 || lstat (path, &buf) != 0 || !S_ISREG (buf.st_mode)) {
+      g_free (line);
+      continue;
+    }
+
+    git_file.path = line;
+    git_file.mtime = (gint64) buf.st_mtim.tv_sec * G_USEC_PER_SEC + buf.st_mtim.tv_nsec / 1000;
+    git_file.size = buf.st_size;
+    g_array_append_val (files, git_file);
+  }
+
+  if (local_error != NULL) {
+    g_subprocess_force_exit (process);
+    g_propagate_error (error, local_error);
+    return NULL;
+  }
+
+  if (!g_subprocess_wait_check (process, cancellable, error))
+    return NULL;
+
+  return g_steal_pointer (&files);
+}
+
+/*
+ * The tracked files of the working tree at @directory, read from the index
+ * where possible and from git ls-files otherwise.
+ */
+GArray*
+llyfr_git_files_list (const gchar *directory,
+                      GCancellable *cancellable,
+                      GError **error)
+{
+  g_autoptr(GError) local_error = NULL;
+  GArray *files;
+
+  files = llyfr_git_files_read_index (directory, &local_error);
+  if (files != NULL)
+    return files;
+
+  if (g_error_matches (local_error, LLYFR_GIT_FILES_ERROR, LLYFR_GIT_FILES_ERROR_NOT_A_REPOSITORY)) {
+    g_propagate_error (error, g_steal_pointer (&local_error));
+    return NULL;
+  }
+
+  g_debug ("Falling back to git ls-files for %s: %s", directory, local_error->message);
+  return llyfr_git_files_ls_files (directory, cancellable, error);
+}
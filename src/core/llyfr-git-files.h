@@ -0,0 +1,67 @@
+/* llyfr-git-files.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_GIT_FILES_H
+#define LLYFR_GIT_FILES_H
+
+#include <gio/gio.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define LLYFR_GIT_FILES_ERROR (llyfr_git_files_error_quark ())
+
+typedef enum
+{
+  LLYFR_GIT_FILES_ERROR_NOT_A_REPOSITORY,
+  LLYFR_GIT_FILES_ERROR_UNSUPPORTED,
+  LLYFR_GIT_FILES_ERROR_INVALID_DATA,
+} LlyfrGitFilesError;
+
+GQuark llyfr_git_files_error_quark (void);
+
+/*
+ * A file tracked by git, along with what git last saw of it.
+ */
+typedef struct
+{
+  gchar  *path;
+  gint64  mtime;
+  gint64  size;
+} LlyfrGitFile;
+
+void    llyfr_git_file_clear             (LlyfrGitFile *file);
+
+gchar*  llyfr_git_files_get_index_path   (const gchar *directory);
+
+GArray* llyfr_git_files_read_index       (const gchar *directory,
+                                          GError **error);
+
+GArray* llyfr_git_files_ls_files         (const gchar *directory,
+                                          GCancellable *cancellable,
+                                          GError **error);
+
+GArray* llyfr_git_files_list             (const gchar *directory,
+                                          GCancellable *cancellable,
+                                          GError **error);
+
+G_END_DECLS
+
+#endif /* LLYFR_GIT_FILES_H */
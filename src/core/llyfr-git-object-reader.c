@@ -0,0 +1,444 @@
+/* llyfr-git-object-reader.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-git-object-reader"
+
+#include <signal.h>
+#include <string.h>
+
+#include "llyfr-git-object-reader.h"
+#include "llyfr-host.h"
+
+/*
+ * Reads objects out of a repository through a single git cat-file --batch
+ * process, started the first time it's needed and kept running until the
+ * reader is closed. Asking for an object is a line written to its stdin,
+ * so reading thousands of blobs costs one process rather than thousands.
+ *
+ * Requests are answered in order, so only one can be in flight at a time.
+ * Should one fail part way through, say it was cancelled, the process is
+ * stopped since there's no telling where in its output we've got to and
+ * the next request starts another.
+ */
+
+// Replies are read in chunks of this size.
+#define READ_BUFFER_SIZE (64 * 1024)
+
+struct _LlyfrGitObjectReader
+{
+  GObject           parent_instance;
+
+  gchar            *directory;
+
+  // Guards everything below.
+  GMutex            mutex;
+  GSubprocess      *process;
+  GOutputStream    *requests;
+  GDataInputStream *replies;
+};
+
+G_DEFINE_TYPE (LlyfrGitObjectReader, llyfr_git_object_reader, G_TYPE_OBJECT)
+
+enum
+{
+  PROP_0,
+  PROP_DIRECTORY,
+  LAST_PROP
+};
+
+static GParamSpec *properties[LAST_PROP];
+
+LlyfrGitObjectReader*
+llyfr_git_object_reader_new (const gchar *directory)
+{
+  return g_object_new (LLYFR_TYPE_GIT_OBJECT_READER,
+                       "directory", directory,
+                       NULL);
+}
+
+const gchar*
+llyfr_git_object_reader_get_directory (LlyfrGitObjectReader *reader)
+{
+  g_return_val_if_fail (LLYFR_IS_GIT_OBJECT_READER (reader), NULL);
+
+  return reader->directory;
+}
+
+static void
+llyfr_git_object_reader_stop_locked (LlyfrGitObjectReader *self)
+{
+  if (self->process == NULL)
+    return;
+
+  // Running out of input is enough for cat-file to exit, unless it's stuck
+  // writing a reply nobody is going to read.
+  g_output_stream_close (self->requests, NULL, NULL);
+  g_subprocess_send_signal (self->process, SIGTERM);
+
+  g_clear_object (&self->requests);
+  g_clear_object (&self->replies);
+  g_clear_object (&self->process);
+}
+
+static gboolean
+llyfr_git_object_reader_start_locked (LlyfrGitObjectReader  *self,
+                                      GError               **error)
+{
+  const gchar *argv[] = { "git", "-C", self->directory, "cat-file", "--batch", NULL };
+
+  if (self->process != NULL)
+    return TRUE;
+
+  self->process = llyfr_host_spawnv (G_SUBPROCESS_FLAGS_STDIN_PIPE |
+                                     G_SUBPROCESS_FLAGS_STDOUT_PIPE |
+                                     G_SUBPROCESS_FLAGS_STDERR_SILENCE,
+                                     argv, error);
+  if (self->process == NULL)
+    return FALSE;
+
+  self->requests = g_object_ref (g_subprocess_get_stdin_pipe (self->process));
+  self->replies = g_data_input_stream_new (g_subprocess_get_stdout_pipe (self->process));
+  g_buffered_input_stream_set_buffer_size (G_BUFFERED_INPUT_STREAM (self->replies), READ_BUFFER_SIZE);
+
+  return TRUE;
+}
+
+/*
+ * Ask for @name, returning its contents along with its type and id.
+ */
+static GBytes*
+llyfr_git_object_reader_read_locked (LlyfrGitObjectReader  *self,
+                                     const gchar           *name,
+                                     gchar                **type,
+                                     gchar                **oid,
+                                     GCancellable          *cancellable,
+                                     GError               **error)
+{
+  g_autofree gchar *request = NULL;
+  g_autofree gchar *header = NULL;
+  g_autofree guint8 *contents = NULL;
+  g_auto(GStrv) fields = NULL;
+  guint8 newline;
+  guint64 size = 0;
+  gsize length;
+  gchar *end = NULL;
+
+  if (strchr (name, '\n') != NULL) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                 "Invalid object name '%s'", name);
+    return NULL;
+  }
+
+  if (!llyfr_git_object_reader_start_locked (self, error))
+    return NULL;
+
+  request = g_strconcat (name, "\n", NULL);
+  if (!g_output_stream_write_all (self->requests, request, strlen (request), NULL, cancellable, error) ||
+      !g_output_stream_flush (self->requests, cancellable, error))
+    goto failed;
+
+  // Either "<oid> <type> <size>", "<name> missing" or "<name> ambiguous".
+  header = g_data_input_stream_read_line (self->replies, &length, cancellable, error);
+  if (header == NULL) {
+    if (error != NULL && *error == NULL)
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE,
+                   "git cat-file exited in %s", self->directory);
+    goto failed;
+  }
+
+  if (g_str_has_suffix (header, " missing") || g_str_has_suffix (header, " ambiguous")) {
+    // Nothing else follows, so the process can carry on.
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                 "No object '%s' in %s", name, self->directory);
+    return NULL;
+  }
+
+  fields = g_strsplit (header, " ", 3);
+  if (g_strv_length (fields) == 3)
+    size = g_ascii_strtoull (fields[2], &end, 10);
+
+  if (g_strv_length (fields) != 3 || *end != '\0' || size > G_MAXSIZE - 1) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                 "Unexpected reply from git cat-file: %s", header);
+    goto failed;
+  }
+
+  contents = g_malloc (size);
+  if (!g_input_stream_read_all (G_INPUT_STREAM (self->replies), contents, size, &length, cancellable, error))
+    goto failed;
+
+  // Each object is followed by a newline.
+  if (length != size ||
+      !g_input_stream_read_all (G_INPUT_STREAM (self->replies), &newline, 1, &length, cancellable, error) ||
+      length != 1) {
+    if (error != NULL && *error == NULL)
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE,
+                   "git cat-file exited in %s", self->directory);
+    goto failed;
+  }
+
+  if (type != NULL)
+    *type = g_strdup (fields[1]);
+
+  if (oid != NULL)
+    *oid = g_strdup (fields[0]);
+
+  return g_bytes_new_take (g_steal_pointer (&contents), size);
+
+failed:
+  llyfr_git_object_reader_stop_locked (self);
+  return NULL;
+}
+
+/*
+ * Read the object @name, which can be anything git rev-parse understands,
+ * such as an object id, "HEAD:README.md" or "v1.0^{tree}". Its type is
+ * stored in @type when given. Safe to call from any thread, requests from
+ * several threads are answered one after the other.
+ */
+GBytes*
+llyfr_git_object_reader_read (LlyfrGitObjectReader  *reader,
+                              const gchar           *name,
+                              gchar                **type,
+                              GCancellable          *cancellable,
+                              GError               **error)
+{
+  GBytes *contents;
+
+  g_return_val_if_fail (LLYFR_IS_GIT_OBJECT_READER (reader), NULL);
+  g_return_val_if_fail (name != NULL, NULL);
+
+  g_mutex_lock (&reader->mutex);
+  contents = llyfr_git_object_reader_read_locked (reader, name, type, NULL, cancellable, error);
+  g_mutex_unlock (&reader->mutex);
+
+  return contents;
+}
+
+static void
+llyfr_git_tree_entry_clear (LlyfrGitTreeEntry *entry)
+{
+  g_clear_pointer (&entry->path, g_free);
+}
+
+/*
+ * Add the files in the tree @name to @entries, recursing into any
+ * subtrees. Each entry in a tree is "<mode> <name>\0" followed by the raw
+ * object id, as long as that of the tree itself.
+ */
+static gboolean
+llyfr_git_object_reader_list_tree_locked (LlyfrGitObjectReader  *self,
+                                          const gchar           *name,
+                                          const gchar           *prefix,
+                                          GArray                *entries,
+                                          GCancellable          *cancellable,
+                                          GError               **error)
+{
+  g_autoptr(GPtrArray) subtrees = NULL;
+  g_autoptr(GBytes) tree = NULL;
+  g_autofree gchar *type = NULL;
+  g_autofree gchar *oid = NULL;
+  const guint8 *p, *end;
+  gsize oid_length;
+
+  tree = llyfr_git_object_reader_read_locked (self, name, &type, &oid, cancellable, error);
+  if (tree == NULL)
+    return FALSE;
+
+  oid_length = strlen (oid) / 2;
+  if (g_strcmp0 (type, "tree") != 0 || oid_length * 2 > LLYFR_GIT_OID_HEX_MAX) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                 "'%s' is a %s, not a tree", name, type);
+    return FALSE;
+  }
+
+  subtrees = g_ptr_array_new_with_free_func (g_free);
+  p = g_bytes_get_data (tree, NULL);
+  end = p + g_bytes_get_size (tree);
+
+  while (p < end) {
+    const guint8 *space = memchr (p, ' ', end - p);
+    const guint8 *nul = space != NULL ? memchr (space, '\0', end - space) : NULL;
+    gchar hex[LLYFR_GIT_OID_HEX_MAX + 1];
+    g_autofree gchar *path = NULL;
+    guint64 mode;
+
+    if (nul == NULL || (gsize) (end - nul - 1) < oid_length) {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Truncated tree %s in %s", oid, self->directory);
+      return FALSE;
+    }
+
+    mode = g_ascii_strtoull ((const gchar *) p, NULL, 8);
+    path = *prefix != '\0'
+      ? g_strconcat (prefix, "/", (const gchar *) space + 1, NULL)
+      : g_strdup ((const gchar *) space + 1);
+
+    for (gsize i = 0; i < oid_length; i++)
+      g_snprintf (hex + 2 * i, 3, "%02x", nul[1 + i]);
+
+    p = nul + 1 + oid_length;
+
+    // Subtrees are read once we're done with this one. Symlinks and
+    // submodules are left out.
+    if ((mode & 0170000) == 0040000) {
+      g_ptr_array_add (subtrees, g_strdup (hex));
+      g_ptr_array_add (subtrees, g_steal_pointer (&path));
+    } else if ((mode & 0170000) == 0100000) {
+      LlyfrGitTreeEntry entry;
+
+      entry.path = g_steal_pointer (&path);
+      memcpy (entry.oid, hex, oid_length * 2 + 1);
+      g_array_append_val (entries, entry);
+    }
+  }
+
+  g_clear_pointer (&tree, g_bytes_unref);
+
+  for (guint i = 0; i < subtrees->len; i += 2) {
+    if (!llyfr_git_object_reader_list_tree_locked (self,
+                                                   g_ptr_array_index (subtrees, i),
+                                                   g_ptr_array_index (subtrees, i + 1),
+                                                   entries,
+                                                   cancellable,
+                                                   error))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/*
+ * Every file in the tree of @revision, with paths relative to the top of
+ * the repository. Symlinks and submodules are left out.
+ */
+GArray*
+llyfr_git_object_reader_list_tree (LlyfrGitObjectReader  *reader,
+                                   const gchar           *revision,
+                                   GCancellable          *cancellable,
+                                   GError               **error)
+{
+  g_autoptr(GArray) entries = NULL;
+  g_autofree gchar *name = NULL;
+  gboolean listed;
+
+  g_return_val_if_fail (LLYFR_IS_GIT_OBJECT_READER (reader), NULL);
+  g_return_val_if_fail (revision != NULL, NULL);
+
+  entries = g_array_new (FALSE, FALSE, sizeof (LlyfrGitTreeEntry));
+  g_array_set_clear_func (entries, (GDestroyNotify) llyfr_git_tree_entry_clear);
+  name = g_strconcat (revision, "^{tree}", NULL);
+
+  g_mutex_lock (&reader->mutex);
+  listed = llyfr_git_object_reader_list_tree_locked (reader, name, "", entries, cancellable, error);
+  g_mutex_unlock (&reader->mutex);
+
+  if (!listed)
+    return NULL;
+
+  return g_steal_pointer (&entries);
+}
+
+/*
+ * Stop the cat-file process, if it's running. The reader can still be
+ * used, the next request starts it again.
+ */
+void
+llyfr_git_object_reader_close (LlyfrGitObjectReader *reader)
+{
+  g_return_if_fail (LLYFR_IS_GIT_OBJECT_READER (reader));
+
+  g_mutex_lock (&reader->mutex);
+  llyfr_git_object_reader_stop_locked (reader);
+  g_mutex_unlock (&reader->mutex);
+}
+
+static void
+llyfr_git_object_reader_get_property (GObject    *object,
+                                      guint       prop_id,
+                                      GValue     *value,
+                                      GParamSpec *pspec)
+{
+  LlyfrGitObjectReader *self = LLYFR_GIT_OBJECT_READER (object);
+
+  switch (prop_id) {
+    case PROP_DIRECTORY:
+      g_value_set_string (value, self->directory);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+  }
+}
+
+static void
+llyfr_git_object_reader_set_property (GObject      *object,
+                                      guint         prop_id,
+                                      const GValue *value,
+                                      GParamSpec   *pspec)
+{
+  LlyfrGitObjectReader *self = LLYFR_GIT_OBJECT_READER (object);
+
+  switch (prop_id) {
+    case PROP_DIRECTORY:
+      self->directory = g_value_dup_string (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+  }
+}
+
+static void
+llyfr_git_object_reader_finalize (GObject *object)
+{
+  LlyfrGitObjectReader *self = LLYFR_GIT_OBJECT_READER (object);
+
+  llyfr_git_object_reader_stop_locked (self);
+  g_mutex_clear (&self->mutex);
+  g_free (self->directory);
+
+  G_OBJECT_CLASS (llyfr_git_object_reader_parent_class)->finalize (object);
+}
+
+static void
+llyfr_git_object_reader_class_init (LlyfrGitObjectReaderClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->get_property = llyfr_git_object_reader_get_property;
+  object_class->set_property = llyfr_git_object_reader_set_property;
+  object_class->finalize = llyfr_git_object_reader_finalize;
+
+  properties[PROP_DIRECTORY] =
+    g_param_spec_string ("directory",
+                         "Directory",
+                         "The repository objects are read from",
+                         NULL,
+                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+
+  g_object_class_install_properties (object_class, LAST_PROP, properties);
+}
+
+static void
+llyfr_git_object_reader_init (LlyfrGitObjectReader *self)
+{
+  g_mutex_init (&self->mutex);
+}
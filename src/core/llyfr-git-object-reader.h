@@ -0,0 +1,64 @@
+/* llyfr-git-object-reader.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_GIT_OBJECT_READER_H
+#define LLYFR_GIT_OBJECT_READER_H
+
+#include <gio/gio.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define LLYFR_TYPE_GIT_OBJECT_READER (llyfr_git_object_reader_get_type())
+
+G_DECLARE_FINAL_TYPE (LlyfrGitObjectReader, llyfr_git_object_reader, LLYFR, GIT_OBJECT_READER, GObject)
+
+// Long enough for a sha256 object id in hex.
+#define LLYFR_GIT_OID_HEX_MAX 64
+
+/*
+ * A file in a tree, along with the id of the blob holding its contents.
+ */
+typedef struct
+{
+  gchar *path;
+  gchar  oid[LLYFR_GIT_OID_HEX_MAX + 1];
+} LlyfrGitTreeEntry;
+
+LlyfrGitObjectReader* llyfr_git_object_reader_new       (const gchar *directory);
+
+const gchar*          llyfr_git_object_reader_get_directory (LlyfrGitObjectReader *reader);
+
+GBytes*               llyfr_git_object_reader_read      (LlyfrGitObjectReader *reader,
+                                                         const gchar *name,
+                                                         gchar **type,
+                                                         GCancellable *cancellable,
+                                                         GError **error);
+
+GArray*               llyfr_git_object_reader_list_tree (LlyfrGitObjectReader *reader,
+                                                         const gchar *revision,
+                                                         GCancellable *cancellable,
+                                                         GError **error);
+
+void                  llyfr_git_object_reader_close     (LlyfrGitObjectReader *reader);
+
+G_END_DECLS
+
+#endif /* LLYFR_GIT_OBJECT_READER_H */
@@ -0,0 +1,77 @@
+/* llyfr-host.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-host"
+
+#include "llyfr-host.h"
+
+/*
+ * The tools we rely on (rg, git) live on the host. Inside the flatpak
+ * sandbox they have to be started through flatpak-spawn, anywhere else,
+ * such as the command line tool on a build machine, they're started
+ * directly.
+ */
+
+/*
+ * Whether we're running inside a flatpak sandbox.
+ */
+gboolean
+llyfr_host_is_sandboxed (void)
+{
+  static gsize sandboxed = 0;
+
+  if (g_once_init_enter (&sandboxed)) {
+    gboolean found = g_file_test ("/.flatpak-info", G_FILE_TEST_EXISTS);
+
+    g_once_init_leave (&sandboxed, found ? 2 : 1);
+  }
+
+  return sandboxed == 2;
+}
+
+/*
+ * Start @argv on the host, from outside the sandbox if need be.
+ */
+GSubprocess*
+llyfr_host_spawnv (GSubprocessFlags      flags,
+                   const gchar * const  *argv,
+                   GError              **error)
+{
+  g_autoptr(GPtrArray) host_argv = NULL;
+
+  g_return_val_if_fail (argv != NULL && argv[0] != NULL, NULL);
+
+  if (!llyfr_host_is_sandboxed ())
+    return g_subprocess_newv (argv, flags, error);
+
+  // --watch-bus makes sure the process is torn down on the host should we
+  // go away without getting the chance to stop it ourselves.
+  host_argv = g_ptr_array_new ();
+  g_ptr_array_add (host_argv, (gpointer) "flatpak-spawn");
+  g_ptr_array_add (host_argv, (gpointer) "--host");
+  g_ptr_array_add (host_argv, (gpointer) "--watch-bus");
+
+  for (guint i = 0; argv[i] != NULL; i++)
+    g_ptr_array_add (host_argv, (gpointer) argv[i]);
+
+  g_ptr_array_add (host_argv, NULL);
+
+  return g_subprocess_newv ((const gchar * const *) host_argv->pdata, flags, error);
+}
@@ -0,0 +1,36 @@
+/* llyfr-host.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_HOST_H
+#define LLYFR_HOST_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+gboolean     llyfr_host_is_sandboxed (void);
+
+GSubprocess* llyfr_host_spawnv       (GSubprocessFlags flags,
+                                      const gchar * const *argv,
+                                      GError **error);
+
+G_END_DECLS
+
+#endif /* LLYFR_HOST_H */
@@ -0,0 +1,322 @@
+/* llyfr-line-index.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-line-index"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "llyfr-line-index.h"
+
+/*
+ * Reads lines out of a file by number, for showing the context around a
+ * match without having asked rg for it up front. The file is read a chunk
+ * at a time, and the offset of each line is only found once a line at or
+ * past it is asked for, so looking at the context of a match near the top
+ * of a large file only reads the start of it. It's read rather than mapped
+ * so a file cut short while we have it open can't take us down with it.
+ *
+ * The last few files looked at are kept by llyfr_line_index_lookup(), so
+ * expanding several matches in the same file reads it once. Indexes are
+ * dropped from there once the file's size or modification time changes.
+ */
+
+#define MAX_CACHED 16
+
+#define READ_CHUNK_SIZE (64 * 1024)
+
+struct _LlyfrLineIndex
+{
+  GObject      parent_instance;
+
+  gchar       *path;
+  int          fd;
+
+  // As much of the file as has been read so far, and as much as there is
+  // to read. That's its size when it was stamped, unless it's since been
+  // cut short.
+  GByteArray  *contents;
+  gsize        length;
+
+  // Taken from the descriptor we read from, in nanoseconds so edits within
+  // the same second are noticed.
+  gint64       mtime;
+  goffset      size;
+
+  // offsets[i] is where line i + 1 starts. Once the whole file has been
+  // looked through, the last entry is one past the end of the last line
+  // as if it ended with a newline.
+  GArray      *offsets;
+  gboolean     complete;
+};
+
+G_DEFINE_TYPE (LlyfrLineIndex, llyfr_line_index, G_TYPE_OBJECT)
+
+// Only used from the main thread.
+static GHashTable *cache = NULL;
+static GQueue cache_lru = G_QUEUE_INIT;
+
+static gint64
+stat_mtime (const GStatBuf *buf)
+{
+  return (gint64) buf->st_mtim.tv_sec * G_GINT64_CONSTANT (1000000000) + buf->st_mtim.tv_nsec;
+}
+
+LlyfrLineIndex*
+llyfr_line_index_new (const gchar *path,
+                      GError **error)
+{
+  LlyfrLineIndex *self;
+  GStatBuf buf;
+  int fd;
+
+  g_return_val_if_fail (path != NULL, NULL);
+
+  fd = g_open (path, O_RDONLY | O_CLOEXEC, 0);
+  if (fd < 0 || fstat (fd, &buf) != 0) {
+    int saved_errno = errno;
+
+    if (fd >= 0)
+      close (fd);
+
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                 "Unable to read %s: %s", path, g_strerror (saved_errno));
+    return NULL;
+  }
+
+  self = g_object_new (LLYFR_TYPE_LINE_INDEX, NULL);
+  self->path = g_strdup (path);
+  self->fd = fd;
+  // Far more than anyone will scroll through, but GByteArray can't go
+  // any further.
+  self->length = MIN ((guint64) buf.st_size, G_MAXUINT);
+  self->mtime = stat_mtime (&buf);
+  self->size = buf.st_size;
+
+  return self;
+}
+
+/*
+ * Read on until there are at least @wanted bytes, or there's nothing more
+ * to read.
+ */
+static void
+llyfr_line_index_read_to (LlyfrLineIndex *self,
+                          gsize wanted)
+{
+  wanted = MIN (wanted, self->length);
+
+  while (self->contents->len < wanted) {
+    gsize start = self->contents->len;
+    gsize chunk = MIN (READ_CHUNK_SIZE, self->length - start);
+    gssize n;
+
+    g_byte_array_set_size (self->contents, start + chunk);
+
+    do
+      n = pread (self->fd, self->contents->data + start, chunk, start);
+    while (n < 0 && errno == EINTR);
+
+    // The file has been cut short, what we have is all there is. It no
+    // longer matches its stamp, so the next lookup starts over.
+    if (n <= 0) {
+      g_byte_array_set_size (self->contents, start);
+      self->length = start;
+      break;
+    }
+
+    g_byte_array_set_size (self->contents, start + n);
+  }
+}
+
+static gboolean
+llyfr_line_index_is_stale (LlyfrLineIndex *self)
+{
+  GStatBuf buf;
+
+  if (g_stat (self->path, &buf) != 0)
+    return TRUE;
+
+  return stat_mtime (&buf) != self->mtime || buf.st_size != self->size;
+}
+
+/*
+ * Like llyfr_line_index_new(), but reusing the index of a recently looked
+ * at file when it hasn't changed since. Must be called from the main
+ * thread.
+ */
+LlyfrLineIndex*
+llyfr_line_index_lookup (const gchar *path,
+                         GError **error)
+{
+  LlyfrLineIndex *index;
+
+  g_return_val_if_fail (path != NULL, NULL);
+
+  if (cache == NULL)
+    cache = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_object_unref);
+
+  index = g_hash_table_lookup (cache, path);
+  if (index != NULL) {
+    g_queue_remove (&cache_lru, index);
+
+    if (!llyfr_line_index_is_stale (index)) {
+      g_queue_push_head (&cache_lru, index);
+      return g_object_ref (index);
+    }
+
+    g_hash_table_remove (cache, path);
+  }
+
+  index = llyfr_line_index_new (path, error);
+  if (index == NULL)
+    return NULL;
+
+  // The table owns the cached index, and the key is its path.
+  g_hash_table_insert (cache, index->path, g_object_ref (index));
+  g_queue_push_head (&cache_lru, index);
+
+  while (cache_lru.length > MAX_CACHED) {
+    LlyfrLineIndex *oldest = g_queue_pop_tail (&cache_lru);
+    g_hash_table_remove (cache, oldest->path);
+  }
+
+  return index;
+}
+
+const gchar*
+llyfr_line_index_get_path (LlyfrLineIndex *index)
+{
+  g_return_val_if_fail (LLYFR_IS_LINE_INDEX (index), NULL);
+
+  return index->path;
+}
+
+/*
+ * Find the start of lines until there are at least @n_offsets offsets, or
+ * the end of the file.
+ */
+static void
+llyfr_line_index_scan_to (LlyfrLineIndex *self,
+                          guint n_offsets)
+{
+  while (self->offsets->len < n_offsets && !self->complete) {
+    gsize start = g_array_index (self->offsets, gsize, self->offsets->len - 1);
+    const guint8 *newline = NULL;
+    gsize from = start;
+    gsize next;
+
+    // Read on until the end of the line turns up, or the file runs out.
+    for (;;) {
+      if (from < self->contents->len)
+        newline = memchr (self->contents->data + from, '\n', self->contents->len - from);
+
+      if (newline != NULL || self->contents->len >= self->length)
+        break;
+
+      from = MAX (from, self->contents->len);
+      llyfr_line_index_read_to (self, self->contents->len + READ_CHUNK_SIZE);
+    }
+
+    if (newline != NULL) {
+      next = newline - self->contents->data + 1;
+    } else {
+      self->complete = TRUE;
+
+      // A file that ends with a newline has nothing after it.
+      if (start >= self->contents->len)
+        break;
+
+      next = self->contents->len + 1;
+    }
+
+    g_array_append_val (self->offsets, next);
+  }
+}
+
+/*
+ * The text of the line numbered @line_number, counting from 1, without
+ * its line ending. The text is not NUL terminated, its length is stored in
+ * @length, and it's only good until @index is next used. Returns NULL when
+ * the file doesn't have that many lines.
+ */
+const gchar*
+llyfr_line_index_get_line (LlyfrLineIndex *index,
+                           gint64 line_number,
+                           gsize *length)
+{
+  gsize start, end;
+
+  g_return_val_if_fail (LLYFR_IS_LINE_INDEX (index), NULL);
+  g_return_val_if_fail (length != NULL, NULL);
+
+  if (line_number < 1 || line_number >= G_MAXUINT)
+    return NULL;
+
+  llyfr_line_index_scan_to (index, line_number + 1);
+  if (index->offsets->len < line_number + 1)
+    return NULL;
+
+  start = g_array_index (index->offsets, gsize, line_number - 1);
+  end = g_array_index (index->offsets, gsize, line_number) - 1;
+
+  if (end > start && index->contents->data[end - 1] == '\r')
+    end--;
+
+  *length = end - start;
+  return (const gchar *) index->contents->data + start;
+}
+
+static void
+llyfr_line_index_finalize (GObject *object)
+{
+  LlyfrLineIndex *self = LLYFR_LINE_INDEX (object);
+
+  g_free (self->path);
+  if (self->fd >= 0)
+    close (self->fd);
+
+  g_byte_array_unref (self->contents);
+  g_array_unref (self->offsets);
+
+  G_OBJECT_CLASS (llyfr_line_index_parent_class)->finalize (object);
+}
+
+static void
+llyfr_line_index_class_init (LlyfrLineIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = llyfr_line_index_finalize;
+}
+
+static void
+llyfr_line_index_init (LlyfrLineIndex *self)
+{
+  gsize zero = 0;
+
+  self->fd = -1;
+  self->contents = g_byte_array_new ();
+  self->offsets = g_array_new (FALSE, FALSE, sizeof (gsize));
+  g_array_append_val (self->offsets, zero);
+}
@@ -0,0 +1,47 @@
+/* llyfr-line-index.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_LINE_INDEX_H
+#define LLYFR_LINE_INDEX_H
+
+#include <glib.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define LLYFR_TYPE_LINE_INDEX (llyfr_line_index_get_type())
+
+G_DECLARE_FINAL_TYPE (LlyfrLineIndex, llyfr_line_index, LLYFR, LINE_INDEX, GObject)
+
+LlyfrLineIndex* llyfr_line_index_new      (const gchar *path,
+                                           GError **error);
+
+LlyfrLineIndex* llyfr_line_index_lookup   (const gchar *path,
+                                           GError **error);
+
+const gchar*    llyfr_line_index_get_path (LlyfrLineIndex *index);
+
+const gchar*    llyfr_line_index_get_line (LlyfrLineIndex *index,
+                                           gint64 line_number,
+                                           gsize *length);
+
+G_END_DECLS
+
+#endif /* LLYFR_LINE_INDEX_H */
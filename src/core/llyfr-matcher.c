@@ -0,0 +1,378 @@
+/* llyfr-matcher.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define _GNU_SOURCE
+#define G_LOG_DOMAIN "llyfr-matcher"
+
+#include <string.h>
+
+#include "llyfr-matcher.h"
+
+/*
+ * Finds the lines matching a query in a block of memory, the way rg would:
+ * plain queries are found with memmem(), anything else is compiled with
+ * GRegex which uses PCRE's JIT. As with rg, matches never span lines and
+ * files with a NUL byte near the start are taken to be binary and skipped.
+ *
+ * Like rg, a regex matches characters rather than bytes, so . or \w take
+ * in the whole of a multi-byte character. PCRE can't be handed text that
+ * isn't valid UTF-8 in that mode though, so files that aren't are matched
+ * a byte at a time instead, which is the one place we can disagree with
+ * rg: there, only ASCII is sure to match the same.
+ */
+
+// Queries without any of these are searched for as plain strings.
+#define REGEX_METACHARACTERS "\\.+*?()|[]{}^$"
+
+// How far into a file llyfr_matcher_is_binary() looks.
+#define BINARY_CHECK_SIZE (8 * 1024)
+
+struct _LlyfrMatcher
+{
+  gchar  *query;
+  gsize   query_length;
+
+  // Only set when the query isn't a plain string, the second for files
+  // that aren't valid UTF-8.
+  GRegex *regex;
+  GRegex *raw_regex;
+
+  guint   max_lines;
+};
+
+/*
+ * Compile @query, which is taken as a regular expression if it contains
+ * any of the characters that are special to one.
+ */
+LlyfrMatcher*
+llyfr_matcher_new (const gchar  *query,
+                   GError      **error)
+{
+  g_autoptr(LlyfrMatcher) matcher = NULL;
+
+  g_return_val_if_fail (query != NULL, NULL);
+
+  matcher = g_new0 (LlyfrMatcher, 1);
+  matcher->query = g_strdup (query);
+  matcher->query_length = strlen (query);
+
+  if (strpbrk (query, REGEX_METACHARACTERS) != NULL) {
+    matcher->regex = g_regex_new (query,
+                                  G_REGEX_MULTILINE | G_REGEX_OPTIMIZE,
+                                  0,
+                                  error);
+    if (matcher->regex == NULL)
+      return NULL;
+
+    matcher->raw_regex = g_regex_new (query,
+                                      G_REGEX_RAW | G_REGEX_MULTILINE | G_REGEX_OPTIMIZE,
+                                      0,
+                                      error);
+    if (matcher->raw_regex == NULL)
+      return NULL;
+  }
+
+  return g_steal_pointer (&matcher);
+}
+
+/*
+ * Stop scanning a file after @max_lines matching lines, like rg's
+ * --max-count. 0, the default, finds them all. Must be set before any
+ * scanning starts.
+ */
+void
+llyfr_matcher_set_max_lines (LlyfrMatcher *matcher,
+                             guint max_lines)
+{
+  g_return_if_fail (matcher != NULL);
+
+  matcher->max_lines = max_lines;
+}
+
+void
+llyfr_matcher_free (LlyfrMatcher *matcher)
+{
+  if (matcher == NULL)
+    return;
+
+  g_clear_pointer (&matcher->regex, g_regex_unref);
+  g_clear_pointer (&matcher->raw_regex, g_regex_unref);
+  g_free (matcher->query);
+  g_free (matcher);
+}
+
+/*
+ * Gathers the matches in a file into a result, a line at a time. Matches
+ * must be added in order.
+ */
+typedef struct
+{
+  const gchar        *path;
+  const gchar        *contents;
+  const gchar        *end;
+  LlyfrSearchArena   *arena;
+
+  // The line currently collecting matches, if any.
+  const gchar        *line_start;
+  const gchar        *line_end;
+  gint64              line_number;
+  GArray             *spans;
+
+  guint               n_lines;
+  guint               max_lines;
+
+  LlyfrSearchResult  *result;
+} LineCollector;
+
+static void
+line_collector_init (LineCollector    *collector,
+                     const gchar      *path,
+                     const gchar      *contents,
+                     gsize             size,
+                     guint             max_lines,
+                     LlyfrSearchArena *arena)
+{
+  collector->path = path;
+  collector->contents = contents;
+  collector->end = contents + size;
+  collector->arena = arena;
+
+  // Newlines before line_start have been counted, so starting off at the
+  // beginning of the file keeps the count right.
+  collector->line_start = NULL;
+  collector->line_end = contents;
+  collector->line_number = 0;
+  collector->spans = g_array_new (FALSE, FALSE, sizeof (gint64));
+  collector->n_lines = 0;
+  collector->max_lines = max_lines;
+  collector->result = NULL;
+}
+
+static void
+line_collector_flush (LineCollector *collector)
+{
+  g_autofree gchar *text = NULL;
+  gsize length;
+
+  if (collector->line_start == NULL)
+    return;
+
+  if (collector->result == NULL)
+    collector->result = llyfr_search_result_new_in_arena (collector->arena, collector->path);
+
+  // In a file that isn't valid UTF-8 the regex matches raw bytes, so its
+  // spans can split a character or sit among bytes that aren't UTF-8 at
+  // all, these are moved onto the characters of the line that's stored.
+  length = collector->line_end - collector->line_start;
+  text = llyfr_search_result_make_valid (collector->line_start,
+                                         length,
+                                         (gint64 *) collector->spans->data,
+                                         collector->spans->len / 2);
+
+  llyfr_search_result_add_match_full (collector->result,
+                                      collector->line_number,
+                                      text,
+                                      (const gint64 *) collector->spans->data,
+                                      collector->spans->len / 2);
+
+  g_array_set_size (collector->spans, 0);
+  collector->line_start = NULL;
+}
+
+/*
+ * Returns FALSE once the match would start a line past max_lines, in
+ * which case it isn't added and there's no point looking for more.
+ */
+static gboolean
+line_collector_add (LineCollector *collector,
+                    const gchar   *start,
+                    const gchar   *end)
+{
+  gint64 span[2];
+
+  if (collector->line_start == NULL || start > collector->line_end) {
+    const gchar *line_start = collector->line_start;
+    const gchar *counted = collector->line_end;
+    const gchar *newline;
+
+    if (collector->max_lines > 0 && collector->n_lines == collector->max_lines)
+      return FALSE;
+
+    collector->n_lines++;
+    line_collector_flush (collector);
+
+    // The first line is number 1, and each newline from the end of the
+    // last line up to the match starts another.
+    if (line_start == NULL && counted == collector->contents) {
+      line_start = collector->contents;
+      collector->line_number = 1;
+    }
+
+    while ((newline = memchr (counted, '\n', start - counted)) != NULL) {
+      line_start = newline + 1;
+      counted = line_start;
+      collector->line_number++;
+    }
+
+    collector->line_start = line_start;
+    collector->line_end = memchr (start, '\n', collector->end - start);
+    if (collector->line_end == NULL)
+      collector->line_end = collector->end;
+  }
+
+  // Only the part of a match on this line is highlighted.
+  span[0] = start - collector->line_start;
+  span[1] = MIN (end, collector->line_end) - collector->line_start;
+  g_array_append_vals (collector->spans, span, 2);
+
+  return TRUE;
+}
+
+/*
+ * Returns the finished result, or NULL if nothing matched.
+ */
+static LlyfrSearchResult*
+line_collector_finish (LineCollector *collector)
+{
+  line_collector_flush (collector);
+  g_array_unref (collector->spans);
+
+  if (collector->result != NULL)
+    llyfr_search_result_end (collector->result);
+
+  return collector->result;
+}
+
+/*
+ * Match the regex against the part of a line from @start to @line_end on
+ * its own. Returns FALSE once there's no point looking for more.
+ */
+static gboolean
+llyfr_matcher_scan_line (GRegex        *regex,
+                         LineCollector *collector,
+                         const gchar   *contents,
+                         gint           start,
+                         gint           line_end)
+{
+  g_autoptr(GMatchInfo) match_info = NULL;
+
+  g_regex_match_full (regex, contents, line_end, start, 0, &match_info, NULL);
+
+  while (g_match_info_matches (match_info)) {
+    gint match_start, match_end;
+
+    g_match_info_fetch_pos (match_info, 0, &match_start, &match_end);
+    if (!line_collector_add (collector, contents + match_start, contents + match_end))
+      return FALSE;
+
+    g_match_info_next (match_info, NULL);
+  }
+
+  return TRUE;
+}
+
+/*
+ * Like rg, a file with a NUL byte near the start is taken to be binary.
+ * Anything that decides which files get searched should agree with this.
+ */
+gboolean
+llyfr_matcher_is_binary (const gchar *contents,
+                         gsize size)
+{
+  return memchr (contents, '\0', MIN (size, BINARY_CHECK_SIZE)) != NULL;
+}
+
+/*
+ * Search @size bytes of @contents, the contents of @path, returning a result
+ * allocated from @arena or NULL if nothing matched. Binary contents never
+ * match. Safe to call from any number of threads at once.
+ */
+LlyfrSearchResult*
+llyfr_matcher_scan (LlyfrMatcher     *matcher,
+                    LlyfrSearchArena *arena,
+                    const gchar      *path,
+                    const gchar      *contents,
+                    gsize             size)
+{
+  LineCollector collector;
+
+  g_return_val_if_fail (matcher != NULL, NULL);
+
+  if (matcher->query_length == 0 || size == 0)
+    return NULL;
+
+  if (llyfr_matcher_is_binary (contents, size))
+    return NULL;
+
+  line_collector_init (&collector, path, contents, size, matcher->max_lines, arena);
+
+  if (matcher->regex == NULL) {
+    const gchar *end = contents + size;
+    const gchar *p = contents;
+    const gchar *match;
+
+    while ((match = memmem (p, end - p, matcher->query, matcher->query_length)) != NULL) {
+      if (!line_collector_add (&collector, match, match + matcher->query_length))
+        break;
+
+      p = match + matcher->query_length;
+    }
+  } else {
+    GRegex *regex = matcher->regex;
+    gboolean more = TRUE;
+    gsize position = 0;
+
+    if (!g_utf8_validate (contents, size, NULL))
+      regex = matcher->raw_regex;
+
+    // Searching the whole lot at once is far quicker than a line at a time,
+    // but lets a match like foo\s+bar carry on past the end of a line where
+    // rg's wouldn't. Any line that happens on is matched again on its own.
+    while (more && position < size) {
+      g_autoptr(GMatchInfo) match_info = NULL;
+
+      g_regex_match_full (regex, contents, size, position, 0, &match_info, NULL);
+      position = size;
+
+      while (g_match_info_matches (match_info)) {
+        const gchar *line_end;
+        gint start, end;
+
+        g_match_info_fetch_pos (match_info, 0, &start, &end);
+        line_end = memchr (contents + start, '\n', size - start);
+
+        if (line_end != NULL && contents + end > line_end) {
+          more = llyfr_matcher_scan_line (regex, &collector, contents, start, line_end - contents);
+          position = line_end - contents + 1;
+          break;
+        }
+
+        if (!line_collector_add (&collector, contents + start, contents + end)) {
+          more = FALSE;
+          break;
+        }
+
+        g_match_info_next (match_info, NULL);
+      }
+    }
+  }
+
+  return line_collector_finish (&collector);
+}
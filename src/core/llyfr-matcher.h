@@ -0,0 +1,54 @@
+/* llyfr-matcher.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_MATCHER_H
+#define LLYFR_MATCHER_H
+
+#include <glib.h>
+
+#include "llyfr-search-arena.h"
+#include "llyfr-search-result.h"
+
+G_BEGIN_DECLS
+
+typedef struct _LlyfrMatcher LlyfrMatcher;
+
+LlyfrMatcher*      llyfr_matcher_new  (const gchar *query,
+                                       GError **error);
+
+void               llyfr_matcher_set_max_lines (LlyfrMatcher *matcher,
+                                                guint max_lines);
+
+void               llyfr_matcher_free (LlyfrMatcher *matcher);
+
+gboolean           llyfr_matcher_is_binary (const gchar *contents,
+                                            gsize size);
+
+LlyfrSearchResult* llyfr_matcher_scan (LlyfrMatcher *matcher,
+                                       LlyfrSearchArena *arena,
+                                       const gchar *path,
+                                       const gchar *contents,
+                                       gsize size);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (LlyfrMatcher, llyfr_matcher_free)
+
+G_END_DECLS
+
+#endif /* LLYFR_MATCHER_H */
@@ -0,0 +1,268 @@
+/* llyfr-memory-stats.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-memory-stats"
+
+#include "llyfr-memory-stats.h"
+
+/*
+ * Counts how much memory results and the text built from them are holding
+ * on to. The types being counted keep the counters up to date themselves,
+ * from whichever thread they happen to be on, so the counters are plain
+ * atomics and can be read at any time.
+ *
+ * The same counters are available as properties of the default instance.
+ * Changes are gathered up and notified from the main loop, rather than
+ * once per result from a search's thread.
+ *
+ * Results that share their matches with another (see
+ * llyfr_search_result_copy()) count them again, so the byte counts are an
+ * upper bound.
+ */
+
+struct _LlyfrMemoryStats
+{
+  GObject parent_instance;
+};
+
+G_DEFINE_TYPE (LlyfrMemoryStats, llyfr_memory_stats, G_TYPE_OBJECT)
+
+enum
+{
+  PROP_0,
+  PROP_RESULTS,
+  PROP_MATCHES,
+  PROP_TEXT_BYTES,
+  PROP_HIGHLIGHT_BYTES,
+  PROP_BUFFERS,
+  PROP_BUFFER_BYTES,
+  LAST_PROP
+};
+
+static GParamSpec *properties[LAST_PROP];
+
+static gssize counters[LLYFR_MEMORY_N_COUNTERS];
+
+static LlyfrMemoryStats *default_stats = NULL;
+static gint notify_pending = FALSE;
+
+// The values last notified, only touched on the main thread.
+static guint64 notified[LLYFR_MEMORY_N_COUNTERS];
+
+static const gchar * const counter_names[LLYFR_MEMORY_N_COUNTERS] = {
+  [LLYFR_MEMORY_RESULTS]         = "results",
+  [LLYFR_MEMORY_MATCHES]         = "matches",
+  [LLYFR_MEMORY_TEXT_BYTES]      = "text-bytes",
+  [LLYFR_MEMORY_HIGHLIGHT_BYTES] = "highlight-bytes",
+  [LLYFR_MEMORY_BUFFERS]         = "buffers",
+  [LLYFR_MEMORY_BUFFER_BYTES]    = "buffer-bytes",
+};
+
+/*
+ * The instance whose properties follow the counters, it lives for as long
+ * as the process does.
+ */
+LlyfrMemoryStats*
+llyfr_memory_stats_get_default (void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized)) {
+    g_atomic_pointer_set (&default_stats, g_object_new (LLYFR_TYPE_MEMORY_STATS, NULL));
+    g_once_init_leave (&initialized, 1);
+  }
+
+  return default_stats;
+}
+
+const gchar*
+llyfr_memory_stats_counter_to_string (LlyfrMemoryCounter counter)
+{
+  g_return_val_if_fail (counter < LLYFR_MEMORY_N_COUNTERS, NULL);
+
+  return counter_names[counter];
+}
+
+static gboolean
+notify_cb (gpointer user_data)
+{
+  LlyfrMemoryStats *self = default_stats;
+
+  g_atomic_int_set (&notify_pending, FALSE);
+
+  g_object_freeze_notify (G_OBJECT (self));
+
+  for (guint counter = 0; counter < LLYFR_MEMORY_N_COUNTERS; counter++) {
+    guint64 value = llyfr_memory_stats_get (counter);
+
+    if (value == notified[counter])
+      continue;
+
+    notified[counter] = value;
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_RESULTS + counter]);
+  }
+
+  g_object_thaw_notify (G_OBJECT (self));
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Adjust @counter by @delta, safe to call from any thread.
+ */
+void
+llyfr_memory_stats_add (LlyfrMemoryCounter counter,
+                        gssize delta)
+{
+  g_return_if_fail (counter < LLYFR_MEMORY_N_COUNTERS);
+
+  g_atomic_pointer_add (&counters[counter], delta);
+
+  // Nobody can be listening until the default instance exists.
+  if (g_atomic_pointer_get (&default_stats) == NULL)
+    return;
+
+  if (g_atomic_int_compare_and_exchange (&notify_pending, FALSE, TRUE))
+    g_idle_add_full (G_PRIORITY_LOW, notify_cb, NULL, NULL);
+}
+
+guint64
+llyfr_memory_stats_get (LlyfrMemoryCounter counter)
+{
+  gssize value;
+
+  g_return_val_if_fail (counter < LLYFR_MEMORY_N_COUNTERS, 0);
+
+  value = (gssize) g_atomic_pointer_get (&counters[counter]);
+
+  // Counters on different threads can briefly pass each other.
+  return MAX (value, 0);
+}
+
+/*
+ * A one line summary of the counters, for logging.
+ */
+gchar*
+llyfr_memory_stats_to_string (void)
+{
+  guint64 matches = llyfr_memory_stats_get (LLYFR_MEMORY_MATCHES);
+  guint64 text_bytes = llyfr_memory_stats_get (LLYFR_MEMORY_TEXT_BYTES);
+  guint64 highlight_bytes = llyfr_memory_stats_get (LLYFR_MEMORY_HIGHLIGHT_BYTES);
+  g_autofree gchar *text = g_format_size (text_bytes);
+  g_autofree gchar *highlights = g_format_size (highlight_bytes);
+  g_autofree gchar *buffers = g_format_size (llyfr_memory_stats_get (LLYFR_MEMORY_BUFFER_BYTES));
+
+  return g_strdup_printf ("%" G_GUINT64_FORMAT " results, %" G_GUINT64_FORMAT " matches "
+                          "(%" G_GUINT64_FORMAT " bytes each), %s of text, %s of highlights, "
+                          "%" G_GUINT64_FORMAT " buffers (%s)",
+                          llyfr_memory_stats_get (LLYFR_MEMORY_RESULTS),
+                          matches,
+                          matches > 0 ? (text_bytes + highlight_bytes) / matches : 0,
+                          text,
+                          highlights,
+                          llyfr_memory_stats_get (LLYFR_MEMORY_BUFFERS),
+                          buffers);
+}
+
+static void
+llyfr_memory_stats_get_property (GObject    *object,
+                                 guint       prop_id,
+                                 GValue     *value,
+                                 GParamSpec *pspec)
+{
+  switch (prop_id)
+    {
+    case PROP_RESULTS:
+    case PROP_MATCHES:
+    case PROP_TEXT_BYTES:
+    case PROP_HIGHLIGHT_BYTES:
+    case PROP_BUFFERS:
+    case PROP_BUFFER_BYTES:
+      g_value_set_uint64 (value, llyfr_memory_stats_get (prop_id - PROP_RESULTS));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+llyfr_memory_stats_class_init (LlyfrMemoryStatsClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->get_property = llyfr_memory_stats_get_property;
+
+  properties[PROP_RESULTS] = g_param_spec_uint64 ("results",
+                                                  "Results",
+                                                  "The number of results that are alive",
+                                                  0,
+                                                  G_MAXUINT64,
+                                                  0,
+                                                  G_PARAM_READABLE);
+
+  properties[PROP_MATCHES] = g_param_spec_uint64 ("matches",
+                                                  "Matches",
+                                                  "The number of matches held by live results",
+                                                  0,
+                                                  G_MAXUINT64,
+                                                  0,
+                                                  G_PARAM_READABLE);
+
+  properties[PROP_TEXT_BYTES] = g_param_spec_uint64 ("text-bytes",
+                                                     "Text bytes",
+                                                     "Bytes of matching lines held by live results",
+                                                     0,
+                                                     G_MAXUINT64,
+                                                     0,
+                                                     G_PARAM_READABLE);
+
+  properties[PROP_HIGHLIGHT_BYTES] = g_param_spec_uint64 ("highlight-bytes",
+                                                          "Highlight bytes",
+                                                          "Bytes of highlight spans held by live results",
+                                                          0,
+                                                          G_MAXUINT64,
+                                                          0,
+                                                          G_PARAM_READABLE);
+
+  properties[PROP_BUFFERS] = g_param_spec_uint64 ("buffers",
+                                                  "Buffers",
+                                                  "The number of results whose text has been built for drawing",
+                                                  0,
+                                                  G_MAXUINT64,
+                                                  0,
+                                                  G_PARAM_READABLE);
+
+  properties[PROP_BUFFER_BYTES] = g_param_spec_uint64 ("buffer-bytes",
+                                                       "Buffer bytes",
+                                                       "Bytes taken up by text built for drawing",
+                                                       0,
+                                                       G_MAXUINT64,
+                                                       0,
+                                                       G_PARAM_READABLE);
+
+  g_object_class_install_properties (object_class, LAST_PROP, properties);
+}
+
+static void
+llyfr_memory_stats_init (LlyfrMemoryStats *self)
+{
+
+}
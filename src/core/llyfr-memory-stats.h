@@ -0,0 +1,63 @@
+/* llyfr-memory-stats.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_MEMORY_STATS_H
+#define LLYFR_MEMORY_STATS_H
+
+#include <glib.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define LLYFR_TYPE_MEMORY_STATS (llyfr_memory_stats_get_type())
+
+G_DECLARE_FINAL_TYPE (LlyfrMemoryStats, llyfr_memory_stats, LLYFR, MEMORY_STATS, GObject)
+
+/*
+ * What's being counted, each is also a property of LlyfrMemoryStats.
+ */
+typedef enum
+{
+  // Results that are still alive, along with the matches they hold.
+  LLYFR_MEMORY_RESULTS,
+  LLYFR_MEMORY_MATCHES,
+  // Bytes of matching lines and highlight spans those results hold.
+  LLYFR_MEMORY_TEXT_BYTES,
+  LLYFR_MEMORY_HIGHLIGHT_BYTES,
+  // Text built for rows to draw, and the bytes it takes up.
+  LLYFR_MEMORY_BUFFERS,
+  LLYFR_MEMORY_BUFFER_BYTES,
+  LLYFR_MEMORY_N_COUNTERS,
+} LlyfrMemoryCounter;
+
+LlyfrMemoryStats* llyfr_memory_stats_get_default       (void);
+
+const gchar*      llyfr_memory_stats_counter_to_string (LlyfrMemoryCounter counter);
+
+void              llyfr_memory_stats_add               (LlyfrMemoryCounter counter,
+                                                        gssize delta);
+
+guint64           llyfr_memory_stats_get               (LlyfrMemoryCounter counter);
+
+gchar*            llyfr_memory_stats_to_string         (void);
+
+G_END_DECLS
+
+#endif /* LLYFR_MEMORY_STATS_H */
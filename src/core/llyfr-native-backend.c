@@ -0,0 +1,281 @@
+/* llyfr-native-backend.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define _GNU_SOURCE
+#define G_LOG_DOMAIN "llyfr-native-backend"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "llyfr-matcher.h"
+#include "llyfr-native-backend.h"
+#include "llyfr-search-result.h"
+
+/*
+ * Searches in process, without rg. The calling thread walks the directory
+ * and hands each file to a thread pool, where it's mapped into memory and
+ * scanned in place by an LlyfrMatcher. Results go straight onto the sink,
+ * there's no process to start and no JSON to write or read.
+ *
+ * As with rg, hidden files and directories are skipped along with binary
+ * files and symlinks aren't followed. Unlike rg, .gitignore is not looked
+ * at.
+ */
+
+struct _LlyfrNativeBackend
+{
+  GObject parent_instance;
+};
+
+static void llyfr_native_backend_iface_init (LlyfrSearchBackendInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (LlyfrNativeBackend, llyfr_native_backend, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (LLYFR_TYPE_SEARCH_BACKEND,
+                                                llyfr_native_backend_iface_init))
+
+typedef struct
+{
+  LlyfrMatcher      *matcher;
+  LlyfrResultSink   *sink;
+  LlyfrSearchArena  *arena;
+  GCancellable      *cancellable;
+
+  // What we were asked to search, followed even when it's a symlink.
+  const gchar       *root;
+} ScanData;
+
+LlyfrSearchBackend*
+llyfr_native_backend_new (void)
+{
+  return g_object_new (LLYFR_TYPE_NATIVE_BACKEND, NULL);
+}
+
+/*
+ * Runs on the thread pool, searching a single file.
+ */
+static void
+llyfr_native_backend_scan_file (gpointer item,
+                                gpointer user_data)
+{
+  g_autofree gchar *path = item;
+  ScanData *data = user_data;
+  LlyfrTrace *trace = llyfr_result_sink_get_trace (data->sink);
+  LlyfrSearchResult *result;
+  struct stat buf;
+  gpointer contents;
+  gint64 begin;
+  int flags = O_RDONLY | O_NOCTTY | O_CLOEXEC;
+  int fd;
+
+  if (g_cancellable_is_cancelled (data->cancellable))
+    return;
+
+  begin = llyfr_trace_begin (trace);
+
+  if (g_strcmp0 (path, data->root) != 0)
+    flags |= O_NOFOLLOW;
+
+  fd = open (path, flags);
+  if (fd < 0)
+    return;
+
+  if (fstat (fd, &buf) != 0 || !S_ISREG (buf.st_mode) || buf.st_size == 0) {
+    close (fd);
+    return;
+  }
+
+  // The mapping outlives the descriptor.
+  contents = mmap (NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+
+  if (contents == MAP_FAILED)
+    return;
+
+  madvise (contents, buf.st_size, MADV_SEQUENTIAL);
+  result = llyfr_matcher_scan (data->matcher, data->arena, path, contents, buf.st_size);
+  munmap (contents, buf.st_size);
+
+  // One mark per file would be far too many, only the total is kept.
+  if (trace != NULL)
+    llyfr_trace_add (trace, LLYFR_TRACE_SCAN, g_get_monotonic_time () - begin);
+
+  if (result != NULL)
+    llyfr_result_sink_push (data->sink, result);
+}
+
+/*
+ * Queue every file under @path on @pool. Only the @root directory is
+ * followed should it be a symlink, and only it failing to open is an
+ * error, a subdirectory we can't read is skipped the same as rg does.
+ */
+static gboolean
+llyfr_native_backend_walk (const gchar   *path,
+                           gboolean       root,
+                           GThreadPool   *pool,
+                           GCancellable  *cancellable,
+                           GError       **error)
+{
+  g_autoptr(GPtrArray) subdirs = NULL;
+  struct dirent *entry;
+  DIR *dir;
+  int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+  int fd;
+
+  if (g_cancellable_is_cancelled (cancellable))
+    return TRUE;
+
+  if (!root)
+    flags |= O_NOFOLLOW;
+
+  fd = open (path, flags);
+  if (fd < 0 || (dir = fdopendir (fd)) == NULL) {
+    int saved_errno = errno;
+
+    if (fd >= 0)
+      close (fd);
+
+    if (root)
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                   "Unable to search %s: %s", path, g_strerror (saved_errno));
+
+    return !root;
+  }
+
+  subdirs = g_ptr_array_new_with_free_func (g_free);
+
+  while ((entry = readdir (dir)) != NULL) {
+    const gchar *name = entry->d_name;
+    unsigned char type = entry->d_type;
+
+    // Also covers . and ..
+    if (name[0] == '.')
+      continue;
+
+    if (type == DT_UNKNOWN) {
+      struct stat buf;
+
+      if (fstatat (dirfd (dir), name, &buf, AT_SYMLINK_NOFOLLOW) != 0)
+        continue;
+
+      type = S_ISDIR (buf.st_mode) ? DT_DIR : S_ISREG (buf.st_mode) ? DT_REG : DT_UNKNOWN;
+    }
+
+    if (type == DT_DIR)
+      g_ptr_array_add (subdirs, g_build_filename (path, name, NULL));
+    else if (type == DT_REG)
+      g_thread_pool_push (pool, g_build_filename (path, name, NULL), NULL);
+  }
+
+  closedir (dir);
+
+  // Files are queued before descending, so the pool has plenty to be
+  // getting on with.
+  for (guint i = 0; i < subdirs->len; i++)
+    llyfr_native_backend_walk (g_ptr_array_index (subdirs, i), FALSE, pool, cancellable, NULL);
+
+  return TRUE;
+}
+
+static gboolean
+llyfr_native_backend_search (LlyfrSearchBackend  *backend,
+                             const gchar         *directory,
+                             const gchar         *query,
+                             GPtrArray           *files,
+                             guint                threads,
+                             LlyfrResultSink     *sink,
+                             LlyfrSearchArena    *arena,
+                             GCancellable        *cancellable,
+                             GError             **error)
+{
+  ScanData data = { 0, };
+  GThreadPool *pool;
+  gboolean success = TRUE;
+  struct stat buf;
+
+  if (stat (directory, &buf) != 0) {
+    int saved_errno = errno;
+
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                 "Unable to search %s: %s", directory, g_strerror (saved_errno));
+    return FALSE;
+  }
+
+  if (*query == '\0')
+    return TRUE;
+
+  data.matcher = llyfr_matcher_new (query, error);
+  if (data.matcher == NULL)
+    return FALSE;
+
+  llyfr_matcher_set_max_lines (data.matcher, llyfr_search_budget_get_max_count (llyfr_result_sink_get_budget (sink)));
+
+  data.sink = sink;
+  data.arena = arena;
+  data.cancellable = cancellable;
+  data.root = directory;
+
+  if (threads == 0)
+    threads = g_get_num_processors ();
+
+  pool = g_thread_pool_new (llyfr_native_backend_scan_file, &data, threads, FALSE, error);
+  if (pool == NULL) {
+    llyfr_matcher_free (data.matcher);
+    return FALSE;
+  }
+
+  if (files != NULL) {
+    for (guint i = 0; i < files->len; i++)
+      g_thread_pool_push (pool, g_strdup (g_ptr_array_index (files, i)), NULL);
+  } else if (S_ISDIR (buf.st_mode)) {
+    success = llyfr_native_backend_walk (directory, TRUE, pool, cancellable, error);
+  } else {
+    g_thread_pool_push (pool, g_strdup (directory), NULL);
+  }
+
+  // Wait for whatever is still queued, scan_file skips the lot once
+  // cancelled.
+  g_thread_pool_free (pool, FALSE, TRUE);
+  llyfr_matcher_free (data.matcher);
+
+  if (!success)
+    return FALSE;
+
+  return !g_cancellable_set_error_if_cancelled (cancellable, error);
+}
+
+static void
+llyfr_native_backend_iface_init (LlyfrSearchBackendInterface *iface)
+{
+  iface->search = llyfr_native_backend_search;
+}
+
+static void
+llyfr_native_backend_class_init (LlyfrNativeBackendClass *klass)
+{
+}
+
+static void
+llyfr_native_backend_init (LlyfrNativeBackend *self)
+{
+}
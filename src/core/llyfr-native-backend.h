@@ -0,0 +1,39 @@
+/* llyfr-native-backend.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_NATIVE_BACKEND_H
+#define LLYFR_NATIVE_BACKEND_H
+
+#include <gio/gio.h>
+#include <glib-object.h>
+
+#include "llyfr-search-backend.h"
+
+G_BEGIN_DECLS
+
+#define LLYFR_TYPE_NATIVE_BACKEND (llyfr_native_backend_get_type())
+
+G_DECLARE_FINAL_TYPE (LlyfrNativeBackend, llyfr_native_backend, LLYFR, NATIVE_BACKEND, GObject)
+
+LlyfrSearchBackend* llyfr_native_backend_new (void);
+
+G_END_DECLS
+
+#endif /* LLYFR_NATIVE_BACKEND_H */
@@ -0,0 +1,533 @@
+/* llyfr-query-cache.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-query-cache"
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "llyfr-query-cache.h"
+#include "llyfr-search-result.h"
+
+/*
+ * Remembers the complete results of recent searches so that repeating one
+ * can fill in the results list straight away, without running rg again.
+ *
+ * Rather than watching every directory under a search context, each entry
+ * notes the modification time and size of the context's directory, its
+ * .git/index and every file with a match. An entry is thrown away on lookup
+ * if any of those have changed. That catches editing a matching file,
+ * adding or removing files at the top level and anything git has noticed,
+ * but not a new match in a file that didn't match before, or a file added
+ * further down the tree. Since a repeated search can then miss results, the
+ * cache is off unless query-cache-max-entries is set.
+ *
+ * Stamps are only taken once the search is over, so anything changed after
+ * it started could be newer than what it found. Results are only cached
+ * when nothing they're stamped with has changed since a little before the
+ * search started, which also covers filesystems with coarse timestamps.
+ */
+
+// How long before a search starts a change still counts as during it.
+#define STAMP_MARGIN (G_USEC_PER_SEC)
+
+typedef struct
+{
+  // In nanoseconds, so edits within the same second are noticed.
+  gint64 mtime;
+  gint64 size;
+} FileStamp;
+
+typedef struct
+{
+  gchar     *key;
+  gchar     *directory;
+  GPtrArray *results;
+
+  // The directory, its .git/index, then one for each result.
+  GArray    *stamps;
+
+  gsize      cost;
+  GList      link;
+} CacheEntry;
+
+struct _LlyfrQueryCache
+{
+  GObject     parent_instance;
+
+  GHashTable *entries;
+  GQueue      lru;
+
+  guint       max_entries;
+  guint64     max_size;
+  guint64     size;
+
+  guint64     hits;
+  guint64     misses;
+};
+
+G_DEFINE_TYPE (LlyfrQueryCache, llyfr_query_cache, G_TYPE_OBJECT)
+
+enum
+{
+  PROP_0,
+  PROP_MAX_ENTRIES,
+  PROP_MAX_SIZE,
+  PROP_SIZE,
+  PROP_HITS,
+  PROP_MISSES,
+  LAST_PROP
+};
+
+static GParamSpec *properties[LAST_PROP];
+
+LlyfrQueryCache*
+llyfr_query_cache_new (void)
+{
+  return g_object_new (LLYFR_TYPE_QUERY_CACHE, NULL);
+}
+
+static FileStamp
+file_stamp_get (const gchar *path)
+{
+  FileStamp stamp = { -1, -1 };
+  GStatBuf buf;
+
+  if (g_stat (path, &buf) == 0) {
+    stamp.mtime = (gint64) buf.st_mtim.tv_sec * G_GINT64_CONSTANT (1000000000) + buf.st_mtim.tv_nsec;
+    stamp.size = buf.st_size;
+  }
+
+  return stamp;
+}
+
+static gboolean
+file_stamp_check (const FileStamp *stamp,
+                  const gchar *path)
+{
+  FileStamp current = file_stamp_get (path);
+
+  return current.mtime == stamp->mtime && current.size == stamp->size;
+}
+
+/*
+ * Anything that changes what a search finds has to be part of the key: the
+ * context's directory, the backend it searches with, whether the files come
+ * from its index or git's, and whether the results are ranked.
+ */
+static gchar*
+llyfr_query_cache_make_key (LlyfrSearchContext *context,
+                            const gchar *query)
+{
+  return g_strdup_printf ("%s\x1f%s\x1f%d%d%d\x1f%s",
+                          llyfr_search_context_get_directory (context),
+                          G_OBJECT_TYPE_NAME (llyfr_search_context_get_backend (context)),
+                          llyfr_search_context_get_indexing_enabled (),
+                          llyfr_search_context_get_git_files_enabled (),
+                          llyfr_search_context_get_ranking_enabled (),
+                          query);
+}
+
+static gboolean
+cache_entry_is_valid (CacheEntry *entry)
+{
+  g_autofree gchar *index = g_build_filename (entry->directory, ".git", "index", NULL);
+
+  if (!file_stamp_check (&g_array_index (entry->stamps, FileStamp, 0), entry->directory) ||
+      !file_stamp_check (&g_array_index (entry->stamps, FileStamp, 1), index))
+    return FALSE;
+
+  for (guint i = 0; i < entry->results->len; i++) {
+    LlyfrSearchResult *result = g_ptr_array_index (entry->results, i);
+
+    if (!file_stamp_check (&g_array_index (entry->stamps, FileStamp, i + 2),
+                           llyfr_search_result_get_filepath (result)))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+cache_entry_free (CacheEntry *entry)
+{
+  g_free (entry->key);
+  g_free (entry->directory);
+  g_ptr_array_unref (entry->results);
+  g_array_unref (entry->stamps);
+  g_free (entry);
+}
+
+static void
+llyfr_query_cache_remove_entry (LlyfrQueryCache *self,
+                                CacheEntry *entry)
+{
+  g_queue_unlink (&self->lru, &entry->link);
+  self->size -= entry->cost;
+
+  g_hash_table_remove (self->entries, entry->key);
+  cache_entry_free (entry);
+}
+
+static void
+llyfr_query_cache_evict (LlyfrQueryCache *self)
+{
+  while (self->lru.head != NULL &&
+         (g_hash_table_size (self->entries) > self->max_entries || self->size > self->max_size))
+    llyfr_query_cache_remove_entry (self, self->lru.head->data);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_SIZE]);
+}
+
+/*
+ * Append the cached results of @query to @results, returning FALSE if there
+ * aren't any or they might be out of date.
+ */
+gboolean
+llyfr_query_cache_lookup (LlyfrQueryCache *self,
+                          LlyfrSearchContext *context,
+                          const gchar *query,
+                          GListStore *results)
+{
+  g_autofree gchar *key = NULL;
+  CacheEntry *entry;
+
+  g_return_val_if_fail (LLYFR_IS_QUERY_CACHE (self), FALSE);
+  g_return_val_if_fail (LLYFR_IS_SEARCH_CONTEXT (context), FALSE);
+  g_return_val_if_fail (G_IS_LIST_STORE (results), FALSE);
+
+  // A branch can move without anything we stamp changing, so searches of
+  // revisions aren't cached.
+  if (llyfr_search_context_get_revisions (context) != NULL)
+    return FALSE;
+
+  key = llyfr_query_cache_make_key (context, query);
+  entry = g_hash_table_lookup (self->entries, key);
+
+  if (entry != NULL && !cache_entry_is_valid (entry)) {
+    g_debug ("Results for '%s' are out of date", query);
+    llyfr_query_cache_remove_entry (self, entry);
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_SIZE]);
+    entry = NULL;
+  }
+
+  if (entry == NULL) {
+    self->misses++;
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_MISSES]);
+    return FALSE;
+  }
+
+  self->hits++;
+
+  g_queue_unlink (&self->lru, &entry->link);
+  g_queue_push_tail_link (&self->lru, &entry->link);
+
+  g_list_store_splice (results,
+                       g_list_model_get_n_items (G_LIST_MODEL (results)),
+                       0,
+                       entry->results->pdata,
+                       entry->results->len);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_HITS]);
+  return TRUE;
+}
+
+/*
+ * Remember @results as the complete results of searching @context for
+ * @query, which started at @started, in g_get_real_time()'s terms.
+ */
+void
+llyfr_query_cache_insert (LlyfrQueryCache *self,
+                          LlyfrSearchContext *context,
+                          const gchar *query,
+                          GListModel *results,
+                          gint64 started)
+{
+  g_autofree gchar *index = NULL;
+  CacheEntry *entry, *existing;
+  guint n_results;
+  gint64 newest = -1;
+  FileStamp stamp;
+
+  g_return_if_fail (LLYFR_IS_QUERY_CACHE (self));
+  g_return_if_fail (LLYFR_IS_SEARCH_CONTEXT (context));
+  g_return_if_fail (G_IS_LIST_MODEL (results));
+
+  if (self->max_entries == 0 || llyfr_search_context_get_revisions (context) != NULL)
+    return;
+
+  entry = g_new0 (CacheEntry, 1);
+  entry->key = llyfr_query_cache_make_key (context, query);
+  entry->directory = g_strdup (llyfr_search_context_get_directory (context));
+  entry->link.data = entry;
+
+  n_results = g_list_model_get_n_items (results);
+  entry->results = g_ptr_array_new_full (n_results, g_object_unref);
+  entry->stamps = g_array_sized_new (FALSE, FALSE, sizeof (FileStamp), n_results + 2);
+  entry->cost = sizeof (CacheEntry) + strlen (entry->key) + (n_results + 2) * sizeof (FileStamp);
+
+  index = g_build_filename (entry->directory, ".git", "index", NULL);
+
+  stamp = file_stamp_get (entry->directory);
+  g_array_append_val (entry->stamps, stamp);
+
+  stamp = file_stamp_get (index);
+  g_array_append_val (entry->stamps, stamp);
+
+  for (guint i = 0; i < n_results; i++) {
+    LlyfrSearchResult *result = g_list_model_get_item (results, i);
+
+    stamp = file_stamp_get (llyfr_search_result_get_filepath (result));
+    g_array_append_val (entry->stamps, stamp);
+
+    entry->cost += llyfr_search_result_get_size (result);
+    g_ptr_array_add (entry->results, result);
+  }
+
+  existing = g_hash_table_lookup (self->entries, entry->key);
+  if (existing != NULL)
+    llyfr_query_cache_remove_entry (self, existing);
+
+  for (guint i = 0; i < entry->stamps->len; i++)
+    newest = MAX (newest, g_array_index (entry->stamps, FileStamp, i).mtime);
+
+  // Changed while the search was running, what it found may already be out
+  // of date.
+  if (newest >= (started - STAMP_MARGIN) * 1000) {
+    g_debug ("Not caching results for '%s', files changed during the search", query);
+    cache_entry_free (entry);
+    return;
+  }
+
+  // Without being able to see the directory there's no way of telling when
+  // the results go stale.
+  if (g_array_index (entry->stamps, FileStamp, 0).mtime < 0 || entry->cost > self->max_size) {
+    cache_entry_free (entry);
+    return;
+  }
+
+  g_hash_table_insert (self->entries, entry->key, entry);
+  g_queue_push_tail_link (&self->lru, &entry->link);
+  self->size += entry->cost;
+
+  llyfr_query_cache_evict (self);
+}
+
+void
+llyfr_query_cache_clear (LlyfrQueryCache *self)
+{
+  g_return_if_fail (LLYFR_IS_QUERY_CACHE (self));
+
+  while (self->lru.head != NULL)
+    llyfr_query_cache_remove_entry (self, self->lru.head->data);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_SIZE]);
+}
+
+guint
+llyfr_query_cache_get_max_entries (LlyfrQueryCache *self)
+{
+  return self->max_entries;
+}
+
+void
+llyfr_query_cache_set_max_entries (LlyfrQueryCache *self,
+                                   guint max_entries)
+{
+  if (self->max_entries == max_entries)
+    return;
+
+  self->max_entries = max_entries;
+  llyfr_query_cache_evict (self);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_MAX_ENTRIES]);
+}
+
+guint64
+llyfr_query_cache_get_max_size (LlyfrQueryCache *self)
+{
+  return self->max_size;
+}
+
+void
+llyfr_query_cache_set_max_size (LlyfrQueryCache *self,
+                                guint64 max_size)
+{
+  if (self->max_size == max_size)
+    return;
+
+  self->max_size = max_size;
+  llyfr_query_cache_evict (self);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_MAX_SIZE]);
+}
+
+guint64
+llyfr_query_cache_get_size (LlyfrQueryCache *self)
+{
+  return self->size;
+}
+
+guint64
+llyfr_query_cache_get_hits (LlyfrQueryCache *self)
+{
+  return self->hits;
+}
+
+guint64
+llyfr_query_cache_get_misses (LlyfrQueryCache *self)
+{
+  return self->misses;
+}
+
+static void
+llyfr_query_cache_get_property (GObject    *object,
+                                guint       prop_id,
+                                GValue     *value,
+                                GParamSpec *pspec)
+{
+  LlyfrQueryCache *self = LLYFR_QUERY_CACHE (object);
+
+  switch (prop_id)
+    {
+    case PROP_MAX_ENTRIES:
+      g_value_set_uint (value, llyfr_query_cache_get_max_entries (self));
+      break;
+
+    case PROP_MAX_SIZE:
+      g_value_set_uint64 (value, llyfr_query_cache_get_max_size (self));
+      break;
+
+    case PROP_SIZE:
+      g_value_set_uint64 (value, llyfr_query_cache_get_size (self));
+      break;
+
+    case PROP_HITS:
+      g_value_set_uint64 (value, llyfr_query_cache_get_hits (self));
+      break;
+
+    case PROP_MISSES:
+      g_value_set_uint64 (value, llyfr_query_cache_get_misses (self));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+llyfr_query_cache_set_property (GObject      *object,
+                                guint         prop_id,
+                                const GValue *value,
+                                GParamSpec   *pspec)
+{
+  LlyfrQueryCache *self = LLYFR_QUERY_CACHE (object);
+
+  switch (prop_id)
+    {
+    case PROP_MAX_ENTRIES:
+      llyfr_query_cache_set_max_entries (self, g_value_get_uint (value));
+      break;
+
+    case PROP_MAX_SIZE:
+      llyfr_query_cache_set_max_size (self, g_value_get_uint64 (value));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+llyfr_query_cache_finalize (GObject *object)
+{
+  LlyfrQueryCache *self = LLYFR_QUERY_CACHE (object);
+
+  // The queue's links are embedded in the entries, so empty it by hand.
+  while (self->lru.head != NULL)
+    llyfr_query_cache_remove_entry (self, self->lru.head->data);
+
+  g_hash_table_unref (self->entries);
+
+  G_OBJECT_CLASS (llyfr_query_cache_parent_class)->finalize (object);
+}
+
+static void
+llyfr_query_cache_class_init (LlyfrQueryCacheClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->get_property = llyfr_query_cache_get_property;
+  object_class->set_property = llyfr_query_cache_set_property;
+  object_class->finalize = llyfr_query_cache_finalize;
+
+  properties[PROP_MAX_ENTRIES] = g_param_spec_uint ("max-entries",
+                                                    "Max entries",
+                                                    "The number of searches to keep, none turns the cache off",
+                                                    0,
+                                                    G_MAXUINT,
+                                                    0,
+                                                    G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY);
+
+  properties[PROP_MAX_SIZE] = g_param_spec_uint64 ("max-size",
+                                                   "Max size",
+                                                   "The estimated number of bytes to keep",
+                                                   0,
+                                                   G_MAXUINT64,
+                                                   128 * 1024 * 1024,
+                                                   G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY);
+
+  properties[PROP_SIZE] = g_param_spec_uint64 ("size",
+                                               "Size",
+                                               "The estimated number of bytes held",
+                                               0,
+                                               G_MAXUINT64,
+                                               0,
+                                               G_PARAM_READABLE);
+
+  properties[PROP_HITS] = g_param_spec_uint64 ("hits",
+                                               "Hits",
+                                               "Lookups that found usable results",
+                                               0,
+                                               G_MAXUINT64,
+                                               0,
+                                               G_PARAM_READABLE);
+
+  properties[PROP_MISSES] = g_param_spec_uint64 ("misses",
+                                                 "Misses",
+                                                 "Lookups that found nothing, or stale results",
+                                                 0,
+                                                 G_MAXUINT64,
+                                                 0,
+                                                 G_PARAM_READABLE);
+
+  g_object_class_install_properties (object_class, LAST_PROP, properties);
+}
+
+static void
+llyfr_query_cache_init (LlyfrQueryCache *self)
+{
+  self->entries = g_hash_table_new (g_str_hash, g_str_equal);
+  g_queue_init (&self->lru);
+
+  self->max_entries = 0;
+  self->max_size = 128 * 1024 * 1024;
+}
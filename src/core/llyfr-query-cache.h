@@ -0,0 +1,68 @@
+/* llyfr-query-cache.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_QUERY_CACHE_H
+#define LLYFR_QUERY_CACHE_H
+
+#include <gio/gio.h>
+#include <glib-object.h>
+
+#include "llyfr-search-context.h"
+
+G_BEGIN_DECLS
+
+#define LLYFR_TYPE_QUERY_CACHE (llyfr_query_cache_get_type())
+
+G_DECLARE_FINAL_TYPE (LlyfrQueryCache, llyfr_query_cache, LLYFR, QUERY_CACHE, GObject)
+
+LlyfrQueryCache* llyfr_query_cache_new             (void);
+
+gboolean         llyfr_query_cache_lookup          (LlyfrQueryCache *cache,
+                                                    LlyfrSearchContext *context,
+                                                    const gchar *query,
+                                                    GListStore *results);
+
+void             llyfr_query_cache_insert          (LlyfrQueryCache *cache,
+                                                    LlyfrSearchContext *context,
+                                                    const gchar *query,
+                                                    GListModel *results,
+                                                    gint64 started);
+
+void             llyfr_query_cache_clear           (LlyfrQueryCache *cache);
+
+guint            llyfr_query_cache_get_max_entries (LlyfrQueryCache *cache);
+
+void             llyfr_query_cache_set_max_entries (LlyfrQueryCache *cache,
+                                                    guint max_entries);
+
+guint64          llyfr_query_cache_get_max_size    (LlyfrQueryCache *cache);
+
+void             llyfr_query_cache_set_max_size    (LlyfrQueryCache *cache,
+                                                    guint64 max_size);
+
+guint64          llyfr_query_cache_get_size        (LlyfrQueryCache *cache);
+
+guint64          llyfr_query_cache_get_hits        (LlyfrQueryCache *cache);
+
+guint64          llyfr_query_cache_get_misses      (LlyfrQueryCache *cache);
+
+G_END_DECLS
+
+#endif /* LLYFR_QUERY_CACHE_H */
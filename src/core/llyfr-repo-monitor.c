@@ -0,0 +1,383 @@
+/* llyfr-repo-monitor.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-repo-monitor"
+
+#include "llyfr-repo-monitor.h"
+#include "llyfr-search-context.h"
+
+/*
+ * Keeps a list of search contexts up to date as repositories come and go,
+ * without walking the whole home directory again.
+ *
+ * The directories containing known repositories are watched, along with a
+ * few roots, since that's where new ones tend to appear. A new directory
+ * that isn't (yet) a repository is watched for a little while in case a
+ * .git turns up inside it, which is what happens during a clone. Contexts
+ * are added and removed one at a time, so views of the list only have to
+ * deal with what actually changed.
+ */
+
+// How long to wait for a new directory to become a repository.
+#define PENDING_TIMEOUT_SECONDS 60
+
+struct _LlyfrRepoMonitor
+{
+  GObject     parent_instance;
+
+  GListStore *contexts;
+
+  // Directory -> GFileMonitor
+  GHashTable *monitors;
+
+  // New directory -> GFileMonitor, until it becomes a repository or times out.
+  GHashTable *pending;
+
+  GHashTable *excludes;
+};
+
+G_DEFINE_TYPE (LlyfrRepoMonitor, llyfr_repo_monitor, G_TYPE_OBJECT)
+
+static void
+llyfr_repo_monitor_drop (GFileMonitor *monitor)
+{
+  g_file_monitor_cancel (monitor);
+  g_object_unref (monitor);
+}
+
+static gint
+llyfr_repo_monitor_find (LlyfrRepoMonitor *self,
+                         const gchar *directory)
+{
+  guint n_contexts = g_list_model_get_n_items (G_LIST_MODEL (self->contexts));
+
+  for (guint i = 0; i < n_contexts; i++) {
+    g_autoptr(LlyfrSearchContext) context = g_list_model_get_item (G_LIST_MODEL (self->contexts), i);
+
+    if (g_strcmp0 (llyfr_search_context_get_directory (context), directory) == 0)
+      return i;
+  }
+
+  return -1;
+}
+
+static void
+llyfr_repo_monitor_add (LlyfrRepoMonitor *self,
+                        const gchar *directory)
+{
+  g_autoptr(LlyfrSearchContext) context = NULL;
+
+  g_hash_table_remove (self->pending, directory);
+
+  if (llyfr_repo_monitor_find (self, directory) >= 0)
+    return;
+
+  g_debug ("Found %s", directory);
+  context = llyfr_search_context_new ((gchar *) directory);
+  g_list_store_append (self->contexts, context);
+}
+
+/*
+ * Remove the context for @directory, along with any nested inside it.
+ */
+static void
+llyfr_repo_monitor_remove (LlyfrRepoMonitor *self,
+                           const gchar *directory)
+{
+  g_autofree gchar *prefix = g_strconcat (directory, G_DIR_SEPARATOR_S, NULL);
+  guint n_contexts = g_list_model_get_n_items (G_LIST_MODEL (self->contexts));
+
+  g_hash_table_remove (self->pending, directory);
+
+  for (guint i = n_contexts; i > 0; i--) {
+    g_autoptr(LlyfrSearchContext) context = g_list_model_get_item (G_LIST_MODEL (self->contexts), i - 1);
+    const gchar *context_directory = llyfr_search_context_get_directory (context);
+
+    if (g_strcmp0 (context_directory, directory) == 0 || g_str_has_prefix (context_directory, prefix)) {
+      g_debug ("Lost %s", context_directory);
+      g_list_store_remove (self->contexts, i - 1);
+    }
+  }
+}
+
+static gboolean
+llyfr_repo_monitor_is_repo (const gchar *directory)
+{
+  g_autofree gchar *git = g_build_filename (directory, ".git", NULL);
+  return g_file_test (git, G_FILE_TEST_EXISTS);
+}
+
+static gboolean
+pending_timeout_cb (gpointer user_data)
+{
+  GFileMonitor *monitor = G_FILE_MONITOR (user_data);
+  LlyfrRepoMonitor *self = g_object_get_data (G_OBJECT (monitor), "llyfr-repo-monitor");
+  const gchar *directory = g_object_get_data (G_OBJECT (monitor), "llyfr-directory");
+
+  // This source is about to go anyway.
+  g_object_steal_data (G_OBJECT (monitor), "llyfr-timeout");
+
+  g_hash_table_remove (self->pending, directory);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+pending_changed_cb (GFileMonitor      *monitor,
+                    GFile             *file,
+                    GFile             *other_file,
+                    GFileMonitorEvent  event,
+                    LlyfrRepoMonitor  *self)
+{
+  g_autofree gchar *name = NULL;
+  g_autofree gchar *directory = NULL;
+
+  if (event != G_FILE_MONITOR_EVENT_CREATED && event != G_FILE_MONITOR_EVENT_MOVED_IN)
+    return;
+
+  name = g_file_get_basename (file);
+  if (g_strcmp0 (name, ".git") != 0)
+    return;
+
+  // Copied, as adding the repository drops this monitor.
+  directory = g_strdup (g_object_get_data (G_OBJECT (monitor), "llyfr-directory"));
+  llyfr_repo_monitor_add (self, directory);
+}
+
+static void
+llyfr_repo_monitor_watch_pending (LlyfrRepoMonitor *self,
+                                  const gchar *directory)
+{
+  g_autoptr(GFile) file = NULL;
+  GFileMonitor *monitor;
+  guint timeout_id;
+
+  if (g_hash_table_contains (self->pending, directory))
+    return;
+
+  file = g_file_new_for_path (directory);
+  monitor = g_file_monitor_directory (file, G_FILE_MONITOR_WATCH_MOVES, NULL, NULL);
+  if (monitor == NULL)
+    return;
+
+  g_object_set_data_full (G_OBJECT (monitor), "llyfr-directory", g_strdup (directory), g_free);
+  g_object_set_data (G_OBJECT (monitor), "llyfr-repo-monitor", self);
+  g_signal_connect (monitor, "changed", G_CALLBACK (pending_changed_cb), self);
+
+  // Removed along with the monitor, should it go first.
+  timeout_id = g_timeout_add_seconds (PENDING_TIMEOUT_SECONDS, pending_timeout_cb, monitor);
+  g_object_set_data_full (G_OBJECT (monitor), "llyfr-timeout",
+                          GUINT_TO_POINTER (timeout_id),
+                          (GDestroyNotify) g_source_remove);
+
+  g_hash_table_insert (self->pending, g_strdup (directory), monitor);
+}
+
+static void
+llyfr_repo_monitor_directory_added (LlyfrRepoMonitor *self,
+                                    GFile *file)
+{
+  g_autofree gchar *path = g_file_get_path (file);
+  g_autofree gchar *name = g_file_get_basename (file);
+
+  if (path == NULL || g_hash_table_contains (self->excludes, name) || g_hash_table_contains (self->excludes, path))
+    return;
+
+  if (g_file_query_file_type (file, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL) != G_FILE_TYPE_DIRECTORY)
+    return;
+
+  if (llyfr_repo_monitor_is_repo (path))
+    llyfr_repo_monitor_add (self, path);
+  else
+    llyfr_repo_monitor_watch_pending (self, path);
+}
+
+static void
+llyfr_repo_monitor_directory_removed (LlyfrRepoMonitor *self,
+                                      GFile *file)
+{
+  g_autofree gchar *path = g_file_get_path (file);
+
+  if (path != NULL)
+    llyfr_repo_monitor_remove (self, path);
+}
+
+static void
+changed_cb (GFileMonitor      *monitor,
+            GFile             *file,
+            GFile             *other_file,
+            GFileMonitorEvent  event,
+            LlyfrRepoMonitor  *self)
+{
+  const gchar *directory = g_object_get_data (G_OBJECT (monitor), "llyfr-directory");
+  g_autofree gchar *path = g_file_get_path (file);
+
+  // The watched directory itself has gone, and everything in it.
+  if (g_strcmp0 (path, directory) == 0) {
+    if (event == G_FILE_MONITOR_EVENT_DELETED || event == G_FILE_MONITOR_EVENT_MOVED_OUT) {
+      llyfr_repo_monitor_remove (self, path);
+      g_hash_table_remove (self->monitors, path);
+    }
+
+    return;
+  }
+
+  switch (event) {
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+      llyfr_repo_monitor_directory_added (self, file);
+      break;
+
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_MOVED_OUT:
+      llyfr_repo_monitor_directory_removed (self, file);
+      break;
+
+    case G_FILE_MONITOR_EVENT_RENAMED:
+      llyfr_repo_monitor_directory_removed (self, file);
+      llyfr_repo_monitor_directory_added (self, other_file);
+      break;
+
+    default:
+      break;
+  }
+}
+
+static void
+llyfr_repo_monitor_watch (LlyfrRepoMonitor *self,
+                          const gchar *directory)
+{
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GError) error = NULL;
+  GFileMonitor *monitor;
+
+  if (g_hash_table_contains (self->monitors, directory))
+    return;
+
+  file = g_file_new_for_path (directory);
+  monitor = g_file_monitor_directory (file, G_FILE_MONITOR_WATCH_MOVES, NULL, &error);
+  if (monitor == NULL) {
+    g_debug ("Unable to watch %s: %s", directory, error->message);
+    return;
+  }
+
+  g_object_set_data_full (G_OBJECT (monitor), "llyfr-directory", g_strdup (directory), g_free);
+  g_signal_connect (monitor, "changed", G_CALLBACK (changed_cb), self);
+
+  g_hash_table_insert (self->monitors, g_strdup (directory), monitor);
+}
+
+static void
+contexts_changed_cb (LlyfrRepoMonitor *self,
+                     guint             position,
+                     guint             removed,
+                     guint             added,
+                     GListModel       *contexts)
+{
+  // Watches on directories that no longer hold any repositories are left
+  // alone, new ones could still turn up there.
+  for (guint i = position; i < position + added; i++) {
+    g_autoptr(LlyfrSearchContext) context = g_list_model_get_item (contexts, i);
+    g_autofree gchar *parent = g_path_get_dirname (llyfr_search_context_get_directory (context));
+
+    llyfr_repo_monitor_watch (self, parent);
+  }
+}
+
+/*
+ * Watch for repositories being added to, or removed from, @contexts. As
+ * well as the directories holding the repositories already in @contexts,
+ * new ones are looked for directly inside each of @roots.
+ */
+LlyfrRepoMonitor*
+llyfr_repo_monitor_new (GListStore *contexts,
+                        const gchar * const *roots)
+{
+  LlyfrRepoMonitor *self;
+
+  g_return_val_if_fail (G_IS_LIST_STORE (contexts), NULL);
+
+  self = g_object_new (LLYFR_TYPE_REPO_MONITOR, NULL);
+  self->contexts = g_object_ref (contexts);
+
+  for (guint i = 0; roots != NULL && roots[i] != NULL; i++)
+    llyfr_repo_monitor_watch (self, roots[i]);
+
+  contexts_changed_cb (self, 0, 0, g_list_model_get_n_items (G_LIST_MODEL (contexts)), G_LIST_MODEL (contexts));
+  g_signal_connect_object (contexts, "items-changed", G_CALLBACK (contexts_changed_cb), self, G_CONNECT_SWAPPED);
+
+  return self;
+}
+
+/*
+ * New directories with one of these names, or at one of these paths, are
+ * ignored.
+ */
+void
+llyfr_repo_monitor_set_excludes (LlyfrRepoMonitor *self,
+                                 const gchar * const *excludes)
+{
+  g_return_if_fail (LLYFR_IS_REPO_MONITOR (self));
+
+  g_hash_table_remove_all (self->excludes);
+
+  for (guint i = 0; excludes != NULL && excludes[i] != NULL; i++)
+    g_hash_table_add (self->excludes, g_strdup (excludes[i]));
+}
+
+static void
+llyfr_repo_monitor_dispose (GObject *object)
+{
+  LlyfrRepoMonitor *self = LLYFR_REPO_MONITOR (object);
+
+  g_hash_table_remove_all (self->monitors);
+  g_hash_table_remove_all (self->pending);
+  g_clear_object (&self->contexts);
+
+  G_OBJECT_CLASS (llyfr_repo_monitor_parent_class)->dispose (object);
+}
+
+static void
+llyfr_repo_monitor_finalize (GObject *object)
+{
+  LlyfrRepoMonitor *self = LLYFR_REPO_MONITOR (object);
+
+  g_hash_table_unref (self->monitors);
+  g_hash_table_unref (self->pending);
+  g_hash_table_unref (self->excludes);
+
+  G_OBJECT_CLASS (llyfr_repo_monitor_parent_class)->finalize (object);
+}
+
+static void
+llyfr_repo_monitor_class_init (LlyfrRepoMonitorClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = llyfr_repo_monitor_dispose;
+  object_class->finalize = llyfr_repo_monitor_finalize;
+}
+
+static void
+llyfr_repo_monitor_init (LlyfrRepoMonitor *self)
+{
+  self->monitors = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) llyfr_repo_monitor_drop);
+  self->pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) llyfr_repo_monitor_drop);
+  self->excludes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+}
@@ -0,0 +1,41 @@
+/* llyfr-repo-monitor.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_REPO_MONITOR_H
+#define LLYFR_REPO_MONITOR_H
+
+#include <gio/gio.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define LLYFR_TYPE_REPO_MONITOR (llyfr_repo_monitor_get_type())
+
+G_DECLARE_FINAL_TYPE (LlyfrRepoMonitor, llyfr_repo_monitor, LLYFR, REPO_MONITOR, GObject)
+
+LlyfrRepoMonitor* llyfr_repo_monitor_new          (GListStore *contexts,
+                                                   const gchar * const *roots);
+
+void              llyfr_repo_monitor_set_excludes (LlyfrRepoMonitor *monitor,
+                                                   const gchar * const *excludes);
+
+G_END_DECLS
+
+#endif /* LLYFR_REPO_MONITOR_H */
@@ -0,0 +1,461 @@
+/* llyfr-repo-walker.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-repo-walker"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "llyfr-repo-walker.h"
+#include "llyfr-result-sink.h"
+#include "llyfr-search-context.h"
+
+/*
+ * Finds git repositories under a directory, creating a search context for
+ * each one.
+ *
+ * Every directory is a separate job on a thread pool, so idle threads pick
+ * up whichever subdirectories are waiting rather than each being handed a
+ * fixed share of the tree. Once a directory turns out to be a repository
+ * there's no need to go any further, unless looking for submodules. Symlinks
+ * are never followed and anything named in the exclude list is skipped.
+ */
+
+#define MAX_THREADS 8
+
+struct _LlyfrRepoWalker
+{
+  GObject  parent_instance;
+
+  gchar   *root;
+  GStrv    excludes;
+  gboolean submodules;
+};
+
+G_DEFINE_TYPE (LlyfrRepoWalker, llyfr_repo_walker, G_TYPE_OBJECT)
+
+enum
+{
+  PROP_0,
+  PROP_ROOT,
+  PROP_EXCLUDES,
+  PROP_SUBMODULES,
+  LAST_PROP
+};
+
+static GParamSpec *properties[LAST_PROP];
+
+typedef struct
+{
+  GTask           *task;
+  GThreadPool     *pool;
+  LlyfrResultSink *sink;
+  GCancellable    *cancellable;
+
+  // Excluded names, or paths when they start with a '/'.
+  GHashTable      *excludes;
+  gboolean         submodules;
+
+  // Directories queued or being read, when this drops to zero we're done
+  // and the task's reference is handed to llyfr_repo_walker_done_cb().
+  gint             pending;
+
+  // Only set when the walk is being traced.
+  LlyfrTrace      *trace;
+} WalkData;
+
+static void
+walk_data_free (WalkData *data)
+{
+  // The last job has finished by now, this only waits for its thread to
+  // return to the pool.
+  if (data->pool != NULL)
+    g_thread_pool_free (data->pool, FALSE, TRUE);
+
+  g_clear_object (&data->sink);
+  g_clear_object (&data->cancellable);
+  g_clear_pointer (&data->trace, llyfr_trace_unref);
+  g_hash_table_unref (data->excludes);
+
+  g_free (data);
+}
+
+LlyfrRepoWalker*
+llyfr_repo_walker_new (const gchar *root)
+{
+  return g_object_new (LLYFR_TYPE_REPO_WALKER,
+                       "root", root,
+                       NULL);
+}
+
+static gboolean
+llyfr_repo_walker_is_excluded (WalkData *data,
+                               const gchar *path,
+                               const gchar *name)
+{
+  return g_hash_table_contains (data->excludes, name) ||
+         g_hash_table_contains (data->excludes, path);
+}
+
+/*
+ * Runs back on the caller's main context once every directory has been read.
+ */
+static gboolean
+llyfr_repo_walker_done_cb (gpointer user_data)
+{
+  g_autoptr(GTask) task = G_TASK (user_data);
+  WalkData *data = g_task_get_task_data (task);
+
+  if (g_task_return_error_if_cancelled (task)) {
+    llyfr_result_sink_close (data->sink);
+    return G_SOURCE_REMOVE;
+  }
+
+  llyfr_result_sink_flush (data->sink);
+  llyfr_trace_finish (data->trace);
+  g_task_return_boolean (task, TRUE);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+llyfr_repo_walker_queue (WalkData *data,
+                         gchar *path)
+{
+  g_atomic_int_inc (&data->pending);
+  g_thread_pool_push (data->pool, path, NULL);
+}
+
+/*
+ * Reads a single directory, queuing each of its subdirectories as a job of
+ * its own.
+ */
+static void
+llyfr_repo_walker_read_dir (gpointer job,
+                            gpointer user_data)
+{
+  g_autofree gchar *path = job;
+  g_autoptr(GPtrArray) subdirs = NULL;
+  WalkData *data = user_data;
+  gboolean is_repo = FALSE;
+  struct dirent *entry;
+  DIR *dir = NULL;
+  gint64 begin;
+  int fd;
+
+  if (g_cancellable_is_cancelled (data->cancellable))
+    goto out;
+
+  begin = llyfr_trace_begin (data->trace);
+
+  fd = open (path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (fd < 0 || (dir = fdopendir (fd)) == NULL) {
+    // Permission denied and the like are normal when walking a home
+    // directory, so just move on.
+    if (fd >= 0)
+      close (fd);
+
+    goto out;
+  }
+
+  subdirs = g_ptr_array_new_with_free_func (g_free);
+
+  while ((entry = readdir (dir)) != NULL) {
+    const gchar *name = entry->d_name;
+    unsigned char type = entry->d_type;
+
+    if (strcmp (name, ".") == 0 || strcmp (name, "..") == 0)
+      continue;
+
+    if (type == DT_UNKNOWN) {
+      struct stat buf;
+
+      if (fstatat (dirfd (dir), name, &buf, AT_SYMLINK_NOFOLLOW) != 0)
+        continue;
+
+      type = S_ISDIR (buf.st_mode) ? DT_DIR : S_ISREG (buf.st_mode) ? DT_REG : DT_UNKNOWN;
+    }
+
+    // Submodules and worktrees have a .git file pointing elsewhere.
+    if (strcmp (name, ".git") == 0) {
+      is_repo = type == DT_DIR || type == DT_REG;
+      continue;
+    }
+
+    if (type == DT_DIR)
+      g_ptr_array_add (subdirs, g_strdup (name));
+  }
+
+  closedir (dir);
+
+  if (data->trace != NULL)
+    llyfr_trace_add (data->trace, LLYFR_TRACE_SCAN, g_get_monotonic_time () - begin);
+
+  if (is_repo)
+    llyfr_result_sink_push (data->sink, llyfr_search_context_new (path));
+
+  if (is_repo && !data->submodules)
+    goto out;
+
+  for (guint i = 0; i < subdirs->len; i++) {
+    const gchar *name = g_ptr_array_index (subdirs, i);
+    gchar *subdir = g_build_filename (path, name, NULL);
+
+    if (llyfr_repo_walker_is_excluded (data, subdir, name)) {
+      g_free (subdir);
+      continue;
+    }
+
+    llyfr_repo_walker_queue (data, subdir);
+  }
+
+out:
+  if (g_atomic_int_dec_and_test (&data->pending)) {
+    GSource *source = g_idle_source_new ();
+
+    g_source_set_callback (source, llyfr_repo_walker_done_cb, data->task, NULL);
+    g_source_attach (source, g_task_get_context (data->task));
+    g_source_unref (source);
+  }
+}
+
+/*
+ * Walk the tree under the walker's root, adding a LlyfrSearchContext to
+ * @found for each repository as it is discovered.
+ */
+void
+llyfr_repo_walker_walk_async (LlyfrRepoWalker     *walker,
+                              GListStore          *found,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data)
+{
+  GError *error = NULL;
+  WalkData *data;
+  GTask *task;
+
+  g_return_if_fail (LLYFR_IS_REPO_WALKER (walker));
+  g_return_if_fail (G_IS_LIST_STORE (found));
+
+  task = g_task_new (walker, cancellable, callback, user_data);
+  g_task_set_source_tag (task, llyfr_repo_walker_walk_async);
+
+  data = g_new0 (WalkData, 1);
+  data->task = task;
+  data->sink = llyfr_result_sink_new (found);
+
+  if (llyfr_trace_get_enabled ()) {
+    g_autofree gchar *name = g_strdup_printf ("Discovery in %s", walker->root);
+
+    data->trace = llyfr_trace_new (name);
+    llyfr_result_sink_set_trace (data->sink, data->trace);
+  }
+
+  data->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+  data->submodules = walker->submodules;
+  data->excludes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  g_task_set_task_data (task, data, (GDestroyNotify) walk_data_free);
+
+  for (guint i = 0; walker->excludes != NULL && walker->excludes[i] != NULL; i++)
+    g_hash_table_add (data->excludes, g_strdup (walker->excludes[i]));
+
+  data->pool = g_thread_pool_new (llyfr_repo_walker_read_dir,
+                                  data,
+                                  MIN (g_get_num_processors (), MAX_THREADS),
+                                  FALSE,
+                                  &error);
+  if (data->pool == NULL) {
+    g_task_return_error (task, error);
+    g_object_unref (task);
+    return;
+  }
+
+  llyfr_repo_walker_queue (data, g_strdup (walker->root));
+}
+
+gboolean
+llyfr_repo_walker_walk_finish (LlyfrRepoWalker  *walker,
+                               GAsyncResult     *result,
+                               GError          **error)
+{
+  g_return_val_if_fail (LLYFR_IS_REPO_WALKER (walker), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, walker), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+const gchar*
+llyfr_repo_walker_get_root (LlyfrRepoWalker *walker)
+{
+  g_return_val_if_fail (LLYFR_IS_REPO_WALKER (walker), NULL);
+  return walker->root;
+}
+
+const gchar* const*
+llyfr_repo_walker_get_excludes (LlyfrRepoWalker *walker)
+{
+  g_return_val_if_fail (LLYFR_IS_REPO_WALKER (walker), NULL);
+  return (const gchar * const *) walker->excludes;
+}
+
+/*
+ * Directory names to skip wherever they appear, or absolute paths to skip
+ * exactly.
+ */
+void
+llyfr_repo_walker_set_excludes (LlyfrRepoWalker *walker,
+                                const gchar * const *excludes)
+{
+  g_return_if_fail (LLYFR_IS_REPO_WALKER (walker));
+
+  g_strfreev (walker->excludes);
+  walker->excludes = g_strdupv ((gchar **) excludes);
+
+  g_object_notify_by_pspec (G_OBJECT (walker), properties[PROP_EXCLUDES]);
+}
+
+gboolean
+llyfr_repo_walker_get_submodules (LlyfrRepoWalker *walker)
+{
+  g_return_val_if_fail (LLYFR_IS_REPO_WALKER (walker), FALSE);
+  return walker->submodules;
+}
+
+/*
+ * Whether to keep looking for repositories nested inside the ones found.
+ */
+void
+llyfr_repo_walker_set_submodules (LlyfrRepoWalker *walker,
+                                  gboolean submodules)
+{
+  g_return_if_fail (LLYFR_IS_REPO_WALKER (walker));
+
+  submodules = !!submodules;
+  if (walker->submodules == submodules)
+    return;
+
+  walker->submodules = submodules;
+  g_object_notify_by_pspec (G_OBJECT (walker), properties[PROP_SUBMODULES]);
+}
+
+static void
+llyfr_repo_walker_get_property (GObject    *object,
+                                guint       prop_id,
+                                GValue     *value,
+                                GParamSpec *pspec)
+{
+  LlyfrRepoWalker *self = LLYFR_REPO_WALKER (object);
+
+  switch (prop_id)
+    {
+    case PROP_ROOT:
+      g_value_set_string (value, self->root);
+      break;
+
+    case PROP_EXCLUDES:
+      g_value_set_boxed (value, self->excludes);
+      break;
+
+    case PROP_SUBMODULES:
+      g_value_set_boolean (value, self->submodules);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+llyfr_repo_walker_set_property (GObject      *object,
+                                guint         prop_id,
+                                const GValue *value,
+                                GParamSpec   *pspec)
+{
+  LlyfrRepoWalker *self = LLYFR_REPO_WALKER (object);
+
+  switch (prop_id)
+    {
+    case PROP_ROOT:
+      g_free (self->root);
+      self->root = g_value_dup_string (value);
+      break;
+
+    case PROP_EXCLUDES:
+      llyfr_repo_walker_set_excludes (self, g_value_get_boxed (value));
+      break;
+
+    case PROP_SUBMODULES:
+      llyfr_repo_walker_set_submodules (self, g_value_get_boolean (value));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+llyfr_repo_walker_finalize (GObject *object)
+{
+  LlyfrRepoWalker *self = LLYFR_REPO_WALKER (object);
+
+  g_free (self->root);
+  g_strfreev (self->excludes);
+
+  G_OBJECT_CLASS (llyfr_repo_walker_parent_class)->finalize (object);
+}
+
+static void
+llyfr_repo_walker_class_init (LlyfrRepoWalkerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->get_property = llyfr_repo_walker_get_property;
+  object_class->set_property = llyfr_repo_walker_set_property;
+  object_class->finalize = llyfr_repo_walker_finalize;
+
+  properties[PROP_ROOT] = g_param_spec_string ("root",
+                                               "Root",
+                                               "The directory to look for repositories in",
+                                               NULL,
+                                               G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+
+  properties[PROP_EXCLUDES] = g_param_spec_boxed ("excludes",
+                                                  "Excludes",
+                                                  "Directories not to look in",
+                                                  G_TYPE_STRV,
+                                                  G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY);
+
+  properties[PROP_SUBMODULES] = g_param_spec_boolean ("submodules",
+                                                      "Submodules",
+                                                      "Whether to look for repositories inside repositories",
+                                                      FALSE,
+                                                      G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY);
+
+  g_object_class_install_properties (object_class, LAST_PROP, properties);
+}
+
+static void
+llyfr_repo_walker_init (LlyfrRepoWalker *self)
+{
+}
@@ -0,0 +1,59 @@
+/* llyfr-repo-walker.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_REPO_WALKER_H
+#define LLYFR_REPO_WALKER_H
+
+#include <gio/gio.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define LLYFR_TYPE_REPO_WALKER (llyfr_repo_walker_get_type())
+
+G_DECLARE_FINAL_TYPE (LlyfrRepoWalker, llyfr_repo_walker, LLYFR, REPO_WALKER, GObject)
+
+LlyfrRepoWalker*     llyfr_repo_walker_new            (const gchar *root);
+
+const gchar*         llyfr_repo_walker_get_root       (LlyfrRepoWalker *walker);
+
+const gchar* const*  llyfr_repo_walker_get_excludes   (LlyfrRepoWalker *walker);
+
+void                 llyfr_repo_walker_set_excludes   (LlyfrRepoWalker *walker,
+                                                       const gchar * const *excludes);
+
+gboolean             llyfr_repo_walker_get_submodules (LlyfrRepoWalker *walker);
+
+void                 llyfr_repo_walker_set_submodules (LlyfrRepoWalker *walker,
+                                                       gboolean submodules);
+
+void                 llyfr_repo_walker_walk_async     (LlyfrRepoWalker     *walker,
+                                                       GListStore          *found,
+                                                       GCancellable        *cancellable,
+                                                       GAsyncReadyCallback  callback,
+                                                       gpointer             user_data);
+
+gboolean             llyfr_repo_walker_walk_finish    (LlyfrRepoWalker  *walker,
+                                                       GAsyncResult     *result,
+                                                       GError          **error);
+
+G_END_DECLS
+
+#endif /* LLYFR_REPO_WALKER_H */
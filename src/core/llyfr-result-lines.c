@@ -0,0 +1,521 @@
+/* llyfr-result-lines.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-result-lines"
+
+#include "llyfr-line-index.h"
+#include "llyfr-result-lines.h"
+
+/*
+ * Flattens a list of LlyfrSearchResults into one item per line, a header
+ * for each file followed by each of its matching lines. Every row in the
+ * view is then the same height, so only the rows on screen ever need to be
+ * laid out, however many matches a single file has.
+ *
+ * Items are created on demand, the model itself only stores the position of
+ * the first row of each result.
+ *
+ * A matching line can be expanded to show the lines around it, read from
+ * the file when asked for (see LlyfrLineIndex) rather than by rg for every
+ * match. Each line of context is a row like any other.
+ */
+
+struct _LlyfrResultLine
+{
+  GObject            parent_instance;
+
+  LlyfrSearchResult *result;
+  gint               index;
+
+  // Lines before (negative) or after the match, 0 for the match itself.
+  gint               context;
+};
+
+G_DEFINE_TYPE (LlyfrResultLine, llyfr_result_line, G_TYPE_OBJECT)
+
+static LlyfrResultLine*
+llyfr_result_line_new (LlyfrSearchResult *result,
+                       gint index,
+                       gint context)
+{
+  LlyfrResultLine *line = g_object_new (LLYFR_TYPE_RESULT_LINE, NULL);
+
+  line->result = result;
+  line->index = index;
+  line->context = context;
+
+  return line;
+}
+
+LlyfrSearchResult*
+llyfr_result_line_get_result (LlyfrResultLine *line)
+{
+  g_return_val_if_fail (LLYFR_IS_RESULT_LINE (line), NULL);
+  return line->result;
+}
+
+/*
+ * The index of the match shown on this line, or -1 for the file's header.
+ * Lines of context give the index of the match they surround.
+ */
+gint
+llyfr_result_line_get_index (LlyfrResultLine *line)
+{
+  g_return_val_if_fail (LLYFR_IS_RESULT_LINE (line), -1);
+  return line->index;
+}
+
+gboolean
+llyfr_result_line_is_header (LlyfrResultLine *line)
+{
+  g_return_val_if_fail (LLYFR_IS_RESULT_LINE (line), FALSE);
+  return line->index < 0;
+}
+
+/*
+ * How many lines before (negative) or after the match this line is, 0 if
+ * it's the match itself.
+ */
+gint
+llyfr_result_line_get_context (LlyfrResultLine *line)
+{
+  g_return_val_if_fail (LLYFR_IS_RESULT_LINE (line), 0);
+  return line->context;
+}
+
+/*
+ * The number of the line in its file, or -1 for the file's header.
+ */
+gint64
+llyfr_result_line_get_line_number (LlyfrResultLine *line)
+{
+  gint64 line_number;
+
+  g_return_val_if_fail (LLYFR_IS_RESULT_LINE (line), -1);
+
+  if (line->index < 0)
+    return -1;
+
+  line_number = llyfr_search_result_get_match_line_number (line->result, line->index);
+  return line_number < 0 ? -1 : line_number + line->context;
+}
+
+static void
+llyfr_result_line_finalize (GObject *object)
+{
+  LlyfrResultLine *self = LLYFR_RESULT_LINE (object);
+
+  g_clear_object (&self->result);
+
+  G_OBJECT_CLASS (llyfr_result_line_parent_class)->finalize (object);
+}
+
+static void
+llyfr_result_line_class_init (LlyfrResultLineClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = llyfr_result_line_finalize;
+}
+
+static void
+llyfr_result_line_init (LlyfrResultLine *self)
+{
+}
+
+struct _LlyfrResultLines
+{
+  GObject     parent_instance;
+
+  GListModel *results;
+
+  // offsets[i] is the row of the header for result i, with one extra entry
+  // at the end holding the total number of rows.
+  GArray     *offsets;
+
+  // Results with expanded matches, to an array of Expansions in the order
+  // of the matches.
+  GHashTable *expanded;
+};
+
+typedef struct
+{
+  guint index;
+  guint before;
+  guint after;
+} Expansion;
+
+static void llyfr_result_lines_list_model_init (GListModelInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (LlyfrResultLines, llyfr_result_lines, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL, llyfr_result_lines_list_model_init))
+
+static guint
+llyfr_result_lines_get_offset (LlyfrResultLines *self,
+                               guint index)
+{
+  return g_array_index (self->offsets, guint, index);
+}
+
+static guint
+llyfr_result_lines_count_rows (LlyfrResultLines *self,
+                               LlyfrSearchResult *result)
+{
+  GArray *expansions = g_hash_table_lookup (self->expanded, result);
+  guint rows = 1 + llyfr_search_result_get_n_matches (result);
+
+  for (guint i = 0; expansions != NULL && i < expansions->len; i++) {
+    const Expansion *expansion = &g_array_index (expansions, Expansion, i);
+    rows += expansion->before + expansion->after;
+  }
+
+  return rows;
+}
+
+/*
+ * Move the rows of every result after @index by @delta.
+ */
+static void
+llyfr_result_lines_shift (LlyfrResultLines *self,
+                          guint index,
+                          gint delta)
+{
+  for (guint i = index + 1; i < self->offsets->len; i++)
+    g_array_index (self->offsets, guint, i) += delta;
+}
+
+/*
+ * The index of the result whose rows include @position, which must be in
+ * range.
+ */
+static guint
+llyfr_result_lines_find (LlyfrResultLines *self,
+                         guint position)
+{
+  guint low = 0, high = self->offsets->len - 1;
+
+  // Find the last result whose header is at or before position.
+  while (high - low > 1) {
+    guint mid = low + (high - low) / 2;
+
+    if (llyfr_result_lines_get_offset (self, mid) <= position)
+      low = mid;
+    else
+      high = mid;
+  }
+
+  return low;
+}
+
+static void
+items_changed_cb (GListModel       *results,
+                  guint             position,
+                  guint             removed,
+                  guint             added,
+                  LlyfrResultLines *self)
+{
+  g_autoptr(GArray) tail = NULL;
+  guint old_start, old_end, new_end;
+  guint tail_start = position + removed + 1;
+
+  old_start = llyfr_result_lines_get_offset (self, position);
+  old_end = llyfr_result_lines_get_offset (self, position + removed);
+
+  // Ranked results are spliced into the middle of the list, so only look at
+  // the new items and shift the offsets of everything after them.
+  tail = g_array_sized_new (FALSE, FALSE, sizeof (guint), self->offsets->len - tail_start);
+  g_array_append_vals (tail,
+                       &g_array_index (self->offsets, guint, tail_start),
+                       self->offsets->len - tail_start);
+  g_array_set_size (self->offsets, position + 1);
+
+  for (guint i = position; i < position + added; i++) {
+    g_autoptr(LlyfrSearchResult) result = g_list_model_get_item (results, i);
+    guint offset = llyfr_result_lines_get_offset (self, i);
+
+    offset += llyfr_result_lines_count_rows (self, result);
+    g_array_append_val (self->offsets, offset);
+  }
+
+  new_end = llyfr_result_lines_get_offset (self, position + added);
+
+  for (guint i = 0; i < tail->len; i++) {
+    guint offset = g_array_index (tail, guint, i) - old_end + new_end;
+
+    g_array_append_val (self->offsets, offset);
+  }
+
+  if (old_end > old_start || new_end > old_start)
+    g_list_model_items_changed (G_LIST_MODEL (self), old_start, old_end - old_start, new_end - old_start);
+}
+
+LlyfrResultLines*
+llyfr_result_lines_new (GListModel *results)
+{
+  LlyfrResultLines *self;
+  guint n_results;
+
+  g_return_val_if_fail (G_IS_LIST_MODEL (results), NULL);
+
+  self = g_object_new (LLYFR_TYPE_RESULT_LINES, NULL);
+  self->results = g_object_ref (results);
+
+  // Nobody is listening yet, so this only fills in the offsets.
+  n_results = g_list_model_get_n_items (results);
+  items_changed_cb (results, 0, 0, n_results, self);
+
+  g_signal_connect_object (results, "items-changed", G_CALLBACK (items_changed_cb), self, 0);
+
+  return self;
+}
+
+GListModel*
+llyfr_result_lines_get_model (LlyfrResultLines *lines)
+{
+  g_return_val_if_fail (LLYFR_IS_RESULT_LINES (lines), NULL);
+  return lines->results;
+}
+
+static GType
+llyfr_result_lines_get_item_type (GListModel *model)
+{
+  return LLYFR_TYPE_RESULT_LINE;
+}
+
+static guint
+llyfr_result_lines_get_n_items (GListModel *model)
+{
+  LlyfrResultLines *self = LLYFR_RESULT_LINES (model);
+  return llyfr_result_lines_get_offset (self, self->offsets->len - 1);
+}
+
+static gpointer
+llyfr_result_lines_get_item (GListModel *model,
+                             guint position)
+{
+  LlyfrResultLines *self = LLYFR_RESULT_LINES (model);
+  LlyfrSearchResult *result;
+  GArray *expansions;
+  guint index, row, match = 0;
+
+  if (position >= llyfr_result_lines_get_offset (self, self->offsets->len - 1))
+    return NULL;
+
+  index = llyfr_result_lines_find (self, position);
+  result = g_list_model_get_item (self->results, index);
+  row = position - llyfr_result_lines_get_offset (self, index);
+
+  if (row == 0)
+    return llyfr_result_line_new (result, -1, 0);
+
+  row--;
+
+  // Walk through the expanded matches, each one is preceded by the plain
+  // matches since the last.
+  expansions = g_hash_table_lookup (self->expanded, result);
+  for (guint i = 0; expansions != NULL && i < expansions->len; i++) {
+    const Expansion *expansion = &g_array_index (expansions, Expansion, i);
+
+    if (row < expansion->index - match)
+      break;
+
+    row -= expansion->index - match;
+
+    if (row < expansion->before)
+      return llyfr_result_line_new (result, expansion->index, (gint) row - (gint) expansion->before);
+
+    row -= expansion->before;
+
+    if (row <= expansion->after)
+      return llyfr_result_line_new (result, expansion->index, row);
+
+    row -= expansion->after + 1;
+    match = expansion->index + 1;
+  }
+
+  return llyfr_result_line_new (result, match + row, 0);
+}
+
+/*
+ * Show the @n_lines lines either side of the match at @position, or hide
+ * them again if they're already shown. Context stops short of the lines
+ * already shown for neighbouring matches. Returns FALSE, with @error set,
+ * if the lines can't be shown.
+ */
+gboolean
+llyfr_result_lines_toggle_context (LlyfrResultLines *self,
+                                   guint position,
+                                   guint n_lines,
+                                   GError **error)
+{
+  g_autoptr(LlyfrResultLine) line = NULL;
+  g_autoptr(LlyfrLineIndex) file = NULL;
+  LlyfrSearchResult *result;
+  GArray *expansions;
+  Expansion expansion;
+  guint index, match_position, insert_at = 0, n_matches;
+  gint64 line_number, lower, upper;
+  gsize length;
+
+  g_return_val_if_fail (LLYFR_IS_RESULT_LINES (self), FALSE);
+
+  line = llyfr_result_lines_get_item (G_LIST_MODEL (self), position);
+  if (line == NULL || llyfr_result_line_is_header (line))
+    return TRUE;
+
+  result = line->result;
+  index = llyfr_result_lines_find (self, position);
+  match_position = position - line->context;
+
+  expansions = g_hash_table_lookup (self->expanded, result);
+  while (expansions != NULL && insert_at < expansions->len &&
+         g_array_index (expansions, Expansion, insert_at).index < (guint) line->index)
+    insert_at++;
+
+  // Already expanded, put it back to a single row.
+  if (expansions != NULL && insert_at < expansions->len &&
+      g_array_index (expansions, Expansion, insert_at).index == (guint) line->index) {
+    expansion = g_array_index (expansions, Expansion, insert_at);
+    g_array_remove_index (expansions, insert_at);
+
+    llyfr_result_lines_shift (self, index, - (gint) (expansion.before + expansion.after));
+    g_list_model_items_changed (G_LIST_MODEL (self),
+                                match_position - expansion.before,
+                                expansion.before + 1 + expansion.after,
+                                1);
+    return TRUE;
+  }
+
+  if (llyfr_search_result_get_revision (result) != NULL) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                 "Context is only available for files in the working tree");
+    return FALSE;
+  }
+
+  line_number = llyfr_search_result_get_match_line_number (result, line->index);
+  if (line_number < 1) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                 "The match has no line number");
+    return FALSE;
+  }
+
+  file = llyfr_line_index_lookup (llyfr_search_result_get_filepath (result), error);
+  if (file == NULL)
+    return FALSE;
+
+  n_matches = llyfr_search_result_get_n_matches (result);
+  lower = MAX (1, line_number - (gint64) n_lines);
+  upper = line_number + n_lines;
+
+  if (line->index > 0) {
+    gint64 previous = llyfr_search_result_get_match_line_number (result, line->index - 1);
+
+    if (insert_at > 0 && g_array_index (expansions, Expansion, insert_at - 1).index == (guint) line->index - 1)
+      previous += g_array_index (expansions, Expansion, insert_at - 1).after;
+
+    lower = MAX (lower, previous + 1);
+  }
+
+  if ((guint) line->index + 1 < n_matches) {
+    gint64 next = llyfr_search_result_get_match_line_number (result, line->index + 1);
+
+    if (expansions != NULL && insert_at < expansions->len &&
+        g_array_index (expansions, Expansion, insert_at).index == (guint) line->index + 1)
+      next -= g_array_index (expansions, Expansion, insert_at).before;
+
+    upper = MIN (upper, next - 1);
+  }
+
+  // Only as far as the file goes, which only reads as far as that.
+  while (upper > line_number && llyfr_line_index_get_line (file, upper, &length) == NULL)
+    upper--;
+
+  expansion.index = line->index;
+  expansion.before = MAX (line_number - lower, 0);
+  expansion.after = MAX (upper - line_number, 0);
+
+  if (expansions == NULL) {
+    expansions = g_array_new (FALSE, FALSE, sizeof (Expansion));
+    g_hash_table_insert (self->expanded, g_object_ref (result), expansions);
+  }
+
+  g_array_insert_val (expansions, insert_at, expansion);
+
+  llyfr_result_lines_shift (self, index, expansion.before + expansion.after);
+  g_list_model_items_changed (G_LIST_MODEL (self),
+                              match_position,
+                              1,
+                              expansion.before + 1 + expansion.after);
+  return TRUE;
+}
+
+static void
+llyfr_result_lines_list_model_init (GListModelInterface *iface)
+{
+  iface->get_item_type = llyfr_result_lines_get_item_type;
+  iface->get_n_items = llyfr_result_lines_get_n_items;
+  iface->get_item = llyfr_result_lines_get_item;
+}
+
+static void
+llyfr_result_lines_dispose (GObject *object)
+{
+  LlyfrResultLines *self = LLYFR_RESULT_LINES (object);
+
+  if (self->results != NULL)
+    g_signal_handlers_disconnect_by_data (self->results, self);
+
+  g_clear_object (&self->results);
+
+  G_OBJECT_CLASS (llyfr_result_lines_parent_class)->dispose (object);
+}
+
+static void
+llyfr_result_lines_finalize (GObject *object)
+{
+  LlyfrResultLines *self = LLYFR_RESULT_LINES (object);
+
+  g_array_unref (self->offsets);
+  g_hash_table_unref (self->expanded);
+
+  G_OBJECT_CLASS (llyfr_result_lines_parent_class)->finalize (object);
+}
+
+static void
+llyfr_result_lines_class_init (LlyfrResultLinesClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = llyfr_result_lines_dispose;
+  object_class->finalize = llyfr_result_lines_finalize;
+}
+
+static void
+llyfr_result_lines_init (LlyfrResultLines *self)
+{
+  guint zero = 0;
+
+  self->offsets = g_array_new (FALSE, FALSE, sizeof (guint));
+  g_array_append_val (self->offsets, zero);
+
+  self->expanded = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                          g_object_unref,
+                                          (GDestroyNotify) g_array_unref);
+}
@@ -0,0 +1,60 @@
+/* llyfr-result-lines.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_RESULT_LINES_H
+#define LLYFR_RESULT_LINES_H
+
+#include <gio/gio.h>
+#include <glib-object.h>
+
+#include "llyfr-search-result.h"
+
+G_BEGIN_DECLS
+
+#define LLYFR_TYPE_RESULT_LINE (llyfr_result_line_get_type())
+
+G_DECLARE_FINAL_TYPE (LlyfrResultLine, llyfr_result_line, LLYFR, RESULT_LINE, GObject)
+
+LlyfrSearchResult* llyfr_result_line_get_result      (LlyfrResultLine *line);
+
+gint               llyfr_result_line_get_index       (LlyfrResultLine *line);
+
+gboolean           llyfr_result_line_is_header       (LlyfrResultLine *line);
+
+gint               llyfr_result_line_get_context     (LlyfrResultLine *line);
+
+gint64             llyfr_result_line_get_line_number (LlyfrResultLine *line);
+
+#define LLYFR_TYPE_RESULT_LINES (llyfr_result_lines_get_type())
+
+G_DECLARE_FINAL_TYPE (LlyfrResultLines, llyfr_result_lines, LLYFR, RESULT_LINES, GObject)
+
+LlyfrResultLines*  llyfr_result_lines_new            (GListModel *results);
+
+GListModel*        llyfr_result_lines_get_model      (LlyfrResultLines *lines);
+
+gboolean           llyfr_result_lines_toggle_context (LlyfrResultLines *lines,
+                                                      guint position,
+                                                      guint n_lines,
+                                                      GError **error);
+
+G_END_DECLS
+
+#endif /* LLYFR_RESULT_LINES_H */
@@ -0,0 +1,305 @@
+/* llyfr-result-ranker.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-result-ranker"
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "llyfr-result-ranker.h"
+
+/*
+ * Scores results by how likely they are to be what was being looked for,
+ * so the result sink can keep them in order as they arrive. Scoring only
+ * looks at the result and the file it came from, never at other results,
+ * so it's done on the thread that found the result.
+ *
+ * Higher is better. The score is a weighted sum of:
+ *  - matches on lines that look like definitions,
+ *  - matches that are whole words rather than part of one,
+ *  - how many lines matched, with diminishing returns,
+ *  - how recently the file was modified,
+ *  - where the file lives: shallow paths and source directories are
+ *    preferred over deep ones, tests and vendored code.
+ */
+
+#define DEFINITION_WEIGHT 4.0
+#define WORD_WEIGHT       2.0
+#define MATCHES_WEIGHT    1.0
+#define RECENCY_WEIGHT    1.5
+#define DIRECTORY_WEIGHT  1.0
+#define DEPTH_WEIGHT      0.25
+
+// A file modified this many days ago gets half the recency score.
+#define RECENCY_HALF_DAYS 30.0
+
+// Lines starting with one of these, once indented, are taken to define
+// something.
+static const gchar * const definition_prefixes[] = {
+  "class ", "def ", "enum ", "fn ", "func ", "function ", "interface ",
+  "module ", "pub fn ", "pub struct ", "struct ", "trait ", "type ",
+  "typedef ", "union ", "#define ",
+};
+
+static const gchar * const preferred_directories[] = {
+  "include", "lib", "src",
+};
+
+static const gchar * const unpreferred_directories[] = {
+  "build", "dist", "node_modules", "test", "tests", "third_party", "vendor",
+};
+
+struct _LlyfrResultRanker
+{
+  GObject  parent_instance;
+
+  gchar   *directory;
+};
+
+G_DEFINE_TYPE (LlyfrResultRanker, llyfr_result_ranker, G_TYPE_OBJECT)
+
+enum
+{
+  PROP_0,
+  PROP_DIRECTORY,
+  LAST_PROP
+};
+
+static GParamSpec *properties[LAST_PROP];
+
+LlyfrResultRanker*
+llyfr_result_ranker_new (const gchar *directory)
+{
+  return g_object_new (LLYFR_TYPE_RESULT_RANKER,
+                       "directory", directory,
+                       NULL);
+}
+
+static gboolean
+is_word_char (gchar c)
+{
+  return g_ascii_isalnum (c) || c == '_';
+}
+
+static gboolean
+is_definition (const gchar *text)
+{
+  while (*text == ' ' || *text == '\t')
+    text++;
+
+  for (guint i = 0; i < G_N_ELEMENTS (definition_prefixes); i++) {
+    if (g_str_has_prefix (text, definition_prefixes[i]))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+static gboolean
+in_list (const gchar        *name,
+         gsize               length,
+         const gchar * const *list,
+         guint               n_items)
+{
+  for (guint i = 0; i < n_items; i++) {
+    if (strlen (list[i]) == length && strncmp (name, list[i], length) == 0)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/*
+ * Score the directories @relative is in, and how deep it is.
+ */
+static gdouble
+score_path (const gchar *relative)
+{
+  gdouble score = 0;
+  guint depth = 0;
+  const gchar *slash;
+
+  while ((slash = strchr (relative, '/')) != NULL) {
+    gsize length = slash - relative;
+
+    if (in_list (relative, length, preferred_directories, G_N_ELEMENTS (preferred_directories)))
+      score += DIRECTORY_WEIGHT;
+    else if (in_list (relative, length, unpreferred_directories, G_N_ELEMENTS (unpreferred_directories)))
+      score -= 2 * DIRECTORY_WEIGHT;
+
+    depth++;
+    relative = slash + 1;
+  }
+
+  return score - DEPTH_WEIGHT * depth;
+}
+
+static gdouble
+score_recency (const gchar *path)
+{
+  GStatBuf buf;
+  gdouble age_days;
+
+  if (g_stat (path, &buf) != 0)
+    return 0;
+
+  age_days = MAX (0, (g_get_real_time () / G_USEC_PER_SEC) - (gint64) buf.st_mtime) / 86400.0;
+
+  return RECENCY_WEIGHT / (1 + age_days / RECENCY_HALF_DAYS);
+}
+
+/*
+ * Score @result, higher being more relevant. Safe to call from any thread.
+ */
+gdouble
+llyfr_result_ranker_score (LlyfrResultRanker *ranker,
+                           LlyfrSearchResult *result)
+{
+  const gchar *path, *relative;
+  guint n_matches, n_words = 0, n_highlights_total = 0;
+  gdouble score = 0;
+
+  g_return_val_if_fail (LLYFR_IS_RESULT_RANKER (ranker), 0);
+  g_return_val_if_fail (LLYFR_IS_SEARCH_RESULT (result), 0);
+
+  n_matches = llyfr_search_result_get_n_matches (result);
+  if (n_matches == 0)
+    return 0;
+
+  for (guint i = 0; i < n_matches; i++) {
+    const LlyfrSearchSpan *spans;
+    const gchar *text;
+    guint n_highlights;
+    gsize length;
+
+    text = llyfr_search_result_get_match_text (result, i, &length);
+    spans = llyfr_search_result_get_match_highlights (result, i, &n_highlights);
+
+    if (n_highlights > 0 && is_definition (text))
+      score += DEFINITION_WEIGHT;
+
+    for (guint j = 0; j < n_highlights; j++) {
+      gboolean word_start = spans[j].start == 0 || !is_word_char (text[spans[j].start - 1]);
+      gboolean word_end = spans[j].end >= length || !is_word_char (text[spans[j].end]);
+
+      if (word_start && word_end)
+        n_words++;
+    }
+
+    n_highlights_total += n_highlights;
+  }
+
+  // Only the first few definitions count, one file shouldn't win just by
+  // defining lots of things.
+  score = MIN (score, 3 * DEFINITION_WEIGHT);
+
+  if (n_highlights_total > 0)
+    score += WORD_WEIGHT * n_words / n_highlights_total;
+
+  // Roughly log2, each doubling of the number of lines adds the same.
+  score += MATCHES_WEIGHT * g_bit_storage (n_matches);
+
+  path = llyfr_search_result_get_filepath (result);
+  relative = path;
+  if (ranker->directory != NULL && g_str_has_prefix (path, ranker->directory)) {
+    relative = path + strlen (ranker->directory);
+    while (*relative == '/')
+      relative++;
+  }
+
+  score += score_path (relative);
+
+  // Files at a revision don't have a modification time to go by.
+  if (llyfr_search_result_get_revision (result) == NULL)
+    score += score_recency (path);
+
+  return score;
+}
+
+static void
+llyfr_result_ranker_get_property (GObject    *object,
+                                  guint       prop_id,
+                                  GValue     *value,
+                                  GParamSpec *pspec)
+{
+  LlyfrResultRanker *self = LLYFR_RESULT_RANKER (object);
+
+  switch (prop_id) {
+    case PROP_DIRECTORY:
+      g_value_set_string (value, self->directory);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+  }
+}
+
+static void
+llyfr_result_ranker_set_property (GObject      *object,
+                                  guint         prop_id,
+                                  const GValue *value,
+                                  GParamSpec   *pspec)
+{
+  LlyfrResultRanker *self = LLYFR_RESULT_RANKER (object);
+
+  switch (prop_id) {
+    case PROP_DIRECTORY:
+      self->directory = g_value_dup_string (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+  }
+}
+
+static void
+llyfr_result_ranker_finalize (GObject *object)
+{
+  LlyfrResultRanker *self = LLYFR_RESULT_RANKER (object);
+
+  g_free (self->directory);
+
+  G_OBJECT_CLASS (llyfr_result_ranker_parent_class)->finalize (object);
+}
+
+static void
+llyfr_result_ranker_class_init (LlyfrResultRankerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->get_property = llyfr_result_ranker_get_property;
+  object_class->set_property = llyfr_result_ranker_set_property;
+  object_class->finalize = llyfr_result_ranker_finalize;
+
+  properties[PROP_DIRECTORY] =
+    g_param_spec_string ("directory",
+                         "Directory",
+                         "The directory searched, paths are scored relative to it",
+                         NULL,
+                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+
+  g_object_class_install_properties (object_class, LAST_PROP, properties);
+}
+
+static void
+llyfr_result_ranker_init (LlyfrResultRanker *self)
+{
+}
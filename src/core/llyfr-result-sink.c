@@ -0,0 +1,441 @@
+/* llyfr-result-sink.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-result-sink"
+
+#include "llyfr-result-sink.h"
+#include "llyfr-search-result.h"
+
+/*
+ * How long results are allowed to pile up before they are handed to the
+ * store, roughly one frame. Every flush lands as a single splice so the
+ * views only have to process one ::items-changed per frame no matter how
+ * quickly results are being produced.
+ */
+#define FLUSH_INTERVAL_MS 16
+
+/*
+ * With a ranker, each result is scored by the thread pushing it and the
+ * store is kept sorted best first. A batch is sorted on its own, then
+ * merged into the store with one splice per run of results landing in the
+ * same place, so nothing already in the store is ever moved.
+ */
+
+struct _LlyfrResultSink
+{
+  GObject        parent_instance;
+
+  GListStore    *store;
+  GMainContext  *context;
+
+  // Set before the search starts, only read after.
+  LlyfrSearchBudget budget;
+  GCancellable  *stop;
+  LlyfrResultRanker *ranker;
+  LlyfrTrace    *trace;
+
+  GMutex         lock;
+  GPtrArray     *pending;
+  GSource       *flush_source;
+  gboolean       closed;
+
+  // What has been pushed so far, counted against the budget.
+  guint64        n_matches;
+  guint64        text_size;
+  LlyfrSearchLimit limit;
+};
+
+G_DEFINE_TYPE (LlyfrResultSink, llyfr_result_sink, G_TYPE_OBJECT)
+
+LlyfrResultSink*
+llyfr_result_sink_new (GListStore *store)
+{
+  LlyfrResultSink *sink;
+
+  g_return_val_if_fail (G_IS_LIST_STORE (store), NULL);
+
+  sink = g_object_new (LLYFR_TYPE_RESULT_SINK, NULL);
+  sink->store = g_object_ref (store);
+
+  return sink;
+}
+
+GListStore*
+llyfr_result_sink_get_store (LlyfrResultSink *sink)
+{
+  return sink->store;
+}
+
+static gboolean
+llyfr_result_sink_flush_cb (gpointer user_data)
+{
+  LlyfrResultSink *sink = LLYFR_RESULT_SINK (user_data);
+
+  llyfr_result_sink_flush (sink);
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Limit what the search feeding the sink may produce. Once @budget runs
+ * out, @stop is cancelled and anything pushed after is dropped. The
+ * backend stops reading a file after llyfr_search_budget_get_max_count()
+ * of its lines, one more than are kept, and any file that had more is
+ * truncated rather than stopping the search.
+ */
+void
+llyfr_result_sink_set_budget (LlyfrResultSink *sink,
+                              const LlyfrSearchBudget *budget,
+                              GCancellable *stop)
+{
+  g_return_if_fail (LLYFR_IS_RESULT_SINK (sink));
+  g_return_if_fail (budget != NULL);
+
+  sink->budget = *budget;
+  g_set_object (&sink->stop, stop);
+}
+
+const LlyfrSearchBudget*
+llyfr_result_sink_get_budget (LlyfrResultSink *sink)
+{
+  g_return_val_if_fail (LLYFR_IS_RESULT_SINK (sink), NULL);
+
+  return &sink->budget;
+}
+
+/*
+ * Keep the store sorted by @ranker's scores, best first. Must be set
+ * before anything is pushed.
+ */
+void
+llyfr_result_sink_set_ranker (LlyfrResultSink *sink,
+                              LlyfrResultRanker *ranker)
+{
+  g_return_if_fail (LLYFR_IS_RESULT_SINK (sink));
+  g_return_if_fail (ranker == NULL || LLYFR_IS_RESULT_RANKER (ranker));
+
+  g_set_object (&sink->ranker, ranker);
+}
+
+/*
+ * Have the time spent adding results to the store counted by @trace, which
+ * whatever feeds the sink can also use. Must be set before anything is
+ * pushed.
+ */
+void
+llyfr_result_sink_set_trace (LlyfrResultSink *sink,
+                             LlyfrTrace *trace)
+{
+  g_return_if_fail (LLYFR_IS_RESULT_SINK (sink));
+
+  g_clear_pointer (&sink->trace, llyfr_trace_unref);
+  sink->trace = trace ? llyfr_trace_ref (trace) : NULL;
+}
+
+/*
+ * The trace of the search feeding the sink, if it's being traced.
+ */
+LlyfrTrace*
+llyfr_result_sink_get_trace (LlyfrResultSink *sink)
+{
+  g_return_val_if_fail (LLYFR_IS_RESULT_SINK (sink), NULL);
+
+  return sink->trace;
+}
+
+/*
+ * Called with the lock held, returns TRUE if the search should be told to
+ * stop.
+ */
+static gboolean
+llyfr_result_sink_stop_locked (LlyfrResultSink *sink,
+                               LlyfrSearchLimit limit)
+{
+  if (sink->limit != LLYFR_SEARCH_LIMIT_NONE)
+    return FALSE;
+
+  g_debug ("Out of budget, stopping search");
+  sink->limit = limit;
+
+  return sink->stop != NULL;
+}
+
+/*
+ * Stop the search feeding the sink as it has run out of @limit, keeping
+ * what has been found so far. May be called from any thread.
+ */
+void
+llyfr_result_sink_stop (LlyfrResultSink *sink,
+                        LlyfrSearchLimit limit)
+{
+  gboolean stop;
+
+  g_return_if_fail (LLYFR_IS_RESULT_SINK (sink));
+
+  g_mutex_lock (&sink->lock);
+  stop = llyfr_result_sink_stop_locked (sink, limit);
+  g_mutex_unlock (&sink->lock);
+
+  if (stop)
+    g_cancellable_cancel (sink->stop);
+}
+
+/*
+ * Which limit the search ran out of, if any. Files that had lines left out
+ * don't count, those are only marked as truncated.
+ */
+LlyfrSearchLimit
+llyfr_result_sink_get_limit (LlyfrResultSink *sink)
+{
+  g_autoptr(GMutexLocker) locker = NULL;
+
+  g_return_val_if_fail (LLYFR_IS_RESULT_SINK (sink), LLYFR_SEARCH_LIMIT_NONE);
+
+  locker = g_mutex_locker_new (&sink->lock);
+
+  return sink->limit;
+}
+
+/*
+ * Queue @item to be added to the store, this takes ownership of @item and
+ * may be called from any thread.
+ */
+void
+llyfr_result_sink_push (LlyfrResultSink *sink,
+                        gpointer item)
+{
+  guint max_file_matches = sink->budget.max_file_matches;
+  gboolean stop = FALSE;
+
+  // The backend is asked for one more line than we keep, so only a file
+  // that gets that far really had more.
+  if (LLYFR_IS_SEARCH_RESULT (item) && max_file_matches > 0 &&
+      llyfr_search_result_get_n_matches (item) > max_file_matches)
+    llyfr_search_result_truncate (item, max_file_matches);
+
+  // Scored here, off the main thread, before taking the lock.
+  if (sink->ranker != NULL && LLYFR_IS_SEARCH_RESULT (item))
+    llyfr_search_result_set_score (item, llyfr_result_ranker_score (sink->ranker, item));
+
+  g_mutex_lock (&sink->lock);
+
+  if (sink->closed || sink->limit != LLYFR_SEARCH_LIMIT_NONE) {
+    g_mutex_unlock (&sink->lock);
+    g_object_unref (item);
+    return;
+  }
+
+  if (LLYFR_IS_SEARCH_RESULT (item)) {
+    LlyfrSearchResult *result = item;
+    guint n_matches = llyfr_search_result_get_n_matches (result);
+
+    sink->n_matches += n_matches;
+    sink->text_size += llyfr_search_result_get_size (result);
+  }
+
+  g_ptr_array_add (sink->pending, item);
+
+  // What took us over is kept, it's been found after all.
+  if (sink->budget.max_matches > 0 && sink->n_matches >= sink->budget.max_matches)
+    stop = llyfr_result_sink_stop_locked (sink, LLYFR_SEARCH_LIMIT_MATCHES);
+  else if (sink->budget.max_text > 0 && sink->text_size >= sink->budget.max_text)
+    stop = llyfr_result_sink_stop_locked (sink, LLYFR_SEARCH_LIMIT_TEXT);
+
+  if (sink->flush_source == NULL) {
+    sink->flush_source = g_timeout_source_new (FLUSH_INTERVAL_MS);
+    g_source_set_callback (sink->flush_source,
+                           llyfr_result_sink_flush_cb,
+                           g_object_ref (sink),
+                           g_object_unref);
+    g_source_attach (sink->flush_source, sink->context);
+  }
+
+  g_mutex_unlock (&sink->lock);
+
+  if (stop)
+    g_cancellable_cancel (sink->stop);
+}
+
+static gint
+compare_scores (gconstpointer a,
+                gconstpointer b)
+{
+  gdouble score_a = llyfr_search_result_get_score (*(LlyfrSearchResult **) a);
+  gdouble score_b = llyfr_search_result_get_score (*(LlyfrSearchResult **) b);
+
+  return (score_a < score_b) - (score_a > score_b);
+}
+
+static gdouble
+get_score_at (GListModel *model,
+              guint position)
+{
+  g_autoptr(LlyfrSearchResult) result = g_list_model_get_item (model, position);
+
+  return llyfr_search_result_get_score (result);
+}
+
+/*
+ * The first position from @start on whose score is below @score, which is
+ * where a result with @score goes to follow those it ties with.
+ */
+static guint
+find_position (GListModel *model,
+               guint start,
+               gdouble score)
+{
+  guint end = g_list_model_get_n_items (model);
+
+  while (start < end) {
+    guint middle = start + (end - start) / 2;
+
+    if (get_score_at (model, middle) >= score)
+      start = middle + 1;
+    else
+      end = middle;
+  }
+
+  return start;
+}
+
+/*
+ * Merge @batch, of results, into the sorted store.
+ */
+static void
+llyfr_result_sink_merge (LlyfrResultSink *sink,
+                         GPtrArray *batch)
+{
+  GListModel *model = G_LIST_MODEL (sink->store);
+  guint position = 0;
+  guint i = 0;
+
+  // g_ptr_array_sort() is stable, so ties keep the order they arrived in.
+  g_ptr_array_sort (batch, compare_scores);
+
+  while (i < batch->len) {
+    guint n_items, run = 1;
+
+    position = find_position (model, position,
+                              llyfr_search_result_get_score (g_ptr_array_index (batch, i)));
+    n_items = g_list_model_get_n_items (model);
+
+    // The batch is sorted too, so anything scoring above what's at
+    // position goes in the same splice.
+    while (i + run < batch->len &&
+           (position == n_items ||
+            get_score_at (model, position) < llyfr_search_result_get_score (g_ptr_array_index (batch, i + run))))
+      run++;
+
+    g_list_store_splice (sink->store, position, 0, batch->pdata + i, run);
+    position += run;
+    i += run;
+  }
+}
+
+/*
+ * Move everything queued so far into the store. Must be called from the
+ * thread that owns the store.
+ */
+void
+llyfr_result_sink_flush (LlyfrResultSink *sink)
+{
+  g_autoptr(GPtrArray) batch = NULL;
+  gint64 begin;
+
+  g_mutex_lock (&sink->lock);
+
+  batch = g_steal_pointer (&sink->pending);
+  sink->pending = g_ptr_array_new_with_free_func (g_object_unref);
+
+  if (sink->flush_source != NULL) {
+    g_source_destroy (sink->flush_source);
+    g_clear_pointer (&sink->flush_source, g_source_unref);
+  }
+
+  g_mutex_unlock (&sink->lock);
+
+  if (batch->len == 0)
+    return;
+
+  // Whatever is watching the store reacts to the splice before it returns,
+  // so that's counted too.
+  begin = llyfr_trace_begin (sink->trace);
+
+  if (sink->ranker != NULL)
+    llyfr_result_sink_merge (sink, batch);
+  else
+    g_list_store_splice (sink->store,
+                         g_list_model_get_n_items (G_LIST_MODEL (sink->store)),
+                         0,
+                         batch->pdata,
+                         batch->len);
+
+  llyfr_trace_end (sink->trace, LLYFR_TRACE_SPLICE, begin);
+}
+
+/*
+ * Drop anything still queued and ignore anything pushed from now on, used
+ * once the search feeding the sink has been abandoned.
+ */
+void
+llyfr_result_sink_close (LlyfrResultSink *sink)
+{
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&sink->lock);
+
+  sink->closed = TRUE;
+  g_ptr_array_set_size (sink->pending, 0);
+
+  if (sink->flush_source != NULL) {
+    g_source_destroy (sink->flush_source);
+    g_clear_pointer (&sink->flush_source, g_source_unref);
+  }
+}
+
+static void
+llyfr_result_sink_finalize (GObject *object)
+{
+  LlyfrResultSink *self = LLYFR_RESULT_SINK (object);
+
+  g_clear_object (&self->store);
+  g_clear_object (&self->stop);
+  g_clear_object (&self->ranker);
+  g_clear_pointer (&self->trace, llyfr_trace_unref);
+  g_clear_pointer (&self->context, g_main_context_unref);
+  g_clear_pointer (&self->pending, g_ptr_array_unref);
+  g_mutex_clear (&self->lock);
+
+  G_OBJECT_CLASS (llyfr_result_sink_parent_class)->finalize (object);
+}
+
+static void
+llyfr_result_sink_class_init (LlyfrResultSinkClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = llyfr_result_sink_finalize;
+}
+
+static void
+llyfr_result_sink_init (LlyfrResultSink *self)
+{
+  g_mutex_init (&self->lock);
+
+  self->context = g_main_context_ref_thread_default ();
+  self->pending = g_ptr_array_new_with_free_func (g_object_unref);
+}
@@ -0,0 +1,69 @@
+/* llyfr-result-sink.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_RESULT_SINK_H
+#define LLYFR_RESULT_SINK_H
+
+#include <gio/gio.h>
+#include <glib-object.h>
+
+#include "llyfr-result-ranker.h"
+#include "llyfr-search-budget.h"
+#include "llyfr-trace.h"
+
+G_BEGIN_DECLS
+
+#define LLYFR_TYPE_RESULT_SINK (llyfr_result_sink_get_type())
+
+G_DECLARE_FINAL_TYPE (LlyfrResultSink, llyfr_result_sink, LLYFR, RESULT_SINK, GObject)
+
+LlyfrResultSink* llyfr_result_sink_new       (GListStore *store);
+
+GListStore*      llyfr_result_sink_get_store (LlyfrResultSink *sink);
+
+void             llyfr_result_sink_push      (LlyfrResultSink *sink,
+                                              gpointer item);
+
+void             llyfr_result_sink_flush     (LlyfrResultSink *sink);
+
+void             llyfr_result_sink_close     (LlyfrResultSink *sink);
+
+void             llyfr_result_sink_set_budget (LlyfrResultSink *sink,
+                                               const LlyfrSearchBudget *budget,
+                                               GCancellable *stop);
+
+const LlyfrSearchBudget* llyfr_result_sink_get_budget (LlyfrResultSink *sink);
+
+void             llyfr_result_sink_stop      (LlyfrResultSink *sink,
+                                              LlyfrSearchLimit limit);
+
+LlyfrSearchLimit llyfr_result_sink_get_limit (LlyfrResultSink *sink);
+
+void             llyfr_result_sink_set_ranker (LlyfrResultSink *sink,
+                                               LlyfrResultRanker *ranker);
+
+void             llyfr_result_sink_set_trace (LlyfrResultSink *sink,
+                                              LlyfrTrace *trace);
+
+LlyfrTrace*      llyfr_result_sink_get_trace (LlyfrResultSink *sink);
+
+G_END_DECLS
+
+#endif /* LLYFR_RESULT_SINK_H */
@@ -0,0 +1,580 @@
+/* llyfr-rg-backend.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-rg-backend"
+
+#include <signal.h>
+#include <string.h>
+
+#include "llyfr-rg-backend.h"
+#include "llyfr-host.h"
+#include "llyfr-rg-decoder.h"
+#include "llyfr-search-result.h"
+
+/*
+ * Searches by running rg on the host and reading back its --json output.
+ */
+
+// The most, in bytes, of file names to pass to rg on the command line.
+#define MAX_FILES_SIZE (256 * 1024)
+
+struct _LlyfrRgBackend
+{
+  GObject             parent_instance;
+
+  LlyfrSearchDecoder  decoder;
+};
+
+static void llyfr_rg_backend_iface_init (LlyfrSearchBackendInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (LlyfrRgBackend, llyfr_rg_backend, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (LLYFR_TYPE_SEARCH_BACKEND,
+                                                llyfr_rg_backend_iface_init))
+
+enum
+{
+  PROP_0,
+  PROP_DECODER,
+  LAST_PROP
+};
+
+static GParamSpec *properties[LAST_PROP];
+
+GType
+llyfr_search_decoder_get_type (void)
+{
+  static gsize type_id = 0;
+
+  if (g_once_init_enter (&type_id)) {
+    static const GEnumValue values[] = {
+      { LLYFR_SEARCH_DECODER_JSON_GLIB, "LLYFR_SEARCH_DECODER_JSON_GLIB", "json-glib" },
+      { LLYFR_SEARCH_DECODER_RG, "LLYFR_SEARCH_DECODER_RG", "rg" },
+      { 0, NULL, NULL }
+    };
+    GType type = g_enum_register_static ("LlyfrSearchDecoder", values);
+
+    g_once_init_leave (&type_id, type);
+  }
+
+  return type_id;
+}
+
+LlyfrSearchBackend*
+llyfr_rg_backend_new (void)
+{
+  return g_object_new (LLYFR_TYPE_RG_BACKEND, NULL);
+}
+
+/*
+ * Spawn rg, limited to @threads threads unless that's 0, searching either
+ * @files or the whole of @directory. Only the first @max_count matching
+ * lines of each file are reported, unless that's 0.
+ */
+static GSubprocess*
+llyfr_rg_backend_spawn (const gchar *directory,
+                        const gchar *query,
+                        GPtrArray *files,
+                        guint threads,
+                        guint max_count,
+                        GError **error)
+{
+  g_autoptr(GPtrArray) argv = g_ptr_array_new_with_free_func (g_free);
+  gsize files_size = 0;
+
+  g_ptr_array_add (argv, g_strdup ("rg"));
+  g_ptr_array_add (argv, g_strdup ("--json"));
+
+  if (threads == 0)
+    g_ptr_array_add (argv, g_strdup ("--threads=0"));
+  else
+    g_ptr_array_add (argv, g_strdup_printf ("--threads=%u", threads));
+
+  if (max_count > 0)
+    g_ptr_array_add (argv, g_strdup_printf ("--max-count=%u", max_count));
+
+  g_ptr_array_add (argv, g_strdup ("--"));
+  g_ptr_array_add (argv, g_strdup (query));
+
+  for (guint i = 0; files != NULL && i < files->len; i++)
+    files_size += strlen (g_ptr_array_index (files, i)) + 1;
+
+  // Past a point the command line gets too long, at which point rg may as
+  // well look through the lot.
+  if (files != NULL && files_size <= MAX_FILES_SIZE) {
+    for (guint i = 0; i < files->len; i++)
+      g_ptr_array_add (argv, g_strdup (g_ptr_array_index (files, i)));
+  } else {
+    g_ptr_array_add (argv, g_strdup (directory));
+  }
+
+  g_ptr_array_add (argv, NULL);
+
+  return llyfr_host_spawnv (G_SUBPROCESS_FLAGS_STDOUT_PIPE,
+                            (const gchar * const *) argv->pdata,
+                            error);
+}
+
+/*
+ * The set of files under @directory that rg would search, relative to it,
+ * that is every file its ignore files and hidden file rules don't leave
+ * out.
+ */
+GHashTable*
+llyfr_rg_backend_list_files (const gchar *directory,
+                             GCancellable *cancellable,
+                             GError **error)
+{
+  const gchar *argv[] = { "rg", "--files", "--null", "--", directory, NULL };
+  g_autoptr(GSubprocess) process = NULL;
+  g_autoptr(GDataInputStream) stream = NULL;
+  g_autoptr(GHashTable) files = NULL;
+  GError *local_error = NULL;
+  gsize prefix_length;
+  gchar *line;
+  gsize length;
+
+  g_return_val_if_fail (directory != NULL, NULL);
+
+  process = llyfr_host_spawnv (G_SUBPROCESS_FLAGS_STDOUT_PIPE | G_SUBPROCESS_FLAGS_STDERR_SILENCE,
+                               argv, error);
+  if (process == NULL)
+    return NULL;
+
+  files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  stream = g_data_input_stream_new (g_subprocess_get_stdout_pipe (process));
+  prefix_length = strlen (directory);
+
+  while ((line = g_data_input_stream_read_upto (stream, "", 1, &length, cancellable, &local_error)) != NULL) {
+    const gchar *relative = line;
+
+    // Skip the NUL we stopped at.
+    g_data_input_stream_read_byte (stream, cancellable, &local_error);
+    if (local_error != NULL) {
+      g_free (line);
+      break;
+    }
+
+    // rg prints each path joined onto the directory it was given.
+    if (strncmp (line, directory, prefix_length) == 0) {
+      relative = line + prefix_length;
+      while (*relative == G_DIR_SEPARATOR)
+        relative++;
+    }
+
+    if (*relative != '\0')
+      g_hash_table_add (files, g_strdup (relative));
+
+    g_free (line);
+  }
+
+  if (local_error != NULL) {
+    g_subprocess_force_exit (process);
+    g_propagate_error (error, local_error);
+    return NULL;
+  }
+
+  if (!g_subprocess_wait (process, cancellable, error))
+    return NULL;
+
+  // rg exits with 1 when there were no files to list.
+  if (!g_subprocess_get_if_exited (process) || g_subprocess_get_exit_status (process) > 1) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                 "Unable to list the files in %s", directory);
+    return NULL;
+  }
+
+  return g_steal_pointer (&files);
+}
+
+static JsonNode *
+llyfr_rg_backend_parse_object (char*    line,
+                               gsize    length,
+                               GError **error)
+{
+  g_autoptr (JsonParser) parser = json_parser_new ();
+  JsonNode *root = NULL;
+
+  if (!json_parser_load_from_data (parser, line, length, error))
+    return NULL;
+
+  root = json_parser_get_root (parser);
+  if (root == NULL || !JSON_NODE_HOLDS_OBJECT (root))
+    {
+      g_set_error (error,
+                   JSON_PARSER_ERROR,
+                   JSON_PARSER_ERROR_INVALID_DATA,
+                   "Expected JSON Object Got: '%s'", line);
+      return NULL;
+    }
+
+  return json_parser_steal_root (parser);
+}
+
+/*
+ * Feed a single line of rg's --json output into the result currently being
+ * built. Once the file's "end" message arrives the finished result is
+ * returned, NULL otherwise. The time spent parsing the line is added to
+ * @decode_time, if given.
+ */
+static LlyfrSearchResult*
+llyfr_rg_backend_handle_line (char                *line,
+                              gsize                length,
+                              LlyfrSearchResult  **current_result,
+                              gint64              *decode_time)
+{
+  g_autoptr(JsonReader) reader = NULL;
+  g_autoptr(JsonNode) node = NULL;
+  g_autoptr(GError) error = NULL;
+  gint64 begin = decode_time ? g_get_monotonic_time () : 0;
+  const char *type;
+
+  g_debug ("%s", line);
+  node = llyfr_rg_backend_parse_object (line, length, &error);
+  if (decode_time != NULL)
+    *decode_time += g_get_monotonic_time () - begin;
+
+  if (node == NULL) {
+    g_message ("Unable to parse line '%s'\n%s", line, error->message);
+    return NULL;
+  }
+
+  reader = json_reader_new (node);
+
+  json_reader_read_member (reader, "type");
+  type = json_reader_get_string_value (reader);
+
+  if (g_strcmp0 (type, "begin") == 0) {
+    g_clear_object (current_result);
+    *current_result = llyfr_search_result_new_from_json (node);
+    return NULL;
+  }
+
+  if (*current_result == NULL) {
+    g_debug ("Unhandled type: %s", type);
+    return NULL;
+  }
+
+  if (g_strcmp0 (type, "match") == 0) {
+    llyfr_search_result_add_match (*current_result, node);
+    return NULL;
+  }
+
+  if (g_strcmp0 (type, "end") == 0) {
+    llyfr_search_result_end (*current_result);
+    return g_steal_pointer (current_result);
+  }
+
+  g_debug ("Unhandled type: %s", type);
+  return NULL;
+}
+
+/*
+ * The same as llyfr_rg_backend_handle_line() but using the dedicated rg
+ * decoder, which reuses @message between lines.
+ */
+static LlyfrSearchResult*
+llyfr_rg_backend_decode_line (char                *line,
+                              gsize                length,
+                              LlyfrRgMessage      *message,
+                              LlyfrSearchArena    *arena,
+                              LlyfrSearchResult  **current_result,
+                              gint64              *decode_time)
+{
+  g_autoptr(GError) error = NULL;
+  gint64 begin = decode_time ? g_get_monotonic_time () : 0;
+  gboolean decoded;
+
+  decoded = llyfr_rg_decode_line (line, length, message, &error);
+  if (decode_time != NULL)
+    *decode_time += g_get_monotonic_time () - begin;
+
+  if (!decoded) {
+    g_message ("Unable to decode line: %s", error->message);
+    return NULL;
+  }
+
+  switch (message->type) {
+    case LLYFR_RG_MESSAGE_BEGIN:
+      g_clear_object (current_result);
+      *current_result = llyfr_search_result_new_in_arena (arena, message->path);
+      return NULL;
+
+    case LLYFR_RG_MESSAGE_MATCH:
+      if (*current_result == NULL || message->text == NULL)
+        return NULL;
+
+      // Lines given to us as base64 aren't guaranteed to be valid UTF-8,
+      // replacing the invalid bytes moves the submatches along with them.
+      if (!g_utf8_validate (message->text, message->text_length, NULL)) {
+        g_autofree gchar *text = llyfr_search_result_make_valid (message->text,
+                                                                 message->text_length,
+                                                                 (gint64 *) message->submatches->data,
+                                                                 message->submatches->len / 2);
+
+        llyfr_search_result_add_match_full (*current_result,
+                                            message->line_number,
+                                            text,
+                                            (const gint64 *) message->submatches->data,
+                                            message->submatches->len / 2);
+        return NULL;
+      }
+
+      llyfr_search_result_add_match_full (*current_result,
+                                          message->line_number,
+                                          message->text,
+                                          (const gint64 *) message->submatches->data,
+                                          message->submatches->len / 2);
+      return NULL;
+
+    case LLYFR_RG_MESSAGE_END:
+      if (*current_result == NULL)
+        return NULL;
+
+      llyfr_search_result_end (*current_result);
+      return g_steal_pointer (current_result);
+
+    default:
+      return NULL;
+  }
+}
+
+static void
+llyfr_rg_backend_cancelled_cb (GCancellable *cancellable,
+                               GSubprocess  *process)
+{
+  // flatpak-spawn forwards SIGTERM on to the process it started on the
+  // host, whereas a SIGKILL would leave rg running there.
+  g_debug ("Search cancelled, stopping rg");
+  g_subprocess_send_signal (process, SIGTERM);
+}
+
+/*
+ * Read rg --json output from @input until it ends, pushing each file's
+ * result into @sink as it's finished. This is everything a search does
+ * besides starting rg, so the benchmarks can drive it with canned output.
+ */
+gboolean
+llyfr_rg_backend_read (LlyfrRgBackend      *backend,
+                       GInputStream        *input,
+                       LlyfrResultSink     *sink,
+                       LlyfrSearchArena    *arena,
+                       GCancellable        *cancellable,
+                       GError             **error)
+{
+  g_autoptr(GDataInputStream) stream = NULL;
+  g_autoptr(LlyfrSearchResult) current_result = NULL;
+  LlyfrTrace *trace = llyfr_result_sink_get_trace (sink);
+  LlyfrSearchDecoder decoder;
+  LlyfrRgMessage message;
+  GError *local_error = NULL;
+  gint64 start, now, waited = 0, decoded = 0, built = 0;
+  gint64 *decode_time;
+  gboolean started = FALSE;
+  char *line = NULL;
+  gsize length = 0;
+
+  g_return_val_if_fail (LLYFR_IS_RG_BACKEND (backend), FALSE);
+  g_return_val_if_fail (G_IS_INPUT_STREAM (input), FALSE);
+
+  decoder = backend->decoder;
+  stream = g_data_input_stream_new (input);
+  llyfr_rg_message_init (&message);
+
+  // Per line times are summed here and handed over once at the end.
+  decode_time = trace != NULL ? &decoded : NULL;
+  start = now = llyfr_trace_begin (trace);
+
+  while ((line = g_data_input_stream_read_line_utf8 (stream, &length, cancellable, &local_error))) {
+    LlyfrSearchResult *finished;
+    gint64 decoded_before = decoded;
+
+    if (trace != NULL) {
+      gint64 read = g_get_monotonic_time ();
+
+      if (!started)
+        llyfr_trace_end (trace, LLYFR_TRACE_STARTUP, start);
+      else
+        waited += read - now;
+
+      started = TRUE;
+
+      now = read;
+    }
+
+    if (decoder == LLYFR_SEARCH_DECODER_RG)
+      finished = llyfr_rg_backend_decode_line (line, length, &message, arena, &current_result, decode_time);
+    else
+      finished = llyfr_rg_backend_handle_line (line, length, &current_result, decode_time);
+
+    if (finished != NULL)
+      llyfr_result_sink_push (sink, finished);
+
+    g_free (line);
+
+    if (trace != NULL) {
+      gint64 handled = g_get_monotonic_time ();
+
+      built += handled - now - (decoded - decoded_before);
+      now = handled;
+    }
+  }
+
+  llyfr_rg_message_clear (&message);
+
+  llyfr_trace_add (trace, LLYFR_TRACE_RG, waited);
+  llyfr_trace_add (trace, LLYFR_TRACE_DECODE, decoded);
+  llyfr_trace_add (trace, LLYFR_TRACE_BUILD, built);
+
+  if (local_error != NULL) {
+    g_propagate_error (error, local_error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+llyfr_rg_backend_search (LlyfrSearchBackend  *backend,
+                         const gchar         *directory,
+                         const gchar         *query,
+                         GPtrArray           *files,
+                         guint                threads,
+                         LlyfrResultSink     *sink,
+                         LlyfrSearchArena    *arena,
+                         GCancellable        *cancellable,
+                         GError             **error)
+{
+  LlyfrRgBackend *self = LLYFR_RG_BACKEND (backend);
+  g_autoptr(GSubprocess) process = NULL;
+  LlyfrTrace *trace = llyfr_result_sink_get_trace (sink);
+  gulong cancelled_id = 0;
+  gboolean success;
+  gint64 begin;
+
+  begin = llyfr_trace_begin (trace);
+  process = llyfr_rg_backend_spawn (directory, query, files, threads,
+                                    llyfr_search_budget_get_max_count (llyfr_result_sink_get_budget (sink)),
+                                    error);
+  llyfr_trace_end (trace, LLYFR_TRACE_SPAWN, begin);
+
+  if (process == NULL)
+    return FALSE;
+
+  if (cancellable != NULL)
+    cancelled_id = g_cancellable_connect (cancellable,
+                                          G_CALLBACK (llyfr_rg_backend_cancelled_cb),
+                                          g_object_ref (process),
+                                          g_object_unref);
+
+  success = llyfr_rg_backend_read (self, g_subprocess_get_stdout_pipe (process),
+                                   sink, arena, cancellable, error);
+
+  g_cancellable_disconnect (cancellable, cancelled_id);
+
+  return success;
+}
+
+LlyfrSearchDecoder
+llyfr_rg_backend_get_decoder (LlyfrRgBackend *backend)
+{
+  g_return_val_if_fail (LLYFR_IS_RG_BACKEND (backend), LLYFR_SEARCH_DECODER_RG);
+
+  return backend->decoder;
+}
+
+void
+llyfr_rg_backend_set_decoder (LlyfrRgBackend *backend,
+                              LlyfrSearchDecoder decoder)
+{
+  g_return_if_fail (LLYFR_IS_RG_BACKEND (backend));
+
+  if (backend->decoder == decoder)
+    return;
+
+  backend->decoder = decoder;
+  g_object_notify_by_pspec (G_OBJECT (backend), properties[PROP_DECODER]);
+}
+
+static void
+llyfr_rg_backend_get_property (GObject    *object,
+                               guint       prop_id,
+                               GValue     *value,
+                               GParamSpec *pspec)
+{
+  LlyfrRgBackend *self = LLYFR_RG_BACKEND (object);
+
+  switch (prop_id) {
+    case PROP_DECODER:
+      g_value_set_enum (value, llyfr_rg_backend_get_decoder (self));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+  }
+}
+
+static void
+llyfr_rg_backend_set_property (GObject      *object,
+                               guint         prop_id,
+                               const GValue *value,
+                               GParamSpec   *pspec)
+{
+  LlyfrRgBackend *self = LLYFR_RG_BACKEND (object);
+
+  switch (prop_id) {
+    case PROP_DECODER:
+      llyfr_rg_backend_set_decoder (self, g_value_get_enum (value));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+  }
+}
+
+static void
+llyfr_rg_backend_iface_init (LlyfrSearchBackendInterface *iface)
+{
+  iface->search = llyfr_rg_backend_search;
+}
+
+static void
+llyfr_rg_backend_class_init (LlyfrRgBackendClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->get_property = llyfr_rg_backend_get_property;
+  object_class->set_property = llyfr_rg_backend_set_property;
+
+  properties[PROP_DECODER] =
+    g_param_spec_enum ("decoder",
+                       "Decoder",
+                       "How rg's output is decoded",
+                       LLYFR_TYPE_SEARCH_DECODER,
+                       LLYFR_SEARCH_DECODER_RG,
+                       G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY);
+
+  g_object_class_install_properties (object_class, LAST_PROP, properties);
+}
+
+static void
+llyfr_rg_backend_init (LlyfrRgBackend *self)
+{
+  self->decoder = LLYFR_SEARCH_DECODER_RG;
+}
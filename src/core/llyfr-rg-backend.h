@@ -0,0 +1,69 @@
+/* llyfr-rg-backend.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_RG_BACKEND_H
+#define LLYFR_RG_BACKEND_H
+
+#include <gio/gio.h>
+#include <glib-object.h>
+
+#include "llyfr-search-backend.h"
+
+G_BEGIN_DECLS
+
+#define LLYFR_TYPE_RG_BACKEND (llyfr_rg_backend_get_type())
+#define LLYFR_TYPE_SEARCH_DECODER (llyfr_search_decoder_get_type())
+
+/*
+ * How rg's --json output is turned into results, json-glib builds a full
+ * document for every line whereas the rg decoder picks the fields it needs
+ * straight out of the line.
+ */
+typedef enum
+{
+  LLYFR_SEARCH_DECODER_JSON_GLIB,
+  LLYFR_SEARCH_DECODER_RG,
+} LlyfrSearchDecoder;
+
+GType llyfr_search_decoder_get_type (void);
+
+G_DECLARE_FINAL_TYPE (LlyfrRgBackend, llyfr_rg_backend, LLYFR, RG_BACKEND, GObject)
+
+LlyfrSearchBackend* llyfr_rg_backend_new         (void);
+
+LlyfrSearchDecoder  llyfr_rg_backend_get_decoder (LlyfrRgBackend *backend);
+
+void                llyfr_rg_backend_set_decoder (LlyfrRgBackend *backend,
+                                                  LlyfrSearchDecoder decoder);
+
+gboolean            llyfr_rg_backend_read        (LlyfrRgBackend *backend,
+                                                  GInputStream *input,
+                                                  LlyfrResultSink *sink,
+                                                  LlyfrSearchArena *arena,
+                                                  GCancellable *cancellable,
+                                                  GError **error);
+
+GHashTable*         llyfr_rg_backend_list_files  (const gchar *directory,
+                                                  GCancellable *cancellable,
+                                                  GError **error);
+
+G_END_DECLS
+
+#endif /* LLYFR_RG_BACKEND_H */
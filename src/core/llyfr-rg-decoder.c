@@ -0,0 +1,539 @@
+/* llyfr-rg-decoder.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-rg-decoder"
+
+#include <string.h>
+
+#include "llyfr-rg-decoder.h"
+
+/*
+ * A decoder for the handful of messages rg --json produces. Rather than
+ * building a tree of nodes for every line, the line is scanned once and the
+ * fields we care about are picked out as they go past. Strings are unescaped
+ * in place (an escape sequence is never shorter than what it decodes to) and
+ * NUL terminated, so the decoded message simply points back into the line.
+ */
+
+G_DEFINE_QUARK (llyfr-rg-decoder-error-quark, llyfr_rg_decoder_error)
+
+typedef struct
+{
+  gchar  *start;
+  gchar  *cursor;
+  gchar  *end;
+} Scanner;
+
+typedef gboolean (*ScanMemberFunc) (Scanner     *scanner,
+                                    const gchar *key,
+                                    gpointer     user_data,
+                                    GError     **error);
+
+typedef struct
+{
+  const gchar **text;
+  gsize        *length;
+} TextField;
+
+static gboolean
+scan_fail (Scanner *scanner, GError **error, const gchar *expected)
+{
+  g_set_error (error,
+               LLYFR_RG_DECODER_ERROR,
+               LLYFR_RG_DECODER_ERROR_INVALID_DATA,
+               "Expected %s at offset %" G_GSIZE_FORMAT,
+               expected,
+               (gsize) (scanner->cursor - scanner->start));
+  return FALSE;
+}
+
+static inline void
+scan_whitespace (Scanner *scanner)
+{
+  while (scanner->cursor < scanner->end) {
+    switch (*scanner->cursor) {
+      case ' ':
+      case '\t':
+      case '\r':
+      case '\n':
+        scanner->cursor++;
+        break;
+
+      default:
+        return;
+    }
+  }
+}
+
+static inline gboolean
+scan_char (Scanner *scanner, gchar expected)
+{
+  scan_whitespace (scanner);
+
+  if (scanner->cursor >= scanner->end || *scanner->cursor != expected)
+    return FALSE;
+
+  scanner->cursor++;
+  return TRUE;
+}
+
+static gboolean
+scan_hex4 (Scanner *scanner, gunichar *out)
+{
+  gunichar value = 0;
+
+  if (scanner->end - scanner->cursor < 4)
+    return FALSE;
+
+  for (gint i = 0; i < 4; i++) {
+    gint digit = g_ascii_xdigit_value (scanner->cursor[i]);
+    if (digit < 0)
+      return FALSE;
+
+    value = (value << 4) | digit;
+  }
+
+  scanner->cursor += 4;
+  *out = value;
+  return TRUE;
+}
+
+/*
+ * Unescape the string under the cursor in place, leaving @out pointing at
+ * the NUL terminated result.
+ */
+static gboolean
+scan_string (Scanner *scanner, gchar **out, gsize *length, GError **error)
+{
+  gchar *write;
+  gchar *start;
+
+  if (!scan_char (scanner, '"'))
+    return scan_fail (scanner, error, "string");
+
+  start = write = scanner->cursor;
+
+  while (scanner->cursor < scanner->end) {
+    gchar c = *scanner->cursor++;
+
+    if (c == '"') {
+      *write = '\0';
+      *out = start;
+      *length = write - start;
+      return TRUE;
+    }
+
+    if (c != '\\') {
+      *write++ = c;
+      continue;
+    }
+
+    if (scanner->cursor >= scanner->end)
+      break;
+
+    c = *scanner->cursor++;
+    switch (c) {
+      case 'b': *write++ = '\b'; break;
+      case 'f': *write++ = '\f'; break;
+      case 'n': *write++ = '\n'; break;
+      case 'r': *write++ = '\r'; break;
+      case 't': *write++ = '\t'; break;
+
+      case 'u':
+        {
+          gunichar ch, low;
+
+          if (!scan_hex4 (scanner, &ch))
+            return scan_fail (scanner, error, "unicode escape");
+
+          if (ch >= 0xd800 && ch < 0xdc00) {
+            if (scanner->end - scanner->cursor >= 6 &&
+                scanner->cursor[0] == '\\' && scanner->cursor[1] == 'u') {
+              scanner->cursor += 2;
+
+              if (!scan_hex4 (scanner, &low))
+                return scan_fail (scanner, error, "unicode escape");
+
+              if (low >= 0xdc00 && low < 0xe000)
+                ch = 0x10000 + ((ch - 0xd800) << 10) + (low - 0xdc00);
+              else
+                ch = 0xfffd;
+            } else {
+              ch = 0xfffd;
+            }
+          } else if (ch >= 0xdc00 && ch < 0xe000) {
+            ch = 0xfffd;
+          }
+
+          write += g_unichar_to_utf8 (ch, write);
+          break;
+        }
+
+      default:
+        *write++ = c;
+        break;
+    }
+  }
+
+  return scan_fail (scanner, error, "end of string");
+}
+
+static gboolean
+skip_string (Scanner *scanner, GError **error)
+{
+  if (!scan_char (scanner, '"'))
+    return scan_fail (scanner, error, "string");
+
+  while (scanner->cursor < scanner->end) {
+    gchar c = *scanner->cursor++;
+
+    if (c == '\\')
+      scanner->cursor++;
+    else if (c == '"')
+      return TRUE;
+  }
+
+  return scan_fail (scanner, error, "end of string");
+}
+
+static gboolean
+skip_value (Scanner *scanner, GError **error)
+{
+  gint depth = 0;
+
+  scan_whitespace (scanner);
+  if (scanner->cursor >= scanner->end)
+    return scan_fail (scanner, error, "value");
+
+  switch (*scanner->cursor) {
+    case '"':
+      return skip_string (scanner, error);
+
+    case '{':
+    case '[':
+      while (scanner->cursor < scanner->end) {
+        switch (*scanner->cursor) {
+          case '"':
+            if (!skip_string (scanner, error))
+              return FALSE;
+            continue;
+
+          case '{':
+          case '[':
+            depth++;
+            break;
+
+          case '}':
+          case ']':
+            depth--;
+            break;
+
+          default:
+            break;
+        }
+
+        scanner->cursor++;
+        if (depth == 0)
+          return TRUE;
+      }
+
+      return scan_fail (scanner, error, "end of container");
+
+    default:
+      // Numbers, true, false and null.
+      while (scanner->cursor < scanner->end &&
+             strchr (",}] \t\r\n", *scanner->cursor) == NULL)
+        scanner->cursor++;
+
+      return TRUE;
+  }
+}
+
+static gboolean
+scan_int (Scanner *scanner, gint64 *out, GError **error)
+{
+  gchar *endptr = NULL;
+
+  scan_whitespace (scanner);
+
+  if (scanner->end - scanner->cursor >= 4 && strncmp (scanner->cursor, "null", 4) == 0) {
+    scanner->cursor += 4;
+    *out = -1;
+    return TRUE;
+  }
+
+  *out = g_ascii_strtoll (scanner->cursor, &endptr, 10);
+  if (endptr == scanner->cursor || endptr > scanner->end)
+    return scan_fail (scanner, error, "integer");
+
+  scanner->cursor = endptr;
+  return TRUE;
+}
+
+static gboolean
+scan_object (Scanner        *scanner,
+             ScanMemberFunc  func,
+             gpointer        user_data,
+             GError        **error)
+{
+  if (!scan_char (scanner, '{'))
+    return scan_fail (scanner, error, "object");
+
+  if (scan_char (scanner, '}'))
+    return TRUE;
+
+  for (;;) {
+    gchar *key;
+    gsize key_length;
+
+    if (!scan_string (scanner, &key, &key_length, error))
+      return FALSE;
+
+    if (!scan_char (scanner, ':'))
+      return scan_fail (scanner, error, "':'");
+
+    if (!func (scanner, key, user_data, error))
+      return FALSE;
+
+    if (scan_char (scanner, ','))
+      continue;
+
+    if (scan_char (scanner, '}'))
+      return TRUE;
+
+    return scan_fail (scanner, error, "',' or '}'");
+  }
+}
+
+/*
+ * rg reports paths and lines as either {"text": "..."} or, when they are
+ * not valid UTF-8, {"bytes": "<base64>"}.
+ */
+static gboolean
+scan_text_member (Scanner     *scanner,
+                  const gchar *key,
+                  gpointer     user_data,
+                  GError     **error)
+{
+  TextField *field = user_data;
+  gchar *value;
+  gsize length;
+
+  if (strcmp (key, "text") == 0) {
+    if (!scan_string (scanner, &value, &length, error))
+      return FALSE;
+
+    *field->text = value;
+    *field->length = length;
+    return TRUE;
+  }
+
+  if (strcmp (key, "bytes") == 0) {
+    if (!scan_string (scanner, &value, &length, error))
+      return FALSE;
+
+    g_base64_decode_inplace (value, &length);
+    value[length] = '\0';
+
+    *field->text = value;
+    *field->length = length;
+    return TRUE;
+  }
+
+  return skip_value (scanner, error);
+}
+
+static gboolean
+scan_text (Scanner      *scanner,
+           const gchar **text,
+           gsize        *length,
+           GError      **error)
+{
+  TextField field = { text, length };
+
+  scan_whitespace (scanner);
+  if (scanner->cursor < scanner->end && *scanner->cursor != '{')
+    return skip_value (scanner, error);
+
+  return scan_object (scanner, scan_text_member, &field, error);
+}
+
+static gboolean
+scan_submatch_member (Scanner     *scanner,
+                      const gchar *key,
+                      gpointer     user_data,
+                      GError     **error)
+{
+  gint64 *span = user_data;
+
+  if (strcmp (key, "start") == 0)
+    return scan_int (scanner, &span[0], error);
+
+  if (strcmp (key, "end") == 0)
+    return scan_int (scanner, &span[1], error);
+
+  return skip_value (scanner, error);
+}
+
+static gboolean
+scan_submatches (Scanner        *scanner,
+                 LlyfrRgMessage *message,
+                 GError        **error)
+{
+  if (!scan_char (scanner, '['))
+    return scan_fail (scanner, error, "array");
+
+  if (scan_char (scanner, ']'))
+    return TRUE;
+
+  for (;;) {
+    gint64 span[2] = { -1, -1 };
+
+    if (!scan_object (scanner, scan_submatch_member, span, error))
+      return FALSE;
+
+    if (span[0] >= 0 && span[0] < span[1])
+      g_array_append_vals (message->submatches, span, 2);
+
+    if (scan_char (scanner, ','))
+      continue;
+
+    if (scan_char (scanner, ']'))
+      return TRUE;
+
+    return scan_fail (scanner, error, "',' or ']'");
+  }
+}
+
+static gboolean
+scan_data_member (Scanner     *scanner,
+                  const gchar *key,
+                  gpointer     user_data,
+                  GError     **error)
+{
+  LlyfrRgMessage *message = user_data;
+
+  if (strcmp (key, "path") == 0)
+    return scan_text (scanner, &message->path, &message->path_length, error);
+
+  if (strcmp (key, "lines") == 0)
+    return scan_text (scanner, &message->text, &message->text_length, error);
+
+  if (strcmp (key, "line_number") == 0)
+    return scan_int (scanner, &message->line_number, error);
+
+  if (strcmp (key, "submatches") == 0)
+    return scan_submatches (scanner, message, error);
+
+  return skip_value (scanner, error);
+}
+
+static LlyfrRgMessageType
+message_type_from_string (const gchar *type)
+{
+  if (strcmp (type, "match") == 0)
+    return LLYFR_RG_MESSAGE_MATCH;
+
+  if (strcmp (type, "begin") == 0)
+    return LLYFR_RG_MESSAGE_BEGIN;
+
+  if (strcmp (type, "end") == 0)
+    return LLYFR_RG_MESSAGE_END;
+
+  if (strcmp (type, "context") == 0)
+    return LLYFR_RG_MESSAGE_CONTEXT;
+
+  if (strcmp (type, "summary") == 0)
+    return LLYFR_RG_MESSAGE_SUMMARY;
+
+  return LLYFR_RG_MESSAGE_UNKNOWN;
+}
+
+static gboolean
+scan_message_member (Scanner     *scanner,
+                     const gchar *key,
+                     gpointer     user_data,
+                     GError     **error)
+{
+  LlyfrRgMessage *message = user_data;
+
+  if (strcmp (key, "type") == 0) {
+    gchar *type;
+    gsize length;
+
+    if (!scan_string (scanner, &type, &length, error))
+      return FALSE;
+
+    message->type = message_type_from_string (type);
+    return TRUE;
+  }
+
+  if (strcmp (key, "data") == 0) {
+    scan_whitespace (scanner);
+    if (scanner->cursor < scanner->end && *scanner->cursor != '{')
+      return skip_value (scanner, error);
+
+    return scan_object (scanner, scan_data_member, message, error);
+  }
+
+  return skip_value (scanner, error);
+}
+
+void
+llyfr_rg_message_init (LlyfrRgMessage *message)
+{
+  memset (message, 0, sizeof (LlyfrRgMessage));
+
+  message->line_number = -1;
+  message->submatches = g_array_new (FALSE, FALSE, sizeof (gint64));
+}
+
+void
+llyfr_rg_message_clear (LlyfrRgMessage *message)
+{
+  g_clear_pointer (&message->submatches, g_array_unref);
+}
+
+/*
+ * Decode a single, NUL terminated, line of rg --json output into @message
+ * reusing its storage. @line is modified in the process.
+ */
+gboolean
+llyfr_rg_decode_line (gchar          *line,
+                      gsize           length,
+                      LlyfrRgMessage *message,
+                      GError        **error)
+{
+  Scanner scanner = { line, line, line + length };
+
+  g_return_val_if_fail (line != NULL, FALSE);
+  g_return_val_if_fail (message != NULL, FALSE);
+  g_return_val_if_fail (message->submatches != NULL, FALSE);
+
+  message->type = LLYFR_RG_MESSAGE_UNKNOWN;
+  message->path = NULL;
+  message->path_length = 0;
+  message->text = NULL;
+  message->text_length = 0;
+  message->line_number = -1;
+  g_array_set_size (message->submatches, 0);
+
+  return scan_object (&scanner, scan_message_member, message, error);
+}
@@ -0,0 +1,78 @@
+/* llyfr-rg-decoder.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_RG_DECODER_H
+#define LLYFR_RG_DECODER_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define LLYFR_RG_DECODER_ERROR (llyfr_rg_decoder_error_quark ())
+
+typedef enum
+{
+  LLYFR_RG_DECODER_ERROR_INVALID_DATA,
+} LlyfrRgDecoderError;
+
+typedef enum
+{
+  LLYFR_RG_MESSAGE_UNKNOWN,
+  LLYFR_RG_MESSAGE_BEGIN,
+  LLYFR_RG_MESSAGE_MATCH,
+  LLYFR_RG_MESSAGE_CONTEXT,
+  LLYFR_RG_MESSAGE_END,
+  LLYFR_RG_MESSAGE_SUMMARY,
+} LlyfrRgMessageType;
+
+/*
+ * A single message from rg --json, decoded in place. The path and text
+ * fields point into the line that was decoded, so are only valid for as
+ * long as that line is. Submatches are stored as (start, end) pairs of
+ * byte offsets into text.
+ */
+typedef struct
+{
+  LlyfrRgMessageType  type;
+
+  const gchar        *path;
+  gsize               path_length;
+
+  const gchar        *text;
+  gsize               text_length;
+
+  gint64              line_number;
+  GArray             *submatches;
+} LlyfrRgMessage;
+
+GQuark   llyfr_rg_decoder_error_quark (void);
+
+void     llyfr_rg_message_init        (LlyfrRgMessage *message);
+
+void     llyfr_rg_message_clear       (LlyfrRgMessage *message);
+
+gboolean llyfr_rg_decode_line         (gchar          *line,
+                                       gsize           length,
+                                       LlyfrRgMessage *message,
+                                       GError        **error);
+
+G_END_DECLS
+
+#endif /* LLYFR_RG_DECODER_H */
@@ -0,0 +1,169 @@
+/* llyfr-search-arena.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-search-arena"
+
+#include "llyfr-search-arena.h"
+
+/*
+ * Backing storage shared by all the results of a single search. Memory is
+ * handed out from a list of blocks which are never moved or resized, so
+ * anything already allocated stays put while the search carries on adding
+ * to the arena from another thread. Nothing is freed individually, the
+ * whole lot goes once the last result holding a reference is gone.
+ */
+
+#define MIN_BLOCK_SIZE    (4 * 1024)
+#define MAX_BLOCK_SIZE    (256 * 1024)
+#define BLOCK_HEADER_SIZE ((sizeof (Block) + 15) & ~(gsize) 15)
+
+typedef struct _Block Block;
+
+struct _Block
+{
+  Block  *next;
+  gsize   size;
+  gsize   used;
+};
+
+struct _LlyfrSearchArena
+{
+  gatomicrefcount  ref_count;
+
+  GMutex           lock;
+  Block           *blocks;
+  gsize            next_block_size;
+  gsize            allocated;
+};
+
+G_DEFINE_BOXED_TYPE (LlyfrSearchArena, llyfr_search_arena,
+                     llyfr_search_arena_ref, llyfr_search_arena_unref)
+
+LlyfrSearchArena*
+llyfr_search_arena_new (void)
+{
+  LlyfrSearchArena *arena = g_new0 (LlyfrSearchArena, 1);
+
+  g_atomic_ref_count_init (&arena->ref_count);
+  g_mutex_init (&arena->lock);
+  arena->next_block_size = MIN_BLOCK_SIZE;
+
+  return arena;
+}
+
+LlyfrSearchArena*
+llyfr_search_arena_ref (LlyfrSearchArena *arena)
+{
+  g_return_val_if_fail (arena != NULL, NULL);
+
+  g_atomic_ref_count_inc (&arena->ref_count);
+  return arena;
+}
+
+void
+llyfr_search_arena_unref (LlyfrSearchArena *arena)
+{
+  Block *block;
+
+  g_return_if_fail (arena != NULL);
+
+  if (!g_atomic_ref_count_dec (&arena->ref_count))
+    return;
+
+  block = arena->blocks;
+  while (block != NULL) {
+    Block *next = block->next;
+
+    g_free (block);
+    block = next;
+  }
+
+  g_mutex_clear (&arena->lock);
+  g_free (arena);
+}
+
+static Block*
+block_new (gsize size)
+{
+  Block *block = g_malloc (BLOCK_HEADER_SIZE + size);
+
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+
+  return block;
+}
+
+/*
+ * Allocate @size bytes, aligned to 8 bytes, that remain valid for as long
+ * as the arena does. Safe to call from any thread.
+ */
+gpointer
+llyfr_search_arena_alloc (LlyfrSearchArena *arena,
+                          gsize size)
+{
+  g_autoptr(GMutexLocker) locker = NULL;
+  Block *block;
+  gpointer mem;
+
+  g_return_val_if_fail (arena != NULL, NULL);
+
+  size = (size + 7) & ~(gsize) 7;
+  locker = g_mutex_locker_new (&arena->lock);
+
+  block = arena->blocks;
+  if (block == NULL || block->size - block->used < size) {
+
+    // Anything big enough to waste most of a block gets one of its own,
+    // leaving the current block to carry on serving small requests.
+    if (block != NULL && size > MAX_BLOCK_SIZE / 4) {
+      Block *large = block_new (size);
+
+      large->next = block->next;
+      block->next = large;
+      large->used = size;
+      arena->allocated += size;
+
+      return (guint8 *) large + BLOCK_HEADER_SIZE;
+    }
+
+    block = block_new (MAX (arena->next_block_size, size));
+    block->next = arena->blocks;
+    arena->blocks = block;
+    arena->next_block_size = MIN (arena->next_block_size * 2, MAX_BLOCK_SIZE);
+  }
+
+  mem = (guint8 *) block + BLOCK_HEADER_SIZE + block->used;
+  block->used += size;
+  arena->allocated += size;
+
+  return mem;
+}
+
+/*
+ * The number of bytes handed out by the arena so far.
+ */
+gsize
+llyfr_search_arena_get_size (LlyfrSearchArena *arena)
+{
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&arena->lock);
+
+  return arena->allocated;
+}
@@ -0,0 +1,50 @@
+/* llyfr-search-arena.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_SEARCH_ARENA_H
+#define LLYFR_SEARCH_ARENA_H
+
+#include <glib.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define LLYFR_TYPE_SEARCH_ARENA (llyfr_search_arena_get_type())
+
+typedef struct _LlyfrSearchArena LlyfrSearchArena;
+
+GType             llyfr_search_arena_get_type (void) G_GNUC_CONST;
+
+LlyfrSearchArena* llyfr_search_arena_new      (void);
+
+LlyfrSearchArena* llyfr_search_arena_ref      (LlyfrSearchArena *arena);
+
+void              llyfr_search_arena_unref    (LlyfrSearchArena *arena);
+
+gpointer          llyfr_search_arena_alloc    (LlyfrSearchArena *arena,
+                                               gsize size);
+
+gsize             llyfr_search_arena_get_size (LlyfrSearchArena *arena);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (LlyfrSearchArena, llyfr_search_arena_unref)
+
+G_END_DECLS
+
+#endif /* LLYFR_SEARCH_ARENA_H */
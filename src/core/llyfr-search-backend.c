@@ -0,0 +1,73 @@
+/* llyfr-search-backend.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-search-backend"
+
+#include "llyfr-search-backend.h"
+
+/*
+ * Something able to find the lines matching a query in a directory. The
+ * search context takes care of running searches on a worker thread and
+ * limiting how many run at once, backends only have to do the searching.
+ */
+
+G_DEFINE_INTERFACE (LlyfrSearchBackend, llyfr_search_backend, G_TYPE_OBJECT)
+
+static void
+llyfr_search_backend_default_init (LlyfrSearchBackendInterface *iface)
+{
+}
+
+/*
+ * Search @directory for @query, pushing a LlyfrSearchResult onto @sink for
+ * every file with a match. Results should be allocated from @arena and
+ * @threads, when not 0, is how many threads the search may keep busy.
+ * When @files is given, only those files (absolute paths within
+ * @directory) need searching. No more than the max_file_matches of the
+ * sink's budget lines should be reported for any one file.
+ *
+ * Blocks until the search is done, so is always called from a worker
+ * thread, and should give up as soon as it can once @cancellable is
+ * cancelled.
+ */
+gboolean
+llyfr_search_backend_search (LlyfrSearchBackend  *backend,
+                             const gchar         *directory,
+                             const gchar         *query,
+                             GPtrArray           *files,
+                             guint                threads,
+                             LlyfrResultSink     *sink,
+                             LlyfrSearchArena    *arena,
+                             GCancellable        *cancellable,
+                             GError             **error)
+{
+  LlyfrSearchBackendInterface *iface;
+
+  g_return_val_if_fail (LLYFR_IS_SEARCH_BACKEND (backend), FALSE);
+  g_return_val_if_fail (directory != NULL, FALSE);
+  g_return_val_if_fail (query != NULL, FALSE);
+  g_return_val_if_fail (LLYFR_IS_RESULT_SINK (sink), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  iface = LLYFR_SEARCH_BACKEND_GET_IFACE (backend);
+  g_return_val_if_fail (iface->search != NULL, FALSE);
+
+  return iface->search (backend, directory, query, files, threads, sink, arena, cancellable, error);
+}
@@ -0,0 +1,63 @@
+/* llyfr-search-backend.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_SEARCH_BACKEND_H
+#define LLYFR_SEARCH_BACKEND_H
+
+#include <gio/gio.h>
+#include <glib-object.h>
+
+#include "llyfr-result-sink.h"
+#include "llyfr-search-arena.h"
+
+G_BEGIN_DECLS
+
+#define LLYFR_TYPE_SEARCH_BACKEND (llyfr_search_backend_get_type())
+
+G_DECLARE_INTERFACE (LlyfrSearchBackend, llyfr_search_backend, LLYFR, SEARCH_BACKEND, GObject)
+
+struct _LlyfrSearchBackendInterface
+{
+  GTypeInterface parent;
+
+  gboolean (*search) (LlyfrSearchBackend  *backend,
+                      const gchar         *directory,
+                      const gchar         *query,
+                      GPtrArray           *files,
+                      guint                threads,
+                      LlyfrResultSink     *sink,
+                      LlyfrSearchArena    *arena,
+                      GCancellable        *cancellable,
+                      GError             **error);
+};
+
+gboolean llyfr_search_backend_search (LlyfrSearchBackend  *backend,
+                                      const gchar         *directory,
+                                      const gchar         *query,
+                                      GPtrArray           *files,
+                                      guint                threads,
+                                      LlyfrResultSink     *sink,
+                                      LlyfrSearchArena    *arena,
+                                      GCancellable        *cancellable,
+                                      GError             **error);
+
+G_END_DECLS
+
+#endif /* LLYFR_SEARCH_BACKEND_H */
@@ -0,0 +1,100 @@
+/* llyfr-search-budget.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-search-budget"
+
+#include "llyfr-search-budget.h"
+
+static guint
+scale_uint (guint value,
+            guint factor)
+{
+  if (value == 0 || factor == 0)
+    return value;
+
+  return value > G_MAXUINT / factor ? G_MAXUINT : value * factor;
+}
+
+/*
+ * Store @budget with every limit multiplied by @factor in @scaled, used to
+ * carry on with a search that ran out.
+ */
+void
+llyfr_search_budget_scale (const LlyfrSearchBudget *budget,
+                           guint factor,
+                           LlyfrSearchBudget *scaled)
+{
+  g_return_if_fail (budget != NULL);
+  g_return_if_fail (scaled != NULL);
+
+  scaled->max_time = scale_uint (budget->max_time, factor);
+  scaled->max_matches = scale_uint (budget->max_matches, factor);
+  scaled->max_file_matches = scale_uint (budget->max_file_matches, factor);
+
+  if (budget->max_text == 0 || factor == 0)
+    scaled->max_text = budget->max_text;
+  else
+    scaled->max_text = budget->max_text > G_MAXSIZE / factor ? G_MAXSIZE : budget->max_text * factor;
+}
+
+/*
+ * A sentence saying why a search that ran out of @limit stopped, to show
+ * alongside its results.
+ */
+gchar*
+llyfr_search_budget_describe (const LlyfrSearchBudget *budget,
+                              LlyfrSearchLimit limit)
+{
+  g_autofree gchar *size = NULL;
+
+  g_return_val_if_fail (budget != NULL, NULL);
+
+  switch (limit) {
+    case LLYFR_SEARCH_LIMIT_TIME:
+      return g_strdup_printf ("Stopped after %.1f seconds", budget->max_time / 1000.0);
+
+    case LLYFR_SEARCH_LIMIT_MATCHES:
+      return g_strdup_printf ("Stopped after %u matching lines", budget->max_matches);
+
+    case LLYFR_SEARCH_LIMIT_TEXT:
+      size = g_format_size (budget->max_text);
+      return g_strdup_printf ("Stopped after %s of results", size);
+
+    case LLYFR_SEARCH_LIMIT_NONE:
+    default:
+      return g_strdup ("Search complete");
+  }
+}
+
+/*
+ * How many matching lines a backend should report from each file, one more
+ * than @budget keeps so that the sink can tell a file that had more from
+ * one that had exactly that many. 0 for no limit.
+ */
+guint
+llyfr_search_budget_get_max_count (const LlyfrSearchBudget *budget)
+{
+  g_return_val_if_fail (budget != NULL, 0);
+
+  if (budget->max_file_matches == 0 || budget->max_file_matches == G_MAXUINT)
+    return budget->max_file_matches;
+
+  return budget->max_file_matches + 1;
+}
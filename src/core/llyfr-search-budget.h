@@ -0,0 +1,68 @@
+/* llyfr-search-budget.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_SEARCH_BUDGET_H
+#define LLYFR_SEARCH_BUDGET_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * How much a single search is allowed to take before it's stopped and
+ * whatever was found so far shown instead. A limit of 0 means none.
+ */
+typedef struct
+{
+  // In milliseconds, from when the search starts running.
+  guint  max_time;
+  guint  max_matches;
+
+  // Lines kept per file, any more are left out. Unlike the others this
+  // doesn't stop the search, the files are only marked as truncated.
+  guint  max_file_matches;
+
+  // Bytes of results, as counted by llyfr_search_result_get_size().
+  gsize  max_text;
+} LlyfrSearchBudget;
+
+/*
+ * Which part of a budget a search ran out of.
+ */
+typedef enum
+{
+  LLYFR_SEARCH_LIMIT_NONE,
+  LLYFR_SEARCH_LIMIT_TIME,
+  LLYFR_SEARCH_LIMIT_MATCHES,
+  LLYFR_SEARCH_LIMIT_TEXT,
+} LlyfrSearchLimit;
+
+void   llyfr_search_budget_scale    (const LlyfrSearchBudget *budget,
+                                     guint factor,
+                                     LlyfrSearchBudget *scaled);
+
+gchar* llyfr_search_budget_describe (const LlyfrSearchBudget *budget,
+                                     LlyfrSearchLimit limit);
+
+guint  llyfr_search_budget_get_max_count (const LlyfrSearchBudget *budget);
+
+G_END_DECLS
+
+#endif /* LLYFR_SEARCH_BUDGET_H */
@@ -20,20 +20,39 @@
 
 #define G_LOG_DOMAIN "llyfr-search-context"
 
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "llyfr-git-files.h"
+#include "llyfr-git-object-reader.h"
+#include "llyfr-matcher.h"
+#include "llyfr-result-sink.h"
+#include "llyfr-rg-backend.h"
 #include "llyfr-search-context.h"
 #include "llyfr-search-result.h"
 
 typedef struct
 {
-  gchar          *directory;
+  gchar              *directory;
+  LlyfrSearchBackend *backend;
+  LlyfrTrigramIndex  *index;
+
+  // Searched instead of the working tree when set.
+  gchar             **revisions;
+  LlyfrGitObjectReader *object_reader;
 } LlyfrSearchContextPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (LlyfrSearchContext, llyfr_search_context, G_TYPE_OBJECT)
 
+G_DEFINE_QUARK (llyfr-search-context-error-quark, llyfr_search_context_error)
+
 enum
 {
   PROP_0,
   PROP_DIRECTORY,
+  PROP_BACKEND,
+  PROP_REVISIONS,
   LAST_PROP
 };
 
@@ -44,114 +63,851 @@ LlyfrSearchContext* llyfr_search_context_new (char* directory)
                        NULL);
 }
 
-static gboolean
-llyfr_search_context_do_rg_search (LlyfrSearchContext *context,
-                                   const gchar *query,
-                                   char **output,
-                                   GError **error)
-{
-  g_autoptr(GSubprocess) process = NULL;
-  const gchar *search_directory = llyfr_search_context_get_directory (context);
-
-  g_assert (search_directory != NULL);
-  process = g_subprocess_new (G_SUBPROCESS_FLAGS_STDOUT_PIPE, error,
-                              "flatpak-spawn", "--host",
-                              "rg", "--json",
-                              query, search_directory,
-                              NULL);
-
-  if (process == NULL)
-    return FALSE;
+/*
+ * Characters that give a query a special meaning to rg, rather than being
+ * matched literally.
+ */
+#define REGEX_METACHARACTERS "\\.+*?()|[]{}^$"
 
-  return g_subprocess_communicate_utf8 (process, NULL, NULL, output, NULL, error);
-}
+typedef struct
+{
+  LlyfrSearchBackend *backend;
+  LlyfrTrigramIndex  *index;
+  LlyfrResultSink    *sink;
+  LlyfrSearchArena   *arena;
+
+  gchar              *directory;
+  gchar              *query;
+  guint               threads;
+  gboolean            running;
+  gboolean            git_files;
+
+  // Only set when refining the results of an earlier search.
+  GPtrArray          *previous;
 
-static JsonNode *
-llyfr_search_context_parse_object (char*    line,
-                                   gsize    length,
-                                   GError **error)
+  // Only set when searching revisions rather than the working tree.
+  gchar             **revisions;
+  LlyfrGitObjectReader *object_reader;
+
+  // Cancelled when either the search is, or it runs out of budget.
+  LlyfrSearchBudget   budget;
+  GCancellable       *stop;
+  GCancellable       *cancellable;
+  gulong              cancelled_id;
+  GSource            *timeout;
+
+  // Only set when the search is being traced, queued is when it started
+  // waiting for its turn, if it had to.
+  LlyfrTrace         *trace;
+  gint64              queued;
+} SearchData;
+
+/*
+ * The most blobs read by the search thread that can be waiting to be
+ * matched on the thread pool, which bounds the memory a revision search
+ * holds at once.
+ */
+#define MAX_BLOBS_IN_FLIGHT 64
+
+typedef struct
 {
-  g_autoptr (JsonParser) parser = json_parser_new ();
-  JsonNode *root = NULL;
+  LlyfrMatcher     *matcher;
+  LlyfrResultSink  *sink;
+  LlyfrSearchArena *arena;
+  GCancellable     *cancellable;
 
-  if (!json_parser_load_from_data (parser, line, length, error))
-    return NULL;
+  // Guards everything below.
+  GMutex            mutex;
+  GCond             cond;
+  guint             in_flight;
 
-  root = json_parser_get_root (parser);
-  if (root == NULL || !JSON_NODE_HOLDS_OBJECT (root))
-    {
-      g_set_error (error,
-                   JSON_PARSER_ERROR,
-                   JSON_PARSER_ERROR_INVALID_DATA,
-                   "Expected JSON Object Got: '%s'", line);
-      return NULL;
-    }
+  // Blob id to what was found in it, for each blob with a match.
+  GHashTable       *found;
+} RevisionScan;
+
+typedef struct
+{
+  gchar       *oid;
+  gchar       *path;
+  const gchar *revision;
+  GBytes      *contents;
+} BlobJob;
 
-  return json_parser_steal_root (parser);
+/*
+ * However many searches are started, across however many contexts, only
+ * this many run at once, the rest wait their turn. Each one is given an
+ * even share of the CPUs. Only touched from the main thread.
+ */
+static guint  max_running_searches = 0;
+static guint  n_running_searches = 0;
+static GQueue waiting_searches = G_QUEUE_INIT;
+
+// Used by any context without a backend of its own.
+static LlyfrSearchBackend *default_backend = NULL;
+
+static gboolean indexing_enabled = FALSE;
+static gboolean ranking_enabled = TRUE;
+
+// Used by searches not given a budget of their own.
+static LlyfrSearchBudget default_budget = { 0, };
+static gboolean git_files_enabled = FALSE;
+
+static void
+search_data_free (SearchData *data)
+{
+  g_clear_object (&data->backend);
+  g_clear_object (&data->index);
+  g_clear_object (&data->sink);
+  g_clear_pointer (&data->arena, llyfr_search_arena_unref);
+  g_clear_pointer (&data->previous, g_ptr_array_unref);
+  g_clear_pointer (&data->revisions, g_strfreev);
+  g_clear_object (&data->object_reader);
+  g_clear_pointer (&data->trace, llyfr_trace_unref);
+
+  if (data->timeout != NULL) {
+    g_source_destroy (data->timeout);
+    g_clear_pointer (&data->timeout, g_source_unref);
+  }
+
+  if (data->cancelled_id != 0)
+    g_cancellable_disconnect (data->cancellable, data->cancelled_id);
+
+  g_clear_object (&data->cancellable);
+  g_clear_object (&data->stop);
+  g_free (data->directory);
+  g_free (data->query);
+
+  g_free (data);
 }
 
 GListModel* llyfr_search_context_search (LlyfrSearchContext *context,
                                          const gchar* query,
                                          GError **error)
 {
-  g_autoptr(GInputStream) instream = NULL;
-  g_autoptr(GDataInputStream) stream = NULL;
-
-  LlyfrSearchResult* current_result = NULL;
-  char* line = NULL;
-  char* output = NULL;
-  gsize length = 0;
-  GListStore* results;
+  g_autoptr(GListStore) results = g_list_store_new (LLYFR_TYPE_SEARCH_RESULT);
+  g_autoptr(LlyfrResultSink) sink = llyfr_result_sink_new (results);
+  g_autoptr(LlyfrSearchArena) arena = llyfr_search_arena_new ();
 
-  if (!llyfr_search_context_do_rg_search (context, query, &output, error)) {
+  if (!llyfr_search_backend_search (llyfr_search_context_get_backend (context),
+                                    llyfr_search_context_get_directory (context),
+                                    query, NULL, 0, sink, arena, NULL, error))
     return NULL;
-  }
 
-  results = g_list_store_new (LLYFR_TYPE_SEARCH_RESULT);
-  instream = g_memory_input_stream_new_from_data (output, -1, g_free);
-  stream = g_data_input_stream_new (instream);
+  // We're the thread that owns the store, so everything can be moved
+  // across now.
+  llyfr_result_sink_flush (sink);
 
-  while ((line = g_data_input_stream_read_line_utf8 (stream, &length, NULL, error))) {
-    g_autoptr(JsonReader) reader = NULL;
-    g_autoptr(JsonNode) node = NULL;
+  return G_LIST_MODEL (g_steal_pointer (&results));
+}
 
-    g_debug ("%s", line);
-    node = llyfr_search_context_parse_object (line, length, error);
-    if (node == NULL) {
-      g_message ("Unable to parse line '%s'\n%s", line, (*error)->message);
+/*
+ * The files git is tracking in @directory, as absolute paths, or NULL if it
+ * isn't a repository and has to be walked instead. Files deleted from the
+ * working tree but not from the index are left out.
+ */
+static GPtrArray*
+llyfr_search_context_list_git_files (const gchar  *directory,
+                                     GCancellable *cancellable)
+{
+  g_autoptr(GArray) git_files = NULL;
+  g_autoptr(GError) error = NULL;
+  GPtrArray *files;
 
-      g_clear_error (error);
-      g_free (line);
+  git_files = llyfr_git_files_list (directory, cancellable, &error);
+  if (git_files == NULL) {
+    g_debug ("Walking %s instead: %s", directory, error->message);
+    return NULL;
+  }
+
+  files = g_ptr_array_new_full (git_files->len, g_free);
+  for (guint i = 0; i < git_files->len; i++) {
+    LlyfrGitFile *file = &g_array_index (git_files, LlyfrGitFile, i);
+    gchar *path = g_build_filename (directory, file->path, NULL);
+    GStatBuf buf;
+
+    // rg complains about every path it can't open.
+    if (g_lstat (path, &buf) != 0) {
+      g_free (path);
       continue;
     }
 
-    reader = json_reader_new (node);
+    g_ptr_array_add (files, path);
+  }
 
-    json_reader_read_member (reader, "type");
-    const char* type = json_reader_get_string_value (reader);
+  return files;
+}
 
-    if (g_strcmp0 (type, "begin") == 0) {
-      current_result = llyfr_search_result_new_from_json (node);
-      continue;
-    }
+static void
+blob_job_free (BlobJob *job)
+{
+  g_free (job->oid);
+  g_free (job->path);
+  g_clear_pointer (&job->contents, g_bytes_unref);
+  g_free (job);
+}
+
+/*
+ * Runs on the thread pool, matching a single blob.
+ */
+static void
+llyfr_search_context_scan_blob (gpointer item,
+                                gpointer user_data)
+{
+  BlobJob *job = item;
+  RevisionScan *scan = user_data;
+  LlyfrTrace *trace = llyfr_result_sink_get_trace (scan->sink);
+  LlyfrSearchResult *result = NULL;
+
+  if (!g_cancellable_is_cancelled (scan->cancellable)) {
+    gint64 begin = llyfr_trace_begin (trace);
+    gsize size;
+    const gchar *contents = g_bytes_get_data (job->contents, &size);
+
+    result = llyfr_matcher_scan (scan->matcher, scan->arena, job->path, contents, size);
+
+    if (trace != NULL)
+      llyfr_trace_add (trace, LLYFR_TRACE_SCAN, g_get_monotonic_time () - begin);
+  }
+
+  g_mutex_lock (&scan->mutex);
+  if (result != NULL) {
+    llyfr_search_result_set_revision (result, job->revision);
+    g_hash_table_insert (scan->found, g_strdup (job->oid), g_object_ref (result));
+  }
+  scan->in_flight--;
+  g_cond_signal (&scan->cond);
+  g_mutex_unlock (&scan->mutex);
+
+  if (result != NULL)
+    llyfr_result_sink_push (scan->sink, result);
+
+  blob_job_free (job);
+}
+
+/*
+ * Search the trees of each of the revisions in @data. Blobs are read one
+ * at a time through the context's cat-file process and matched on a
+ * thread pool. A blob is only searched the first time it's seen, should
+ * it turn up again, at another revision or another path, what was found
+ * the first time is reported again.
+ */
+static gboolean
+llyfr_search_context_search_revisions (SearchData    *data,
+                                       GCancellable  *cancellable,
+                                       GError       **error)
+{
+  g_autoptr(LlyfrMatcher) matcher = NULL;
+  g_autoptr(GPtrArray) duplicates = NULL;
+  g_autoptr(GHashTable) seen = NULL;
+  RevisionScan scan = { 0, };
+  GError *local_error = NULL;
+  gboolean success = FALSE;
+  GThreadPool *pool;
+  guint threads;
+
+  if (*data->query == '\0')
+    return TRUE;
+
+  matcher = llyfr_matcher_new (data->query, error);
+  if (matcher == NULL)
+    return FALSE;
+
+  llyfr_matcher_set_max_lines (matcher, llyfr_search_budget_get_max_count (&data->budget));
+  threads = data->threads > 0 ? data->threads : g_get_num_processors ();
+
+  scan.matcher = matcher;
+  scan.sink = data->sink;
+  scan.arena = data->arena;
+  scan.cancellable = cancellable;
+  scan.found = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+  g_mutex_init (&scan.mutex);
+  g_cond_init (&scan.cond);
+
+  pool = g_thread_pool_new (llyfr_search_context_scan_blob, &scan, threads, FALSE, error);
+  if (pool == NULL)
+    goto out;
+
+  // The id of every blob queued, then (blob id, path, revision) of each
+  // file whose blob already was.
+  seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  duplicates = g_ptr_array_new_with_free_func (g_free);
+
+  for (guint r = 0; data->revisions[r] != NULL && local_error == NULL; r++) {
+    const gchar *revision = data->revisions[r];
+    g_autoptr(GArray) entries = NULL;
+
+    entries = llyfr_git_object_reader_list_tree (data->object_reader, revision, cancellable, &local_error);
+    if (entries == NULL)
+      break;
 
-    if (g_strcmp0 (type, "match") == 0) {
-      llyfr_search_result_add_match (current_result, node);
+    for (guint i = 0; i < entries->len && local_error == NULL; i++) {
+      LlyfrGitTreeEntry *entry = &g_array_index (entries, LlyfrGitTreeEntry, i);
+      g_autofree gchar *path = g_build_filename (data->directory, entry->path, NULL);
+      BlobJob *job;
+
+      if (!g_hash_table_add (seen, g_strdup (entry->oid))) {
+        g_ptr_array_add (duplicates, g_strdup (entry->oid));
+        g_ptr_array_add (duplicates, g_steal_pointer (&path));
+        g_ptr_array_add (duplicates, g_strdup (revision));
+        continue;
+      }
+
+      g_mutex_lock (&scan.mutex);
+
+      // Don't read too far ahead of the pool.
+      while (scan.in_flight >= MAX_BLOBS_IN_FLIGHT)
+        g_cond_wait (&scan.cond, &scan.mutex);
+
+      scan.in_flight++;
+      g_mutex_unlock (&scan.mutex);
+
+      job = g_new0 (BlobJob, 1);
+      job->oid = g_strdup (entry->oid);
+      job->path = g_steal_pointer (&path);
+      job->revision = revision;
+      job->contents = llyfr_git_object_reader_read (data->object_reader, entry->oid, NULL,
+                                                    cancellable, &local_error);
+
+      if (job->contents == NULL) {
+        g_mutex_lock (&scan.mutex);
+        scan.in_flight--;
+        g_mutex_unlock (&scan.mutex);
+
+        // cat-file carries on after a blob it can't find, so only give up
+        // on the search when it has stopped answering altogether.
+        if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND) ||
+            g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT)) {
+          g_debug ("Skipping %s at %s: %s", entry->path, revision, local_error->message);
+          g_clear_error (&local_error);
+        }
+
+        blob_job_free (job);
+        continue;
+      }
+
+      g_thread_pool_push (pool, job, NULL);
     }
+  }
 
-    if (g_strcmp0 (type, "end") == 0) {
-      llyfr_search_result_end (current_result);
-      g_list_store_append (results, current_result);
+  // Wait for whatever is still queued, scan_blob skips the lot once
+  // cancelled.
+  g_thread_pool_free (pool, FALSE, TRUE);
 
-      g_object_unref (current_result);
+  if (local_error != NULL) {
+    g_propagate_error (error, local_error);
+    goto out;
+  }
+
+  for (guint i = 0; i < duplicates->len; i += 3) {
+    LlyfrSearchResult *found = g_hash_table_lookup (scan.found, g_ptr_array_index (duplicates, i));
+    LlyfrSearchResult *copy;
+
+    if (found == NULL)
       continue;
-    }
 
-    g_debug ("Unhandled type: %s", type);
-    g_free (line);
+    copy = llyfr_search_result_copy (found, g_ptr_array_index (duplicates, i + 1));
+    llyfr_search_result_set_revision (copy, g_ptr_array_index (duplicates, i + 2));
+    llyfr_result_sink_push (data->sink, copy);
+  }
+
+  success = !g_cancellable_set_error_if_cancelled (cancellable, error);
+
+out:
+  g_hash_table_unref (scan.found);
+  g_mutex_clear (&scan.mutex);
+  g_cond_clear (&scan.cond);
+
+  return success;
+}
+
+/*
+ * Runs on a worker thread, leaving the backend to queue each result it
+ * finds on the sink which hands them to the main loop in batches. With an
+ * index, only the files it says could match are searched, otherwise those
+ * git is tracking, when there's a repository to ask.
+ */
+static void
+llyfr_search_context_search_thread (GTask        *task,
+                                    gpointer      source_object,
+                                    gpointer      task_data,
+                                    GCancellable *cancellable)
+{
+  g_autoptr(GPtrArray) files = NULL;
+  SearchData *data = task_data;
+  GError *error = NULL;
+  gint64 begin;
+
+  if (data->revisions != NULL) {
+    if (!llyfr_search_context_search_revisions (data, cancellable, &error))
+      g_task_return_error (task, error);
+    else
+      g_task_return_boolean (task, TRUE);
+
+    return;
+  }
+
+  begin = llyfr_trace_begin (data->trace);
+
+  if (data->index != NULL)
+    files = llyfr_trigram_index_find_candidates (data->index, data->query);
+
+  if (files == NULL && data->git_files)
+    files = llyfr_search_context_list_git_files (data->directory, cancellable);
+
+  llyfr_trace_end (data->trace, LLYFR_TRACE_LIST, begin);
+
+  if (files != NULL && files->len == 0) {
+    g_task_return_boolean (task, TRUE);
+    return;
+  }
+
+  if (!llyfr_search_backend_search (data->backend, data->directory, data->query,
+                                    files, data->threads, data->sink, data->arena,
+                                    cancellable, &error)) {
+    g_task_return_error (task, error);
+    return;
+  }
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void llyfr_search_context_start_search (GTask *task);
+
+/*
+ * Called once a search has finished, making room for the next one.
+ */
+static void
+llyfr_search_context_search_done (SearchData *data)
+{
+  guint max_running = llyfr_search_context_get_max_running_searches ();
+
+  if (!data->running)
+    return;
+
+  data->running = FALSE;
+  n_running_searches--;
+
+  if (data->timeout != NULL) {
+    g_source_destroy (data->timeout);
+    g_clear_pointer (&data->timeout, g_source_unref);
+  }
+
+  while (n_running_searches < max_running && !g_queue_is_empty (&waiting_searches))
+    llyfr_search_context_start_search (g_queue_pop_head (&waiting_searches));
+}
+
+static void
+llyfr_search_context_search_thread_cb (GObject      *object,
+                                       GAsyncResult *result,
+                                       gpointer      user_data)
+{
+  g_autoptr(GTask) task = G_TASK (user_data);
+  SearchData *data = g_task_get_task_data (task);
+  LlyfrSearchLimit limit;
+  GError *error = NULL;
+  gboolean success;
+
+  llyfr_search_context_search_done (data);
+
+  success = g_task_propagate_boolean (G_TASK (result), &error);
+  limit = llyfr_result_sink_get_limit (data->sink);
+
+  // Running out of budget stops the search the same way cancelling it
+  // would, but what was found is kept.
+  if (limit != LLYFR_SEARCH_LIMIT_NONE &&
+      !g_cancellable_is_cancelled (g_task_get_cancellable (task)) &&
+      (success || g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))) {
+    g_autofree gchar *message = llyfr_search_budget_describe (&data->budget, limit);
+
+    g_clear_error (&error);
+    llyfr_result_sink_flush (data->sink);
+    g_task_return_new_error (task,
+                             LLYFR_SEARCH_CONTEXT_ERROR,
+                             LLYFR_SEARCH_CONTEXT_ERROR_PARTIAL,
+                             "%s", message);
+    return;
+  }
+
+  if (!success) {
+    llyfr_result_sink_close (data->sink);
+    g_task_return_error (task, error);
+    return;
+  }
+
+  // Make sure the last batch has landed before telling anyone we're done.
+  llyfr_result_sink_flush (data->sink);
+  g_task_return_boolean (task, TRUE);
+}
+
+/*
+ * Once the search has run for as long as its budget allows, stop it where
+ * it is and keep what was found.
+ */
+static gboolean
+llyfr_search_context_timeout_cb (gpointer user_data)
+{
+  SearchData *data = user_data;
+
+  llyfr_result_sink_stop (data->sink, LLYFR_SEARCH_LIMIT_TIME);
+  g_clear_pointer (&data->timeout, g_source_unref);
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Start a search that has been given a slot, takes ownership of @task.
+ */
+static void
+llyfr_search_context_start_search (GTask *task)
+{
+  LlyfrSearchContext *context = g_task_get_source_object (task);
+  GCancellable *cancellable = g_task_get_cancellable (task);
+  SearchData *data = g_task_get_task_data (task);
+  GTask *thread_task;
+
+  // Given up on while waiting for its turn.
+  if (g_task_return_error_if_cancelled (task)) {
+    g_object_unref (task);
+    return;
   }
 
-  return G_LIST_MODEL(results);
+  data->threads = MAX (1, g_get_num_processors () / llyfr_search_context_get_max_running_searches ());
+  data->running = TRUE;
+  n_running_searches++;
+
+  if (data->queued != 0)
+    llyfr_trace_end (data->trace, LLYFR_TRACE_QUEUED, data->queued);
+
+  // Time spent waiting for a slot doesn't count.
+  if (data->budget.max_time > 0) {
+    data->timeout = g_timeout_source_new (data->budget.max_time);
+    g_source_set_callback (data->timeout, llyfr_search_context_timeout_cb, data, NULL);
+    g_source_attach (data->timeout, g_main_context_get_thread_default ());
+  }
+
+  thread_task = g_task_new (context, data->stop,
+                            llyfr_search_context_search_thread_cb,
+                            task);
+  g_task_set_task_data (thread_task, data, NULL);
+  g_task_run_in_thread (thread_task, llyfr_search_context_search_thread);
+  g_object_unref (thread_task);
+}
+
+/*
+ * Have @sink keep results in order of relevance, if enabled.
+ */
+static void
+llyfr_search_context_set_up_ranking (LlyfrSearchContext *context,
+                                     LlyfrResultSink    *sink)
+{
+  g_autoptr(LlyfrResultRanker) ranker = NULL;
+
+  if (!ranking_enabled)
+    return;
+
+  ranker = llyfr_result_ranker_new (llyfr_search_context_get_directory (context));
+  llyfr_result_sink_set_ranker (sink, ranker);
+}
+
+static void
+llyfr_search_context_cancelled_cb (GCancellable *cancellable,
+                                   GCancellable *stop)
+{
+  g_cancellable_cancel (stop);
+}
+
+void
+llyfr_search_context_search_async (LlyfrSearchContext  *context,
+                                   const gchar         *query,
+                                   GListStore          *results,
+                                   GCancellable        *cancellable,
+                                   GAsyncReadyCallback  callback,
+                                   gpointer             user_data)
+{
+  llyfr_search_context_search_full_async (context, query, &default_budget, NULL, results,
+                                          cancellable, callback, user_data);
+}
+
+/*
+ * Like llyfr_search_context_search_async(), but limited by @budget rather
+ * than the default. Should the search run out, it's stopped and finishes
+ * with LLYFR_SEARCH_CONTEXT_ERROR_PARTIAL, having added what it found to
+ * @results. Pass NULL to search without limits. The time spent on each
+ * stage of the search is added to @trace, if given.
+ */
+void
+llyfr_search_context_search_full_async (LlyfrSearchContext      *context,
+                                        const gchar             *query,
+                                        const LlyfrSearchBudget *budget,
+                                        LlyfrTrace              *trace,
+                                        GListStore              *results,
+                                        GCancellable            *cancellable,
+                                        GAsyncReadyCallback      callback,
+                                        gpointer                 user_data)
+{
+  GTask *task;
+  SearchData *data;
+
+  g_return_if_fail (LLYFR_IS_SEARCH_CONTEXT (context));
+  g_return_if_fail (G_IS_LIST_STORE (results));
+
+  task = g_task_new (context, cancellable, callback, user_data);
+  g_task_set_source_tag (task, llyfr_search_context_search_async);
+
+  data = g_new0 (SearchData, 1);
+  if (budget != NULL)
+    data->budget = *budget;
+
+  data->stop = g_cancellable_new ();
+  if (cancellable != NULL) {
+    data->cancellable = g_object_ref (cancellable);
+    data->cancelled_id = g_cancellable_connect (cancellable,
+                                                G_CALLBACK (llyfr_search_context_cancelled_cb),
+                                                data->stop,
+                                                NULL);
+  }
+
+  data->sink = llyfr_result_sink_new (results);
+  llyfr_result_sink_set_budget (data->sink, &data->budget, data->stop);
+  llyfr_result_sink_set_trace (data->sink, trace);
+  llyfr_search_context_set_up_ranking (context, data->sink);
+  data->trace = trace ? llyfr_trace_ref (trace) : NULL;
+  data->arena = llyfr_search_arena_new ();
+  data->backend = g_object_ref (llyfr_search_context_get_backend (context));
+  data->index = llyfr_search_context_get_index (context);
+  if (data->index != NULL)
+    g_object_ref (data->index);
+  data->directory = g_strdup (llyfr_search_context_get_directory (context));
+  data->query = g_strdup (query);
+  data->git_files = git_files_enabled;
+  data->revisions = g_strdupv ((gchar **) llyfr_search_context_get_revisions (context));
+  if (data->revisions != NULL)
+    data->object_reader = g_object_ref (llyfr_search_context_get_object_reader (context));
+  g_task_set_task_data (task, data, (GDestroyNotify) search_data_free);
+
+  if (n_running_searches < llyfr_search_context_get_max_running_searches ()) {
+    llyfr_search_context_start_search (task);
+    return;
+  }
+
+  g_debug ("%u searches running, queueing search of %s",
+           n_running_searches, llyfr_search_context_get_directory (context));
+  data->queued = llyfr_trace_begin (trace);
+  g_queue_push_tail (&waiting_searches, task);
+}
+
+/*
+ * The budget searches are given unless they're started with one of their
+ * own. By default there are no limits.
+ */
+const LlyfrSearchBudget*
+llyfr_search_context_get_default_budget (void)
+{
+  return &default_budget;
+}
+
+void
+llyfr_search_context_set_default_budget (const LlyfrSearchBudget *budget)
+{
+  g_return_if_fail (budget != NULL);
+
+  default_budget = *budget;
+}
+
+/*
+ * The number of searches allowed to run at once, across all contexts.
+ */
+guint
+llyfr_search_context_get_max_running_searches (void)
+{
+  if (max_running_searches == 0)
+    return MAX (1, g_get_num_processors () / 2);
+
+  return max_running_searches;
+}
+
+/*
+ * Pass 0 to go back to the default, half the number of CPUs.
+ */
+void
+llyfr_search_context_set_max_running_searches (guint max_running)
+{
+  max_running_searches = max_running;
+
+  while (n_running_searches < llyfr_search_context_get_max_running_searches () &&
+         !g_queue_is_empty (&waiting_searches))
+    llyfr_search_context_start_search (g_queue_pop_head (&waiting_searches));
+}
+
+gboolean
+llyfr_search_context_search_finish (LlyfrSearchContext  *context,
+                                    GAsyncResult        *result,
+                                    GError             **error)
+{
+  g_return_val_if_fail (LLYFR_IS_SEARCH_CONTEXT (context), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, context), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/*
+ * Whether the results for @query can be found by filtering those of
+ * @previous_query, rather than searching again. This holds when both are
+ * plain strings as far as rg is concerned and @query contains
+ * @previous_query, since any line containing @query must then already be in
+ * the previous results.
+ */
+gboolean
+llyfr_search_context_can_refine (LlyfrSearchContext *context,
+                                 const gchar *previous_query,
+                                 const gchar *query)
+{
+  gsize length;
+
+  g_return_val_if_fail (LLYFR_IS_SEARCH_CONTEXT (context), FALSE);
+
+  if (previous_query == NULL || *previous_query == '\0' || query == NULL)
+    return FALSE;
+
+  if (strpbrk (previous_query, REGEX_METACHARACTERS) != NULL ||
+      strpbrk (query, REGEX_METACHARACTERS) != NULL)
+    return FALSE;
+
+  // Trailing whitespace is trimmed from the lines we keep, so a match
+  // against it could have been lost.
+  length = strlen (query);
+  if (length == 0 || g_ascii_isspace (query[length - 1]))
+    return FALSE;
+
+  return strstr (query, previous_query) != NULL;
+}
+
+/*
+ * Search the file of @previous, which was truncated, for @query again,
+ * keeping no more lines than it did. Returns FALSE if the file can't be
+ * read, in which case all there is to go on is @previous itself.
+ */
+static gboolean
+llyfr_search_context_rescan (LlyfrSearchResult  *previous,
+                             LlyfrSearchArena   *arena,
+                             const gchar        *query,
+                             LlyfrSearchResult **refined)
+{
+  g_autoptr(LlyfrMatcher) matcher = NULL;
+  g_autofree gchar *contents = NULL;
+  guint max_lines = llyfr_search_result_get_n_matches (previous);
+  gsize size;
+
+  // Those from a revision would have to be read from git all over again.
+  if (llyfr_search_result_get_revision (previous) != NULL)
+    return FALSE;
+
+  if (!g_file_get_contents (llyfr_search_result_get_filepath (previous), &contents, &size, NULL))
+    return FALSE;
+
+  matcher = llyfr_matcher_new (query, NULL);
+  if (matcher == NULL)
+    return FALSE;
+
+  llyfr_matcher_set_max_lines (matcher, max_lines + 1);
+  *refined = llyfr_matcher_scan (matcher, arena, llyfr_search_result_get_filepath (previous),
+                                 contents, size);
+
+  if (*refined != NULL)
+    llyfr_search_result_truncate (*refined, max_lines);
+
+  return TRUE;
+}
+
+/*
+ * Runs on a worker thread, filtering each of the previous results and
+ * queuing whatever is left on the sink. Files that had lines left out are
+ * searched again, the lines that would match could be among them.
+ */
+static void
+llyfr_search_context_refine_thread (GTask        *task,
+                                    gpointer      source_object,
+                                    gpointer      task_data,
+                                    GCancellable *cancellable)
+{
+  SearchData *data = task_data;
+  gint64 scanned = 0;
+
+  for (guint i = 0; i < data->previous->len; i++) {
+    LlyfrSearchResult *previous = g_ptr_array_index (data->previous, i);
+    LlyfrSearchResult *refined = NULL;
+    gint64 begin = llyfr_trace_begin (data->trace);
+
+    if (g_task_return_error_if_cancelled (task))
+      break;
+
+    if (!llyfr_search_result_get_truncated (previous) ||
+        !llyfr_search_context_rescan (previous, data->arena, data->query, &refined))
+      refined = llyfr_search_result_refine (previous, data->arena, data->query);
+
+    if (data->trace != NULL)
+      scanned += g_get_monotonic_time () - begin;
+
+    if (refined != NULL)
+      llyfr_result_sink_push (data->sink, refined);
+  }
+
+  llyfr_trace_add (data->trace, LLYFR_TRACE_SCAN, scanned);
+
+  if (!g_task_had_error (task))
+    g_task_return_boolean (task, TRUE);
+}
+
+/*
+ * Like llyfr_search_context_search_async() but rather than searching, the
+ * results are found by filtering @previous, the complete results of an
+ * earlier search. Only valid when llyfr_search_context_can_refine() says
+ * so, finish with llyfr_search_context_search_finish().
+ */
+void
+llyfr_search_context_refine_async (LlyfrSearchContext  *context,
+                                   GListModel          *previous,
+                                   const gchar         *query,
+                                   LlyfrTrace          *trace,
+                                   GListStore          *results,
+                                   GCancellable        *cancellable,
+                                   GAsyncReadyCallback  callback,
+                                   gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(GTask) thread_task = NULL;
+  guint n_previous;
+  SearchData *data;
+
+  g_return_if_fail (LLYFR_IS_SEARCH_CONTEXT (context));
+  g_return_if_fail (G_IS_LIST_MODEL (previous));
+  g_return_if_fail (G_IS_LIST_STORE (results));
+
+  task = g_task_new (context, cancellable, callback, user_data);
+  g_task_set_source_tag (task, llyfr_search_context_refine_async);
+
+  // The previous model is only safe to read from the main thread, so take a
+  // copy of what's in it for the worker.
+  n_previous = g_list_model_get_n_items (previous);
+
+  data = g_new0 (SearchData, 1);
+  data->sink = llyfr_result_sink_new (results);
+  llyfr_result_sink_set_trace (data->sink, trace);
+  llyfr_search_context_set_up_ranking (context, data->sink);
+  data->trace = trace ? llyfr_trace_ref (trace) : NULL;
+  data->arena = llyfr_search_arena_new ();
+  data->previous = g_ptr_array_new_full (n_previous, g_object_unref);
+  data->query = g_strdup (query);
+  g_task_set_task_data (task, data, (GDestroyNotify) search_data_free);
+
+  for (guint i = 0; i < n_previous; i++)
+    g_ptr_array_add (data->previous, g_list_model_get_item (previous, i));
+
+  thread_task = g_task_new (context, cancellable,
+                            llyfr_search_context_search_thread_cb,
+                            g_steal_pointer (&task));
+  g_task_set_task_data (thread_task, data, NULL);
+  g_task_run_in_thread (thread_task, llyfr_search_context_refine_thread);
 }
 
 const gchar*
@@ -170,6 +926,179 @@ llyfr_search_context_set_directory (LlyfrSearchContext *context,
 
   g_clear_pointer (&priv->directory, g_free);
   priv->directory = g_strdup (directory);
+
+  // The index is of the old directory.
+  g_clear_object (&priv->index);
+
+  if (priv->object_reader != NULL) {
+    llyfr_git_object_reader_close (priv->object_reader);
+    g_clear_object (&priv->object_reader);
+  }
+}
+
+/*
+ * The revisions searched by this context, or NULL when searches look at the
+ * working tree.
+ */
+const gchar * const *
+llyfr_search_context_get_revisions (LlyfrSearchContext *context)
+{
+  LlyfrSearchContextPrivate *priv = llyfr_search_context_get_instance_private (context);
+
+  return (const gchar * const *) priv->revisions;
+}
+
+/*
+ * Search the trees of @revisions, anything git rev-parse understands, in
+ * place of the working tree. Pass NULL, or an empty list, to go back to the
+ * working tree.
+ */
+void
+llyfr_search_context_set_revisions (LlyfrSearchContext *context,
+                                    const gchar * const *revisions)
+{
+  LlyfrSearchContextPrivate *priv = llyfr_search_context_get_instance_private (context);
+
+  g_clear_pointer (&priv->revisions, g_strfreev);
+
+  if (revisions != NULL && revisions[0] != NULL)
+    priv->revisions = g_strdupv ((gchar **) revisions);
+}
+
+/*
+ * The reader revision searches get their trees and blobs through. Its
+ * cat-file process is started on first use and then kept for the life of
+ * the context.
+ */
+LlyfrGitObjectReader*
+llyfr_search_context_get_object_reader (LlyfrSearchContext *context)
+{
+  LlyfrSearchContextPrivate *priv = llyfr_search_context_get_instance_private (context);
+
+  if (priv->object_reader == NULL)
+    priv->object_reader = llyfr_git_object_reader_new (llyfr_search_context_get_directory (context));
+
+  return priv->object_reader;
+}
+
+/*
+ * The backend searches of this context are run with, which is the default
+ * backend unless one has been set.
+ */
+LlyfrSearchBackend*
+llyfr_search_context_get_backend (LlyfrSearchContext *context)
+{
+  LlyfrSearchContextPrivate *priv = llyfr_search_context_get_instance_private (context);
+
+  if (priv->backend != NULL)
+    return priv->backend;
+
+  return llyfr_search_context_get_default_backend ();
+}
+
+void
+llyfr_search_context_set_backend (LlyfrSearchContext *context,
+                                  LlyfrSearchBackend *backend)
+{
+  LlyfrSearchContextPrivate *priv = llyfr_search_context_get_instance_private (context);
+
+  g_set_object (&priv->backend, backend);
+}
+
+/*
+ * Backends are only ever used from the main thread and the workers running
+ * their searches, each search holding a reference to its own.
+ */
+LlyfrSearchBackend*
+llyfr_search_context_get_default_backend (void)
+{
+  if (default_backend == NULL)
+    default_backend = llyfr_rg_backend_new ();
+
+  return default_backend;
+}
+
+/*
+ * Pass NULL to go back to running rg. Searches already started carry on
+ * with the backend they started with.
+ */
+void
+llyfr_search_context_set_default_backend (LlyfrSearchBackend *backend)
+{
+  g_set_object (&default_backend, backend);
+}
+
+/*
+ * Whether contexts keep a trigram index of their directory, to narrow down
+ * the files searched.
+ */
+gboolean
+llyfr_search_context_get_indexing_enabled (void)
+{
+  return indexing_enabled;
+}
+
+void
+llyfr_search_context_set_indexing_enabled (gboolean enabled)
+{
+  indexing_enabled = enabled;
+}
+
+/*
+ * Whether the files to search, and index, in a git repository are the ones
+ * git is tracking, read from its index. This skips everything ignored
+ * without the cost of walking it first.
+ */
+gboolean
+llyfr_search_context_get_git_files_enabled (void)
+{
+  return git_files_enabled;
+}
+
+void
+llyfr_search_context_set_git_files_enabled (gboolean enabled)
+{
+  git_files_enabled = enabled;
+}
+
+/*
+ * Whether results are ordered by how relevant they look, rather than in
+ * the order they're found.
+ */
+gboolean
+llyfr_search_context_get_ranking_enabled (void)
+{
+  return ranking_enabled;
+}
+
+void
+llyfr_search_context_set_ranking_enabled (gboolean enabled)
+{
+  ranking_enabled = enabled;
+}
+
+/*
+ * The context's index, or NULL when indexing is turned off. The index is
+ * loaded and brought up to date in the background the first time it's
+ * asked for, until then searches go without.
+ */
+LlyfrTrigramIndex*
+llyfr_search_context_get_index (LlyfrSearchContext *context)
+{
+  LlyfrSearchContextPrivate *priv = llyfr_search_context_get_instance_private (context);
+
+  if (!indexing_enabled || priv->directory == NULL)
+    return NULL;
+
+  if (priv->index == NULL) {
+    priv->index = llyfr_trigram_index_new (priv->directory);
+    llyfr_trigram_index_set_git_files (priv->index, git_files_enabled);
+    llyfr_trigram_index_update (priv->index);
+  } else {
+    llyfr_trigram_index_set_git_files (priv->index, git_files_enabled);
+  }
+
+  return priv->index;
 }
 
 static void
@@ -185,6 +1114,14 @@ llyfr_search_context_get_property (GObject    *object,
       g_value_set_string (value, llyfr_search_context_get_directory (self));
       break;
 
+    case PROP_BACKEND:
+      g_value_set_object (value, llyfr_search_context_get_backend (self));
+      break;
+
+    case PROP_REVISIONS:
+      g_value_set_boxed (value, llyfr_search_context_get_revisions (self));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -203,6 +1140,14 @@ llyfr_search_context_set_property (GObject      *object,
       llyfr_search_context_set_directory (self, g_value_get_string (value));
       break;
 
+    case PROP_BACKEND:
+      llyfr_search_context_set_backend (self, g_value_get_object (value));
+      break;
+
+    case PROP_REVISIONS:
+      llyfr_search_context_set_revisions (self, g_value_get_boxed (value));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -215,6 +1160,14 @@ llyfr_search_context_finalize (GObject *object)
   LlyfrSearchContextPrivate *priv = llyfr_search_context_get_instance_private (self);
 
   g_free (priv->directory);
+  g_clear_object (&priv->backend);
+  g_clear_object (&priv->index);
+  g_clear_pointer (&priv->revisions, g_strfreev);
+
+  if (priv->object_reader != NULL) {
+    llyfr_git_object_reader_close (priv->object_reader);
+    g_clear_object (&priv->object_reader);
+  }
 
   G_OBJECT_CLASS (llyfr_search_context_parent_class)->finalize (object);
 }
@@ -237,6 +1190,22 @@ llyfr_search_context_class_init (LlyfrSearchContextClass *klass)
                                                         NULL,
                                                         G_PARAM_READWRITE));
 
+  g_object_class_install_property (object_class,
+                                   PROP_BACKEND,
+                                   g_param_spec_object ("backend",
+                                                        "Backend",
+                                                        "What searches are run with, the default backend if unset",
+                                                        LLYFR_TYPE_SEARCH_BACKEND,
+                                                        G_PARAM_READWRITE));
+
+  g_object_class_install_property (object_class,
+                                   PROP_REVISIONS,
+                                   g_param_spec_boxed ("revisions",
+                                                       "Revisions",
+                                                       "The git revisions searched in place of the working tree",
+                                                       G_TYPE_STRV,
+                                                       G_PARAM_READWRITE));
+
 }
 
 void
@@ -245,4 +1214,5 @@ llyfr_search_context_init (LlyfrSearchContext *self)
   LlyfrSearchContextPrivate *priv = llyfr_search_context_get_instance_private (self);
 
   priv->directory = NULL;
+  priv->backend = NULL;
 }
@@ -26,10 +26,25 @@
 #include <glib-object.h>
 #include <json-glib/json-glib.h>
 
+#include "llyfr-git-object-reader.h"
+#include "llyfr-search-backend.h"
+#include "llyfr-search-budget.h"
+#include "llyfr-trace.h"
+#include "llyfr-trigram-index.h"
+
 G_BEGIN_DECLS
 
 #define LLYFR_TYPE_SEARCH_CONTEXT (llyfr_search_context_get_type())
 
+#define LLYFR_SEARCH_CONTEXT_ERROR (llyfr_search_context_error_quark ())
+
+typedef enum
+{
+  LLYFR_SEARCH_CONTEXT_ERROR_PARTIAL,
+} LlyfrSearchContextError;
+
+GQuark llyfr_search_context_error_quark (void);
+
 G_DECLARE_DERIVABLE_TYPE (LlyfrSearchContext, llyfr_search_context, LLYFR, SEARCH_CONTEXT, GObject)
 
 struct _LlyfrSearchContextClass
@@ -44,10 +59,81 @@ const gchar*        llyfr_search_context_get_directory (LlyfrSearchContext *cont
 void                llyfr_search_context_set_directory (LlyfrSearchContext *context,
                                                         const gchar *directory);
 
+LlyfrSearchBackend* llyfr_search_context_get_backend   (LlyfrSearchContext *context);
+
+void                llyfr_search_context_set_backend   (LlyfrSearchContext *context,
+                                                        LlyfrSearchBackend *backend);
+
+const gchar * const * llyfr_search_context_get_revisions (LlyfrSearchContext *context);
+
+void                llyfr_search_context_set_revisions (LlyfrSearchContext *context,
+                                                        const gchar * const *revisions);
+
+LlyfrGitObjectReader* llyfr_search_context_get_object_reader (LlyfrSearchContext *context);
+
+LlyfrSearchBackend* llyfr_search_context_get_default_backend (void);
+
+void                llyfr_search_context_set_default_backend (LlyfrSearchBackend *backend);
+
 GListModel*         llyfr_search_context_search        (LlyfrSearchContext *context,
                                                         const gchar* query,
                                                         GError **error);
 
+void                llyfr_search_context_search_async  (LlyfrSearchContext  *context,
+                                                        const gchar         *query,
+                                                        GListStore          *results,
+                                                        GCancellable        *cancellable,
+                                                        GAsyncReadyCallback  callback,
+                                                        gpointer             user_data);
+
+void                llyfr_search_context_search_full_async (LlyfrSearchContext      *context,
+                                                            const gchar             *query,
+                                                            const LlyfrSearchBudget *budget,
+                                                            LlyfrTrace              *trace,
+                                                            GListStore              *results,
+                                                            GCancellable            *cancellable,
+                                                            GAsyncReadyCallback      callback,
+                                                            gpointer                 user_data);
+
+gboolean            llyfr_search_context_search_finish (LlyfrSearchContext  *context,
+                                                        GAsyncResult        *result,
+                                                        GError             **error);
+
+LlyfrTrigramIndex*  llyfr_search_context_get_index     (LlyfrSearchContext *context);
+
+gboolean            llyfr_search_context_get_indexing_enabled (void);
+
+void                llyfr_search_context_set_indexing_enabled (gboolean enabled);
+
+gboolean            llyfr_search_context_get_ranking_enabled (void);
+
+void                llyfr_search_context_set_ranking_enabled (gboolean enabled);
+
+gboolean            llyfr_search_context_get_git_files_enabled (void);
+
+void                llyfr_search_context_set_git_files_enabled (gboolean enabled);
+
+const LlyfrSearchBudget* llyfr_search_context_get_default_budget (void);
+
+void                llyfr_search_context_set_default_budget (const LlyfrSearchBudget *budget);
+
+guint               llyfr_search_context_get_max_running_searches (void);
+
+void                llyfr_search_context_set_max_running_searches (guint max_running);
+
+gboolean            llyfr_search_context_can_refine    (LlyfrSearchContext  *context,
+                                                        const gchar         *previous_query,
+                                                        const gchar         *query);
+
+void                llyfr_search_context_refine_async  (LlyfrSearchContext  *context,
+                                                        GListModel          *previous,
+                                                        const gchar         *query,
+                                                        LlyfrTrace          *trace,
+                                                        GListStore          *results,
+                                                        GCancellable        *cancellable,
+                                                        GAsyncReadyCallback  callback,
+                                                        gpointer             user_data);
+
 G_END_DECLS
 
 #endif /* LLYFR_SEARCH_CONTEXT_H */
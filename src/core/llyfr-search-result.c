@@ -20,18 +20,49 @@
 
 #define G_LOG_DOMAIN "llyfr-search-result"
 
+#include <string.h>
+
+#include "llyfr-memory-stats.h"
 #include "llyfr-search-result.h"
 
-#include "llyfr-search-match.h"
+/*
+ * Matches are packed into a single block of the search's arena once the
+ * result ends. The block holds one record per match (plus a sentinel so
+ * lengths can be worked out from the following record), then all of the
+ * highlight spans, then the text of every line, each NUL terminated.
+ */
+typedef struct
+{
+  gint64   line_number;
+  guint32  text_offset;
+  guint32  highlight_offset;
+} LlyfrSearchRecord;
 
 struct _LlyfrSearchResult
 {
-  GObject          parent_instance;
+  GObject                  parent_instance;
+
+  gchar                   *filepath;
+
+  // The git revision the file was read at, NULL for the working tree.
+  gchar                   *revision;
+
+  // Set by the ranker, results are kept in descending order of it.
+  gdouble                  score;
 
-  gchar           *filepath;
-  GList           *matches;
+  LlyfrSearchArena        *arena;
+  const LlyfrSearchRecord *records;
+  const LlyfrSearchSpan   *spans;
+  const gchar             *text;
+  guint                    n_matches;
 
-  GtkTextBuffer   *buffer;
+  // Set when the file had more matching lines than were kept.
+  gboolean                 truncated;
+
+  // Only used while matches are still being added.
+  GArray                  *pending_records;
+  GArray                  *pending_spans;
+  GByteArray              *pending_text;
 };
 
 G_DEFINE_TYPE (LlyfrSearchResult, llyfr_search_result, G_TYPE_OBJECT)
@@ -40,6 +71,7 @@ enum
 {
   PROP_0,
   PROP_FILEPATH,
+  PROP_REVISION,
   LAST_PROP
 };
 
@@ -57,12 +89,44 @@ static gint64      parse_match_line_number (JsonReader *reader);
 
 static const char* parse_match_text        (JsonReader *reader);
 
+/*
+ * Add (@sign of 1) or remove (-1) the matches held by @result to the
+ * memory counters, once they've been packed.
+ */
+static void
+account_matches (LlyfrSearchResult *result,
+                 gssize sign)
+{
+  const LlyfrSearchRecord *sentinel = &result->records[result->n_matches];
+
+  llyfr_memory_stats_add (LLYFR_MEMORY_MATCHES, sign * result->n_matches);
+  llyfr_memory_stats_add (LLYFR_MEMORY_TEXT_BYTES, sign * sentinel->text_offset);
+  llyfr_memory_stats_add (LLYFR_MEMORY_HIGHLIGHT_BYTES,
+                          sign * (gssize) (sentinel->highlight_offset * sizeof (LlyfrSearchSpan)));
+}
+
 LlyfrSearchResult*
 llyfr_search_result_new (const char* filepath)
 {
-  return g_object_new (LLYFR_TYPE_SEARCH_RESULT,
-                       "filepath", filepath,
-                       NULL);
+  return llyfr_search_result_new_in_arena (NULL, filepath);
+}
+
+/*
+ * Create a result whose matches will be stored in @arena, or in an arena of
+ * its own when @arena is NULL.
+ */
+LlyfrSearchResult*
+llyfr_search_result_new_in_arena (LlyfrSearchArena *arena,
+                                  const char* filepath)
+{
+  LlyfrSearchResult *result = g_object_new (LLYFR_TYPE_SEARCH_RESULT,
+                                            "filepath", filepath,
+                                            NULL);
+
+  if (arena != NULL)
+    result->arena = llyfr_search_arena_ref (arena);
+
+  return result;
 }
 
 LlyfrSearchResult*
@@ -80,13 +144,12 @@ llyfr_search_result_add_match (LlyfrSearchResult *result,
                                JsonNode *node)
 {
   g_autoptr (JsonReader) reader = json_reader_new (node);
+  g_autoptr (GArray) highlights = g_array_new (FALSE, FALSE, sizeof (gint64));
   parse_check_type (reader, "match");
 
   const char *line = parse_match_text (reader);
   gint64 line_number = parse_match_line_number (reader);
 
-  LlyfrSearchMatch *match = llyfr_search_match_new (line_number, line);
-
   g_assert (json_reader_read_member (reader, "data"));
   g_assert (json_reader_read_member (reader, "submatches"));
   g_assert (json_reader_is_array (reader));
@@ -98,16 +161,293 @@ llyfr_search_result_add_match (LlyfrSearchResult *result,
     parse_match_highlight (reader, &start, &end);
     json_reader_end_element (reader);
 
-    llyfr_search_match_add_highlight (match, start, end);
+    g_array_append_val (highlights, start);
+    g_array_append_val (highlights, end);
+  }
+
+  llyfr_search_result_add_match_full (result, line_number, line,
+                                      (const gint64 *) highlights->data,
+                                      highlights->len / 2);
+}
+
+/*
+ * Add a matching line to @result, @highlights holds @n_highlights pairs of
+ * (start, end) byte offsets into @text. Trailing whitespace is dropped from
+ * the line.
+ */
+void
+llyfr_search_result_add_match_full (LlyfrSearchResult *result,
+                                    gint64 line_number,
+                                    const gchar *text,
+                                    const gint64 *highlights,
+                                    guint n_highlights)
+{
+  LlyfrSearchRecord record;
+  gsize length;
+
+  g_return_if_fail (LLYFR_IS_SEARCH_RESULT (result));
+  g_return_if_fail (result->records == NULL);
+
+  if (result->pending_records == NULL) {
+    result->pending_records = g_array_new (FALSE, FALSE, sizeof (LlyfrSearchRecord));
+    result->pending_spans = g_array_new (FALSE, FALSE, sizeof (LlyfrSearchSpan));
+    result->pending_text = g_byte_array_new ();
+  }
+
+  if (text == NULL)
+    text = "";
+
+  length = strlen (text);
+  while (length > 0 && g_ascii_isspace (text[length - 1]))
+    length--;
+
+  record.line_number = line_number;
+  record.text_offset = result->pending_text->len;
+  record.highlight_offset = result->pending_spans->len;
+  g_array_append_val (result->pending_records, record);
+
+  g_byte_array_append (result->pending_text, (const guint8 *) text, length);
+  g_byte_array_append (result->pending_text, (const guint8 *) "", 1);
+
+  for (guint i = 0; i < n_highlights; i++) {
+    LlyfrSearchSpan span;
+
+    span.start = MIN ((gsize) MAX (highlights[2 * i], 0), length);
+    span.end = MIN ((gsize) MAX (highlights[2 * i + 1], 0), length);
+
+    if (span.start < span.end)
+      g_array_append_val (result->pending_spans, span);
+  }
+}
+
+/*
+ * Moves @offset, a byte offset into the valid UTF-8 @text, back to the
+ * start of the character it falls in, or on to its end when @forward.
+ */
+static gint64
+snap_to_char (const gchar *text,
+              gsize length,
+              gint64 offset,
+              gboolean forward)
+{
+  offset = CLAMP (offset, 0, (gint64) length);
+
+  if (forward) {
+    while (offset < (gint64) length && (text[offset] & 0xc0) == 0x80)
+      offset++;
+  } else {
+    while (offset > 0 && (text[offset] & 0xc0) == 0x80)
+      offset--;
+  }
+
+  return offset;
+}
+
+/*
+ * Returns a copy of @length bytes of @text that is valid UTF-8, each
+ * invalid byte replaced by U+FFFD as g_utf8_make_valid() does, and moves
+ * the @n_highlights pairs of byte offsets in @highlights along with it.
+ * Highlights that start or end part way through a character are widened
+ * to take in all of it, so they never split one.
+ */
+gchar*
+llyfr_search_result_make_valid (const gchar *text,
+                                gsize length,
+                                gint64 *highlights,
+                                guint n_highlights)
+{
+  g_autofree gsize *offsets = NULL;
+  const gchar *remainder = text;
+  gsize remaining = length;
+  GString *valid;
+
+  if (g_utf8_validate (text, length, NULL)) {
+    for (guint i = 0; i < n_highlights; i++) {
+      highlights[2 * i] = snap_to_char (text, length, highlights[2 * i], FALSE);
+      highlights[2 * i + 1] = snap_to_char (text, length, highlights[2 * i + 1], TRUE);
+    }
+
+    return g_strndup (text, length);
+  }
+
+  // Where each byte of @text ends up in the new string.
+  offsets = g_new (gsize, length + 1);
+  valid = g_string_sized_new (length + 8);
+
+  for (;;) {
+    const gchar *invalid;
+    gsize n_valid;
+
+    g_utf8_validate (remainder, remaining, &invalid);
+    n_valid = invalid - remainder;
+
+    for (gsize i = 0; i < n_valid; i++)
+      offsets[remainder - text + i] = valid->len + i;
+
+    g_string_append_len (valid, remainder, n_valid);
+    if (n_valid == remaining)
+      break;
+
+    offsets[invalid - text] = valid->len;
+    g_string_append (valid, "\357\277\275");
+
+    remaining -= n_valid + 1;
+    remainder = invalid + 1;
+  }
+
+  offsets[length] = valid->len;
+
+  for (guint i = 0; i < n_highlights; i++) {
+    gint64 start = CLAMP (highlights[2 * i], 0, (gint64) length);
+    gint64 end = CLAMP (highlights[2 * i + 1], 0, (gint64) length);
+
+    highlights[2 * i] = snap_to_char (valid->str, valid->len, offsets[start], FALSE);
+    highlights[2 * i + 1] = snap_to_char (valid->str, valid->len, offsets[end], TRUE);
   }
 
-  result->matches = g_list_prepend (result->matches, match);
+  return g_string_free (valid, FALSE);
 }
 
+/*
+ * Called once every match has been added, packs the matches into the
+ * arena after which they can be read back through the accessors.
+ */
 void
 llyfr_search_result_end (LlyfrSearchResult *result)
 {
-  result->matches = g_list_reverse (result->matches);
+  LlyfrSearchRecord sentinel;
+  gsize records_size, spans_size;
+  guint8 *block;
+
+  g_return_if_fail (LLYFR_IS_SEARCH_RESULT (result));
+
+  if (result->pending_records == NULL || result->records != NULL)
+    return;
+
+  if (result->arena == NULL)
+    result->arena = llyfr_search_arena_new ();
+
+  sentinel.line_number = -1;
+  sentinel.text_offset = result->pending_text->len;
+  sentinel.highlight_offset = result->pending_spans->len;
+
+  result->n_matches = result->pending_records->len;
+  g_array_append_val (result->pending_records, sentinel);
+
+  records_size = result->pending_records->len * sizeof (LlyfrSearchRecord);
+  spans_size = result->pending_spans->len * sizeof (LlyfrSearchSpan);
+
+  block = llyfr_search_arena_alloc (result->arena,
+                                    records_size + spans_size + result->pending_text->len);
+
+  memcpy (block, result->pending_records->data, records_size);
+  memcpy (block + records_size, result->pending_spans->data, spans_size);
+  memcpy (block + records_size + spans_size, result->pending_text->data, result->pending_text->len);
+
+  result->records = (const LlyfrSearchRecord *) block;
+  result->spans = (const LlyfrSearchSpan *) (block + records_size);
+  result->text = (const gchar *) (block + records_size + spans_size);
+
+  g_clear_pointer (&result->pending_records, g_array_unref);
+  g_clear_pointer (&result->pending_spans, g_array_unref);
+  g_clear_pointer (&result->pending_text, g_byte_array_unref);
+
+  account_matches (result, 1);
+}
+
+/*
+ * Build a new result holding only the lines of @result that contain
+ * @literal, highlighting each occurrence the way rg would for the same
+ * query. Returns NULL when none of the lines match.
+ *
+ * This is only the same as searching again for @literal when every line
+ * that could match it is already in @result, for instance when @literal
+ * contains the query that produced it. Lines that matched after @result
+ * was truncated can't be, so what's refined from it is marked truncated
+ * too.
+ */
+LlyfrSearchResult*
+llyfr_search_result_refine (LlyfrSearchResult *result,
+                            LlyfrSearchArena *arena,
+                            const gchar *literal)
+{
+  LlyfrSearchResult *refined = NULL;
+  g_autoptr(GArray) highlights = NULL;
+  gsize literal_length;
+
+  g_return_val_if_fail (LLYFR_IS_SEARCH_RESULT (result), NULL);
+  g_return_val_if_fail (literal != NULL && *literal != '\0', NULL);
+
+  literal_length = strlen (literal);
+  highlights = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+  for (guint index = 0; index < result->n_matches; index++) {
+    const gchar *text = result->text + result->records[index].text_offset;
+    const gchar *found = strstr (text, literal);
+
+    if (found == NULL)
+      continue;
+
+    g_array_set_size (highlights, 0);
+
+    // Occurrences don't overlap, matching how rg reports a literal.
+    while (found != NULL) {
+      gint64 start = found - text;
+      gint64 end = start + literal_length;
+
+      g_array_append_val (highlights, start);
+      g_array_append_val (highlights, end);
+
+      found = strstr (found + literal_length, literal);
+    }
+
+    if (refined == NULL) {
+      refined = llyfr_search_result_new_in_arena (arena, result->filepath);
+      llyfr_search_result_set_revision (refined, result->revision);
+    }
+
+    llyfr_search_result_add_match_full (refined,
+                                        result->records[index].line_number,
+                                        text,
+                                        (const gint64 *) highlights->data,
+                                        highlights->len / 2);
+  }
+
+  if (refined != NULL) {
+    llyfr_search_result_end (refined);
+    refined->truncated = result->truncated;
+  }
+
+  return refined;
+}
+
+/*
+ * A result with the same matches as @result, which must have ended, found
+ * in @filepath instead. The matches aren't copied, both results share the
+ * block they are packed into.
+ */
+LlyfrSearchResult*
+llyfr_search_result_copy (LlyfrSearchResult *result,
+                          const gchar *filepath)
+{
+  LlyfrSearchResult *copy;
+
+  g_return_val_if_fail (LLYFR_IS_SEARCH_RESULT (result), NULL);
+  g_return_val_if_fail (result->pending_records == NULL, NULL);
+
+  copy = llyfr_search_result_new_in_arena (result->arena, filepath);
+  copy->revision = g_strdup (result->revision);
+  copy->score = result->score;
+  copy->records = result->records;
+  copy->spans = result->spans;
+  copy->text = result->text;
+  copy->n_matches = result->n_matches;
+  copy->truncated = result->truncated;
+
+  if (copy->records != NULL)
+    account_matches (copy, 1);
+
+  return copy;
 }
 
 const gchar*
@@ -124,58 +464,165 @@ llyfr_search_result_set_filepath (LlyfrSearchResult *result,
   result->filepath = g_strdup (filepath);
 }
 
-GList*
-llyfr_search_result_get_matches (LlyfrSearchResult *self)
+/*
+ * The revision the matches were found at, or NULL if they were found in the
+ * working tree.
+ */
+const gchar*
+llyfr_search_result_get_revision (LlyfrSearchResult *result)
 {
-  return self->matches;
+  return result->revision;
 }
 
+void
+llyfr_search_result_set_revision (LlyfrSearchResult *result,
+                                  const gchar *revision)
+{
+  g_clear_pointer (&result->revision, g_free);
+  result->revision = g_strdup (revision);
+}
 
-GtkTextBuffer*
-llyfr_search_result_get_text_buffer (LlyfrSearchResult *self)
+/*
+ * How relevant the result is thought to be, see LlyfrResultRanker.
+ */
+gdouble
+llyfr_search_result_get_score (LlyfrSearchResult *result)
 {
+  return result->score;
+}
 
-  if (self->buffer)
-    return self->buffer;
+void
+llyfr_search_result_set_score (LlyfrSearchResult *result,
+                               gdouble score)
+{
+  result->score = score;
+}
 
-  self->buffer = gtk_text_buffer_new (NULL);
-  gtk_text_buffer_insert_at_cursor (self->buffer, "\n", -1);
-  gtk_text_buffer_create_tag (self->buffer, "highlighted",
-                              "background", "#268bd2",
-                              "foreground", "white",
-                              NULL);
+guint
+llyfr_search_result_get_n_matches (LlyfrSearchResult *self)
+{
+  return self->n_matches;
+}
 
+/*
+ * Keep only the first @n_matches matches of @result, which must have ended,
+ * marking it as truncated if that leaves any out.
+ */
+void
+llyfr_search_result_truncate (LlyfrSearchResult *result,
+                              guint n_matches)
+{
+  g_return_if_fail (LLYFR_IS_SEARCH_RESULT (result));
+  g_return_if_fail (result->pending_records == NULL);
+
+  if (n_matches >= result->n_matches)
+    return;
+
+  // The record after the last one kept marks where its text ends, so
+  // nothing needs moving.
+  account_matches (result, -1);
+  result->n_matches = n_matches;
+  result->truncated = TRUE;
+  account_matches (result, 1);
+}
 
-  for (GList *matches = self->matches; matches != NULL; matches = matches->next) {
-    GtkTextIter start, end;
-    LlyfrSearchMatch *match = matches->data;
+/*
+ * Whether the file had more matching lines than @result holds.
+ */
+gboolean
+llyfr_search_result_get_truncated (LlyfrSearchResult *result)
+{
+  return result->truncated;
+}
 
-    const gchar* text = llyfr_search_match_get_text (match);
-    GArray *highlights = llyfr_search_match_get_highlights (match);
+/*
+ * What to show above the matches of @result: its path, after the revision
+ * it was found at if there is one, and whether some of its matching lines
+ * were left out.
+ */
+gchar*
+llyfr_search_result_dup_header (LlyfrSearchResult *result)
+{
+  GString *header = g_string_new (NULL);
 
-    // TODO: Add line numbers to the start of a line.
-    gtk_text_buffer_insert_at_cursor (self->buffer, text, -1);
-    gtk_text_buffer_insert_at_cursor (self->buffer, "\n", -1);
+  g_return_val_if_fail (LLYFR_IS_SEARCH_RESULT (result), NULL);
 
-    if (highlights == NULL || highlights->len == 0)
-      continue;
+  if (result->revision != NULL)
+    g_string_append_printf (header, "%s: ", result->revision);
 
-    for (guint index = 0; index < highlights->len; index += 2) {
-      gtk_text_buffer_get_end_iter (self->buffer, &start);
-      gtk_text_iter_backward_line (&start);
-      end = start;
+  g_string_append (header, llyfr_search_result_get_filepath (result));
 
-      gint64 start_offset = g_array_index (highlights, gint64, index);
-      gint64 end_offset = g_array_index (highlights, gint64, index + 1);
+  if (result->truncated)
+    g_string_append_printf (header, " (only the first %u matching lines)", result->n_matches);
 
-      gtk_text_iter_forward_chars (&start, start_offset);
-      gtk_text_iter_forward_chars (&end, end_offset);
+  return g_string_free (header, FALSE);
+}
 
-      gtk_text_buffer_apply_tag_by_name (self->buffer, "highlighted", &start, &end);
-    }
+/*
+ * An estimate of the memory held by @self, including its share of the
+ * search's arena.
+ */
+gsize
+llyfr_search_result_get_size (LlyfrSearchResult *self)
+{
+  gsize size = sizeof (LlyfrSearchResult);
+
+  if (self->filepath != NULL)
+    size += strlen (self->filepath) + 1;
+
+  if (self->revision != NULL)
+    size += strlen (self->revision) + 1;
+
+  if (self->records != NULL) {
+    const LlyfrSearchRecord *sentinel = &self->records[self->n_matches];
+
+    size += (self->n_matches + 1) * sizeof (LlyfrSearchRecord);
+    size += sentinel->highlight_offset * sizeof (LlyfrSearchSpan);
+    size += sentinel->text_offset;
   }
 
-  return self->buffer;
+  return size;
+}
+
+gint64
+llyfr_search_result_get_match_line_number (LlyfrSearchResult *self,
+                                           guint index)
+{
+  g_return_val_if_fail (index < self->n_matches, -1);
+
+  return self->records[index].line_number;
+}
+
+const gchar*
+llyfr_search_result_get_match_text (LlyfrSearchResult *self,
+                                    guint index,
+                                    gsize *length)
+{
+  const LlyfrSearchRecord *record;
+
+  g_return_val_if_fail (index < self->n_matches, NULL);
+
+  record = &self->records[index];
+  if (length != NULL)
+    *length = record[1].text_offset - record->text_offset - 1;
+
+  return self->text + record->text_offset;
+}
+
+const LlyfrSearchSpan*
+llyfr_search_result_get_match_highlights (LlyfrSearchResult *self,
+                                          guint index,
+                                          guint *n_highlights)
+{
+  const LlyfrSearchRecord *record;
+
+  g_return_val_if_fail (index < self->n_matches, NULL);
+
+  record = &self->records[index];
+  if (n_highlights != NULL)
+    *n_highlights = record[1].highlight_offset - record->highlight_offset;
+
+  return self->spans + record->highlight_offset;
 }
 
 static void
@@ -192,6 +639,10 @@ llyfr_search_result_get_property (GObject    *object,
       g_value_set_string (value, llyfr_search_result_get_filepath (self));
       break;
 
+    case PROP_REVISION:
+      g_value_set_string (value, llyfr_search_result_get_revision (self));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
     }
@@ -211,6 +662,10 @@ llyfr_search_result_set_property (GObject      *object,
       llyfr_search_result_set_filepath (self, g_value_get_string (value));
       break;
 
+    case PROP_REVISION:
+      llyfr_search_result_set_revision (self, g_value_get_string (value));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
     }
@@ -221,9 +676,17 @@ llyfr_search_result_finalize (GObject *object)
 {
   LlyfrSearchResult *self = LLYFR_SEARCH_RESULT (object);
 
+  if (self->records != NULL)
+    account_matches (self, -1);
+
+  llyfr_memory_stats_add (LLYFR_MEMORY_RESULTS, -1);
+
   g_free (self->filepath);
-  g_list_free_full (self->matches, g_object_unref);
-  g_object_unref (self->buffer);
+  g_free (self->revision);
+  g_clear_pointer (&self->pending_records, g_array_unref);
+  g_clear_pointer (&self->pending_spans, g_array_unref);
+  g_clear_pointer (&self->pending_text, g_byte_array_unref);
+  g_clear_pointer (&self->arena, llyfr_search_arena_unref);
 
   G_OBJECT_CLASS (llyfr_search_result_parent_class)->finalize (object);
 }
@@ -244,12 +707,20 @@ llyfr_search_result_class_init (LlyfrSearchResultClass *klass)
                                                         "Filepath that contains one or more search matches",
                                                         NULL,
                                                         G_PARAM_READWRITE));
+
+  g_object_class_install_property (object_class,
+                                   PROP_REVISION,
+                                   g_param_spec_string ("revision",
+                                                        "Revision",
+                                                        "The git revision the matches were found at, if not the working tree",
+                                                        NULL,
+                                                        G_PARAM_READWRITE));
 }
 
 static void
 llyfr_search_result_init (LlyfrSearchResult *self)
 {
-
+  llyfr_memory_stats_add (LLYFR_MEMORY_RESULTS, 1);
 }
 
 static void
@@ -23,32 +23,91 @@
 
 #include <glib.h>
 #include <glib-object.h>
-#include <gtk/gtk.h>
 #include <json-glib/json-glib.h>
 
+#include "llyfr-search-arena.h"
+
 G_BEGIN_DECLS
 
 #define LLYFR_TYPE_SEARCH_RESULT (llyfr_search_result_get_type())
 
 G_DECLARE_FINAL_TYPE (LlyfrSearchResult, llyfr_search_result, LLYFR, SEARCH_RESULT, GObject)
 
-LlyfrSearchResult* llyfr_search_result_new              (const char *filepath);
+/*
+ * A highlighted region of a matching line, as byte offsets into its text.
+ */
+typedef struct
+{
+  guint32 start;
+  guint32 end;
+} LlyfrSearchSpan;
+
+LlyfrSearchResult*     llyfr_search_result_new                    (const char *filepath);
+
+LlyfrSearchResult*     llyfr_search_result_new_in_arena           (LlyfrSearchArena *arena,
+                                                                   const char *filepath);
+
+LlyfrSearchResult*     llyfr_search_result_new_from_json          (JsonNode *node);
+
+void                   llyfr_search_result_add_match              (LlyfrSearchResult *result,
+                                                                   JsonNode *node);
+
+void                   llyfr_search_result_add_match_full         (LlyfrSearchResult *result,
+                                                                   gint64 line_number,
+                                                                   const gchar *text,
+                                                                   const gint64 *highlights,
+                                                                   guint n_highlights);
+
+gchar*                 llyfr_search_result_make_valid             (const gchar *text,
+                                                                   gsize length,
+                                                                   gint64 *highlights,
+                                                                   guint n_highlights);
+
+void                   llyfr_search_result_end                    (LlyfrSearchResult *result);
+
+LlyfrSearchResult*     llyfr_search_result_refine                 (LlyfrSearchResult *result,
+                                                                   LlyfrSearchArena *arena,
+                                                                   const gchar *literal);
+
+LlyfrSearchResult*     llyfr_search_result_copy                   (LlyfrSearchResult *result,
+                                                                   const gchar *filepath);
+
+guint                  llyfr_search_result_get_n_matches          (LlyfrSearchResult *result);
+
+void                   llyfr_search_result_truncate               (LlyfrSearchResult *result,
+                                                                   guint n_matches);
+
+gboolean               llyfr_search_result_get_truncated          (LlyfrSearchResult *result);
+
+gchar*                 llyfr_search_result_dup_header             (LlyfrSearchResult *result);
+
+gsize                  llyfr_search_result_get_size               (LlyfrSearchResult *result);
+
+gint64                 llyfr_search_result_get_match_line_number  (LlyfrSearchResult *result,
+                                                                   guint index);
+
+const gchar*           llyfr_search_result_get_match_text         (LlyfrSearchResult *result,
+                                                                   guint index,
+                                                                   gsize *length);
 
-LlyfrSearchResult* llyfr_search_result_new_from_json    (JsonNode *node);
+const LlyfrSearchSpan* llyfr_search_result_get_match_highlights   (LlyfrSearchResult *result,
+                                                                   guint index,
+                                                                   guint *n_highlights);
 
-void               llyfr_search_result_add_match        (LlyfrSearchResult *result,
-                                                         JsonNode *node);
+const gchar*           llyfr_search_result_get_filepath           (LlyfrSearchResult *result);
 
-GList*             llyfr_search_result_get_matches      (LlyfrSearchResult *result);
+void                   llyfr_search_result_set_filepath           (LlyfrSearchResult *result,
+                                                                   const gchar* filepath);
 
-void               llyfr_search_result_end              (LlyfrSearchResult *result);
+const gchar*           llyfr_search_result_get_revision           (LlyfrSearchResult *result);
 
-const gchar*       llyfr_search_result_get_filepath     (LlyfrSearchResult *result);
+gdouble                llyfr_search_result_get_score              (LlyfrSearchResult *result);
 
-void               llyfr_search_result_set_filepath     (LlyfrSearchResult *result,
-                                                         const gchar* filepath);
+void                   llyfr_search_result_set_score              (LlyfrSearchResult *result,
+                                                                   gdouble score);
 
-GtkTextBuffer*     llyfr_search_result_get_text_buffer  (LlyfrSearchResult *result);
+void                   llyfr_search_result_set_revision           (LlyfrSearchResult *result,
+                                                                   const gchar *revision);
 
 G_END_DECLS
 
@@ -0,0 +1,316 @@
+/* llyfr-trace.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-trace"
+
+#include "llyfr-config.h"
+
+#if HAVE_SYSPROF
+#include <sysprof-capture.h>
+#endif
+
+#include "llyfr-trace.h"
+
+/*
+ * Where the time goes in a search. A trace is shared by everything that
+ * takes part in one, from the backend's thread to the rows drawing the
+ * results, each adding the time it spends to one of the stages.
+ *
+ * Spans that happen a handful of times per search (starting rg, a batch
+ * of results being added to the model) go through llyfr_trace_end() and
+ * also become marks in a sysprof capture when we're being profiled. Spans
+ * that happen once per line are summed by the caller and added with
+ * llyfr_trace_add(), thousands of marks would only drown out the rest.
+ *
+ * Tracing costs a couple of clock reads per line, so it's off unless
+ * turned on or we're running under sysprof.
+ */
+
+#define MAX_RECENT 10
+
+struct _LlyfrTrace
+{
+  gatomicrefcount  ref_count;
+
+  gchar           *name;
+  gint64           start;
+  gint64           end;
+
+  GMutex           lock;
+  gint64           stages[LLYFR_TRACE_N_STAGES];
+};
+
+G_DEFINE_BOXED_TYPE (LlyfrTrace, llyfr_trace, llyfr_trace_ref, llyfr_trace_unref)
+
+static gint enabled = FALSE;
+
+// The last few traces to finish, newest first.
+static GMutex recent_lock;
+static GQueue recent = G_QUEUE_INIT;
+
+static const gchar * const stage_names[LLYFR_TRACE_N_STAGES] = {
+  [LLYFR_TRACE_QUEUED]  = "Queued",
+  [LLYFR_TRACE_LIST]    = "Listing files",
+  [LLYFR_TRACE_SPAWN]   = "Spawning rg",
+  [LLYFR_TRACE_STARTUP] = "rg start-up",
+  [LLYFR_TRACE_RG]      = "Waiting on rg",
+  [LLYFR_TRACE_DECODE]  = "Decoding",
+  [LLYFR_TRACE_BUILD]   = "Building results",
+  [LLYFR_TRACE_SCAN]    = "Scanning",
+  [LLYFR_TRACE_SPLICE]  = "Adding to model",
+  [LLYFR_TRACE_TEXT]    = "Row text",
+};
+
+static gboolean
+llyfr_trace_is_profiling (void)
+{
+#if HAVE_SYSPROF
+  static gsize profiling = 0;
+
+  // sysprof hands the capture to the processes it starts through this.
+  if (g_once_init_enter (&profiling))
+    g_once_init_leave (&profiling, g_getenv ("SYSPROF_TRACE_FD") != NULL ? 2 : 1);
+
+  return profiling == 2;
+#else
+  return FALSE;
+#endif
+}
+
+/*
+ * Whether new searches should be traced.
+ */
+gboolean
+llyfr_trace_get_enabled (void)
+{
+  return g_atomic_int_get (&enabled) || llyfr_trace_is_profiling ();
+}
+
+void
+llyfr_trace_set_enabled (gboolean value)
+{
+  g_atomic_int_set (&enabled, value);
+}
+
+const gchar*
+llyfr_trace_stage_to_string (LlyfrTraceStage stage)
+{
+  g_return_val_if_fail (stage < LLYFR_TRACE_N_STAGES, NULL);
+
+  return stage_names[stage];
+}
+
+LlyfrTrace*
+llyfr_trace_new (const gchar *name)
+{
+  LlyfrTrace *trace = g_new0 (LlyfrTrace, 1);
+
+  g_atomic_ref_count_init (&trace->ref_count);
+  g_mutex_init (&trace->lock);
+  trace->name = g_strdup (name);
+  trace->start = g_get_monotonic_time ();
+
+  return trace;
+}
+
+LlyfrTrace*
+llyfr_trace_ref (LlyfrTrace *trace)
+{
+  g_return_val_if_fail (trace != NULL, NULL);
+
+  g_atomic_ref_count_inc (&trace->ref_count);
+  return trace;
+}
+
+void
+llyfr_trace_unref (LlyfrTrace *trace)
+{
+  g_return_if_fail (trace != NULL);
+
+  if (!g_atomic_ref_count_dec (&trace->ref_count))
+    return;
+
+  g_mutex_clear (&trace->lock);
+  g_free (trace->name);
+  g_free (trace);
+}
+
+static void
+llyfr_trace_mark (LlyfrTrace  *trace,
+                  const gchar *mark,
+                  gint64       begin,
+                  gint64       duration)
+{
+#if HAVE_SYSPROF
+  if (!llyfr_trace_is_profiling ())
+    return;
+
+  // Both count from the same monotonic clock, in ns and us respectively.
+  sysprof_collector_mark (begin * 1000, duration * 1000, "llyfrgell", mark, "%s", trace->name);
+#endif
+}
+
+/*
+ * The start of a span, to be given to llyfr_trace_end(). Does nothing when
+ * @trace is NULL, so callers needn't check whether they're being traced.
+ */
+gint64
+llyfr_trace_begin (LlyfrTrace *trace)
+{
+  if (trace == NULL)
+    return 0;
+
+  return g_get_monotonic_time ();
+}
+
+/*
+ * Add the time since @begin to @stage. Safe to call from any thread.
+ */
+void
+llyfr_trace_end (LlyfrTrace      *trace,
+                 LlyfrTraceStage  stage,
+                 gint64           begin)
+{
+  gint64 duration;
+
+  if (trace == NULL)
+    return;
+
+  g_return_if_fail (stage < LLYFR_TRACE_N_STAGES);
+
+  duration = g_get_monotonic_time () - begin;
+  llyfr_trace_add (trace, stage, duration);
+  llyfr_trace_mark (trace, stage_names[stage], begin, duration);
+}
+
+/*
+ * Add @duration, in microseconds, to @stage without leaving a mark. Safe to
+ * call from any thread.
+ */
+void
+llyfr_trace_add (LlyfrTrace      *trace,
+                 LlyfrTraceStage  stage,
+                 gint64           duration)
+{
+  if (trace == NULL)
+    return;
+
+  g_return_if_fail (stage < LLYFR_TRACE_N_STAGES);
+
+  g_mutex_lock (&trace->lock);
+  trace->stages[stage] += duration;
+  g_mutex_unlock (&trace->lock);
+}
+
+/*
+ * Mark the end of whatever @trace was following, and add it to the list of
+ * recent traces. Stages can still be added to afterwards, the text of the
+ * results is built for as long as they're on screen.
+ */
+void
+llyfr_trace_finish (LlyfrTrace *trace)
+{
+  if (trace == NULL)
+    return;
+
+  g_mutex_lock (&trace->lock);
+
+  if (trace->end != 0) {
+    g_mutex_unlock (&trace->lock);
+    return;
+  }
+
+  trace->end = g_get_monotonic_time ();
+  g_mutex_unlock (&trace->lock);
+
+  llyfr_trace_mark (trace, "Search", trace->start, trace->end - trace->start);
+
+  g_mutex_lock (&recent_lock);
+
+  g_queue_push_head (&recent, llyfr_trace_ref (trace));
+  while (recent.length > MAX_RECENT)
+    llyfr_trace_unref (g_queue_pop_tail (&recent));
+
+  g_mutex_unlock (&recent_lock);
+}
+
+const gchar*
+llyfr_trace_get_name (LlyfrTrace *trace)
+{
+  g_return_val_if_fail (trace != NULL, NULL);
+
+  return trace->name;
+}
+
+/*
+ * Microseconds from @trace being created to it finishing, or to now if it
+ * hasn't yet.
+ */
+gint64
+llyfr_trace_get_duration (LlyfrTrace *trace)
+{
+  gint64 end;
+
+  g_return_val_if_fail (trace != NULL, 0);
+
+  g_mutex_lock (&trace->lock);
+  end = trace->end != 0 ? trace->end : g_get_monotonic_time ();
+  g_mutex_unlock (&trace->lock);
+
+  return end - trace->start;
+}
+
+/*
+ * Microseconds spent in @stage. Stages run on several threads at once can
+ * add up to more than the trace's duration.
+ */
+gint64
+llyfr_trace_get_stage (LlyfrTrace      *trace,
+                       LlyfrTraceStage  stage)
+{
+  gint64 duration;
+
+  g_return_val_if_fail (trace != NULL, 0);
+  g_return_val_if_fail (stage < LLYFR_TRACE_N_STAGES, 0);
+
+  g_mutex_lock (&trace->lock);
+  duration = trace->stages[stage];
+  g_mutex_unlock (&trace->lock);
+
+  return duration;
+}
+
+/*
+ * The last few traces to finish, newest first.
+ */
+GPtrArray*
+llyfr_trace_get_recent (void)
+{
+  GPtrArray *traces = g_ptr_array_new_with_free_func ((GDestroyNotify) llyfr_trace_unref);
+
+  g_mutex_lock (&recent_lock);
+
+  for (GList *l = recent.head; l != NULL; l = l->next)
+    g_ptr_array_add (traces, llyfr_trace_ref (l->data));
+
+  g_mutex_unlock (&recent_lock);
+
+  return traces;
+}
@@ -0,0 +1,99 @@
+/* llyfr-trace.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_TRACE_H
+#define LLYFR_TRACE_H
+
+#include <glib.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define LLYFR_TYPE_TRACE (llyfr_trace_get_type())
+
+/*
+ * The stages a search's time is split into.
+ */
+typedef enum
+{
+  // Waiting for one of the running searches to finish.
+  LLYFR_TRACE_QUEUED,
+  // Asking the index or git which files to search.
+  LLYFR_TRACE_LIST,
+  // Starting rg, through flatpak-spawn when sandboxed.
+  LLYFR_TRACE_SPAWN,
+  // From rg starting to its first line of output.
+  LLYFR_TRACE_STARTUP,
+  // Waiting on rg for the rest of its output.
+  LLYFR_TRACE_RG,
+  LLYFR_TRACE_DECODE,
+  // Creating results and adding matches to them.
+  LLYFR_TRACE_BUILD,
+  // Reading and matching files in process, or reading directories.
+  LLYFR_TRACE_SCAN,
+  // Adding results to the model, items-changed handlers included.
+  LLYFR_TRACE_SPLICE,
+  // Building the text rows draw.
+  LLYFR_TRACE_TEXT,
+  LLYFR_TRACE_N_STAGES,
+} LlyfrTraceStage;
+
+typedef struct _LlyfrTrace LlyfrTrace;
+
+GType        llyfr_trace_get_type          (void) G_GNUC_CONST;
+
+gboolean     llyfr_trace_get_enabled       (void);
+
+void         llyfr_trace_set_enabled       (gboolean enabled);
+
+const gchar* llyfr_trace_stage_to_string   (LlyfrTraceStage stage);
+
+LlyfrTrace*  llyfr_trace_new               (const gchar *name);
+
+LlyfrTrace*  llyfr_trace_ref               (LlyfrTrace *trace);
+
+void         llyfr_trace_unref             (LlyfrTrace *trace);
+
+gint64       llyfr_trace_begin             (LlyfrTrace *trace);
+
+void         llyfr_trace_end               (LlyfrTrace *trace,
+                                            LlyfrTraceStage stage,
+                                            gint64 begin);
+
+void         llyfr_trace_add               (LlyfrTrace *trace,
+                                            LlyfrTraceStage stage,
+                                            gint64 duration);
+
+void         llyfr_trace_finish            (LlyfrTrace *trace);
+
+const gchar* llyfr_trace_get_name          (LlyfrTrace *trace);
+
+gint64       llyfr_trace_get_duration      (LlyfrTrace *trace);
+
+gint64       llyfr_trace_get_stage         (LlyfrTrace *trace,
+                                            LlyfrTraceStage stage);
+
+GPtrArray*   llyfr_trace_get_recent        (void);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (LlyfrTrace, llyfr_trace_unref)
+
+G_END_DECLS
+
+#endif /* LLYFR_TRACE_H */
@@ -0,0 +1,1467 @@
+/* llyfr-trigram-index.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-trigram-index"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+#include "llyfr-git-files.h"
+#include "llyfr-matcher.h"
+#include "llyfr-rg-backend.h"
+#include "llyfr-trigram-index.h"
+
+/*
+ * An index of which files contain which trigrams, three byte sequences, so
+ * that a search only has to read the files that could possibly match. Every
+ * match of "search" contains "sea", "ear", "arc" and "rch", so only the
+ * files containing all four need to be looked at.
+ *
+ * The index is a single serialised GVariant in the user's cache directory,
+ * mapped straight into memory. Next to the posting lists it records the
+ * modification time of every file indexed, and of whatever would change
+ * were files added or removed: every directory and ignore file when walking
+ * the tree, or just .git/index when the files come from git. A walk only
+ * keeps the files rg would search itself, since rg is handed the candidates
+ * by name and doesn't apply its ignore rules to those. Files changed since
+ * are always searched, and should the list of files have changed it isn't
+ * used at all. Either way an update is started in the background, which only
+ * reads the files that have changed.
+ */
+
+#define INDEX_VERSION 1
+
+// (version, time built, [(file, mtime, size)], [(watched path, mtime)],
+//  sorted trigrams, offset of each trigram's postings, postings)
+#define INDEX_TYPE    "(uxa(sxx)a(sx)auauau)"
+
+// Files up to this size are read rather than mapped.
+#define MAX_READ_SIZE (64 * 1024)
+
+// Building an index reads the whole repository, so don't do too many at once.
+#define MAX_BUILDS 2
+
+#define N_TRIGRAMS (1 << 24)
+
+struct _LlyfrTrigramIndex
+{
+  GObject                 parent_instance;
+
+  gchar                  *directory;
+  gchar                  *filename;
+  GMainContext           *context;
+
+  LlyfrTrigramIndexState  state;
+  gint                    update_queued;
+  gboolean                git_files;
+
+  // Searches read the index from other threads.
+  GMutex                  lock;
+  GVariant               *data;
+};
+
+G_DEFINE_TYPE (LlyfrTrigramIndex, llyfr_trigram_index, G_TYPE_OBJECT)
+
+enum
+{
+  PROP_0,
+  PROP_DIRECTORY,
+  PROP_STATE,
+  PROP_GIT_FILES,
+  LAST_PROP
+};
+
+static GParamSpec *properties[LAST_PROP];
+
+static GThreadPool *build_pool = NULL;
+
+typedef struct
+{
+  gchar    *path;
+  gint64    mtime;
+  gint64    size;
+} IndexEntry;
+
+typedef struct
+{
+  gchar    *directory;
+  gchar    *filename;
+  GVariant *previous;
+  gboolean  git_files;
+
+  GArray   *files;
+  GArray   *directories;
+} BuildData;
+
+GType
+llyfr_trigram_index_state_get_type (void)
+{
+  static gsize type_id = 0;
+
+  if (g_once_init_enter (&type_id)) {
+    static const GEnumValue values[] = {
+      { LLYFR_TRIGRAM_INDEX_MISSING, "LLYFR_TRIGRAM_INDEX_MISSING", "missing" },
+      { LLYFR_TRIGRAM_INDEX_BUILDING, "LLYFR_TRIGRAM_INDEX_BUILDING", "building" },
+      { LLYFR_TRIGRAM_INDEX_FRESH, "LLYFR_TRIGRAM_INDEX_FRESH", "fresh" },
+      { LLYFR_TRIGRAM_INDEX_STALE, "LLYFR_TRIGRAM_INDEX_STALE", "stale" },
+      { 0, NULL, NULL }
+    };
+    GType type = g_enum_register_static ("LlyfrTrigramIndexState", values);
+
+    g_once_init_leave (&type_id, type);
+  }
+
+  return type_id;
+}
+
+static void
+index_entry_clear (IndexEntry *entry)
+{
+  g_free (entry->path);
+}
+
+static void
+build_data_free (BuildData *data)
+{
+  g_free (data->directory);
+  g_free (data->filename);
+  g_clear_pointer (&data->previous, g_variant_unref);
+  g_clear_pointer (&data->files, g_array_unref);
+  g_clear_pointer (&data->directories, g_array_unref);
+
+  g_free (data);
+}
+
+static gint64
+stat_mtime (const struct stat *buf)
+{
+  return (gint64) buf->st_mtim.tv_sec * G_USEC_PER_SEC + buf->st_mtim.tv_nsec / 1000;
+}
+
+static gint
+compare_uint32 (gconstpointer a,
+                  gconstpointer b)
+{
+  guint32 x = *(const guint32 *) a;
+  guint32 y = *(const guint32 *) b;
+
+  return (x > y) - (x < y);
+}
+
+/*
+ * Whether the posting lists of @data can be followed without reading past
+ * the end of anything. The file could have been cut short or corrupted,
+ * and GVariant only promises that the arrays are arrays.
+ */
+static gboolean
+llyfr_trigram_index_check (GVariant *data)
+{
+  g_autoptr(GVariant) trigrams_v = g_variant_get_child_value (data, 4);
+  g_autoptr(GVariant) offsets_v = g_variant_get_child_value (data, 5);
+  g_autoptr(GVariant) postings_v = g_variant_get_child_value (data, 6);
+  const guint32 *trigrams, *offsets;
+  gsize n_trigrams, n_offsets, n_postings;
+
+  trigrams = g_variant_get_fixed_array (trigrams_v, &n_trigrams, sizeof (guint32));
+  offsets = g_variant_get_fixed_array (offsets_v, &n_offsets, sizeof (guint32));
+  g_variant_get_fixed_array (postings_v, &n_postings, sizeof (guint32));
+
+  if (n_offsets != n_trigrams + 1)
+    return FALSE;
+
+  // Trigrams are looked up with bsearch().
+  for (gsize i = 1; i < n_trigrams; i++) {
+    if (trigrams[i - 1] >= trigrams[i])
+      return FALSE;
+  }
+
+  for (gsize i = 0; i < n_trigrams; i++) {
+    if (offsets[i] > offsets[i + 1])
+      return FALSE;
+  }
+
+  return offsets[n_trigrams] <= n_postings;
+}
+
+static GVariant*
+llyfr_trigram_index_load (const gchar *filename,
+                          GError **error)
+{
+  g_autoptr(GMappedFile) file = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GVariant) data = NULL;
+  guint32 version;
+
+  file = g_mapped_file_new (filename, FALSE, error);
+  if (file == NULL)
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (file);
+  data = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (INDEX_TYPE), bytes, FALSE));
+
+  g_variant_get_child (data, 0, "u", &version);
+  if (version != INDEX_VERSION) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                 "Unsupported index version %u", version);
+    return NULL;
+  }
+
+  if (!llyfr_trigram_index_check (data)) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                 "The index is corrupt");
+    return NULL;
+  }
+
+  return g_steal_pointer (&data);
+}
+
+/*
+ * Add each trigram in @contents not already marked in @seen to @found.
+ * Matches never span lines, so neither do trigrams.
+ */
+static void
+llyfr_trigram_index_scan (const guint8 *contents,
+                          gsize size,
+                          guint8 *seen,
+                          GArray *found)
+{
+  guint32 trigram = 0;
+  guint n = 0;
+
+  for (gsize i = 0; i < size; i++) {
+    if (contents[i] == '\n') {
+      n = 0;
+      continue;
+    }
+
+    trigram = ((trigram << 8) | contents[i]) & (N_TRIGRAMS - 1);
+    if (++n < 3)
+      continue;
+
+    if (seen[trigram >> 3] & (1 << (trigram & 7)))
+      continue;
+
+    seen[trigram >> 3] |= 1 << (trigram & 7);
+    g_array_append_val (found, trigram);
+  }
+}
+
+/*
+ * Skip a bracketed argument starting at @p, returning its last character.
+ */
+static const gchar*
+skip_bracketed (const gchar *p)
+{
+  gchar close = *p == '{' ? '}' : *p == '<' ? '>' : '\'';
+
+  while (p[1] != '\0' && *++p != close)
+    ;
+
+  return p;
+}
+
+/*
+ * Skip up to @max characters after @p that are hex digits, or digits when
+ * @decimal, returning the last character skipped.
+ */
+static const gchar*
+skip_digits (const gchar *p,
+             guint max,
+             gboolean decimal)
+{
+  for (guint i = 0; i < max; i++) {
+    if (decimal ? !g_ascii_isdigit (p[1]) : !g_ascii_isxdigit (p[1]))
+      break;
+
+    p++;
+  }
+
+  return p;
+}
+
+/*
+ * Skip an escape, @p points at the character after the backslash. Returns
+ * the escape's last character.
+ */
+static const gchar*
+skip_escape (const gchar *p)
+{
+  switch (*p) {
+    case 'x':
+      // \xHH or \x{HHHH}
+      if (p[1] == '{')
+        return skip_bracketed (p + 1);
+      return skip_digits (p, 2, FALSE);
+
+    case 'u':
+      if (p[1] == '{')
+        return skip_bracketed (p + 1);
+      return skip_digits (p, 4, FALSE);
+
+    case 'U':
+      return skip_digits (p, 8, FALSE);
+
+    case 'o':
+      // \o{OOO}
+      if (p[1] == '{')
+        return skip_bracketed (p + 1);
+      return p;
+
+    case 'p':
+    case 'P':
+      // \pL or \p{Greek}
+      if (p[1] == '{')
+        return skip_bracketed (p + 1);
+      return p[1] != '\0' ? p + 1 : p;
+
+    case 'N':
+    case 'k':
+    case 'g':
+      // \N{name}, \k<name>, \k'name', \g{-1}, \g1
+      if (p[1] == '{' || p[1] == '<' || p[1] == '\'')
+        return skip_bracketed (p + 1);
+      if (p[1] == '-')
+        p++;
+      return skip_digits (p, G_MAXUINT, TRUE);
+
+    case 'c':
+      // \cX
+      return p[1] != '\0' ? p + 1 : p;
+
+    default:
+      // Octal \0, \012 and backreferences \1, \12
+      if (g_ascii_isdigit (*p))
+        return skip_digits (p, 2, TRUE);
+      return p;
+  }
+}
+
+/*
+ * Skip the bracket expression starting at @p, returning its closing ]. A ]
+ * straight after the [ or ^ is part of it, as are the ]s of POSIX classes
+ * such as [:digit:], [=a=] and [.-.]. Returns NULL for anything we can't
+ * be sure of, like a nested class or rg's set operations, since a class
+ * that ends early would turn the rest of it into literals.
+ */
+static const gchar*
+skip_class (const gchar *p)
+{
+  p++;
+  if (*p == '^')
+    p++;
+  if (*p == ']')
+    p++;
+
+  for (; *p != ']'; p++) {
+    switch (*p) {
+      case '\0':
+        return NULL;
+
+      case '\\':
+        if (p[1] == '\0')
+          return NULL;
+        p = g_ascii_ispunct (p[1]) ? p + 1 : skip_escape (p + 1);
+        break;
+
+      case '[': {
+        const gchar close[] = { p[1], ']', '\0' };
+
+        if (p[1] != ':' && p[1] != '=' && p[1] != '.')
+          return NULL;
+
+        p = strstr (p + 2, close);
+        if (p == NULL)
+          return NULL;
+
+        p++;
+        break;
+      }
+
+      case '&':
+      case '-':
+      case '~':
+        // [a&&b], [a--b] and [a~~b]
+        if (p[1] == *p)
+          return NULL;
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  return p;
+}
+
+/*
+ * The trigrams every match of @query must contain, or NULL if there's no
+ * telling. Regular expressions are only taken apart as far as runs of
+ * literal characters outside any group, anything cleverer (alternation,
+ * flags) gives up. Giving up is always safe, the one thing this mustn't
+ * do is ask for a trigram that a match of @query could do without.
+ */
+GArray*
+llyfr_trigram_index_extract (const gchar *query)
+{
+  g_autoptr(GByteArray) run = g_byte_array_new ();
+  g_autoptr(GArray) trigrams = g_array_new (FALSE, FALSE, sizeof (guint32));
+  g_autofree guint8 *seen = NULL;
+  guint depth = 0;
+
+  if (strstr (query, "(?") != NULL || strchr (query, '|') != NULL)
+    return NULL;
+
+  seen = g_malloc0 (N_TRIGRAMS / 8);
+
+  for (const gchar *p = query; ; p++) {
+    gboolean literal = FALSE;
+    guint8 c = *p;
+
+    switch (c) {
+      case '\0':
+        break;
+
+      case '{':
+        // Take {n,m} as a whole, we don't care how many.
+        while (p[1] != '\0' && *p != '}')
+          p++;
+        G_GNUC_FALLTHROUGH;
+
+      case '?':
+      case '*':
+        // The character before is optional.
+        if (run->len > 0)
+          g_byte_array_set_size (run, run->len - 1);
+        break;
+
+      case '+':
+        // Needed at least once, but whatever follows needn't be next to it.
+        break;
+
+      case '(':
+        depth++;
+        break;
+
+      case ')':
+        if (depth > 0)
+          depth--;
+        break;
+
+      case '[':
+        p = skip_class (p);
+        if (p == NULL)
+          return NULL;
+        break;
+
+      case '\\':
+        // Escaped punctuation stands for itself. Anything else is a class,
+        // an assertion or a character given some other way, none of which
+        // can be part of a run, and whatever follows the letter is part of
+        // the escape rather than the pattern.
+        if (p[1] != '\0' && g_ascii_ispunct (p[1])) {
+          c = *++p;
+          literal = TRUE;
+        } else if (p[1] != '\0') {
+          p = skip_escape (p + 1);
+        }
+        break;
+
+      case '.':
+      case '^':
+      case '$':
+        break;
+
+      default:
+        literal = TRUE;
+    }
+
+    if (literal && depth == 0) {
+      g_byte_array_append (run, &c, 1);
+      continue;
+    }
+
+    llyfr_trigram_index_scan (run->data, run->len, seen, trigrams);
+    g_byte_array_set_size (run, 0);
+
+    if (*p == '\0')
+      break;
+  }
+
+  return g_steal_pointer (&trigrams);
+}
+
+/*
+ * Record the modification time of @relative, if it exists, so the index is
+ * rebuilt should it change.
+ */
+static void
+llyfr_trigram_index_watch (BuildData   *data,
+                           const gchar *relative)
+{
+  g_autofree gchar *path = g_build_filename (data->directory, relative, NULL);
+  IndexEntry watched;
+  struct stat buf;
+
+  if (stat (path, &buf) != 0)
+    return;
+
+  watched.path = g_strdup (relative);
+  watched.mtime = stat_mtime (&buf);
+  watched.size = 0;
+  g_array_append_val (data->directories, watched);
+}
+
+/*
+ * Walk @directory, adding every file and directory in it to @data.
+ * Hidden files are skipped and symlinks aren't followed. Ignore files are
+ * watched, since changing them changes which files rg would search.
+ */
+static void
+llyfr_trigram_index_walk (BuildData   *data,
+                          const gchar *relative)
+{
+  g_autofree gchar *path = g_build_filename (data->directory, relative, NULL);
+  g_autoptr(GPtrArray) subdirs = NULL;
+  struct dirent *entry;
+  struct stat buf;
+  IndexEntry dir_entry;
+  DIR *dir;
+  int fd;
+
+  fd = open (path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (fd < 0 || fstat (fd, &buf) != 0 || (dir = fdopendir (fd)) == NULL) {
+    if (fd >= 0)
+      close (fd);
+
+    return;
+  }
+
+  dir_entry.path = g_strdup (relative);
+  dir_entry.mtime = stat_mtime (&buf);
+  dir_entry.size = 0;
+  g_array_append_val (data->directories, dir_entry);
+
+  subdirs = g_ptr_array_new_with_free_func (g_free);
+
+  while ((entry = readdir (dir)) != NULL) {
+    IndexEntry file_entry;
+
+    if (g_str_equal (entry->d_name, ".gitignore") ||
+        g_str_equal (entry->d_name, ".ignore") ||
+        g_str_equal (entry->d_name, ".rgignore")) {
+      g_autofree gchar *ignore = g_build_filename (relative, entry->d_name, NULL);
+
+      llyfr_trigram_index_watch (data, ignore);
+      continue;
+    }
+
+    // Also covers . and ..
+    if (entry->d_name[0] == '.')
+      continue;
+
+    if (fstatat (dirfd (dir), entry->d_name, &buf, AT_SYMLINK_NOFOLLOW) != 0)
+      continue;
+
+    if (S_ISDIR (buf.st_mode)) {
+      g_ptr_array_add (subdirs, g_build_filename (relative, entry->d_name, NULL));
+      continue;
+    }
+
+    if (!S_ISREG (buf.st_mode))
+      continue;
+
+    file_entry.path = g_build_filename (relative, entry->d_name, NULL);
+    file_entry.mtime = stat_mtime (&buf);
+    file_entry.size = buf.st_size;
+    g_array_append_val (data->files, file_entry);
+  }
+
+  closedir (dir);
+
+  for (guint i = 0; i < subdirs->len; i++)
+    llyfr_trigram_index_walk (data, g_ptr_array_index (subdirs, i));
+}
+
+/*
+ * Drop the files rg would leave out from those the walk found. Should rg
+ * not be there to ask, they're all kept, which is what the native backend
+ * searches anyway.
+ */
+static void
+llyfr_trigram_index_drop_ignored (BuildData *data)
+{
+  g_autoptr(GHashTable) wanted = NULL;
+  g_autoptr(GError) error = NULL;
+  guint kept = 0;
+
+  wanted = llyfr_rg_backend_list_files (data->directory, NULL, &error);
+  if (wanted == NULL) {
+    g_debug ("Unable to ask rg which files to index in %s: %s", data->directory, error->message);
+    return;
+  }
+
+  llyfr_trigram_index_watch (data, ".git/info/exclude");
+
+  for (guint i = 0; i < data->files->len; i++) {
+    IndexEntry *entry = &g_array_index (data->files, IndexEntry, i);
+
+    if (!g_hash_table_contains (wanted, entry->path)) {
+      index_entry_clear (entry);
+      continue;
+    }
+
+    if (kept != i)
+      g_array_index (data->files, IndexEntry, kept) = *entry;
+
+    kept++;
+  }
+
+  // Everything past what's kept has been moved or cleared already.
+  g_array_set_clear_func (data->files, NULL);
+  g_array_set_size (data->files, kept);
+  g_array_set_clear_func (data->files, (GDestroyNotify) index_entry_clear);
+}
+
+/*
+ * Fill @data with the files git is tracking, watching its index for any
+ * being added or removed. Returns FALSE if @directory isn't a repository.
+ */
+static gboolean
+llyfr_trigram_index_list_git_files (BuildData *data)
+{
+  g_autoptr(GArray) git_files = NULL;
+  g_autoptr(GError) error = NULL;
+  IndexEntry watched;
+  struct stat buf;
+
+  watched.path = llyfr_git_files_get_index_path (data->directory);
+  if (watched.path == NULL || stat (watched.path, &buf) != 0) {
+    g_free (watched.path);
+    return FALSE;
+  }
+
+  // Take the time before listing, so a change made while we're at it is
+  // noticed next time.
+  watched.mtime = stat_mtime (&buf);
+  watched.size = 0;
+
+  git_files = llyfr_git_files_list (data->directory, NULL, &error);
+  if (git_files == NULL) {
+    g_debug ("Unable to list files in %s: %s", data->directory, error->message);
+    g_free (watched.path);
+    return FALSE;
+  }
+
+  g_array_append_val (data->directories, watched);
+
+  // What git has recorded could be out of date, so go by the files.
+  for (guint i = 0; i < git_files->len; i++) {
+    LlyfrGitFile *git_file = &g_array_index (git_files, LlyfrGitFile, i);
+    g_autofree gchar *path = g_build_filename (data->directory, git_file->path, NULL);
+    IndexEntry entry;
+
+    if (lstat (path, &buf) != 0 || !S_ISREG (buf.st_mode))
+      continue;
+
+    entry.path = g_steal_pointer (&git_file->path);
+    entry.mtime = stat_mtime (&buf);
+    entry.size = buf.st_size;
+    g_array_append_val (data->files, entry);
+  }
+
+  return TRUE;
+}
+
+static void
+llyfr_trigram_index_add_file (BuildData   *data,
+                              IndexEntry  *file,
+                              guint32      id,
+                              guint8      *seen,
+                              GArray      *found,
+                              GHashTable  *postings)
+{
+  g_autofree gchar *path = g_build_filename (data->directory, file->path, NULL);
+  g_autofree guint8 *buffer = NULL;
+  gpointer contents = NULL;
+  struct stat buf;
+  gsize size;
+  int fd;
+
+  fd = open (path, O_RDONLY | O_NOFOLLOW | O_NOCTTY | O_CLOEXEC);
+  if (fd < 0)
+    return;
+
+  // The file may have changed since it was listed, and touching a mapping
+  // past the end of a file that has since shrunk raises SIGBUS. Go by what
+  // it is now.
+  if (fstat (fd, &buf) != 0 || !S_ISREG (buf.st_mode) || buf.st_size == 0) {
+    close (fd);
+    return;
+  }
+
+  size = buf.st_size;
+
+  if (size <= MAX_READ_SIZE) {
+    gsize n_read = 0;
+
+    buffer = g_malloc (size);
+    while (n_read < size) {
+      gssize n = read (fd, buffer + n_read, size - n_read);
+
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n <= 0)
+        break;
+
+      n_read += n;
+    }
+
+    size = n_read;
+  } else {
+    contents = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (contents == MAP_FAILED)
+      size = 0;
+    else
+      madvise (contents, size, MADV_SEQUENTIAL);
+  }
+
+  close (fd);
+
+  // Binary files are never searched, so there's nothing to index.
+  if (size > 0) {
+    const guint8 *bytes = buffer != NULL ? buffer : contents;
+
+    // Binary files are never searched, so there's no point indexing them.
+    if (!llyfr_matcher_is_binary ((const gchar *) bytes, size))
+      llyfr_trigram_index_scan (bytes, size, seen, found);
+  }
+
+  if (contents != NULL && contents != MAP_FAILED)
+    munmap (contents, buf.st_size);
+
+  for (guint i = 0; i < found->len; i++) {
+    guint32 trigram = g_array_index (found, guint32, i);
+    GArray *list = g_hash_table_lookup (postings, GUINT_TO_POINTER (trigram));
+
+    if (list == NULL) {
+      list = g_array_new (FALSE, FALSE, sizeof (guint32));
+      g_hash_table_insert (postings, GUINT_TO_POINTER (trigram), list);
+    }
+
+    g_array_append_val (list, id);
+    seen[trigram >> 3] &= ~(1 << (trigram & 7));
+  }
+
+  g_array_set_size (found, 0);
+}
+
+/*
+ * Carry the postings of every file that hasn't changed since @previous was
+ * built over to @postings, under the file's new id.
+ */
+static void
+llyfr_trigram_index_reuse (GVariant   *previous,
+                           GArray     *files,
+                           gboolean   *reused,
+                           GHashTable *postings)
+{
+  g_autoptr(GHashTable) old_ids = g_hash_table_new (g_str_hash, g_str_equal);
+  g_autoptr(GVariant) old_files = g_variant_get_child_value (previous, 2);
+  g_autoptr(GVariant) trigrams_v = g_variant_get_child_value (previous, 4);
+  g_autoptr(GVariant) offsets_v = g_variant_get_child_value (previous, 5);
+  g_autoptr(GVariant) ids_v = g_variant_get_child_value (previous, 6);
+  g_autofree guint32 *old_to_new = NULL;
+  const guint32 *trigrams, *offsets, *ids;
+  gsize n_old, n_trigrams, n_offsets, n_ids;
+
+  n_old = g_variant_n_children (old_files);
+  old_to_new = g_new (guint32, MAX (n_old, 1));
+
+  for (gsize i = 0; i < n_old; i++) {
+    const gchar *path;
+
+    old_to_new[i] = G_MAXUINT32;
+    g_variant_get_child (old_files, i, "(&sxx)", &path, NULL, NULL);
+    g_hash_table_insert (old_ids, (gpointer) path, GSIZE_TO_POINTER (i + 1));
+  }
+
+  for (guint i = 0; i < files->len; i++) {
+    IndexEntry *file = &g_array_index (files, IndexEntry, i);
+    gsize old_id = GPOINTER_TO_SIZE (g_hash_table_lookup (old_ids, file->path));
+    gint64 mtime, size;
+
+    if (old_id == 0)
+      continue;
+
+    g_variant_get_child (old_files, old_id - 1, "(&sxx)", NULL, &mtime, &size);
+    if (mtime != file->mtime || size != file->size)
+      continue;
+
+    old_to_new[old_id - 1] = i;
+    reused[i] = TRUE;
+  }
+
+  trigrams = g_variant_get_fixed_array (trigrams_v, &n_trigrams, sizeof (guint32));
+  offsets = g_variant_get_fixed_array (offsets_v, &n_offsets, sizeof (guint32));
+  ids = g_variant_get_fixed_array (ids_v, &n_ids, sizeof (guint32));
+
+  if (n_offsets != n_trigrams + 1)
+    return;
+
+  for (gsize t = 0; t < n_trigrams; t++) {
+    GArray *list = NULL;
+
+    for (guint32 j = offsets[t]; j < offsets[t + 1] && j < n_ids; j++) {
+      guint32 new_id;
+
+      if (ids[j] >= n_old || (new_id = old_to_new[ids[j]]) == G_MAXUINT32)
+        continue;
+
+      if (list == NULL) {
+        list = g_array_new (FALSE, FALSE, sizeof (guint32));
+        g_hash_table_insert (postings, GUINT_TO_POINTER (trigrams[t]), list);
+      }
+
+      g_array_append_val (list, new_id);
+    }
+  }
+}
+
+static GVariant*
+llyfr_trigram_index_serialise (BuildData  *data,
+                               GHashTable *postings)
+{
+  g_autoptr(GArray) trigrams = g_array_new (FALSE, FALSE, sizeof (guint32));
+  g_autoptr(GArray) offsets = g_array_new (FALSE, FALSE, sizeof (guint32));
+  g_autoptr(GArray) ids = g_array_new (FALSE, FALSE, sizeof (guint32));
+  GVariantBuilder files, directories;
+  GHashTableIter iter;
+  gpointer key;
+
+  g_hash_table_iter_init (&iter, postings);
+  while (g_hash_table_iter_next (&iter, &key, NULL)) {
+    guint32 trigram = GPOINTER_TO_UINT (key);
+    g_array_append_val (trigrams, trigram);
+  }
+
+  g_array_sort (trigrams, compare_uint32);
+
+  for (guint i = 0; i < trigrams->len; i++) {
+    guint32 trigram = g_array_index (trigrams, guint32, i);
+    GArray *list = g_hash_table_lookup (postings, GUINT_TO_POINTER (trigram));
+    guint32 offset = ids->len;
+
+    // Reused postings come first, so the ids need putting back in order.
+    g_array_sort (list, compare_uint32);
+
+    g_array_append_val (offsets, offset);
+    g_array_append_vals (ids, list->data, list->len);
+  }
+
+  g_array_append_val (offsets, ids->len);
+
+  g_variant_builder_init (&files, G_VARIANT_TYPE ("a(sxx)"));
+  for (guint i = 0; i < data->files->len; i++) {
+    IndexEntry *file = &g_array_index (data->files, IndexEntry, i);
+    g_variant_builder_add (&files, "(sxx)", file->path, file->mtime, file->size);
+  }
+
+  g_variant_builder_init (&directories, G_VARIANT_TYPE ("a(sx)"));
+  for (guint i = 0; i < data->directories->len; i++) {
+    IndexEntry *dir = &g_array_index (data->directories, IndexEntry, i);
+    g_variant_builder_add (&directories, "(sx)", dir->path, dir->mtime);
+  }
+
+  return g_variant_ref_sink (g_variant_new ("(ux@a(sxx)@a(sx)@au@au@au)",
+                                            INDEX_VERSION,
+                                            g_get_real_time () / G_USEC_PER_SEC,
+                                            g_variant_builder_end (&files),
+                                            g_variant_builder_end (&directories),
+                                            g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32,
+                                                                       trigrams->data, trigrams->len,
+                                                                       sizeof (guint32)),
+                                            g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32,
+                                                                       offsets->data, offsets->len,
+                                                                       sizeof (guint32)),
+                                            g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32,
+                                                                       ids->data, ids->len,
+                                                                       sizeof (guint32))));
+}
+
+/*
+ * Runs on the build pool, indexing everything that's changed since the
+ * previous index was built and saving the result.
+ */
+static void
+llyfr_trigram_index_build (gpointer item,
+                           gpointer user_data)
+{
+  g_autoptr(GTask) task = item;
+  BuildData *data = g_task_get_task_data (task);
+  g_autoptr(GHashTable) postings = NULL;
+  g_autoptr(GArray) found = NULL;
+  g_autoptr(GVariant) index = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gboolean *reused = NULL;
+  g_autofree guint8 *seen = NULL;
+  g_autofree gchar *parent = NULL;
+  GVariant *saved;
+  guint n_read = 0;
+
+  data->files = g_array_new (FALSE, FALSE, sizeof (IndexEntry));
+  data->directories = g_array_new (FALSE, FALSE, sizeof (IndexEntry));
+  g_array_set_clear_func (data->files, (GDestroyNotify) index_entry_clear);
+  g_array_set_clear_func (data->directories, (GDestroyNotify) index_entry_clear);
+
+  if (!data->git_files || !llyfr_trigram_index_list_git_files (data)) {
+    llyfr_trigram_index_walk (data, "");
+    llyfr_trigram_index_drop_ignored (data);
+  }
+
+  postings = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_array_unref);
+  reused = g_new0 (gboolean, MAX (data->files->len, 1));
+
+  if (data->previous != NULL)
+    llyfr_trigram_index_reuse (data->previous, data->files, reused, postings);
+
+  seen = g_malloc0 (N_TRIGRAMS / 8);
+  found = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+  for (guint i = 0; i < data->files->len; i++) {
+    if (reused[i])
+      continue;
+
+    llyfr_trigram_index_add_file (data, &g_array_index (data->files, IndexEntry, i),
+                                  i, seen, found, postings);
+    n_read++;
+  }
+
+  g_debug ("Indexed %s, read %u of %u files",
+           data->directory, n_read, data->files->len);
+
+  index = llyfr_trigram_index_serialise (data, postings);
+  g_clear_pointer (&postings, g_hash_table_unref);
+
+  parent = g_path_get_dirname (data->filename);
+  if (g_mkdir_with_parents (parent, 0700) != 0 ||
+      !g_file_set_contents (data->filename,
+                            g_variant_get_data (index),
+                            g_variant_get_size (index),
+                            &error)) {
+    g_message ("Unable to save index of %s: %s",
+               data->directory, error ? error->message : g_strerror (errno));
+    g_task_return_pointer (task, g_steal_pointer (&index), (GDestroyNotify) g_variant_unref);
+    return;
+  }
+
+  // Swap the copy on the heap for the one on disk.
+  saved = llyfr_trigram_index_load (data->filename, NULL);
+  if (saved == NULL)
+    saved = g_steal_pointer (&index);
+
+  g_task_return_pointer (task, saved, (GDestroyNotify) g_variant_unref);
+}
+
+static void
+llyfr_trigram_index_set_state (LlyfrTrigramIndex      *index,
+                               LlyfrTrigramIndexState  state)
+{
+  if (index->state == state)
+    return;
+
+  index->state = state;
+  g_object_notify_by_pspec (G_OBJECT (index), properties[PROP_STATE]);
+}
+
+static void
+llyfr_trigram_index_build_cb (GObject      *object,
+                              GAsyncResult *result,
+                              gpointer      user_data)
+{
+  LlyfrTrigramIndex *index = LLYFR_TRIGRAM_INDEX (object);
+  GVariant *data = g_task_propagate_pointer (G_TASK (result), NULL);
+
+  g_mutex_lock (&index->lock);
+  g_clear_pointer (&index->data, g_variant_unref);
+  index->data = data;
+  g_mutex_unlock (&index->lock);
+
+  llyfr_trigram_index_set_state (index, LLYFR_TRIGRAM_INDEX_FRESH);
+}
+
+/*
+ * Bring the index up to date in the background, unless that's already
+ * happening.
+ */
+void
+llyfr_trigram_index_update (LlyfrTrigramIndex *index)
+{
+  GTask *task;
+  BuildData *data;
+
+  g_return_if_fail (LLYFR_IS_TRIGRAM_INDEX (index));
+
+  if (index->state == LLYFR_TRIGRAM_INDEX_BUILDING)
+    return;
+
+  if (build_pool == NULL)
+    build_pool = g_thread_pool_new (llyfr_trigram_index_build, NULL, MAX_BUILDS, FALSE, NULL);
+
+  data = g_new0 (BuildData, 1);
+  data->directory = g_strdup (index->directory);
+  data->filename = g_strdup (index->filename);
+  data->git_files = index->git_files;
+
+  g_mutex_lock (&index->lock);
+  if (index->data != NULL)
+    data->previous = g_variant_ref (index->data);
+  g_mutex_unlock (&index->lock);
+
+  task = g_task_new (index, NULL, llyfr_trigram_index_build_cb, NULL);
+  g_task_set_source_tag (task, llyfr_trigram_index_update);
+  g_task_set_task_data (task, data, (GDestroyNotify) build_data_free);
+
+  llyfr_trigram_index_set_state (index, LLYFR_TRIGRAM_INDEX_BUILDING);
+
+  g_thread_pool_push (build_pool, task, NULL);
+}
+
+static gboolean
+llyfr_trigram_index_update_cb (gpointer user_data)
+{
+  LlyfrTrigramIndex *index = LLYFR_TRIGRAM_INDEX (user_data);
+
+  g_atomic_int_set (&index->update_queued, FALSE);
+
+  if (index->state != LLYFR_TRIGRAM_INDEX_BUILDING)
+    llyfr_trigram_index_set_state (index, LLYFR_TRIGRAM_INDEX_STALE);
+
+  llyfr_trigram_index_update (index);
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Called from a search when it's found the index is out of date.
+ */
+static void
+llyfr_trigram_index_queue_update (LlyfrTrigramIndex *index)
+{
+  GSource *source;
+
+  if (!g_atomic_int_compare_and_exchange (&index->update_queued, FALSE, TRUE))
+    return;
+
+  source = g_idle_source_new ();
+  g_source_set_callback (source, llyfr_trigram_index_update_cb,
+                         g_object_ref (index), g_object_unref);
+  g_source_attach (source, index->context);
+  g_source_unref (source);
+}
+
+/*
+ * Intersect the sorted @ids with the postings of @trigram, or use them to
+ * start with when @ids is NULL.
+ */
+static GArray*
+llyfr_trigram_index_intersect (GArray        *ids,
+                               guint32        trigram,
+                               const guint32 *trigrams,
+                               gsize          n_trigrams,
+                               const guint32 *offsets,
+                               const guint32 *postings)
+{
+  const guint32 *found = bsearch (&trigram, trigrams, n_trigrams, sizeof (guint32), compare_uint32);
+  GArray *result = g_array_new (FALSE, FALSE, sizeof (guint32));
+  const guint32 *list, *end;
+  guint i = 0;
+
+  if (found == NULL)
+    goto out;
+
+  list = postings + offsets[found - trigrams];
+  end = postings + offsets[found - trigrams + 1];
+
+  if (ids == NULL) {
+    g_array_append_vals (result, list, end - list);
+    goto out;
+  }
+
+  while (list < end && i < ids->len) {
+    guint32 id = g_array_index (ids, guint32, i);
+
+    if (*list < id) {
+      list++;
+    } else if (id < *list) {
+      i++;
+    } else {
+      g_array_append_val (result, id);
+      list++;
+      i++;
+    }
+  }
+
+out:
+  if (ids != NULL)
+    g_array_unref (ids);
+
+  return result;
+}
+
+/*
+ * The files in the index that could match @query, along with any that have
+ * changed since it was built, as absolute paths. Returns NULL when the index
+ * is of no help, in which case the whole directory has to be searched.
+ *
+ * Safe to call from any thread.
+ */
+GPtrArray*
+llyfr_trigram_index_find_candidates (LlyfrTrigramIndex *index,
+                                     const gchar *query)
+{
+  g_autoptr(GVariant) data = NULL;
+  g_autoptr(GVariant) files = NULL;
+  g_autoptr(GVariant) directories = NULL;
+  g_autoptr(GVariant) trigrams_v = NULL;
+  g_autoptr(GVariant) offsets_v = NULL;
+  g_autoptr(GVariant) postings_v = NULL;
+  g_autoptr(GArray) required = NULL;
+  g_autofree guint8 *candidates = NULL;
+  const guint32 *trigrams, *offsets, *postings;
+  gsize n_trigrams, n_offsets, n_postings, n_files;
+  GArray *ids = NULL;
+  GPtrArray *result;
+  gboolean stale = FALSE;
+
+  g_return_val_if_fail (LLYFR_IS_TRIGRAM_INDEX (index), NULL);
+
+  g_mutex_lock (&index->lock);
+  if (index->data != NULL)
+    data = g_variant_ref (index->data);
+  g_mutex_unlock (&index->lock);
+
+  if (data == NULL)
+    return NULL;
+
+  required = llyfr_trigram_index_extract (query);
+  if (required == NULL || required->len == 0)
+    return NULL;
+
+  // A change here could mean files we know nothing about.
+  directories = g_variant_get_child_value (data, 3);
+  for (gsize i = 0; i < g_variant_n_children (directories); i++) {
+    g_autofree gchar *path = NULL;
+    const gchar *relative;
+    struct stat buf;
+    gint64 mtime;
+
+    g_variant_get_child (directories, i, "(&sx)", &relative, &mtime);
+    if (g_path_is_absolute (relative))
+      path = g_strdup (relative);
+    else
+      path = g_build_filename (index->directory, relative, NULL);
+
+    if (stat (path, &buf) != 0 || stat_mtime (&buf) != mtime) {
+      g_debug ("%s has changed, not using the index", path);
+      llyfr_trigram_index_queue_update (index);
+      return NULL;
+    }
+  }
+
+  trigrams_v = g_variant_get_child_value (data, 4);
+  offsets_v = g_variant_get_child_value (data, 5);
+  postings_v = g_variant_get_child_value (data, 6);
+
+  trigrams = g_variant_get_fixed_array (trigrams_v, &n_trigrams, sizeof (guint32));
+  offsets = g_variant_get_fixed_array (offsets_v, &n_offsets, sizeof (guint32));
+  postings = g_variant_get_fixed_array (postings_v, &n_postings, sizeof (guint32));
+
+  if (n_offsets != n_trigrams + 1)
+    return NULL;
+
+  for (guint i = 0; i < required->len; i++) {
+    ids = llyfr_trigram_index_intersect (ids, g_array_index (required, guint32, i),
+                                         trigrams, n_trigrams, offsets, postings);
+    if (ids->len == 0)
+      break;
+  }
+
+  files = g_variant_get_child_value (data, 2);
+  n_files = g_variant_n_children (files);
+  candidates = g_new0 (guint8, MAX (n_files, 1));
+
+  for (guint i = 0; i < ids->len; i++) {
+    guint32 id = g_array_index (ids, guint32, i);
+
+    if (id < n_files)
+      candidates[id] = TRUE;
+  }
+
+  g_array_unref (ids);
+
+  // Files edited since the index was built have to be searched regardless.
+  for (gsize i = 0; i < n_files; i++) {
+    g_autofree gchar *path = NULL;
+    const gchar *relative;
+    gint64 mtime, size;
+    struct stat buf;
+
+    g_variant_get_child (files, i, "(&sxx)", &relative, &mtime, &size);
+    path = g_build_filename (index->directory, relative, NULL);
+
+    if (stat (path, &buf) != 0) {
+      candidates[i] = FALSE;
+      stale = TRUE;
+      continue;
+    }
+
+    if (stat_mtime (&buf) != mtime || buf.st_size != size) {
+      candidates[i] = TRUE;
+      stale = TRUE;
+    }
+  }
+
+  if (stale)
+    llyfr_trigram_index_queue_update (index);
+
+  result = g_ptr_array_new_with_free_func (g_free);
+  for (gsize i = 0; i < n_files; i++) {
+    const gchar *relative;
+
+    if (!candidates[i])
+      continue;
+
+    g_variant_get_child (files, i, "(&sxx)", &relative, NULL, NULL);
+    g_ptr_array_add (result, g_build_filename (index->directory, relative, NULL));
+  }
+
+  g_debug ("Searching %u of %" G_GSIZE_FORMAT " files in %s",
+           result->len, n_files, index->directory);
+
+  return result;
+}
+
+LlyfrTrigramIndex*
+llyfr_trigram_index_new (const gchar *directory)
+{
+  return g_object_new (LLYFR_TYPE_TRIGRAM_INDEX,
+                       "directory", directory,
+                       NULL);
+}
+
+const gchar*
+llyfr_trigram_index_get_directory (LlyfrTrigramIndex *index)
+{
+  g_return_val_if_fail (LLYFR_IS_TRIGRAM_INDEX (index), NULL);
+
+  return index->directory;
+}
+
+LlyfrTrigramIndexState
+llyfr_trigram_index_get_state (LlyfrTrigramIndex *index)
+{
+  g_return_val_if_fail (LLYFR_IS_TRIGRAM_INDEX (index), LLYFR_TRIGRAM_INDEX_MISSING);
+
+  return index->state;
+}
+
+/*
+ * When the index in use was built, in seconds since the epoch, or -1 if
+ * there isn't one.
+ */
+gint64
+llyfr_trigram_index_get_built_time (LlyfrTrigramIndex *index)
+{
+  g_autoptr(GMutexLocker) locker = NULL;
+  gint64 built;
+
+  g_return_val_if_fail (LLYFR_IS_TRIGRAM_INDEX (index), -1);
+
+  locker = g_mutex_locker_new (&index->lock);
+
+  if (index->data == NULL)
+    return -1;
+
+  g_variant_get_child (index->data, 1, "x", &built);
+  return built;
+}
+
+/*
+ * Whether to index the files git is tracking, rather than everything in
+ * the directory. Takes effect from the next update.
+ */
+gboolean
+llyfr_trigram_index_get_git_files (LlyfrTrigramIndex *index)
+{
+  g_return_val_if_fail (LLYFR_IS_TRIGRAM_INDEX (index), FALSE);
+
+  return index->git_files;
+}
+
+void
+llyfr_trigram_index_set_git_files (LlyfrTrigramIndex *index,
+                                   gboolean git_files)
+{
+  g_return_if_fail (LLYFR_IS_TRIGRAM_INDEX (index));
+
+  git_files = !!git_files;
+  if (index->git_files == git_files)
+    return;
+
+  index->git_files = git_files;
+  g_object_notify_by_pspec (G_OBJECT (index), properties[PROP_GIT_FILES]);
+}
+
+static void
+llyfr_trigram_index_constructed (GObject *object)
+{
+  LlyfrTrigramIndex *self = LLYFR_TRIGRAM_INDEX (object);
+  g_autofree gchar *checksum = NULL;
+  g_autofree gchar *name = NULL;
+  g_autoptr(GError) error = NULL;
+
+  G_OBJECT_CLASS (llyfr_trigram_index_parent_class)->constructed (object);
+
+  g_return_if_fail (self->directory != NULL);
+
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, self->directory, -1);
+  name = g_strconcat (checksum, ".gvariant", NULL);
+  self->filename = g_build_filename (g_get_user_cache_dir (), "llyfrgell", "index", name, NULL);
+
+  // Until it's next updated, assume the index saved last time is still good.
+  self->data = llyfr_trigram_index_load (self->filename, &error);
+  if (self->data != NULL)
+    self->state = LLYFR_TRIGRAM_INDEX_FRESH;
+  else if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+    g_message ("Unable to load index of %s: %s", self->directory, error->message);
+}
+
+static void
+llyfr_trigram_index_get_property (GObject    *object,
+                                  guint       prop_id,
+                                  GValue     *value,
+                                  GParamSpec *pspec)
+{
+  LlyfrTrigramIndex *self = LLYFR_TRIGRAM_INDEX (object);
+
+  switch (prop_id) {
+    case PROP_DIRECTORY:
+      g_value_set_string (value, self->directory);
+      break;
+
+    case PROP_STATE:
+      g_value_set_enum (value, self->state);
+      break;
+
+    case PROP_GIT_FILES:
+      g_value_set_boolean (value, self->git_files);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+  }
+}
+
+static void
+llyfr_trigram_index_set_property (GObject      *object,
+                                  guint         prop_id,
+                                  const GValue *value,
+                                  GParamSpec   *pspec)
+{
+  LlyfrTrigramIndex *self = LLYFR_TRIGRAM_INDEX (object);
+
+  switch (prop_id) {
+    case PROP_DIRECTORY:
+      self->directory = g_value_dup_string (value);
+      break;
+
+    case PROP_GIT_FILES:
+      llyfr_trigram_index_set_git_files (self, g_value_get_boolean (value));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+  }
+}
+
+static void
+llyfr_trigram_index_finalize (GObject *object)
+{
+  LlyfrTrigramIndex *self = LLYFR_TRIGRAM_INDEX (object);
+
+  g_free (self->directory);
+  g_free (self->filename);
+  g_clear_pointer (&self->context, g_main_context_unref);
+  g_clear_pointer (&self->data, g_variant_unref);
+  g_mutex_clear (&self->lock);
+
+  G_OBJECT_CLASS (llyfr_trigram_index_parent_class)->finalize (object);
+}
+
+static void
+llyfr_trigram_index_class_init (LlyfrTrigramIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->constructed = llyfr_trigram_index_constructed;
+  object_class->get_property = llyfr_trigram_index_get_property;
+  object_class->set_property = llyfr_trigram_index_set_property;
+  object_class->finalize = llyfr_trigram_index_finalize;
+
+  properties[PROP_DIRECTORY] =
+    g_param_spec_string ("directory",
+                         "Directory",
+                         "The directory indexed",
+                         NULL,
+                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+
+  properties[PROP_STATE] =
+    g_param_spec_enum ("state",
+                       "State",
+                       "Whether the index is up to date",
+                       LLYFR_TYPE_TRIGRAM_INDEX_STATE,
+                       LLYFR_TRIGRAM_INDEX_MISSING,
+                       G_PARAM_READABLE | G_PARAM_EXPLICIT_NOTIFY);
+
+  properties[PROP_GIT_FILES] =
+    g_param_spec_boolean ("git-files",
+                          "Git files",
+                          "Whether to index only the files git is tracking",
+                          FALSE,
+                          G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY);
+
+  g_object_class_install_properties (object_class, LAST_PROP, properties);
+}
+
+static void
+llyfr_trigram_index_init (LlyfrTrigramIndex *self)
+{
+  g_mutex_init (&self->lock);
+
+  self->context = g_main_context_ref_thread_default ();
+  self->state = LLYFR_TRIGRAM_INDEX_MISSING;
+}
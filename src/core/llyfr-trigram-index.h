@@ -0,0 +1,66 @@
+/* llyfr-trigram-index.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_TRIGRAM_INDEX_H
+#define LLYFR_TRIGRAM_INDEX_H
+
+#include <gio/gio.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define LLYFR_TYPE_TRIGRAM_INDEX (llyfr_trigram_index_get_type())
+#define LLYFR_TYPE_TRIGRAM_INDEX_STATE (llyfr_trigram_index_state_get_type())
+
+typedef enum
+{
+  LLYFR_TRIGRAM_INDEX_MISSING,
+  LLYFR_TRIGRAM_INDEX_BUILDING,
+  LLYFR_TRIGRAM_INDEX_FRESH,
+  LLYFR_TRIGRAM_INDEX_STALE,
+} LlyfrTrigramIndexState;
+
+GType llyfr_trigram_index_state_get_type (void);
+
+G_DECLARE_FINAL_TYPE (LlyfrTrigramIndex, llyfr_trigram_index, LLYFR, TRIGRAM_INDEX, GObject)
+
+LlyfrTrigramIndex*     llyfr_trigram_index_new               (const gchar *directory);
+
+const gchar*           llyfr_trigram_index_get_directory     (LlyfrTrigramIndex *index);
+
+LlyfrTrigramIndexState llyfr_trigram_index_get_state         (LlyfrTrigramIndex *index);
+
+gint64                 llyfr_trigram_index_get_built_time    (LlyfrTrigramIndex *index);
+
+gboolean               llyfr_trigram_index_get_git_files     (LlyfrTrigramIndex *index);
+
+void                   llyfr_trigram_index_set_git_files     (LlyfrTrigramIndex *index,
+                                                              gboolean git_files);
+
+void                   llyfr_trigram_index_update            (LlyfrTrigramIndex *index);
+
+GPtrArray*             llyfr_trigram_index_find_candidates   (LlyfrTrigramIndex *index,
+                                                              const gchar *query);
+
+GArray*                llyfr_trigram_index_extract           (const gchar *query);
+
+G_END_DECLS
+
+#endif /* LLYFR_TRIGRAM_INDEX_H */
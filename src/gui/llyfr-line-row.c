@@ -0,0 +1,323 @@
+/* llyfr-line-row.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-line-row"
+
+#include "llyfr-line-index.h"
+#include "llyfr-line-row.h"
+
+/*
+ * A single line of the flattened results view, either a file's path, one
+ * of its matching lines or a line of context around one. Long lines are
+ * cut short rather than wrapped so that every row has the same height
+ * whatever it happens to be showing.
+ */
+
+#define PADDING 3
+
+struct _LlyfrLineRow
+{
+  GtkWidget    parent_instance;
+
+  PangoLayout *layout;
+};
+
+G_DEFINE_TYPE (LlyfrLineRow, llyfr_line_row, GTK_TYPE_WIDGET)
+
+LlyfrLineRow*
+llyfr_line_row_new (void)
+{
+  return g_object_new (LLYFR_TYPE_LINE_ROW, NULL);
+}
+
+static void
+llyfr_line_row_set_header (LlyfrLineRow *self,
+                           LlyfrSearchResult *result)
+{
+  PangoAttrList *attrs = pango_attr_list_new ();
+  g_autofree gchar *header = llyfr_search_result_dup_header (result);
+
+  pango_attr_list_insert (attrs, pango_attr_weight_new (PANGO_WEIGHT_BOLD));
+
+  pango_layout_set_text (self->layout, header, -1);
+  pango_layout_set_attributes (self->layout, attrs);
+  pango_layout_set_ellipsize (self->layout, PANGO_ELLIPSIZE_START);
+
+  pango_attr_list_unref (attrs);
+}
+
+static void
+llyfr_line_row_set_match (LlyfrLineRow *self,
+                          LlyfrSearchResult *result,
+                          guint index)
+{
+  PangoAttrList *attrs = pango_attr_list_new ();
+  guint n_matches = llyfr_search_result_get_n_matches (result);
+  const LlyfrSearchSpan *highlights;
+  PangoAttribute *attr;
+  const gchar *text;
+  guint n_highlights;
+  gsize length, content_start;
+  gint64 line_number;
+  GString *line;
+  gint digits = 1;
+
+  // Matches come in line order, so the last one has the widest line number
+  // and every line in the file can share its gutter width.
+  for (gint64 n = llyfr_search_result_get_match_line_number (result, n_matches - 1); n >= 10; n /= 10)
+    digits++;
+
+  line_number = llyfr_search_result_get_match_line_number (result, index);
+  text = llyfr_search_result_get_match_text (result, index, &length);
+  highlights = llyfr_search_result_get_match_highlights (result, index, &n_highlights);
+
+  line = g_string_new (NULL);
+  if (line_number >= 0)
+    g_string_append_printf (line, "%*" G_GINT64_FORMAT "  ", digits, line_number);
+  else
+    g_string_append_printf (line, "%*s  ", digits, "");
+
+  content_start = line->len;
+  g_string_append_len (line, text, length);
+
+  pango_attr_list_insert (attrs, pango_attr_family_new ("monospace"));
+
+  attr = pango_attr_foreground_new (0x9393, 0xa1a1, 0xa1a1);
+  attr->start_index = 0;
+  attr->end_index = digits;
+  pango_attr_list_insert (attrs, attr);
+
+  for (guint i = 0; i < n_highlights; i++) {
+    attr = pango_attr_background_new (0x2626, 0x8b8b, 0xd2d2);
+    attr->start_index = content_start + highlights[i].start;
+    attr->end_index = content_start + highlights[i].end;
+    pango_attr_list_insert (attrs, attr);
+
+    attr = pango_attr_foreground_new (0xffff, 0xffff, 0xffff);
+    attr->start_index = content_start + highlights[i].start;
+    attr->end_index = content_start + highlights[i].end;
+    pango_attr_list_insert (attrs, attr);
+  }
+
+  pango_layout_set_text (self->layout, line->str, line->len);
+  pango_layout_set_attributes (self->layout, attrs);
+  pango_layout_set_ellipsize (self->layout, PANGO_ELLIPSIZE_END);
+
+  g_string_free (line, TRUE);
+  pango_attr_list_unref (attrs);
+}
+
+/*
+ * A line of context is read from the file, and dimmed so the match stands
+ * out from it.
+ */
+static void
+llyfr_line_row_set_context (LlyfrLineRow *self,
+                            LlyfrResultLine *line)
+{
+  LlyfrSearchResult *result = llyfr_result_line_get_result (line);
+  guint n_matches = llyfr_search_result_get_n_matches (result);
+  g_autoptr(LlyfrLineIndex) file = NULL;
+  PangoAttrList *attrs = pango_attr_list_new ();
+  PangoAttribute *attr;
+  const gchar *text = NULL;
+  gsize length = 0;
+  gint64 line_number;
+  GString *row;
+  gint digits = 1;
+
+  line_number = llyfr_result_line_get_line_number (line);
+
+  // Context after the last match can need a wider gutter than the matches,
+  // only that line is pushed along.
+  for (gint64 n = MAX (line_number, llyfr_search_result_get_match_line_number (result, n_matches - 1)); n >= 10; n /= 10)
+    digits++;
+
+  // The file was looked at when the match was expanded, so this is only a
+  // lookup unless it has changed since.
+  file = llyfr_line_index_lookup (llyfr_search_result_get_filepath (result), NULL);
+  if (file != NULL)
+    text = llyfr_line_index_get_line (file, line_number, &length);
+
+  row = g_string_new (NULL);
+  g_string_append_printf (row, "%*" G_GINT64_FORMAT "  ", digits, line_number);
+
+  // Unlike rg's output, nothing has checked the file is valid UTF-8.
+  if (text != NULL && g_utf8_validate (text, length, NULL)) {
+    g_string_append_len (row, text, length);
+  } else if (text != NULL) {
+    g_autofree gchar *valid = g_utf8_make_valid (text, length);
+    g_string_append (row, valid);
+  }
+
+  pango_attr_list_insert (attrs, pango_attr_family_new ("monospace"));
+
+  attr = pango_attr_foreground_new (0x9393, 0xa1a1, 0xa1a1);
+  attr->start_index = 0;
+  attr->end_index = row->len;
+  pango_attr_list_insert (attrs, attr);
+
+  pango_layout_set_text (self->layout, row->str, row->len);
+  pango_layout_set_attributes (self->layout, attrs);
+  pango_layout_set_ellipsize (self->layout, PANGO_ELLIPSIZE_END);
+
+  g_string_free (row, TRUE);
+  pango_attr_list_unref (attrs);
+}
+
+/*
+ * Show @line, pass NULL to clear the row.
+ */
+void
+llyfr_line_row_set_line (LlyfrLineRow *self,
+                         LlyfrResultLine *line)
+{
+  g_return_if_fail (LLYFR_IS_LINE_ROW (self));
+
+  if (line == NULL) {
+    pango_layout_set_text (self->layout, "", 0);
+    pango_layout_set_attributes (self->layout, NULL);
+  } else if (llyfr_result_line_is_header (line)) {
+    llyfr_line_row_set_header (self, llyfr_result_line_get_result (line));
+    gtk_widget_add_css_class (GTK_WIDGET (self), "header");
+  } else if (llyfr_result_line_get_context (line) != 0) {
+    llyfr_line_row_set_context (self, line);
+    gtk_widget_remove_css_class (GTK_WIDGET (self), "header");
+  } else {
+    llyfr_line_row_set_match (self,
+                              llyfr_result_line_get_result (line),
+                              llyfr_result_line_get_index (line));
+    gtk_widget_remove_css_class (GTK_WIDGET (self), "header");
+  }
+
+  // Only the width can change, the height of a row is fixed.
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+static int
+llyfr_line_row_get_font_height (PangoContext *context,
+                                const gchar *family)
+{
+  PangoFontDescription *desc;
+  PangoFontMetrics *metrics;
+  int height;
+
+  desc = pango_font_description_copy (pango_context_get_font_description (context));
+  if (family != NULL)
+    pango_font_description_set_family (desc, family);
+
+  metrics = pango_context_get_metrics (context, desc, NULL);
+  height = PANGO_PIXELS_CEIL (pango_font_metrics_get_ascent (metrics) +
+                              pango_font_metrics_get_descent (metrics));
+
+  pango_font_metrics_unref (metrics);
+  pango_font_description_free (desc);
+
+  return height;
+}
+
+static void
+llyfr_line_row_measure (GtkWidget      *widget,
+                        GtkOrientation  orientation,
+                        int             for_size,
+                        int            *minimum,
+                        int            *natural,
+                        int            *minimum_baseline,
+                        int            *natural_baseline)
+{
+  if (orientation == GTK_ORIENTATION_HORIZONTAL) {
+    *minimum = 2 * PADDING;
+    *natural = 2 * PADDING;
+  } else {
+    PangoContext *context = gtk_widget_get_pango_context (widget);
+    int height;
+
+    // Measured from the fonts rather than the text, so every row agrees.
+    height = MAX (llyfr_line_row_get_font_height (context, NULL),
+                  llyfr_line_row_get_font_height (context, "monospace"));
+
+    *minimum = *natural = height + 2 * PADDING;
+  }
+
+  *minimum_baseline = -1;
+  *natural_baseline = -1;
+}
+
+static void
+llyfr_line_row_size_allocate (GtkWidget *widget,
+                              int        width,
+                              int        height,
+                              int        baseline)
+{
+  LlyfrLineRow *self = LLYFR_LINE_ROW (widget);
+
+  pango_layout_set_width (self->layout, MAX (width - 2 * PADDING, 1) * PANGO_SCALE);
+}
+
+static void
+llyfr_line_row_snapshot (GtkWidget   *widget,
+                         GtkSnapshot *snapshot)
+{
+  LlyfrLineRow *self = LLYFR_LINE_ROW (widget);
+  GdkRGBA color;
+
+#if GTK_CHECK_VERSION (4, 10, 0)
+  gtk_widget_get_color (widget, &color);
+#else
+  gtk_style_context_get_color (gtk_widget_get_style_context (widget), &color);
+#endif
+
+  gtk_snapshot_save (snapshot);
+  gtk_snapshot_translate (snapshot, &GRAPHENE_POINT_INIT (PADDING, PADDING));
+  gtk_snapshot_append_layout (snapshot, self->layout, &color);
+  gtk_snapshot_restore (snapshot);
+}
+
+static void
+llyfr_line_row_dispose (GObject *object)
+{
+  LlyfrLineRow *self = LLYFR_LINE_ROW (object);
+
+  g_clear_object (&self->layout);
+
+  G_OBJECT_CLASS (llyfr_line_row_parent_class)->dispose (object);
+}
+
+static void
+llyfr_line_row_class_init (LlyfrLineRowClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  object_class->dispose = llyfr_line_row_dispose;
+
+  widget_class->measure = llyfr_line_row_measure;
+  widget_class->size_allocate = llyfr_line_row_size_allocate;
+  widget_class->snapshot = llyfr_line_row_snapshot;
+
+  gtk_widget_class_set_css_name (widget_class, "llyfrlinerow");
+}
+
+static void
+llyfr_line_row_init (LlyfrLineRow *self)
+{
+  self->layout = gtk_widget_create_pango_layout (GTK_WIDGET (self), NULL);
+  pango_layout_set_single_paragraph_mode (self->layout, TRUE);
+}
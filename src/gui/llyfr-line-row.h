@@ -0,0 +1,42 @@
+/* llyfr-line-row.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_LINE_ROW_H
+#define LLYFR_LINE_ROW_H
+
+#include <glib-object.h>
+#include <gtk/gtk.h>
+
+#include "llyfr-result-lines.h"
+
+G_BEGIN_DECLS
+
+#define LLYFR_TYPE_LINE_ROW (llyfr_line_row_get_type())
+
+G_DECLARE_FINAL_TYPE (LlyfrLineRow, llyfr_line_row, LLYFR, LINE_ROW, GtkWidget)
+
+LlyfrLineRow* llyfr_line_row_new       (void);
+
+void          llyfr_line_row_set_line  (LlyfrLineRow *row,
+                                        LlyfrResultLine *line);
+
+G_END_DECLS
+
+#endif /* LLYFR_LINE_ROW_H */
@@ -0,0 +1,402 @@
+/* llyfr-result-cache.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-result-cache"
+
+#include "llyfr-result-cache.h"
+
+/*
+ * A bounded cache of values built from search results, such as the text
+ * displayed in the results list. Entries are pinned while a row is
+ * bound to them, once released they become candidates for eviction, least
+ * recently used first, whenever the cache is over its entry or size budget.
+ */
+
+typedef struct
+{
+  LlyfrSearchResult *result;
+  gpointer           value;
+  gsize              cost;
+  guint              pin_count;
+  gboolean           cleared;
+  GList              link;
+} CacheEntry;
+
+struct _LlyfrResultCache
+{
+  GObject                    parent_instance;
+
+  LlyfrResultCacheBuildFunc  build_func;
+  GDestroyNotify             value_free;
+  gpointer                   build_data;
+
+  GHashTable                *entries;
+  GQueue                     lru;
+
+  guint                      max_entries;
+  guint64                    max_size;
+  guint64                    size;
+
+  guint64                    hits;
+  guint64                    misses;
+};
+
+G_DEFINE_TYPE (LlyfrResultCache, llyfr_result_cache, G_TYPE_OBJECT)
+
+enum
+{
+  PROP_0,
+  PROP_MAX_ENTRIES,
+  PROP_MAX_SIZE,
+  PROP_SIZE,
+  PROP_HITS,
+  PROP_MISSES,
+  LAST_PROP
+};
+
+static GParamSpec *properties[LAST_PROP];
+
+LlyfrResultCache*
+llyfr_result_cache_new (LlyfrResultCacheBuildFunc build_func,
+                        GDestroyNotify value_free,
+                        gpointer user_data)
+{
+  LlyfrResultCache *cache = g_object_new (LLYFR_TYPE_RESULT_CACHE, NULL);
+
+  cache->build_func = build_func;
+  cache->value_free = value_free;
+  cache->build_data = user_data;
+
+  return cache;
+}
+
+static void
+llyfr_result_cache_remove_entry (LlyfrResultCache *self,
+                                 CacheEntry *entry)
+{
+  g_queue_unlink (&self->lru, &entry->link);
+  self->size -= entry->cost;
+
+  g_hash_table_remove (self->entries, entry->result);
+
+  if (self->value_free != NULL)
+    self->value_free (entry->value);
+
+  g_object_unref (entry->result);
+  g_free (entry);
+}
+
+static void
+llyfr_result_cache_evict (LlyfrResultCache *self)
+{
+  GList *link = self->lru.head;
+
+  while (link != NULL &&
+         (g_hash_table_size (self->entries) > self->max_entries || self->size > self->max_size)) {
+    CacheEntry *entry = link->data;
+
+    link = link->next;
+    if (entry->pin_count > 0)
+      continue;
+
+    llyfr_result_cache_remove_entry (self, entry);
+  }
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_SIZE]);
+}
+
+/*
+ * Look up, building it if need be, the value cached for @result. The entry
+ * stays pinned until a matching call to llyfr_result_cache_release().
+ */
+gpointer
+llyfr_result_cache_acquire (LlyfrResultCache *self,
+                            LlyfrSearchResult *result)
+{
+  CacheEntry *entry;
+
+  g_return_val_if_fail (LLYFR_IS_RESULT_CACHE (self), NULL);
+  g_return_val_if_fail (LLYFR_IS_SEARCH_RESULT (result), NULL);
+
+  entry = g_hash_table_lookup (self->entries, result);
+  if (entry != NULL) {
+    self->hits++;
+    entry->pin_count++;
+    entry->cleared = FALSE;
+
+    g_queue_unlink (&self->lru, &entry->link);
+    g_queue_push_tail_link (&self->lru, &entry->link);
+
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_HITS]);
+    return entry->value;
+  }
+
+  self->misses++;
+
+  entry = g_new0 (CacheEntry, 1);
+  entry->result = g_object_ref (result);
+  entry->value = self->build_func (result, &entry->cost, self->build_data);
+  entry->pin_count = 1;
+  entry->link.data = entry;
+
+  g_hash_table_insert (self->entries, result, entry);
+  g_queue_push_tail_link (&self->lru, &entry->link);
+  self->size += entry->cost;
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_MISSES]);
+  llyfr_result_cache_evict (self);
+
+  return entry->value;
+}
+
+void
+llyfr_result_cache_release (LlyfrResultCache *self,
+                            LlyfrSearchResult *result)
+{
+  CacheEntry *entry;
+
+  g_return_if_fail (LLYFR_IS_RESULT_CACHE (self));
+
+  entry = g_hash_table_lookup (self->entries, result);
+  if (entry == NULL || entry->pin_count == 0)
+    return;
+
+  entry->pin_count--;
+  if (entry->pin_count == 0 && entry->cleared)
+    llyfr_result_cache_remove_entry (self, entry);
+
+  llyfr_result_cache_evict (self);
+}
+
+/*
+ * Drop every entry, those still pinned by a row are only marked and go once
+ * they are released, so their values stay valid for as long as they're bound.
+ */
+void
+llyfr_result_cache_clear (LlyfrResultCache *self)
+{
+  g_return_if_fail (LLYFR_IS_RESULT_CACHE (self));
+
+  g_debug ("Clearing cache: %u entries, %" G_GUINT64_FORMAT " bytes, "
+           "%" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses",
+           g_hash_table_size (self->entries), self->size, self->hits, self->misses);
+
+  for (GList *link = self->lru.head; link != NULL;) {
+    CacheEntry *entry = link->data;
+
+    link = link->next;
+    if (entry->pin_count > 0)
+      entry->cleared = TRUE;
+    else
+      llyfr_result_cache_remove_entry (self, entry);
+  }
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_SIZE]);
+}
+
+guint
+llyfr_result_cache_get_max_entries (LlyfrResultCache *self)
+{
+  return self->max_entries;
+}
+
+void
+llyfr_result_cache_set_max_entries (LlyfrResultCache *self,
+                                    guint max_entries)
+{
+  if (self->max_entries == max_entries)
+    return;
+
+  self->max_entries = max_entries;
+  llyfr_result_cache_evict (self);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_MAX_ENTRIES]);
+}
+
+guint64
+llyfr_result_cache_get_max_size (LlyfrResultCache *self)
+{
+  return self->max_size;
+}
+
+void
+llyfr_result_cache_set_max_size (LlyfrResultCache *self,
+                                 guint64 max_size)
+{
+  if (self->max_size == max_size)
+    return;
+
+  self->max_size = max_size;
+  llyfr_result_cache_evict (self);
+
+  g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_MAX_SIZE]);
+}
+
+guint64
+llyfr_result_cache_get_size (LlyfrResultCache *self)
+{
+  return self->size;
+}
+
+guint64
+llyfr_result_cache_get_hits (LlyfrResultCache *self)
+{
+  return self->hits;
+}
+
+guint64
+llyfr_result_cache_get_misses (LlyfrResultCache *self)
+{
+  return self->misses;
+}
+
+static void
+llyfr_result_cache_get_property (GObject    *object,
+                                 guint       prop_id,
+                                 GValue     *value,
+                                 GParamSpec *pspec)
+{
+  LlyfrResultCache *self = LLYFR_RESULT_CACHE (object);
+
+  switch (prop_id)
+    {
+    case PROP_MAX_ENTRIES:
+      g_value_set_uint (value, llyfr_result_cache_get_max_entries (self));
+      break;
+
+    case PROP_MAX_SIZE:
+      g_value_set_uint64 (value, llyfr_result_cache_get_max_size (self));
+      break;
+
+    case PROP_SIZE:
+      g_value_set_uint64 (value, llyfr_result_cache_get_size (self));
+      break;
+
+    case PROP_HITS:
+      g_value_set_uint64 (value, llyfr_result_cache_get_hits (self));
+      break;
+
+    case PROP_MISSES:
+      g_value_set_uint64 (value, llyfr_result_cache_get_misses (self));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+llyfr_result_cache_set_property (GObject      *object,
+                                 guint         prop_id,
+                                 const GValue *value,
+                                 GParamSpec   *pspec)
+{
+  LlyfrResultCache *self = LLYFR_RESULT_CACHE (object);
+
+  switch (prop_id)
+    {
+    case PROP_MAX_ENTRIES:
+      llyfr_result_cache_set_max_entries (self, g_value_get_uint (value));
+      break;
+
+    case PROP_MAX_SIZE:
+      llyfr_result_cache_set_max_size (self, g_value_get_uint64 (value));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+llyfr_result_cache_finalize (GObject *object)
+{
+  LlyfrResultCache *self = LLYFR_RESULT_CACHE (object);
+
+  // The queue's links are embedded in the entries, so empty it by hand.
+  while (self->lru.head != NULL)
+    llyfr_result_cache_remove_entry (self, self->lru.head->data);
+
+  g_hash_table_unref (self->entries);
+
+  G_OBJECT_CLASS (llyfr_result_cache_parent_class)->finalize (object);
+}
+
+static void
+llyfr_result_cache_class_init (LlyfrResultCacheClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->get_property = llyfr_result_cache_get_property;
+  object_class->set_property = llyfr_result_cache_set_property;
+  object_class->finalize = llyfr_result_cache_finalize;
+
+  properties[PROP_MAX_ENTRIES] = g_param_spec_uint ("max-entries",
+                                                    "Max entries",
+                                                    "The number of entries to keep",
+                                                    1,
+                                                    G_MAXUINT,
+                                                    256,
+                                                    G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY);
+
+  properties[PROP_MAX_SIZE] = g_param_spec_uint64 ("max-size",
+                                                   "Max size",
+                                                   "The estimated number of bytes to keep",
+                                                   0,
+                                                   G_MAXUINT64,
+                                                   64 * 1024 * 1024,
+                                                   G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY);
+
+  properties[PROP_SIZE] = g_param_spec_uint64 ("size",
+                                               "Size",
+                                               "The estimated number of bytes held",
+                                               0,
+                                               G_MAXUINT64,
+                                               0,
+                                               G_PARAM_READABLE);
+
+  properties[PROP_HITS] = g_param_spec_uint64 ("hits",
+                                               "Hits",
+                                               "Lookups that found an existing entry",
+                                               0,
+                                               G_MAXUINT64,
+                                               0,
+                                               G_PARAM_READABLE);
+
+  properties[PROP_MISSES] = g_param_spec_uint64 ("misses",
+                                                 "Misses",
+                                                 "Lookups that had to build a new entry",
+                                                 0,
+                                                 G_MAXUINT64,
+                                                 0,
+                                                 G_PARAM_READABLE);
+
+  g_object_class_install_properties (object_class, LAST_PROP, properties);
+}
+
+static void
+llyfr_result_cache_init (LlyfrResultCache *self)
+{
+  self->entries = g_hash_table_new (NULL, NULL);
+  g_queue_init (&self->lru);
+
+  self->max_entries = 256;
+  self->max_size = 64 * 1024 * 1024;
+}
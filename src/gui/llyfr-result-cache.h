@@ -0,0 +1,72 @@
+/* llyfr-result-cache.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_RESULT_CACHE_H
+#define LLYFR_RESULT_CACHE_H
+
+#include <glib-object.h>
+
+#include "llyfr-search-result.h"
+
+G_BEGIN_DECLS
+
+#define LLYFR_TYPE_RESULT_CACHE (llyfr_result_cache_get_type())
+
+G_DECLARE_FINAL_TYPE (LlyfrResultCache, llyfr_result_cache, LLYFR, RESULT_CACHE, GObject)
+
+/*
+ * Builds the value to be cached for @result, setting @cost to an estimate
+ * of how many bytes it holds on to.
+ */
+typedef gpointer (*LlyfrResultCacheBuildFunc) (LlyfrSearchResult *result,
+                                               gsize             *cost,
+                                               gpointer           user_data);
+
+LlyfrResultCache* llyfr_result_cache_new             (LlyfrResultCacheBuildFunc build_func,
+                                                      GDestroyNotify value_free,
+                                                      gpointer user_data);
+
+gpointer          llyfr_result_cache_acquire         (LlyfrResultCache *cache,
+                                                      LlyfrSearchResult *result);
+
+void              llyfr_result_cache_release         (LlyfrResultCache *cache,
+                                                      LlyfrSearchResult *result);
+
+void              llyfr_result_cache_clear           (LlyfrResultCache *cache);
+
+guint             llyfr_result_cache_get_max_entries (LlyfrResultCache *cache);
+
+void              llyfr_result_cache_set_max_entries (LlyfrResultCache *cache,
+                                                      guint max_entries);
+
+guint64           llyfr_result_cache_get_max_size    (LlyfrResultCache *cache);
+
+void              llyfr_result_cache_set_max_size    (LlyfrResultCache *cache,
+                                                      guint64 max_size);
+
+guint64           llyfr_result_cache_get_size        (LlyfrResultCache *cache);
+
+guint64           llyfr_result_cache_get_hits        (LlyfrResultCache *cache);
+
+guint64           llyfr_result_cache_get_misses      (LlyfrResultCache *cache);
+
+G_END_DECLS
+
+#endif /* LLYFR_RESULT_CACHE_H */
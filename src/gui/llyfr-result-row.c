@@ -0,0 +1,498 @@
+/* llyfr-result-row.c
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "llyfr-result-row"
+
+#include <string.h>
+
+#include "llyfr-memory-stats.h"
+#include "llyfr-result-row.h"
+
+/*
+ * Displays a single search result, the file's path followed by each of its
+ * matching lines. Rather than a GtkTextView and its buffer per row, the text
+ * is drawn straight from a pair of PangoLayouts using attributes worked out
+ * once per result (see LlyfrResultText). Text can still be selected by
+ * dragging and copied with the usual shortcut.
+ */
+
+#define PADDING         6
+#define SEPARATOR_WIDTH 1
+
+struct _LlyfrResultText
+{
+  gchar          *text;
+  gsize           length;
+
+  // Bytes taken up by the line number at the start of each line.
+  guint           gutter_length;
+
+  PangoAttrList  *attrs;
+
+  // Roughly what all of the above takes up.
+  gsize           cost;
+};
+
+struct _LlyfrResultRow
+{
+  GtkWidget     parent_instance;
+
+  PangoLayout  *header;
+  PangoLayout  *body;
+  guint         gutter_length;
+
+  gint          selection_bound;
+  gint          selection_insert;
+};
+
+G_DEFINE_TYPE (LlyfrResultRow, llyfr_result_row, GTK_TYPE_WIDGET)
+
+static const GdkRGBA separator_color = { 0.576, 0.631, 0.631, 1.0 };
+static const GdkRGBA selection_color = { 0.576, 0.631, 0.631, 0.4 };
+
+LlyfrResultText*
+llyfr_result_text_new (LlyfrSearchResult *result,
+                       gsize *cost)
+{
+  LlyfrResultText *self = g_new0 (LlyfrResultText, 1);
+  guint n_matches = llyfr_search_result_get_n_matches (result);
+  GString *text = g_string_new (NULL);
+  PangoAttribute *attr;
+  gint64 max_line_number = 0;
+  guint n_attrs = 0;
+  gint digits = 1;
+
+  for (guint index = 0; index < n_matches; index++)
+    max_line_number = MAX (max_line_number, llyfr_search_result_get_match_line_number (result, index));
+
+  for (gint64 n = max_line_number; n >= 10; n /= 10)
+    digits++;
+
+  self->gutter_length = digits + 2;
+  self->attrs = pango_attr_list_new ();
+
+  pango_attr_list_insert (self->attrs, pango_attr_family_new ("monospace"));
+
+  // Attributes are added in order of their start index, which Pango can
+  // append without searching the list.
+  for (guint index = 0; index < n_matches; index++) {
+    const LlyfrSearchSpan *highlights;
+    gint64 line_number;
+    guint n_highlights;
+    gsize line_start, content_start, length;
+    const gchar *line;
+
+    line_number = llyfr_search_result_get_match_line_number (result, index);
+    line = llyfr_search_result_get_match_text (result, index, &length);
+    highlights = llyfr_search_result_get_match_highlights (result, index, &n_highlights);
+
+    line_start = text->len;
+    if (line_number >= 0)
+      g_string_append_printf (text, "%*" G_GINT64_FORMAT "  ", digits, line_number);
+    else
+      g_string_append_printf (text, "%*s  ", digits, "");
+
+    attr = pango_attr_foreground_new (0x9393, 0xa1a1, 0xa1a1);
+    attr->start_index = line_start;
+    attr->end_index = line_start + digits;
+    pango_attr_list_insert (self->attrs, attr);
+
+    content_start = text->len;
+    g_string_append_len (text, line, length);
+
+    for (guint i = 0; i < n_highlights; i++) {
+      attr = pango_attr_background_new (0x2626, 0x8b8b, 0xd2d2);
+      attr->start_index = content_start + highlights[i].start;
+      attr->end_index = content_start + highlights[i].end;
+      pango_attr_list_insert (self->attrs, attr);
+
+      attr = pango_attr_foreground_new (0xffff, 0xffff, 0xffff);
+      attr->start_index = content_start + highlights[i].start;
+      attr->end_index = content_start + highlights[i].end;
+      pango_attr_list_insert (self->attrs, attr);
+    }
+
+    n_attrs += 1 + 2 * n_highlights;
+
+    if (index + 1 < n_matches)
+      g_string_append_c (text, '\n');
+  }
+
+  self->length = text->len;
+  self->text = g_string_free (text, FALSE);
+
+  self->cost = sizeof (LlyfrResultText) + self->length + n_attrs * 2 * sizeof (PangoAttribute);
+  if (cost != NULL)
+    *cost = self->cost;
+
+  llyfr_memory_stats_add (LLYFR_MEMORY_BUFFERS, 1);
+  llyfr_memory_stats_add (LLYFR_MEMORY_BUFFER_BYTES, self->cost);
+
+  return self;
+}
+
+void
+llyfr_result_text_free (LlyfrResultText *text)
+{
+  if (text == NULL)
+    return;
+
+  llyfr_memory_stats_add (LLYFR_MEMORY_BUFFERS, -1);
+  llyfr_memory_stats_add (LLYFR_MEMORY_BUFFER_BYTES, -(gssize) text->cost);
+
+  g_free (text->text);
+  pango_attr_list_unref (text->attrs);
+
+  g_free (text);
+}
+
+LlyfrResultRow*
+llyfr_result_row_new (void)
+{
+  return g_object_new (LLYFR_TYPE_RESULT_ROW, NULL);
+}
+
+/*
+ * Show @text, pass NULL to clear the row. The row keeps its own copy of
+ * anything it needs.
+ */
+void
+llyfr_result_row_set_text (LlyfrResultRow *self,
+                           const gchar *filepath,
+                           const LlyfrResultText *text)
+{
+  g_return_if_fail (LLYFR_IS_RESULT_ROW (self));
+
+  pango_layout_set_text (self->header, filepath ? filepath : "", -1);
+
+  if (text != NULL) {
+    pango_layout_set_text (self->body, text->text, text->length);
+    pango_layout_set_attributes (self->body, text->attrs);
+    self->gutter_length = text->gutter_length;
+  } else {
+    pango_layout_set_text (self->body, "", 0);
+    pango_layout_set_attributes (self->body, NULL);
+    self->gutter_length = 0;
+  }
+
+  self->selection_bound = 0;
+  self->selection_insert = 0;
+
+  gtk_widget_queue_resize (GTK_WIDGET (self));
+}
+
+static int
+llyfr_result_row_get_body_y (LlyfrResultRow *self)
+{
+  int header_height;
+
+  pango_layout_get_pixel_size (self->header, NULL, &header_height);
+  return header_height + 3 * PADDING + SEPARATOR_WIDTH;
+}
+
+static gint
+llyfr_result_row_get_index_at (LlyfrResultRow *self,
+                               double x,
+                               double y)
+{
+  const gchar *text = pango_layout_get_text (self->body);
+  int body_y = llyfr_result_row_get_body_y (self);
+  int index, trailing;
+
+  if (y < body_y)
+    return 0;
+
+  pango_layout_xy_to_index (self->body,
+                            (x - PADDING) * PANGO_SCALE,
+                            (y - body_y) * PANGO_SCALE,
+                            &index, &trailing);
+
+  return g_utf8_offset_to_pointer (text + index, trailing) - text;
+}
+
+static void
+drag_begin_cb (GtkGestureDrag *gesture,
+               double x,
+               double y,
+               LlyfrResultRow *self)
+{
+  self->selection_bound = llyfr_result_row_get_index_at (self, x, y);
+  self->selection_insert = self->selection_bound;
+
+  gtk_widget_grab_focus (GTK_WIDGET (self));
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+static void
+drag_update_cb (GtkGestureDrag *gesture,
+                double offset_x,
+                double offset_y,
+                LlyfrResultRow *self)
+{
+  double x, y;
+
+  gtk_gesture_drag_get_start_point (gesture, &x, &y);
+  self->selection_insert = llyfr_result_row_get_index_at (self, x + offset_x, y + offset_y);
+
+  gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+/*
+ * Copy the selected text, leaving out the line numbers.
+ */
+static void
+llyfr_result_row_copy (GtkWidget  *widget,
+                       const char *action_name,
+                       GVariant   *parameter)
+{
+  LlyfrResultRow *self = LLYFR_RESULT_ROW (widget);
+  const gchar *text = pango_layout_get_text (self->body);
+  gsize start = MIN (self->selection_bound, self->selection_insert);
+  gsize end = MAX (self->selection_bound, self->selection_insert);
+  gsize length = strlen (text);
+  gsize line_start = 0;
+  GString *selected;
+
+  if (start == end)
+    return;
+
+  selected = g_string_new (NULL);
+
+  while (line_start < end) {
+    const gchar *newline = memchr (text + line_start, '\n', length - line_start);
+    gsize line_end = newline ? (gsize) (newline - text) : length;
+    gsize content_start = MIN (line_start + self->gutter_length, line_end);
+    gsize from = MAX (content_start, start);
+    gsize to = MIN (line_end, end);
+
+    if (from < to)
+      g_string_append_len (selected, text + from, to - from);
+
+    if (newline == NULL)
+      break;
+
+    if (line_end >= start && line_end < end)
+      g_string_append_c (selected, '\n');
+
+    line_start = line_end + 1;
+  }
+
+  gdk_clipboard_set_text (gtk_widget_get_clipboard (widget), selected->str);
+  g_string_free (selected, TRUE);
+}
+
+static void
+llyfr_result_row_select_all (GtkWidget  *widget,
+                             const char *action_name,
+                             GVariant   *parameter)
+{
+  LlyfrResultRow *self = LLYFR_RESULT_ROW (widget);
+
+  self->selection_bound = 0;
+  self->selection_insert = strlen (pango_layout_get_text (self->body));
+
+  gtk_widget_queue_draw (widget);
+}
+
+static GtkSizeRequestMode
+llyfr_result_row_get_request_mode (GtkWidget *widget)
+{
+  return GTK_SIZE_REQUEST_HEIGHT_FOR_WIDTH;
+}
+
+static void
+llyfr_result_row_measure (GtkWidget      *widget,
+                          GtkOrientation  orientation,
+                          int             for_size,
+                          int            *minimum,
+                          int            *natural,
+                          int            *minimum_baseline,
+                          int            *natural_baseline)
+{
+  LlyfrResultRow *self = LLYFR_RESULT_ROW (widget);
+  int header_size, body_size;
+
+  if (orientation == GTK_ORIENTATION_HORIZONTAL) {
+    pango_layout_set_width (self->header, -1);
+    pango_layout_set_width (self->body, -1);
+
+    pango_layout_get_pixel_size (self->header, &header_size, NULL);
+    pango_layout_get_pixel_size (self->body, &body_size, NULL);
+
+    *minimum = 2 * PADDING;
+    *natural = MAX (header_size, body_size) + 2 * PADDING;
+  } else {
+    int width = for_size < 0 ? -1 : MAX (for_size - 2 * PADDING, 1) * PANGO_SCALE;
+
+    pango_layout_set_width (self->header, width);
+    pango_layout_set_width (self->body, width);
+
+    pango_layout_get_pixel_size (self->header, NULL, &header_size);
+    pango_layout_get_pixel_size (self->body, NULL, &body_size);
+
+    *minimum = *natural = header_size + body_size + 4 * PADDING + SEPARATOR_WIDTH;
+  }
+
+  *minimum_baseline = -1;
+  *natural_baseline = -1;
+}
+
+static void
+llyfr_result_row_size_allocate (GtkWidget *widget,
+                                int        width,
+                                int        height,
+                                int        baseline)
+{
+  LlyfrResultRow *self = LLYFR_RESULT_ROW (widget);
+  int layout_width = MAX (width - 2 * PADDING, 1) * PANGO_SCALE;
+
+  pango_layout_set_width (self->header, layout_width);
+  pango_layout_set_width (self->body, layout_width);
+}
+
+static void
+llyfr_result_row_snapshot_selection (LlyfrResultRow *self,
+                                     GtkSnapshot    *snapshot)
+{
+  gint start = MIN (self->selection_bound, self->selection_insert);
+  gint end = MAX (self->selection_bound, self->selection_insert);
+  PangoLayoutIter *iter;
+
+  if (start == end)
+    return;
+
+  iter = pango_layout_get_iter (self->body);
+
+  do {
+    PangoLayoutLine *line = pango_layout_iter_get_line_readonly (iter);
+    gint *ranges = NULL;
+    gint n_ranges = 0;
+    gint y0, y1;
+
+    if (line->start_index + line->length < start || line->start_index > end)
+      continue;
+
+    pango_layout_iter_get_line_yrange (iter, &y0, &y1);
+    pango_layout_line_get_x_ranges (line, start, end, &ranges, &n_ranges);
+
+    for (gint i = 0; i < n_ranges; i++) {
+      gtk_snapshot_append_color (snapshot,
+                                 &selection_color,
+                                 &GRAPHENE_RECT_INIT (ranges[2 * i] / (float) PANGO_SCALE,
+                                                      y0 / (float) PANGO_SCALE,
+                                                      (ranges[2 * i + 1] - ranges[2 * i]) / (float) PANGO_SCALE,
+                                                      (y1 - y0) / (float) PANGO_SCALE));
+    }
+
+    g_free (ranges);
+  } while (pango_layout_iter_next_line (iter));
+
+  pango_layout_iter_free (iter);
+}
+
+static void
+llyfr_result_row_snapshot (GtkWidget   *widget,
+                           GtkSnapshot *snapshot)
+{
+  LlyfrResultRow *self = LLYFR_RESULT_ROW (widget);
+  int width = gtk_widget_get_width (widget);
+  int body_y = llyfr_result_row_get_body_y (self);
+  GdkRGBA color;
+
+#if GTK_CHECK_VERSION (4, 10, 0)
+  gtk_widget_get_color (widget, &color);
+#else
+  gtk_style_context_get_color (gtk_widget_get_style_context (widget), &color);
+#endif
+
+  gtk_snapshot_save (snapshot);
+  gtk_snapshot_translate (snapshot, &GRAPHENE_POINT_INIT (PADDING, PADDING));
+  gtk_snapshot_append_layout (snapshot, self->header, &color);
+  gtk_snapshot_restore (snapshot);
+
+  gtk_snapshot_append_color (snapshot,
+                             &separator_color,
+                             &GRAPHENE_RECT_INIT (0, body_y - PADDING - SEPARATOR_WIDTH,
+                                                  width, SEPARATOR_WIDTH));
+
+  gtk_snapshot_save (snapshot);
+  gtk_snapshot_translate (snapshot, &GRAPHENE_POINT_INIT (PADDING, body_y));
+  llyfr_result_row_snapshot_selection (self, snapshot);
+  gtk_snapshot_append_layout (snapshot, self->body, &color);
+  gtk_snapshot_restore (snapshot);
+}
+
+static void
+llyfr_result_row_dispose (GObject *object)
+{
+  LlyfrResultRow *self = LLYFR_RESULT_ROW (object);
+
+  g_clear_object (&self->header);
+  g_clear_object (&self->body);
+
+  G_OBJECT_CLASS (llyfr_result_row_parent_class)->dispose (object);
+}
+
+static void
+llyfr_result_row_class_init (LlyfrResultRowClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  object_class->dispose = llyfr_result_row_dispose;
+
+  widget_class->get_request_mode = llyfr_result_row_get_request_mode;
+  widget_class->measure = llyfr_result_row_measure;
+  widget_class->size_allocate = llyfr_result_row_size_allocate;
+  widget_class->snapshot = llyfr_result_row_snapshot;
+
+  gtk_widget_class_install_action (widget_class, "clipboard.copy", NULL, llyfr_result_row_copy);
+  gtk_widget_class_install_action (widget_class, "selection.select-all", NULL, llyfr_result_row_select_all);
+
+  gtk_widget_class_add_binding_action (widget_class, GDK_KEY_c, GDK_CONTROL_MASK, "clipboard.copy", NULL);
+  gtk_widget_class_add_binding_action (widget_class, GDK_KEY_a, GDK_CONTROL_MASK, "selection.select-all", NULL);
+
+  gtk_widget_class_set_css_name (widget_class, "llyfrresultrow");
+}
+
+static void
+llyfr_result_row_init (LlyfrResultRow *self)
+{
+  GtkGesture *drag;
+  PangoAttrList *attrs;
+
+  gtk_widget_set_focusable (GTK_WIDGET (self), TRUE);
+
+  self->header = gtk_widget_create_pango_layout (GTK_WIDGET (self), NULL);
+  pango_layout_set_ellipsize (self->header, PANGO_ELLIPSIZE_START);
+
+  attrs = pango_attr_list_new ();
+  pango_attr_list_insert (attrs, pango_attr_weight_new (PANGO_WEIGHT_BOLD));
+  pango_layout_set_attributes (self->header, attrs);
+  pango_attr_list_unref (attrs);
+
+  self->body = gtk_widget_create_pango_layout (GTK_WIDGET (self), NULL);
+  pango_layout_set_wrap (self->body, PANGO_WRAP_WORD_CHAR);
+
+  drag = gtk_gesture_drag_new ();
+  g_signal_connect (drag, "drag-begin", G_CALLBACK (drag_begin_cb), self);
+  g_signal_connect (drag, "drag-update", G_CALLBACK (drag_update_cb), self);
+  gtk_widget_add_controller (GTK_WIDGET (self), GTK_EVENT_CONTROLLER (drag));
+}
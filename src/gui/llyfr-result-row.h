@@ -0,0 +1,55 @@
+/* llyfr-result-row.h
+ *
+ * Copyright 2021 Alex Carney <alcarneyme@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef LLYFR_RESULT_ROW_H
+#define LLYFR_RESULT_ROW_H
+
+#include <glib-object.h>
+#include <gtk/gtk.h>
+
+#include "llyfr-search-result.h"
+
+G_BEGIN_DECLS
+
+#define LLYFR_TYPE_RESULT_ROW (llyfr_result_row_get_type())
+
+G_DECLARE_FINAL_TYPE (LlyfrResultRow, llyfr_result_row, LLYFR, RESULT_ROW, GtkWidget)
+
+/*
+ * The text of a result, line numbers and all, along with the attributes
+ * needed to draw it. Built once per result and shared by whichever row
+ * happens to be displaying it.
+ */
+typedef struct _LlyfrResultText LlyfrResultText;
+
+LlyfrResultText* llyfr_result_text_new      (LlyfrSearchResult *result,
+                                             gsize *cost);
+
+void             llyfr_result_text_free     (LlyfrResultText *text);
+
+LlyfrResultRow*  llyfr_result_row_new       (void);
+
+void             llyfr_result_row_set_text  (LlyfrResultRow *row,
+                                             const gchar *filepath,
+                                             const LlyfrResultText *text);
+
+G_END_DECLS
+
+#endif /* LLYFR_RESULT_ROW_H */
@@ -21,6 +21,7 @@
 #define G_LOG_DOMAIN "llyfr-search-bar"
 
 #include "llyfr-application.h"
+#include "llyfr-query-cache.h"
 #include "llyfr-search-bar.h"
 #include "llyfr-search-context.h"
 #include "llyfr-search-context-switcher.h"
@@ -29,12 +30,52 @@ struct _LlyfrSearchBar
 {
   GtkBox                           parent_instance;
 
-  LlyfrSearchContext              *current_context;
+  // The contexts being searched and, at the same index, the results found
+  // in each.
+  GPtrArray                       *current_contexts;
+  GPtrArray                       *context_results;
 
+  // context_results merged into one model, grouped by context.
+  GListModel                      *current_results;
+  GCancellable                    *current_search;
+  gchar                           *current_query;
+  LlyfrQueryCache                 *query_cache;
+  GSettings                       *settings;
+
+  // The number of contexts current_search is still waiting on.
+  guint                            pending_searches;
+  gboolean                         search_failed;
+
+  // Set when current_search ran out of budget, saying why.
+  gchar                           *partial_message;
+
+  // How many times over the default budget the current query gets, grown
+  // each time the user asks to continue.
+  guint                            budget_scale;
+
+  // The query context_results holds the complete results for, if any.
+  gchar                           *completed_query;
+
+  // When the search behind context_results started. Refining results
+  // doesn't look at the files again, so they're only as new as that.
+  gint64                           results_started;
+
+  // The indexes of current_contexts, if they have them.
+  GPtrArray                       *current_indexes;
+
+  // Searched in place of the working tree, when set.
+  gchar                          **current_revisions;
+
+  // Where current_query's time went, across all the contexts, when
+  // tracing is turned on.
+  LlyfrTrace                      *current_trace;
+
+  GtkEntry                        *revision_entry;
   GtkSearchEntry                  *search_entry;
   GtkButton                       *search_button;
 
   GtkLabel                        *context_label;
+  GtkImage                        *index_status;
   GtkButton                       *context_switch_button;
   LlyfrSearchContextSwitcher      *context_switcher;
   GtkPopover                      *context_popover;
@@ -44,34 +85,242 @@ G_DEFINE_TYPE (LlyfrSearchBar, llyfr_search_bar, GTK_TYPE_BOX)
 
 enum {
   SIGNAL_SEARCH,
+  SIGNAL_SEARCH_FINISHED,
   N_SIGNALS
 };
 
 static guint signals[N_SIGNALS] = {0, };
 
+/*
+ * The search of a single context, as part of a search across many.
+ */
+typedef struct {
+  // Weak, so closing the window disposes of the bar and cancels the search
+  // rather than the search keeping the bar alive until it's done.
+  GWeakRef            self;
+  LlyfrSearchContext *context;
+  GListStore         *results;
+  GCancellable       *cancellable;
+
+  // When it started, anything changed since may not be in its results.
+  gint64              started;
+} ContextSearch;
+
 static void
-search_cb (LlyfrSearchBar *self, GtkSearchEntry *search_entry)
+context_search_free (ContextSearch *search)
 {
-  const char* query;
+  g_weak_ref_clear (&search->self);
+  g_object_unref (search->context);
+  g_object_unref (search->results);
+  g_object_unref (search->cancellable);
+  g_free (search);
+}
 
-  g_assert (LLYFR_IS_SEARCH_BAR (self));
-  g_assert (GTK_IS_SEARCH_ENTRY (search_entry));
+static void
+llyfr_search_bar_cancel_search (LlyfrSearchBar *self)
+{
+  if (self->current_search == NULL)
+    return;
 
+  g_cancellable_cancel (self->current_search);
+  g_clear_object (&self->current_search);
+  self->pending_searches = 0;
+}
 
-  query = gtk_editable_get_text (GTK_EDITABLE (search_entry));
+/*
+ * Called as each context finishes, the search as a whole is finished once
+ * they all have.
+ */
+static void
+llyfr_search_bar_context_done (LlyfrSearchBar *self)
+{
+  g_assert (self->pending_searches > 0);
 
-  GError* error = NULL;
-  GListModel *model = llyfr_search_context_search (self->current_context,
-                                                   query, &error);
-  if (model == NULL) {
-    g_message ("Error while searching: %s", error->message);
+  if (--self->pending_searches > 0)
+    return;
+
+  g_clear_object (&self->current_search);
+  llyfr_trace_finish (self->current_trace);
+
+  if (!self->search_failed)
+    self->completed_query = g_strdup (self->current_query);
+
+  g_message ("Found %d results!", g_list_model_get_n_items (self->current_results));
+  g_signal_emit (self, signals[SIGNAL_SEARCH_FINISHED], 0, self->current_results);
+}
+
+static void
+search_finished_cb (GObject      *object,
+                    GAsyncResult *result,
+                    gpointer      user_data)
+{
+  ContextSearch *search = user_data;
+  g_autoptr(LlyfrSearchBar) self = g_weak_ref_get (&search->self);
+  g_autoptr(GError) error = NULL;
+
+  if (!llyfr_search_context_search_finish (LLYFR_SEARCH_CONTEXT (object), result, &error) &&
+      !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) &&
+      !g_error_matches (error, LLYFR_SEARCH_CONTEXT_ERROR, LLYFR_SEARCH_CONTEXT_ERROR_PARTIAL))
+    g_message ("Error while searching %s: %s",
+               llyfr_search_context_get_directory (search->context),
+               error->message);
+
+  // Superseded by a newer search, which now owns the results, or the bar
+  // has gone altogether.
+  if (self == NULL || search->cancellable != self->current_search) {
+    context_search_free (search);
     return;
   }
 
-  g_message ("Found %d results!", g_list_model_get_n_items (model));
-  g_signal_emit(self, signals[SIGNAL_SEARCH], 0, model);
+  if (error == NULL)
+    llyfr_query_cache_insert (self->query_cache,
+                              search->context,
+                              self->current_query,
+                              G_LIST_MODEL (search->results),
+                              search->started);
+  else
+    self->search_failed = TRUE;
+
+  if (g_error_matches (error, LLYFR_SEARCH_CONTEXT_ERROR, LLYFR_SEARCH_CONTEXT_ERROR_PARTIAL) &&
+      self->partial_message == NULL)
+    self->partial_message = g_strdup (error->message);
+
+  llyfr_search_bar_context_done (self);
+  context_search_free (search);
 }
 
+static void
+llyfr_search_bar_start_search (LlyfrSearchBar *self,
+                               const char     *query)
+{
+  g_autoptr(GPtrArray) previous = NULL;
+  g_autoptr(GListStore) groups = NULL;
+  LlyfrSearchBudget budget;
+  gboolean refine = FALSE;
+
+  llyfr_search_bar_cancel_search (self);
+
+  if (self->current_contexts == NULL || query == NULL || *query == '\0')
+    return;
+
+  // A new query starts back at the default budget.
+  if (g_strcmp0 (query, self->current_query) != 0)
+    self->budget_scale = 1;
+
+  llyfr_search_budget_scale (llyfr_search_context_get_default_budget (), self->budget_scale, &budget);
+  g_clear_pointer (&self->partial_message, g_free);
+  g_clear_pointer (&self->current_query, g_free);
+  self->current_query = g_strdup (query);
+
+  // Typing more of a plain query only ever narrows down its results, so
+  // when the last search ran to completion we can filter what it found
+  // rather than going back to rg.
+  if (self->context_results != NULL && self->completed_query != NULL)
+    refine = llyfr_search_context_can_refine (g_ptr_array_index (self->current_contexts, 0),
+                                              self->completed_query, query);
+
+  g_clear_pointer (&self->completed_query, g_free);
+
+  if (!refine)
+    self->results_started = g_get_real_time ();
+
+  // Results are appended to the model as they are found, so hand it out
+  // straight away rather than waiting for the search to complete.
+  previous = g_steal_pointer (&self->context_results);
+  self->context_results = g_ptr_array_new_with_free_func (g_object_unref);
+  groups = g_list_store_new (G_TYPE_LIST_MODEL);
+
+  for (guint i = 0; i < self->current_contexts->len; i++) {
+    GListStore *results = g_list_store_new (LLYFR_TYPE_SEARCH_RESULT);
+
+    g_ptr_array_add (self->context_results, results);
+    g_list_store_append (groups, results);
+  }
+
+  g_clear_pointer (&self->current_trace, llyfr_trace_unref);
+  if (llyfr_trace_get_enabled ())
+    self->current_trace = llyfr_trace_new (query);
+
+  g_clear_object (&self->current_results);
+  self->current_results = G_LIST_MODEL (gtk_flatten_list_model_new (G_LIST_MODEL (g_steal_pointer (&groups))));
+  g_signal_emit (self, signals[SIGNAL_SEARCH], 0, self->current_results);
+
+  self->current_search = g_cancellable_new ();
+  self->search_failed = FALSE;
+
+  // Held until every search has been started, so one finishing straight
+  // away can't finish the whole thing.
+  self->pending_searches = 1;
+
+  for (guint i = 0; i < self->current_contexts->len; i++) {
+    LlyfrSearchContext *context = g_ptr_array_index (self->current_contexts, i);
+    GListStore *results = g_ptr_array_index (self->context_results, i);
+    ContextSearch *search;
+
+    if (llyfr_query_cache_lookup (self->query_cache, context, query, results)) {
+      g_debug ("Using cached results for '%s' in %s",
+               query, llyfr_search_context_get_directory (context));
+      continue;
+    }
+
+    search = g_new0 (ContextSearch, 1);
+    g_weak_ref_init (&search->self, self);
+    search->context = g_object_ref (context);
+    search->results = g_object_ref (results);
+    search->cancellable = g_object_ref (self->current_search);
+    search->started = self->results_started;
+    self->pending_searches++;
+
+    if (refine) {
+      g_debug ("Refining results for '%s' in %s",
+               query, llyfr_search_context_get_directory (context));
+      llyfr_search_context_refine_async (context,
+                                         G_LIST_MODEL (g_ptr_array_index (previous, i)),
+                                         query,
+                                         self->current_trace,
+                                         results,
+                                         search->cancellable,
+                                         search_finished_cb,
+                                         search);
+      continue;
+    }
+
+    // The contexts don't all start rg straight away, past a certain
+    // number they wait for an earlier search to finish.
+    llyfr_search_context_search_full_async (context,
+                                            query,
+                                            &budget,
+                                            self->current_trace,
+                                            results,
+                                            search->cancellable,
+                                            search_finished_cb,
+                                            search);
+  }
+
+  llyfr_search_bar_context_done (self);
+}
+
+static void
+search_cb (LlyfrSearchBar *self, GtkSearchEntry *search_entry)
+{
+  g_assert (LLYFR_IS_SEARCH_BAR (self));
+  g_assert (GTK_IS_SEARCH_ENTRY (search_entry));
+
+  const char *text = gtk_editable_get_text (GTK_EDITABLE (search_entry));
+
+  // Pressing Enter also flushes ::search-changed, which has most likely
+  // already started this same search, don't throw it away and start over.
+  if (self->current_search != NULL && g_strcmp0 (text, self->current_query) == 0)
+    return;
+
+  llyfr_search_bar_start_search (self, text);
+}
+
+/*
+ * GtkSearchEntry only emits ::search-changed once typing has paused for a
+ * moment, so searching from here already gives us a debounced
+ * search-as-you-type.
+ */
 static void
 search_changed_cb (LlyfrSearchBar *self, GtkSearchEntry *search_entry)
 {
@@ -84,6 +333,65 @@ search_changed_cb (LlyfrSearchBar *self, GtkSearchEntry *search_entry)
   } else {
     gtk_widget_set_sensitive (GTK_WIDGET (self->search_button), FALSE);
   }
+
+  llyfr_search_bar_start_search (self, text);
+}
+
+static void
+stop_search_cb (LlyfrSearchBar *self, GtkSearchEntry *search_entry)
+{
+  g_assert (LLYFR_IS_SEARCH_BAR (self));
+  g_assert (GTK_IS_SEARCH_ENTRY (search_entry));
+
+  llyfr_search_bar_cancel_search (self);
+}
+
+static void
+llyfr_search_bar_apply_revisions (LlyfrSearchBar *self)
+{
+  if (self->current_contexts == NULL)
+    return;
+
+  for (guint i = 0; i < self->current_contexts->len; i++)
+    llyfr_search_context_set_revisions (g_ptr_array_index (self->current_contexts, i),
+                                        (const gchar * const *) self->current_revisions);
+}
+
+/*
+ * Revisions are separated by spaces, leaving the entry empty searches the
+ * working tree.
+ */
+static void
+revision_cb (LlyfrSearchBar *self, GtkEntry *entry)
+{
+  g_auto(GStrv) words = NULL;
+  GPtrArray *revisions;
+
+  g_assert (LLYFR_IS_SEARCH_BAR (self));
+  g_assert (GTK_IS_ENTRY (entry));
+
+  words = g_strsplit_set (gtk_editable_get_text (GTK_EDITABLE (entry)), " \t", -1);
+  revisions = g_ptr_array_new ();
+
+  for (guint i = 0; words[i] != NULL; i++) {
+    if (*words[i] != '\0')
+      g_ptr_array_add (revisions, g_strdup (words[i]));
+  }
+
+  g_clear_pointer (&self->current_revisions, g_strfreev);
+  if (revisions->len > 0) {
+    g_ptr_array_add (revisions, NULL);
+    self->current_revisions = (gchar **) g_ptr_array_free (revisions, FALSE);
+  } else {
+    g_ptr_array_free (revisions, TRUE);
+  }
+
+  llyfr_search_bar_apply_revisions (self);
+
+  // What we have was found somewhere else, so search again from scratch.
+  g_clear_pointer (&self->completed_query, g_free);
+  g_clear_pointer (&self->context_results, g_ptr_array_unref);
+  llyfr_search_bar_start_search (self, gtk_editable_get_text (GTK_EDITABLE (self->search_entry)));
 }
 
 static void
@@ -94,27 +402,203 @@ switch_context_cb (LlyfrSearchBar *self, GtkButton *button)
   gtk_popover_popup (self->context_popover);
 }
 
+/*
+ * Show how up to date the indexes of the current contexts are, going by
+ * whichever is furthest behind.
+ */
+static void
+llyfr_search_bar_update_index_status (LlyfrSearchBar *self)
+{
+  g_autofree gchar *tooltip = NULL;
+  guint n_building = 0;
+  guint n_stale = 0;
+  guint n_indexes;
+
+  n_indexes = self->current_indexes ? self->current_indexes->len : 0;
+  gtk_widget_set_visible (GTK_WIDGET (self->index_status), n_indexes > 0);
+
+  if (n_indexes == 0)
+    return;
+
+  for (guint i = 0; i < n_indexes; i++) {
+    switch (llyfr_trigram_index_get_state (g_ptr_array_index (self->current_indexes, i))) {
+      case LLYFR_TRIGRAM_INDEX_BUILDING:
+        n_building++;
+        break;
+
+      case LLYFR_TRIGRAM_INDEX_MISSING:
+      case LLYFR_TRIGRAM_INDEX_STALE:
+        n_stale++;
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  if (n_building > 0) {
+    gtk_image_set_from_icon_name (self->index_status, "content-loading-symbolic");
+    tooltip = g_strdup_printf ("Indexing %u of %u repositories", n_building, n_indexes);
+  } else if (n_stale > 0) {
+    gtk_image_set_from_icon_name (self->index_status, "dialog-warning-symbolic");
+    tooltip = g_strdup_printf ("%u of %u indexes out of date", n_stale, n_indexes);
+  } else if (n_indexes == 1) {
+    gint64 built = llyfr_trigram_index_get_built_time (g_ptr_array_index (self->current_indexes, 0));
+    g_autoptr(GDateTime) time = g_date_time_new_from_unix_local (built);
+
+    gtk_image_set_from_icon_name (self->index_status, "emblem-ok-symbolic");
+    tooltip = g_date_time_format (time, "Index up to date, as of %X");
+  } else {
+    gtk_image_set_from_icon_name (self->index_status, "emblem-ok-symbolic");
+    tooltip = g_strdup_printf ("%u indexes up to date", n_indexes);
+  }
+
+  gtk_widget_set_tooltip_text (GTK_WIDGET (self->index_status), tooltip);
+}
+
+static void
+llyfr_search_bar_unwatch_indexes (LlyfrSearchBar *self)
+{
+  for (guint i = 0; self->current_indexes && i < self->current_indexes->len; i++)
+    g_signal_handlers_disconnect_by_data (g_ptr_array_index (self->current_indexes, i), self);
+
+  g_clear_pointer (&self->current_indexes, g_ptr_array_unref);
+}
+
+static void
+llyfr_search_bar_watch_indexes (LlyfrSearchBar *self)
+{
+  llyfr_search_bar_unwatch_indexes (self);
+  self->current_indexes = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (guint i = 0; self->current_contexts && i < self->current_contexts->len; i++) {
+    LlyfrTrigramIndex *index = llyfr_search_context_get_index (g_ptr_array_index (self->current_contexts, i));
+
+    if (index == NULL)
+      continue;
+
+    g_ptr_array_add (self->current_indexes, g_object_ref (index));
+    g_signal_connect_swapped (index, "notify::state",
+                              G_CALLBACK (llyfr_search_bar_update_index_status),
+                              self);
+  }
+
+  llyfr_search_bar_update_index_status (self);
+}
+
+static void
+llyfr_search_bar_set_contexts (LlyfrSearchBar *self,
+                               GPtrArray      *contexts)
+{
+  g_autofree gchar *label = NULL;
+
+  llyfr_search_bar_cancel_search (self);
+
+  g_clear_pointer (&self->current_contexts, g_ptr_array_unref);
+  self->current_contexts = contexts;
+
+  // The results we have are for a different set of directories.
+  g_clear_pointer (&self->completed_query, g_free);
+  g_clear_pointer (&self->context_results, g_ptr_array_unref);
+
+  if (contexts->len == 1)
+    label = g_strdup (llyfr_search_context_get_directory (g_ptr_array_index (contexts, 0)));
+  else
+    label = g_strdup_printf ("%u repositories", contexts->len);
+
+  gtk_label_set_ellipsize (self->context_label, PANGO_ELLIPSIZE_START);
+  gtk_label_set_label (self->context_label, label);
+
+  // Selecting a context is what starts its index being built.
+  llyfr_search_bar_watch_indexes (self);
+  llyfr_search_bar_apply_revisions (self);
+
+  gtk_popover_popdown (self->context_popover);
+
+  gtk_widget_set_sensitive (GTK_WIDGET (self->search_entry), TRUE);
+  gtk_widget_set_sensitive (GTK_WIDGET (self->revision_entry), TRUE);
+}
+
 static void
 select_cb (LlyfrSearchBar *self,
            LlyfrSearchContext *context,
            LlyfrSearchContextSwitcher *switcher)
 {
+  GPtrArray *contexts;
+
   g_assert (LLYFR_IS_SEARCH_BAR (self));
   g_assert (LLYFR_IS_SEARCH_CONTEXT (context));
   g_assert (LLYFR_IS_SEARCH_CONTEXT_SWITCHER (switcher));
 
-  if (self->current_context)
-    g_object_unref (self->current_context);
+  contexts = g_ptr_array_new_with_free_func (g_object_unref);
+  g_ptr_array_add (contexts, g_object_ref (context));
 
-  self->current_context = g_object_ref (context);
+  llyfr_search_bar_set_contexts (self, contexts);
+}
 
-  gtk_label_set_ellipsize (self->context_label, PANGO_ELLIPSIZE_START);
-  gtk_label_set_label (self->context_label,
-                       llyfr_search_context_get_directory (self->current_context));
+static void
+select_many_cb (LlyfrSearchBar *self,
+                GListModel *model,
+                LlyfrSearchContextSwitcher *switcher)
+{
+  GPtrArray *contexts;
+  guint n_items;
 
-  gtk_popover_popdown (self->context_popover);
+  g_assert (LLYFR_IS_SEARCH_BAR (self));
+  g_assert (G_IS_LIST_MODEL (model));
+  g_assert (LLYFR_IS_SEARCH_CONTEXT_SWITCHER (switcher));
 
-  gtk_widget_set_sensitive (GTK_WIDGET (self->search_entry), TRUE);
+  n_items = g_list_model_get_n_items (model);
+  contexts = g_ptr_array_new_full (n_items, g_object_unref);
+
+  for (guint i = 0; i < n_items; i++)
+    g_ptr_array_add (contexts, g_list_model_get_item (model, i));
+
+  llyfr_search_bar_set_contexts (self, contexts);
+}
+
+/*
+ * Why the last search stopped short of finding everything, or NULL if it
+ * didn't.
+ */
+const gchar*
+llyfr_search_bar_get_partial_message (LlyfrSearchBar *self)
+{
+  g_return_val_if_fail (LLYFR_IS_SEARCH_BAR (self), NULL);
+
+  return self->partial_message;
+}
+
+/*
+ * The trace of the last search, or NULL if it wasn't traced.
+ */
+LlyfrTrace*
+llyfr_search_bar_get_trace (LlyfrSearchBar *self)
+{
+  g_return_val_if_fail (LLYFR_IS_SEARCH_BAR (self), NULL);
+
+  return self->current_trace;
+}
+
+/*
+ * Run the last search again with ten times the budget it had.
+ */
+void
+llyfr_search_bar_continue_search (LlyfrSearchBar *self)
+{
+  g_autofree gchar *query = NULL;
+
+  g_return_if_fail (LLYFR_IS_SEARCH_BAR (self));
+
+  if (self->current_query == NULL)
+    return;
+
+  query = g_strdup (self->current_query);
+  self->budget_scale = self->budget_scale > G_MAXUINT / 10 ? G_MAXUINT : self->budget_scale * 10;
+
+  // Refining partial results would only find what's already there.
+  g_clear_pointer (&self->completed_query, g_free);
+  llyfr_search_bar_start_search (self, query);
 }
 
 LlyfrSearchBar*
@@ -130,13 +614,33 @@ llyfr_search_bar_set_application (LlyfrSearchBar *self,
   llyfr_search_context_switcher_set_application (self->context_switcher, app);
 }
 
+static void
+llyfr_search_bar_dispose (GObject *object)
+{
+  LlyfrSearchBar *self = LLYFR_SEARCH_BAR (object);
+
+  // Don't leave rg running once the window has gone.
+  llyfr_search_bar_cancel_search (self);
+  llyfr_search_bar_unwatch_indexes (self);
+
+  G_OBJECT_CLASS (llyfr_search_bar_parent_class)->dispose (object);
+}
+
 static void
 llyfr_search_bar_finalize (GObject *object)
 {
   LlyfrSearchBar *self = LLYFR_SEARCH_BAR (object);
 
-  if (self->current_context)
-    g_object_unref (self->current_context);
+  g_clear_pointer (&self->current_contexts, g_ptr_array_unref);
+  g_clear_pointer (&self->context_results, g_ptr_array_unref);
+  g_clear_object (&self->current_results);
+  g_free (self->current_query);
+  g_free (self->completed_query);
+  g_free (self->partial_message);
+  g_strfreev (self->current_revisions);
+  g_clear_pointer (&self->current_trace, llyfr_trace_unref);
+  g_clear_object (&self->query_cache);
+  g_clear_object (&self->settings);
 
   G_OBJECT_CLASS (llyfr_search_bar_parent_class)->finalize (object);
 }
@@ -152,17 +656,23 @@ llyfr_search_bar_class_init (LlyfrSearchBarClass *klass)
   gtk_widget_class_set_template_from_resource (widget_class, "/io/github/swyddfa/Llyfrgell/gui/llyfr-search-bar.ui");
   gtk_widget_class_bind_template_child (widget_class, LlyfrSearchBar, search_entry);
   gtk_widget_class_bind_template_child (widget_class, LlyfrSearchBar, search_button);
+  gtk_widget_class_bind_template_child (widget_class, LlyfrSearchBar, revision_entry);
 
   gtk_widget_class_bind_template_child (widget_class, LlyfrSearchBar, context_label);
+  gtk_widget_class_bind_template_child (widget_class, LlyfrSearchBar, index_status);
   gtk_widget_class_bind_template_child (widget_class, LlyfrSearchBar, context_popover);
   gtk_widget_class_bind_template_child (widget_class, LlyfrSearchBar, context_switch_button);
   gtk_widget_class_bind_template_child (widget_class, LlyfrSearchBar, context_switcher);
 
+  gtk_widget_class_bind_template_callback (widget_class, revision_cb);
   gtk_widget_class_bind_template_callback (widget_class, search_cb);
   gtk_widget_class_bind_template_callback (widget_class, select_cb);
+  gtk_widget_class_bind_template_callback (widget_class, select_many_cb);
   gtk_widget_class_bind_template_callback (widget_class, search_changed_cb);
+  gtk_widget_class_bind_template_callback (widget_class, stop_search_cb);
   gtk_widget_class_bind_template_callback (widget_class, switch_context_cb);
 
+  object_class->dispose = llyfr_search_bar_dispose;
   object_class->finalize = llyfr_search_bar_finalize;
 
   signals[SIGNAL_SEARCH] = g_signal_new ("search",
@@ -175,10 +685,32 @@ llyfr_search_bar_class_init (LlyfrSearchBarClass *klass)
                                          G_TYPE_NONE,
                                          1,
                                          G_TYPE_LIST_MODEL);
+
+  signals[SIGNAL_SEARCH_FINISHED] = g_signal_new ("search-finished",
+                                                  LLYFR_TYPE_SEARCH_BAR,
+                                                  G_SIGNAL_RUN_LAST,
+                                                  0,
+                                                  NULL,
+                                                  NULL,
+                                                  NULL,
+                                                  G_TYPE_NONE,
+                                                  1,
+                                                  G_TYPE_LIST_MODEL);
 }
 
 static void
 llyfr_search_bar_init (LlyfrSearchBar *self)
 {
   gtk_widget_init_template (GTK_WIDGET (self));
+
+  self->budget_scale = 1;
+  self->query_cache = llyfr_query_cache_new ();
+
+  self->settings = g_settings_new ("io.github.swyddfa.Llyfrgell");
+  g_settings_bind (self->settings, "query-cache-max-entries",
+                   self->query_cache, "max-entries",
+                   G_SETTINGS_BIND_GET);
+  g_settings_bind (self->settings, "query-cache-max-size",
+                   self->query_cache, "max-size",
+                   G_SETTINGS_BIND_GET);
 }
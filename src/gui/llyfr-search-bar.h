@@ -24,6 +24,8 @@
 #include <glib-object.h>
 #include <gtk/gtk.h>
 
+#include "llyfr-trace.h"
+
 G_BEGIN_DECLS
 
 #define LLYFR_TYPE_SEARCH_BAR (llyfr_search_bar_get_type())
@@ -35,6 +37,12 @@ LlyfrSearchBar *llyfr_search_bar_new             (void);
 void            llyfr_search_bar_set_application (LlyfrSearchBar *self,
                                                   GtkApplication *app);
 
+const gchar    *llyfr_search_bar_get_partial_message (LlyfrSearchBar *self);
+
+void            llyfr_search_bar_continue_search (LlyfrSearchBar *self);
+
+LlyfrTrace     *llyfr_search_bar_get_trace (LlyfrSearchBar *self);
+
 G_END_DECLS
 
 #endif /* LLYFR_SEARCH_BAR_H */
@@ -30,8 +30,12 @@ struct _LlyfrSearchContextSwitcher
   GtkSelectionModel       *current_model;
   GtkListItemFactory      *current_factory;
 
+  // The contexts ticked for searching together.
+  GHashTable              *checked;
+
   GtkListView             *context_list;
   GtkSearchEntry          *filter_entry;
+  GtkButton               *search_selected_button;
   GtkButton               *find_repo_button;
   GtkSpinner              *find_repo_spinner;
 };
@@ -40,6 +44,7 @@ G_DEFINE_TYPE (LlyfrSearchContextSwitcher, llyfr_search_context_switcher, GTK_TY
 
 enum {
   SIGNAL_SELECT,
+  SIGNAL_SELECT_MANY,
   N_SIGNALS
 };
 
@@ -52,27 +57,72 @@ llyfr_search_context_switcher_new (void)
 }
 
 static void
-setup_listitem_cb (GtkListItemFactory *factory,
-                   GtkListItem        *list_item)
+context_toggled_cb (LlyfrSearchContextSwitcher *self,
+                    GtkCheckButton             *check)
+{
+  LlyfrSearchContext *context = g_object_get_data (G_OBJECT (check), "llyfr-context");
+
+  if (context == NULL)
+    return;
+
+  if (gtk_check_button_get_active (check))
+    g_hash_table_add (self->checked, g_object_ref (context));
+  else
+    g_hash_table_remove (self->checked, context);
+
+  gtk_widget_set_sensitive (GTK_WIDGET (self->search_selected_button),
+                            g_hash_table_size (self->checked) > 0);
+}
+
+static void
+setup_listitem_cb (GtkListItemFactory         *factory,
+                   GtkListItem                *list_item,
+                   LlyfrSearchContextSwitcher *self)
 {
+  GtkWidget *box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+  GtkWidget *check = gtk_check_button_new ();
   GtkWidget *label = gtk_label_new ("");
   gtk_widget_set_halign (GTK_WIDGET (label), GTK_ALIGN_START);
 
-  gtk_list_item_set_child (list_item, label);
+  g_signal_connect_object (check, "toggled",
+                           G_CALLBACK (context_toggled_cb), self,
+                           G_CONNECT_SWAPPED);
+
+  gtk_box_append (GTK_BOX (box), check);
+  gtk_box_append (GTK_BOX (box), label);
+  gtk_list_item_set_child (list_item, box);
 }
 
 static void
-bind_listitem_cb (GtkListItemFactory *factory,
-                  GtkListItem        *list_item)
+bind_listitem_cb (GtkListItemFactory         *factory,
+                  GtkListItem                *list_item,
+                  LlyfrSearchContextSwitcher *self)
 {
-  GtkWidget *label;
+  GtkWidget *box, *check, *label;
   LlyfrSearchContext *context;
 
-  label = gtk_list_item_get_child (list_item);
+  box = gtk_list_item_get_child (list_item);
+  check = gtk_widget_get_first_child (box);
+  label = gtk_widget_get_next_sibling (check);
   context = LLYFR_SEARCH_CONTEXT (gtk_list_item_get_item (list_item));
 
   gtk_label_set_label (GTK_LABEL (label),
                        llyfr_search_context_get_directory (context));
+
+  g_object_set_data (G_OBJECT (check), "llyfr-context", context);
+  gtk_check_button_set_active (GTK_CHECK_BUTTON (check),
+                               g_hash_table_contains (self->checked, context));
+}
+
+static void
+unbind_listitem_cb (GtkListItemFactory         *factory,
+                    GtkListItem                *list_item,
+                    LlyfrSearchContextSwitcher *self)
+{
+  GtkWidget *check = gtk_widget_get_first_child (gtk_list_item_get_child (list_item));
+
+  // Recycled rows shouldn't tick or untick the context they used to show.
+  g_object_set_data (G_OBJECT (check), "llyfr-context", NULL);
 }
 
 static void
@@ -91,6 +141,37 @@ activate_listitem_cb (LlyfrSearchContextSwitcher *self,
   context = g_list_model_get_item (model, position);
 
   g_signal_emit (self, signals[SIGNAL_SELECT], 0, context);
+  g_object_unref (context);
+}
+
+static void
+search_selected_cb (LlyfrSearchContextSwitcher *self, GtkButton *button)
+{
+  g_autoptr(GListStore) contexts = g_list_store_new (LLYFR_TYPE_SEARCH_CONTEXT);
+  GListModel *model;
+  guint n_items;
+
+  g_assert (LLYFR_IS_SEARCH_CONTEXT_SWITCHER (self));
+
+  if (self->current_model == NULL)
+    return;
+
+  // Walk the list rather than the hash table so the results come back in
+  // the same order the contexts are shown in.
+  model = G_LIST_MODEL (self->current_model);
+  n_items = g_list_model_get_n_items (model);
+
+  for (guint i = 0; i < n_items; i++) {
+    g_autoptr(LlyfrSearchContext) context = g_list_model_get_item (model, i);
+
+    if (g_hash_table_contains (self->checked, context))
+      g_list_store_append (contexts, context);
+  }
+
+  if (g_list_model_get_n_items (G_LIST_MODEL (contexts)) == 0)
+    return;
+
+  g_signal_emit (self, signals[SIGNAL_SELECT_MANY], 0, contexts);
 }
 
 static void
@@ -116,8 +197,9 @@ context_refresh_cb (LlyfrApplication           *app,
     g_object_unref (self->current_factory);
 
   self->current_factory = gtk_signal_list_item_factory_new ();
-  g_signal_connect (self->current_factory, "setup", G_CALLBACK (setup_listitem_cb), NULL);
-  g_signal_connect (self->current_factory, "bind", G_CALLBACK (bind_listitem_cb), NULL);
+  g_signal_connect (self->current_factory, "setup", G_CALLBACK (setup_listitem_cb), self);
+  g_signal_connect (self->current_factory, "bind", G_CALLBACK (bind_listitem_cb), self);
+  g_signal_connect (self->current_factory, "unbind", G_CALLBACK (unbind_listitem_cb), self);
 
   gtk_list_view_set_model (self->context_list,
                            GTK_SELECTION_MODEL (self->current_model));
@@ -159,6 +241,8 @@ llyfr_search_context_switcher_finalize (GObject *object)
   if (self->current_factory)
     g_object_unref (self->current_factory);
 
+  g_hash_table_unref (self->checked);
+
   G_OBJECT_CLASS (llyfr_search_context_switcher_parent_class)->finalize (object);
 }
 
@@ -171,11 +255,13 @@ llyfr_search_context_switcher_class_init (LlyfrSearchContextSwitcherClass *klass
   gtk_widget_class_set_template_from_resource (widget_class, "/io/github/swyddfa/Llyfrgell/gui/llyfr-search-context-switcher.ui");
   gtk_widget_class_bind_template_child (widget_class, LlyfrSearchContextSwitcher, context_list);
   gtk_widget_class_bind_template_child (widget_class, LlyfrSearchContextSwitcher, filter_entry);
+  gtk_widget_class_bind_template_child (widget_class, LlyfrSearchContextSwitcher, search_selected_button);
   gtk_widget_class_bind_template_child (widget_class, LlyfrSearchContextSwitcher, find_repo_button);
   gtk_widget_class_bind_template_child (widget_class, LlyfrSearchContextSwitcher, find_repo_spinner);
 
   gtk_widget_class_bind_template_callback (widget_class, find_repos_cb);
   gtk_widget_class_bind_template_callback (widget_class, activate_listitem_cb);
+  gtk_widget_class_bind_template_callback (widget_class, search_selected_cb);
 
   object_class->finalize = llyfr_search_context_switcher_finalize;
 
@@ -189,10 +275,23 @@ llyfr_search_context_switcher_class_init (LlyfrSearchContextSwitcherClass *klass
                                          G_TYPE_NONE,
                                          1,
                                          LLYFR_TYPE_SEARCH_CONTEXT);
+
+  signals[SIGNAL_SELECT_MANY] = g_signal_new ("select-many",
+                                              LLYFR_TYPE_SEARCH_CONTEXT_SWITCHER,
+                                              G_SIGNAL_RUN_LAST,
+                                              0,
+                                              NULL,
+                                              NULL,
+                                              NULL,
+                                              G_TYPE_NONE,
+                                              1,
+                                              G_TYPE_LIST_MODEL);
 }
 
 static void
 llyfr_search_context_switcher_init (LlyfrSearchContextSwitcher *self)
 {
   gtk_widget_init_template (GTK_WIDGET (self));
+
+  self->checked = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, NULL);
 }
@@ -22,20 +22,51 @@
 
 #include "llyfr-search-page.h"
 
+#include "llyfr-line-row.h"
+#include "llyfr-memory-stats.h"
+#include "llyfr-result-cache.h"
+#include "llyfr-result-lines.h"
+#include "llyfr-result-row.h"
 #include "llyfr-search-bar.h"
 #include "llyfr-search-result.h"
+#include "llyfr-trace.h"
+
+// How often the latency overlay is brought up to date while it's shown.
+#define LATENCY_REFRESH_MS 500
+
+// Column headings for the latency overlay, one per LlyfrTraceStage.
+static const gchar * const stage_headings[LLYFR_TRACE_N_STAGES] = {
+  [LLYFR_TRACE_QUEUED]  = "queue",
+  [LLYFR_TRACE_LIST]    = "list",
+  [LLYFR_TRACE_SPAWN]   = "spawn",
+  [LLYFR_TRACE_STARTUP] = "start",
+  [LLYFR_TRACE_RG]      = "rg",
+  [LLYFR_TRACE_DECODE]  = "decode",
+  [LLYFR_TRACE_BUILD]   = "build",
+  [LLYFR_TRACE_SCAN]    = "scan",
+  [LLYFR_TRACE_SPLICE]  = "splice",
+  [LLYFR_TRACE_TEXT]    = "text",
+};
 
 struct _LlyfrSearchPage
 {
   GtkBox              parent_instance;
 
+  GListModel         *current_results;
   GtkSelectionModel  *current_model;
   GtkListItemFactory *current_factory;
+  LlyfrResultCache   *text_cache;
+
+  GSettings          *settings;
+  guint               latency_source;
 
   AdwStatusPage      *status_page;
   LlyfrSearchBar     *search_bar;
+  GtkActionBar       *partial_bar;
+  GtkLabel           *partial_label;
   GtkScrolledWindow  *results_view;
   GtkListView        *results_list;
+  GtkLabel           *latency_label;
 };
 
 G_DEFINE_TYPE (LlyfrSearchPage, llyfr_search_page, GTK_TYPE_BOX)
@@ -53,89 +84,117 @@ llyfr_search_page_set_application (LlyfrSearchPage *self,
   llyfr_search_bar_set_application (self->search_bar, app);
 }
 
-static void
-setup_listitem_cb (GtkListItemFactory *factory,
-                   GtkListItem        *list_item)
+static gpointer
+build_result_text (LlyfrSearchResult *result,
+                   gsize             *cost,
+                   gpointer           user_data)
 {
-  GtkWidget *filepath = gtk_label_new ("");
-  GtkWidget *text_widget = gtk_text_view_new ();
-  GtkTextView *text_view = GTK_TEXT_VIEW (text_widget);
+  LlyfrSearchPage *self = LLYFR_SEARCH_PAGE (user_data);
+  LlyfrTrace *trace = llyfr_search_bar_get_trace (self->search_bar);
+  gint64 begin = llyfr_trace_begin (trace);
+  LlyfrResultText *text;
 
-  gtk_widget_set_halign (filepath, GTK_ALIGN_START);
-  gtk_widget_set_margin_start (filepath, 6);
+  text = llyfr_result_text_new (result, cost);
+  llyfr_trace_end (trace, LLYFR_TRACE_TEXT, begin);
 
-  gtk_text_view_set_editable (text_view, FALSE);
-  gtk_text_view_set_monospace (text_view, TRUE);
-  gtk_text_view_set_wrap_mode (text_view, GTK_WRAP_WORD);
-  gtk_text_view_set_pixels_below_lines (text_view, 1);
-  gtk_text_view_set_left_margin (text_view, 6);
-  gtk_text_view_set_top_margin (text_view, 6);
-  gtk_text_view_set_bottom_margin (text_view, 6);
-  gtk_text_view_set_gutter (text_view, GTK_TEXT_WINDOW_TOP, filepath);
+  return text;
+}
 
-  gtk_widget_set_css_classes (text_widget, (const char* []){"solarized", NULL});
+static void
+setup_listitem_cb (GtkListItemFactory *factory,
+                   GtkListItem        *list_item,
+                   LlyfrSearchPage    *self)
+{
+  LlyfrResultRow *row = llyfr_result_row_new ();
 
-  gtk_list_item_set_child (list_item, text_widget);
+  gtk_widget_set_css_classes (GTK_WIDGET (row), (const char* []){"solarized", NULL});
+  gtk_list_item_set_child (list_item, GTK_WIDGET (row));
 }
 
 static void
 bind_listitem_cb (GtkListItemFactory *factory,
-                  GtkListItem        *list_item)
+                  GtkListItem        *list_item,
+                  LlyfrSearchPage    *self)
 {
-
-  GtkLabel *filepath;
-  GtkWidget *top_gutter;
-  GtkTextView *text_view;
-  GtkTextBuffer *buffer;
+  g_autofree gchar *header = NULL;
+  LlyfrResultRow *row;
+  LlyfrResultText *text;
   LlyfrSearchResult *result;
 
   result = LLYFR_SEARCH_RESULT (gtk_list_item_get_item (list_item));
-  buffer = llyfr_search_result_get_text_buffer (result);
+  text = llyfr_result_cache_acquire (self->text_cache, result);
+  header = llyfr_search_result_dup_header (result);
 
-  text_view = GTK_TEXT_VIEW (gtk_list_item_get_child (list_item));
-  top_gutter = gtk_text_view_get_gutter (text_view, GTK_TEXT_WINDOW_TOP);
-  filepath = GTK_LABEL (gtk_widget_get_first_child (top_gutter));
-
-  gtk_label_set_text (filepath, llyfr_search_result_get_filepath (result));
-  gtk_text_view_set_buffer (text_view, g_object_ref (buffer));
+  row = LLYFR_RESULT_ROW (gtk_list_item_get_child (list_item));
+  llyfr_result_row_set_text (row, header, text);
 }
 
 static void
 unbind_listitem_cb (GtkListItemFactory *factory,
-                  GtkListItem        *list_item)
+                    GtkListItem        *list_item,
+                    LlyfrSearchPage    *self)
 {
-  GtkTextView *text_view;
+  LlyfrResultRow *row;
+  LlyfrSearchResult *result;
+
+  row = LLYFR_RESULT_ROW (gtk_list_item_get_child (list_item));
+  llyfr_result_row_set_text (row, NULL, NULL);
 
-  text_view = GTK_TEXT_VIEW (gtk_list_item_get_child (list_item));
-  gtk_text_view_set_buffer (text_view, NULL);
+  // Rows that scroll out of view hand their text back to the cache, which
+  // is then free to drop it.
+  result = LLYFR_SEARCH_RESULT (gtk_list_item_get_item (list_item));
+  if (result != NULL)
+    llyfr_result_cache_release (self->text_cache, result);
 }
 
 static void
-teardown_listitem_cb (GtkListItemFactory *factory,
-                      GtkListItem        *list_item)
+setup_line_cb (GtkListItemFactory *factory,
+               GtkListItem        *list_item,
+               LlyfrSearchPage    *self)
 {
-  GtkWidget *text_view =  gtk_list_item_get_child (list_item);
+  LlyfrLineRow *row = llyfr_line_row_new ();
 
-  if (text_view)
-    g_object_unref (text_view);
+  gtk_widget_set_css_classes (GTK_WIDGET (row), (const char* []){"solarized", NULL});
+  gtk_list_item_set_child (list_item, GTK_WIDGET (row));
 }
 
 static void
-search_cb (LlyfrSearchPage *self, GListModel *results, LlyfrSearchBar *search_bar)
+bind_line_cb (GtkListItemFactory *factory,
+              GtkListItem        *list_item,
+              LlyfrSearchPage    *self)
 {
-  g_assert (LLYFR_IS_SEARCH_PAGE (self));
-  g_assert (G_IS_LIST_MODEL (results));
-  g_assert (LLYFR_IS_SEARCH_BAR (search_bar));
+  LlyfrLineRow *row = LLYFR_LINE_ROW (gtk_list_item_get_child (list_item));
+  LlyfrTrace *trace = llyfr_search_bar_get_trace (self->search_bar);
+  gint64 begin = llyfr_trace_begin (trace);
+
+  llyfr_line_row_set_line (row, LLYFR_RESULT_LINE (gtk_list_item_get_item (list_item)));
 
-  if (g_list_model_get_n_items (results) == 0) {
-    adw_status_page_set_icon_name (self->status_page, "edit-clear");
-    adw_status_page_set_title (self->status_page, "No Results");
+  // Lines are cheap enough on their own that a mark each would be noise.
+  if (trace != NULL)
+    llyfr_trace_add (trace, LLYFR_TRACE_TEXT, g_get_monotonic_time () - begin);
+}
+
+static void
+unbind_line_cb (GtkListItemFactory *factory,
+                GtkListItem        *list_item,
+                LlyfrSearchPage    *self)
+{
+  LlyfrLineRow *row = LLYFR_LINE_ROW (gtk_list_item_get_child (list_item));
+  llyfr_line_row_set_line (row, NULL);
+}
 
-    gtk_widget_set_visible (GTK_WIDGET (self->results_view), FALSE);
-    gtk_widget_set_visible (GTK_WIDGET (self->status_page), TRUE);
+/*
+ * (Re)build the list view's model and factory for the current results,
+ * according to the results-layout setting.
+ */
+static void
+llyfr_search_page_update_view (LlyfrSearchPage *self)
+{
+  g_autofree gchar *layout = NULL;
+  GListModel *model;
 
+  if (self->current_results == NULL)
     return;
-  }
 
   if (self->current_model)
     g_object_unref (self->current_model);
@@ -143,32 +202,182 @@ search_cb (LlyfrSearchPage *self, GListModel *results, LlyfrSearchBar *search_ba
   if (self->current_factory)
     g_object_unref (self->current_factory);
 
-  self->current_model = GTK_SELECTION_MODEL (gtk_no_selection_new (results));
-
+  layout = g_settings_get_string (self->settings, "results-layout");
   self->current_factory = gtk_signal_list_item_factory_new ();
-  g_signal_connect (self->current_factory, "setup", G_CALLBACK (setup_listitem_cb), NULL);
-  g_signal_connect (self->current_factory, "bind", G_CALLBACK (bind_listitem_cb), NULL);
-  g_signal_connect (self->current_factory, "unbind", G_CALLBACK (unbind_listitem_cb), NULL);
-  g_signal_connect (self->current_factory, "teardown", G_CALLBACK (teardown_listitem_cb), NULL);
 
-  gtk_list_view_set_model (self->results_list,
-                           GTK_SELECTION_MODEL (self->current_model));
+  if (g_strcmp0 (layout, "lines") == 0) {
+    model = G_LIST_MODEL (llyfr_result_lines_new (self->current_results));
+
+    g_signal_connect (self->current_factory, "setup", G_CALLBACK (setup_line_cb), self);
+    g_signal_connect (self->current_factory, "bind", G_CALLBACK (bind_line_cb), self);
+    g_signal_connect (self->current_factory, "unbind", G_CALLBACK (unbind_line_cb), self);
+  } else {
+    model = g_object_ref (self->current_results);
+
+    g_signal_connect (self->current_factory, "setup", G_CALLBACK (setup_listitem_cb), self);
+    g_signal_connect (self->current_factory, "bind", G_CALLBACK (bind_listitem_cb), self);
+    g_signal_connect (self->current_factory, "unbind", G_CALLBACK (unbind_listitem_cb), self);
+  }
+
+  self->current_model = GTK_SELECTION_MODEL (gtk_no_selection_new (model));
+
+  // Swap the factory while there's no model, so nothing is bound to the wrong
+  // kind of row.
+  gtk_list_view_set_model (self->results_list, NULL);
   gtk_list_view_set_factory (self->results_list, self->current_factory);
+  gtk_list_view_set_model (self->results_list, self->current_model);
+}
+
+/*
+ * Fill the latency overlay with a row for each of the recent searches,
+ * newest first, with the milliseconds spent on each stage, followed by
+ * the memory results are holding on to.
+ */
+static gboolean
+llyfr_search_page_update_latency (gpointer user_data)
+{
+  LlyfrSearchPage *self = LLYFR_SEARCH_PAGE (user_data);
+  g_autoptr(GPtrArray) traces = llyfr_trace_get_recent ();
+  g_autoptr(GString) text = g_string_new (NULL);
+  g_autofree gchar *stats = NULL;
+
+  g_string_append_printf (text, "%-16s %8s", "search", "total");
+  for (guint stage = 0; stage < LLYFR_TRACE_N_STAGES; stage++)
+    g_string_append_printf (text, " %7s", stage_headings[stage]);
+
+  for (guint i = 0; i < traces->len; i++) {
+    LlyfrTrace *trace = g_ptr_array_index (traces, i);
+    g_autofree gchar *name = g_utf8_substring (llyfr_trace_get_name (trace), 0, 16);
+
+    g_string_append_printf (text, "\n%-16s %8.1f", name, llyfr_trace_get_duration (trace) / 1000.0);
+    for (guint stage = 0; stage < LLYFR_TRACE_N_STAGES; stage++)
+      g_string_append_printf (text, " %7.1f", llyfr_trace_get_stage (trace, stage) / 1000.0);
+  }
+
+  if (traces->len == 0)
+    g_string_append (text, "\nNothing traced yet, search for something");
+
+  stats = llyfr_memory_stats_to_string ();
+  g_string_append_printf (text, "\n\n%s", stats);
+
+  gtk_label_set_text (self->latency_label, text->str);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+show_latency_changed_cb (LlyfrSearchPage *self,
+                         const gchar     *key,
+                         GSettings       *settings)
+{
+  gboolean show = g_settings_get_boolean (settings, key);
+
+  gtk_widget_set_visible (GTK_WIDGET (self->latency_label), show);
+  g_clear_handle_id (&self->latency_source, g_source_remove);
+
+  if (!show)
+    return;
+
+  llyfr_search_page_update_latency (self);
+  self->latency_source = g_timeout_add (LATENCY_REFRESH_MS, llyfr_search_page_update_latency, self);
+}
+
+static void
+memory_stats_notify_cb (LlyfrSearchPage *self,
+                        GParamSpec      *pspec,
+                        GObject         *stats)
+{
+  // Only while the overlay is showing.
+  if (self->latency_source != 0)
+    llyfr_search_page_update_latency (self);
+}
+
+static void
+results_layout_changed_cb (LlyfrSearchPage *self,
+                           const gchar     *key,
+                           GSettings       *settings)
+{
+  llyfr_search_page_update_view (self);
+}
+
+static void
+search_cb (LlyfrSearchPage *self, GListModel *results, LlyfrSearchBar *search_bar)
+{
+  g_assert (LLYFR_IS_SEARCH_PAGE (self));
+  g_assert (G_IS_LIST_MODEL (results));
+  g_assert (LLYFR_IS_SEARCH_BAR (search_bar));
+
+  g_set_object (&self->current_results, results);
+  llyfr_search_page_update_view (self);
+
+  // Everything in the cache belongs to the previous search.
+  llyfr_result_cache_clear (self->text_cache);
 
   gtk_widget_set_visible (GTK_WIDGET (self->status_page), FALSE);
   gtk_widget_set_visible (GTK_WIDGET (self->results_view), TRUE);
+  gtk_action_bar_set_revealed (self->partial_bar, FALSE);
+}
+
+static void
+search_finished_cb (LlyfrSearchPage *self, GListModel *results, LlyfrSearchBar *search_bar)
+{
+  const gchar *message;
+
+  g_assert (LLYFR_IS_SEARCH_PAGE (self));
+  g_assert (G_IS_LIST_MODEL (results));
+  g_assert (LLYFR_IS_SEARCH_BAR (search_bar));
+
+  message = llyfr_search_bar_get_partial_message (search_bar);
+  if (message != NULL) {
+    g_autofree gchar *label = g_strdup_printf ("Partial results: %s", message);
+
+    gtk_label_set_label (self->partial_label, label);
+    gtk_action_bar_set_revealed (self->partial_bar, TRUE);
+  }
+
+  if (g_list_model_get_n_items (results) > 0)
+    return;
+
+  adw_status_page_set_icon_name (self->status_page, "edit-clear");
+  adw_status_page_set_title (self->status_page, "No Results");
+
+  gtk_widget_set_visible (GTK_WIDGET (self->results_view), FALSE);
+  gtk_widget_set_visible (GTK_WIDGET (self->status_page), TRUE);
+}
+
+static void
+continue_cb (LlyfrSearchPage *self, GtkButton *button)
+{
+  g_assert (LLYFR_IS_SEARCH_PAGE (self));
+
+  llyfr_search_bar_continue_search (self->search_bar);
 }
 
+/*
+ * Activating a matching line shows the lines around it, or hides them
+ * again. Only the lines layout has room for them.
+ */
 static void
 activate_listitem_cb (LlyfrSearchPage *self,
                       guint            position,
                       GtkListView     *list_view,
                       gpointer         unused)
 {
+  g_autoptr(GError) error = NULL;
+  GListModel *model;
+
   g_assert (LLYFR_IS_SEARCH_PAGE (self));
   g_assert (GTK_IS_LIST_VIEW (list_view));
 
-  g_message ("Activate!");
+  model = gtk_no_selection_get_model (GTK_NO_SELECTION (self->current_model));
+  if (!LLYFR_IS_RESULT_LINES (model))
+    return;
+
+  if (!llyfr_result_lines_toggle_context (LLYFR_RESULT_LINES (model),
+                                          position,
+                                          g_settings_get_uint (self->settings, "context-lines"),
+                                          &error))
+    g_message ("Unable to show context: %s", error->message);
 }
 
 static void
@@ -176,12 +385,18 @@ llyfr_search_page_finalize (GObject *object)
 {
   LlyfrSearchPage *self = LLYFR_SEARCH_PAGE (object);
 
+  g_clear_handle_id (&self->latency_source, g_source_remove);
+
   if (self->current_model)
     g_object_unref (self->current_model);
 
   if (self->current_factory)
     g_object_unref (self->current_factory);
 
+  g_clear_object (&self->current_results);
+  g_clear_object (&self->text_cache);
+  g_clear_object (&self->settings);
+
   G_OBJECT_CLASS (llyfr_search_page_parent_class)->finalize (object);
 }
 
@@ -196,10 +411,15 @@ llyfr_search_page_class_init (LlyfrSearchPageClass *klass)
   gtk_widget_class_set_template_from_resource (widget_class, "/io/github/swyddfa/Llyfrgell/gui/llyfr-search-page.ui");
   gtk_widget_class_bind_template_child (widget_class, LlyfrSearchPage, search_bar);
   gtk_widget_class_bind_template_child (widget_class, LlyfrSearchPage, status_page);
+  gtk_widget_class_bind_template_child (widget_class, LlyfrSearchPage, partial_bar);
+  gtk_widget_class_bind_template_child (widget_class, LlyfrSearchPage, partial_label);
   gtk_widget_class_bind_template_child (widget_class, LlyfrSearchPage, results_view);
   gtk_widget_class_bind_template_child (widget_class, LlyfrSearchPage, results_list);
+  gtk_widget_class_bind_template_child (widget_class, LlyfrSearchPage, latency_label);
 
   gtk_widget_class_bind_template_callback (widget_class, search_cb);
+  gtk_widget_class_bind_template_callback (widget_class, search_finished_cb);
+  gtk_widget_class_bind_template_callback (widget_class, continue_cb);
   gtk_widget_class_bind_template_callback (widget_class, activate_listitem_cb);
 
   object_class->finalize = llyfr_search_page_finalize;
@@ -209,4 +429,35 @@ static void
 llyfr_search_page_init (LlyfrSearchPage *self)
 {
   gtk_widget_init_template (GTK_WIDGET (self));
+
+  self->text_cache = llyfr_result_cache_new (build_result_text,
+                                             (GDestroyNotify) llyfr_result_text_free,
+                                             self);
+
+  self->settings = g_settings_new ("io.github.swyddfa.Llyfrgell");
+  g_settings_bind (self->settings, "result-cache-max-entries",
+                   self->text_cache, "max-entries",
+                   G_SETTINGS_BIND_GET);
+  g_settings_bind (self->settings, "result-cache-max-size",
+                   self->text_cache, "max-size",
+                   G_SETTINGS_BIND_GET);
+
+  g_signal_connect_object (self->settings, "changed::results-layout",
+                           G_CALLBACK (results_layout_changed_cb), self,
+                           G_CONNECT_SWAPPED);
+
+  // GSettings only reports changes to keys that have been read at least once.
+  g_free (g_settings_get_string (self->settings, "results-layout"));
+
+  g_signal_connect_object (self->settings, "changed::show-latency-overlay",
+                           G_CALLBACK (show_latency_changed_cb), self,
+                           G_CONNECT_SWAPPED);
+  show_latency_changed_cb (self, "show-latency-overlay", self->settings);
+
+  g_signal_connect_object (llyfr_memory_stats_get_default (), "notify::matches",
+                           G_CALLBACK (memory_stats_notify_cb), self,
+                           G_CONNECT_SWAPPED);
+  g_signal_connect_object (llyfr_memory_stats_get_default (), "notify::buffers",
+                           G_CALLBACK (memory_stats_notify_cb), self,
+                           G_CONNECT_SWAPPED);
 }
@@ -19,22 +19,42 @@
  */
 #define G_LOG_DOMAIN "llyfr-application"
 
+#include <glib/gstdio.h>
+
 #include "llyfr-application.h"
+#include "llyfr-catalog.h"
+#include "llyfr-memory-stats.h"
+#include "llyfr-native-backend.h"
+#include "llyfr-repo-monitor.h"
+#include "llyfr-repo-walker.h"
 #include "llyfr-search-context.h"
+#include "llyfr-trace.h"
 #include "llyfr-window.h"
 
 
 struct _LlyfrApplication
 {
-  GtkApplication  application;
+  GtkApplication     application;
+
+  GListStore        *search_contexts;
+  GSettings         *settings;
 
-  GListStore     *search_contexts;
+  LlyfrRepoMonitor  *repo_monitor;
+  guint              rescan_source_id;
+  guint              save_source_id;
 
-  GtkWindow      *window;
+  // Only while scanning for repositories.
+  GCancellable      *scan;
+  GListStore        *found_contexts;
+  GHashTable        *known_directories;
+
+  GtkWindow         *window;
 };
 
 G_DEFINE_TYPE (LlyfrApplication, llyfr_application, GTK_TYPE_APPLICATION)
 
+#define CATALOG_SAVE_DELAY_SECONDS 5
+
 enum
 {
   SIGNAL_CONTEXT_REFRESH,
@@ -52,47 +72,113 @@ llyfr_application_quit (GSimpleAction *simple,
   gtk_window_destroy (self->window);
 }
 
+static gboolean
+save_catalog_cb (gpointer user_data)
+{
+  LlyfrApplication *self = LLYFR_APPLICATION (user_data);
+  g_autofree gchar *catalog_path = llyfr_catalog_get_default_path ();
+  g_autoptr(GError) error = NULL;
+
+  self->save_source_id = 0;
+
+  if (!llyfr_catalog_save (catalog_path, G_LIST_MODEL (self->search_contexts), &error))
+    g_message ("Unable to save catalog: %s", error->message);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+contexts_changed_cb (LlyfrApplication *self,
+                     guint             position,
+                     guint             removed,
+                     guint             added,
+                     GListModel       *contexts)
+{
+  // Whether it came from the scan or the repo monitor, make sure the scan
+  // doesn't add the same repository again.
+  if (self->known_directories != NULL) {
+    for (guint i = position; i < position + added; i++) {
+      g_autoptr(LlyfrSearchContext) context = g_list_model_get_item (contexts, i);
+      g_hash_table_add (self->known_directories, g_strdup (llyfr_search_context_get_directory (context)));
+    }
+  }
+
+  // A scan saves the catalog once it's done, otherwise changes found by the
+  // repo monitor are saved once things have settled down.
+  if (self->scan == NULL && self->save_source_id == 0)
+    self->save_source_id = g_timeout_add_seconds (CATALOG_SAVE_DELAY_SECONDS, save_catalog_cb, self);
+}
+
+static gboolean
+rescan_cb (gpointer user_data)
+{
+  g_action_group_activate_action (G_ACTION_GROUP (user_data), "scan-git-repos", NULL);
+  return G_SOURCE_CONTINUE;
+}
+
+/*
+ * Adds repositories to the list as the scan finds them, skipping any we
+ * already knew about.
+ */
+static void
+repos_found_cb (LlyfrApplication *self,
+                guint             position,
+                guint             removed,
+                guint             added,
+                GListModel       *found)
+{
+  for (guint i = position; i < position + added; i++) {
+    g_autoptr(LlyfrSearchContext) context = g_list_model_get_item (found, i);
+    const gchar *directory = llyfr_search_context_get_directory (context);
+
+    if (g_hash_table_contains (self->known_directories, directory))
+      continue;
+
+    g_debug ("%s", directory);
+    g_list_store_append (self->search_contexts, context);
+  }
+}
+
 static void
 populate_search_contexts_cb (GObject      *object,
                              GAsyncResult *result,
                              gpointer      user_data)
 {
-  LlyfrApplication *self = LLYFR_APPLICATION (user_data);
-  g_autoptr(GSubprocess) process = G_SUBPROCESS (object);
-  g_autoptr(GInputStream) instream = NULL;
-  g_autoptr(GDataInputStream) stream = NULL;
+  g_autoptr(LlyfrApplication) self = LLYFR_APPLICATION (user_data);
+  g_autoptr(GListStore) found = g_steal_pointer (&self->found_contexts);
   g_autoptr(GError) error = NULL;
-  g_autofree gchar *stdout_buf = NULL;
+  g_autofree gchar *catalog_path = NULL;
+  g_autofree const gchar **directories = NULL;
+  guint n_found;
 
-  char* filepath = NULL;
-  gsize length = 0;
+  g_clear_object (&self->scan);
+  g_clear_pointer (&self->known_directories, g_hash_table_unref);
+  g_signal_handlers_disconnect_by_data (found, self);
 
-  if (!g_subprocess_communicate_utf8_finish (process, result, &stdout_buf, NULL, &error)) {
-    gchar *message = error != NULL ? error->message : "Unable to finish process";
-    g_message ("%s", message);
+  if (!llyfr_repo_walker_walk_finish (LLYFR_REPO_WALKER (object), result, &error)) {
+    if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      g_message ("Unable to scan for repositories: %s", error->message);
 
     return;
   }
 
-  if (!self->search_contexts)
-    self->search_contexts = g_list_store_new (LLYFR_TYPE_SEARCH_CONTEXT);
-
-  g_list_store_remove_all (self->search_contexts);
-
-  instream = g_memory_input_stream_new_from_data (stdout_buf, -1, NULL);
-  stream = g_data_input_stream_new (instream);
-
-  while ((filepath = g_data_input_stream_read_line_utf8 (stream, &length, NULL, &error))) {
-    g_autoptr(LlyfrSearchContext) search_context = NULL;
+  // Everything found has been added already, this drops anything that has
+  // since disappeared.
+  n_found = g_list_model_get_n_items (G_LIST_MODEL (found));
+  directories = g_new0 (const gchar *, n_found + 1);
 
-    g_debug ("%s", filepath);
-    search_context = llyfr_search_context_new (filepath);
-    g_list_store_append (self->search_contexts, search_context);
+  for (guint i = 0; i < n_found; i++) {
+    g_autoptr(LlyfrSearchContext) context = g_list_model_get_item (G_LIST_MODEL (found), i);
 
-    g_free (filepath);
+    // found keeps the context alive once this reference is gone.
+    directories[i] = llyfr_search_context_get_directory (context);
   }
 
-  // TODO: Save this list of contexts somewhere.
+  llyfr_catalog_reconcile (self->search_contexts, (const gchar * const *) directories);
+
+  catalog_path = llyfr_catalog_get_default_path ();
+  if (!llyfr_catalog_save (catalog_path, G_LIST_MODEL (self->search_contexts), &error))
+    g_message ("Unable to save catalog: %s", error->message);
 
   g_signal_emit (self, signals[SIGNAL_CONTEXT_REFRESH], 0, self->search_contexts);
 }
@@ -103,31 +189,185 @@ llyfr_application_scan_git_repos (GSimpleAction *simple,
                                   gpointer       user_data)
 {
   LlyfrApplication *self = LLYFR_APPLICATION (user_data);
-  g_autoptr(GError) error = NULL;
-  GSubprocess *process = NULL;
-  const gchar *home_dir = g_get_home_dir ();
-
-  process = g_subprocess_new (G_SUBPROCESS_FLAGS_STDOUT_PIPE, &error,
-                              "flatpak-spawn", "--host",
-                              "find", home_dir,
-                              "-iname", ".git",
-                              "-type", "d",
-                              "-exec", "bash", "-c",
-                              "printf \"%s\n\" ${0:0: -5}", "{}", ";",
-                              NULL);
-
-  if (process == NULL) {
-    gchar *message = error != NULL ? error->message : "Unable to create process";
-    g_message ("%s", message);
+  g_autoptr(LlyfrRepoWalker) walker = NULL;
+  g_auto(GStrv) excludes = NULL;
+  guint n_contexts;
+
+  // Already scanning.
+  if (self->scan != NULL)
     return;
+
+  self->known_directories = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  n_contexts = g_list_model_get_n_items (G_LIST_MODEL (self->search_contexts));
+
+  for (guint i = 0; i < n_contexts; i++) {
+    g_autoptr(LlyfrSearchContext) context = g_list_model_get_item (G_LIST_MODEL (self->search_contexts), i);
+    g_hash_table_add (self->known_directories, g_strdup (llyfr_search_context_get_directory (context)));
+  }
+
+  excludes = g_settings_get_strv (self->settings, "discovery-excludes");
+
+  walker = llyfr_repo_walker_new (g_get_home_dir ());
+  llyfr_repo_walker_set_excludes (walker, (const gchar * const *) excludes);
+  llyfr_repo_walker_set_submodules (walker, g_settings_get_boolean (self->settings, "discovery-submodules"));
+
+  self->found_contexts = g_list_store_new (LLYFR_TYPE_SEARCH_CONTEXT);
+  g_signal_connect_swapped (self->found_contexts, "items-changed", G_CALLBACK (repos_found_cb), self);
+
+  self->scan = g_cancellable_new ();
+  llyfr_repo_walker_walk_async (walker,
+                                self->found_contexts,
+                                self->scan,
+                                populate_search_contexts_cb,
+                                g_object_ref (self));
+}
+
+/*
+ * Make the repositories found last time available straight away. Returns
+ * TRUE if the catalog is recent enough that there's no need to scan for
+ * repositories again just yet.
+ */
+static gboolean
+llyfr_application_load_catalog (LlyfrApplication *self)
+{
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *catalog_path = llyfr_catalog_get_default_path ();
+  GListStore *contexts;
+  GStatBuf buf;
+  guint interval;
+  gint64 age;
+
+  contexts = llyfr_catalog_load (catalog_path, &error);
+  if (contexts == NULL) {
+    if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+      g_message ("Unable to load catalog: %s", error->message);
+
+    return FALSE;
   }
 
-  g_subprocess_communicate_async (process, NULL, NULL,
-                                  populate_search_contexts_cb, self);
+  g_clear_object (&self->search_contexts);
+  self->search_contexts = contexts;
+
+  interval = g_settings_get_uint (self->settings, "discovery-rescan-interval");
+  if (interval == 0)
+    return TRUE;
+
+  if (g_stat (catalog_path, &buf) != 0)
+    return FALSE;
+
+  age = g_get_real_time () / G_USEC_PER_SEC - buf.st_mtime;
+  return age >= 0 && age < (gint64) interval * 3600;
+}
+
+/*
+ * Once the list of repositories is known it's kept up to date by watching
+ * for new ones, with a full scan every so often to catch anything missed.
+ */
+static void
+llyfr_application_watch_repos (LlyfrApplication *self)
+{
+  g_auto(GStrv) excludes = g_settings_get_strv (self->settings, "discovery-excludes");
+  const gchar *roots[] = { g_get_home_dir (), NULL };
+  guint interval = g_settings_get_uint (self->settings, "discovery-rescan-interval");
+
+  self->repo_monitor = llyfr_repo_monitor_new (self->search_contexts, roots);
+  llyfr_repo_monitor_set_excludes (self->repo_monitor, (const gchar * const *) excludes);
+
+  g_signal_connect_object (self->search_contexts, "items-changed",
+                           G_CALLBACK (contexts_changed_cb), self,
+                           G_CONNECT_SWAPPED);
+
+  if (interval > 0)
+    self->rescan_source_id = g_timeout_add_seconds (interval * 3600, rescan_cb, self);
+}
+
+static void
+max_running_searches_changed_cb (LlyfrApplication *self,
+                                 const gchar      *key,
+                                 GSettings        *settings)
+{
+  llyfr_search_context_set_max_running_searches (g_settings_get_uint (settings, key));
+}
+
+static void
+search_budget_changed_cb (LlyfrApplication *self,
+                          const gchar      *key,
+                          GSettings        *settings)
+{
+  LlyfrSearchBudget budget;
+
+  budget.max_time = g_settings_get_uint (settings, "search-max-time");
+  budget.max_matches = g_settings_get_uint (settings, "search-max-matches");
+  budget.max_file_matches = g_settings_get_uint (settings, "search-max-file-matches");
+  budget.max_text = g_settings_get_uint64 (settings, "search-max-size");
+
+  llyfr_search_context_set_default_budget (&budget);
+}
+
+static void
+search_backend_changed_cb (LlyfrApplication *self,
+                           const gchar      *key,
+                           GSettings        *settings)
+{
+  g_autofree gchar *name = g_settings_get_string (settings, key);
+  g_autoptr(LlyfrSearchBackend) backend = NULL;
+
+  if (g_strcmp0 (name, "native") == 0)
+    backend = llyfr_native_backend_new ();
+
+  llyfr_search_context_set_default_backend (backend);
+}
+
+static void
+trigram_index_changed_cb (LlyfrApplication *self,
+                          const gchar      *key,
+                          GSettings        *settings)
+{
+  llyfr_search_context_set_indexing_enabled (g_settings_get_boolean (settings, key));
+}
+
+static void
+git_file_list_changed_cb (LlyfrApplication *self,
+                          const gchar      *key,
+                          GSettings        *settings)
+{
+  llyfr_search_context_set_git_files_enabled (g_settings_get_boolean (settings, key));
+}
+
+static void
+rank_results_changed_cb (LlyfrApplication *self,
+                         const gchar      *key,
+                         GSettings        *settings)
+{
+  llyfr_search_context_set_ranking_enabled (g_settings_get_boolean (settings, key));
+}
+
+static void
+show_latency_overlay_changed_cb (LlyfrApplication *self,
+                                 const gchar      *key,
+                                 GSettings        *settings)
+{
+  // Only trace searches while there's somewhere to show them.
+  llyfr_trace_set_enabled (g_settings_get_boolean (settings, key));
+}
+
+/*
+ * Log how much memory results are holding on to, for debugging. Run it with
+ * gapplication action io.github.swyddfa.Llyfrgell memory-stats
+ */
+static void
+llyfr_application_memory_stats (GSimpleAction *simple,
+                                GVariant      *parameter,
+                                gpointer       user_data)
+{
+  g_autofree gchar *stats = llyfr_memory_stats_to_string ();
+
+  g_message ("Memory: %s", stats);
 }
 
 static const GActionEntry llyfr_application_entries[] = {
     { .name = "scan-git-repos", .activate = llyfr_application_scan_git_repos },
+    { .name = "memory-stats",   .activate = llyfr_application_memory_stats },
     { .name = "quit",           .activate = llyfr_application_quit }
 };
 
@@ -151,6 +391,9 @@ static void
 llyfr_application_startup (GApplication *application)
 {
   GtkCssProvider *provider;
+  GAction *layout_action;
+  GAction *latency_action;
+  gboolean fresh;
   GtkApplication *gtk_app = GTK_APPLICATION (application);
   LlyfrApplication *self = LLYFR_APPLICATION (application);
 
@@ -161,6 +404,60 @@ llyfr_application_startup (GApplication *application)
                                    G_N_ELEMENTS (llyfr_application_entries),
                                    self);
 
+  self->settings = g_settings_new ("io.github.swyddfa.Llyfrgell");
+  layout_action = g_settings_create_action (self->settings, "results-layout");
+  g_action_map_add_action (G_ACTION_MAP (self), layout_action);
+  g_object_unref (layout_action);
+
+  latency_action = g_settings_create_action (self->settings, "show-latency-overlay");
+  g_action_map_add_action (G_ACTION_MAP (self), latency_action);
+  g_object_unref (latency_action);
+
+  g_signal_connect_object (self->settings, "changed::max-running-searches",
+                           G_CALLBACK (max_running_searches_changed_cb), self,
+                           G_CONNECT_SWAPPED);
+  max_running_searches_changed_cb (self, "max-running-searches", self->settings);
+
+  // Any of the limits changing updates the lot.
+  g_signal_connect_object (self->settings, "changed::search-max-time",
+                           G_CALLBACK (search_budget_changed_cb), self,
+                           G_CONNECT_SWAPPED);
+  g_signal_connect_object (self->settings, "changed::search-max-matches",
+                           G_CALLBACK (search_budget_changed_cb), self,
+                           G_CONNECT_SWAPPED);
+  g_signal_connect_object (self->settings, "changed::search-max-file-matches",
+                           G_CALLBACK (search_budget_changed_cb), self,
+                           G_CONNECT_SWAPPED);
+  g_signal_connect_object (self->settings, "changed::search-max-size",
+                           G_CALLBACK (search_budget_changed_cb), self,
+                           G_CONNECT_SWAPPED);
+  search_budget_changed_cb (self, NULL, self->settings);
+
+  g_signal_connect_object (self->settings, "changed::search-backend",
+                           G_CALLBACK (search_backend_changed_cb), self,
+                           G_CONNECT_SWAPPED);
+  search_backend_changed_cb (self, "search-backend", self->settings);
+
+  g_signal_connect_object (self->settings, "changed::trigram-index",
+                           G_CALLBACK (trigram_index_changed_cb), self,
+                           G_CONNECT_SWAPPED);
+  trigram_index_changed_cb (self, "trigram-index", self->settings);
+
+  g_signal_connect_object (self->settings, "changed::git-file-list",
+                           G_CALLBACK (git_file_list_changed_cb), self,
+                           G_CONNECT_SWAPPED);
+  git_file_list_changed_cb (self, "git-file-list", self->settings);
+
+  g_signal_connect_object (self->settings, "changed::rank-results",
+                           G_CALLBACK (rank_results_changed_cb), self,
+                           G_CONNECT_SWAPPED);
+  rank_results_changed_cb (self, "rank-results", self->settings);
+
+  g_signal_connect_object (self->settings, "changed::show-latency-overlay",
+                           G_CALLBACK (show_latency_overlay_changed_cb), self,
+                           G_CONNECT_SWAPPED);
+  show_latency_overlay_changed_cb (self, "show-latency-overlay", self->settings);
+
   G_APPLICATION_CLASS (llyfr_application_parent_class)->startup (application);
 
   provider = gtk_css_provider_new ();
@@ -171,8 +468,15 @@ llyfr_application_startup (GApplication *application)
 
   self->window = GTK_WINDOW (llyfr_window_new (gtk_app));
 
-  // TODO: Look to see if there's an existing list of contexts we can load from
-  // somewhere.
+  fresh = llyfr_application_load_catalog (self);
+  if (self->search_contexts == NULL)
+    self->search_contexts = g_list_store_new (LLYFR_TYPE_SEARCH_CONTEXT);
+
+  g_signal_emit (self, signals[SIGNAL_CONTEXT_REFRESH], 0, self->search_contexts);
+  llyfr_application_watch_repos (self);
+
+  if (!fresh)
+    g_action_group_activate_action (G_ACTION_GROUP (self), "scan-git-repos", NULL);
 }
 
 static void
@@ -180,7 +484,12 @@ llyfr_application_finalize (GObject *object)
 {
   LlyfrApplication *self = LLYFR_APPLICATION (object);
 
+  g_clear_handle_id (&self->rescan_source_id, g_source_remove);
+  g_clear_handle_id (&self->save_source_id, g_source_remove);
+
+  g_clear_object (&self->repo_monitor);
   g_clear_object (&self->search_contexts);
+  g_clear_object (&self->settings);
 
   G_OBJECT_CLASS (llyfr_application_parent_class)->finalize (object);
 }